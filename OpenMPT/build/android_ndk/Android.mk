@@ -35,6 +35,7 @@ LOCAL_SRC_FILES := \
 	soundlib/Dither.cpp \
 	soundlib/Dlsbank.cpp \
 	soundlib/Fastmix.cpp \
+	soundlib/IntMixerSIMD.cpp \
 	soundlib/ITCompression.cpp \
 	soundlib/ITTools.cpp \
 	soundlib/Load_669.cpp \
@@ -70,6 +71,7 @@ LOCAL_SRC_FILES := \
 	soundlib/MIDIEvents.cpp \
 	soundlib/MIDIMacros.cpp \
 	soundlib/MixerLoops.cpp \
+	soundlib/MixerOutput.cpp \
 	soundlib/MixerSettings.cpp \
 	soundlib/Mmcmp.cpp \
 	soundlib/ModChannel.cpp \
@@ -79,12 +81,16 @@ LOCAL_SRC_FILES := \
 	soundlib/ModSequence.cpp \
 	soundlib/modsmp_ctrl.cpp \
 	soundlib/mod_specifications.cpp \
+	soundlib/ParallelMixer.cpp \
 	soundlib/patternContainer.cpp \
 	soundlib/pattern.cpp \
 	soundlib/RowVisitor.cpp \
 	soundlib/S3MTools.cpp \
+	soundlib/SampleDataStore.cpp \
 	soundlib/SampleFormats.cpp \
+	soundlib/SampleFormatConvertersSIMD.cpp \
 	soundlib/SampleIO.cpp \
+	soundlib/SeekIndex.cpp \
 	soundlib/Sndfile.cpp \
 	soundlib/Snd_flt.cpp \
 	soundlib/Snd_fx.cpp \
@@ -99,6 +105,10 @@ LOCAL_SRC_FILES := \
 	soundlib/WAVTools.cpp \
 	soundlib/WindowedFIR.cpp \
 	soundlib/XMTools.cpp \
+	sounddsp/AGC.cpp \
+	sounddsp/DSP.cpp \
+	sounddsp/EQ.cpp \
+	sounddsp/Reverb.cpp \
 	test/TestToolsLib.cpp \
 	test/test.cpp
 
@@ -30,6 +30,7 @@ svn export ./README.md       bin/dist-autotools/README.md
 svn export ./TODO            bin/dist-autotools/TODO
 svn export ./common          bin/dist-autotools/common
 svn export ./soundlib        bin/dist-autotools/soundlib
+svn export ./sounddsp        bin/dist-autotools/sounddsp
 svn export ./test            bin/dist-autotools/test
 svn export ./libopenmpt      bin/dist-autotools/libopenmpt
 mkdir bin/dist-autotools/src
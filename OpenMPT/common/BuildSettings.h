@@ -70,6 +70,47 @@
 
 
 
+// SSE2 (DSP effects), SSE4.1 and AVX2 code is written with compiler intrinsics instead of inline assembly, so it can also be used in library builds.
+#if MPT_COMPILER_MSVC
+#if defined(_M_IX86) || defined(_M_X64)
+#define MPT_INTRINSICS_X86 1
+#endif
+#elif MPT_COMPILER_GCC
+#if MPT_GCC_AT_LEAST(4,9,0) && (defined(__i386__) || defined(__x86_64__))
+#define MPT_INTRINSICS_X86 1
+#endif
+#elif MPT_COMPILER_CLANG
+#if MPT_CLANG_AT_LEAST(3,8,0) && (defined(__i386__) || defined(__x86_64__))
+#define MPT_INTRINSICS_X86 1
+#endif
+#endif
+
+#if defined(MPT_INTRINSICS_X86)
+
+// Generate SSE4.1 intrinsics (only used when the CPU supports it).
+#define ENABLE_SSE4
+
+#if !MPT_COMPILER_MSVC || MPT_MSVC_AT_LEAST(2012,0)
+// Generate AVX2 intrinsics (only used when the CPU and the operating system support it).
+#define ENABLE_AVX2
+#endif
+
+// Functions using SSE2, SSE4.1 or AVX2 intrinsics are compiled with function-specific target attributes,
+// so no special compiler flags are required.
+#if MPT_COMPILER_GCC || MPT_COMPILER_CLANG
+#define MPT_TARGET_SSE2 __attribute__((target("sse2")))
+#define MPT_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define MPT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MPT_TARGET_SSE2
+#define MPT_TARGET_SSE4
+#define MPT_TARGET_AVX2
+#endif
+
+#endif // MPT_INTRINSICS_X86
+
+
+
 #if defined(MODPLUG_TRACKER) && defined(LIBOPENMPT_BUILD)
 
 #error "either MODPLUG_TRACKER or LIBOPENMPT_BUILD has to be defined"
@@ -139,6 +180,9 @@
 // Define to build without miniz support
 #define NO_MINIZ
 
+// Define to build without std::thread based multithreading in the sound library (not supported by all compilers used to build OpenMPT)
+#define NO_THREADS
+
 // Define to build without MP3 import support (via mpg123)
 //#define NO_MP3_SAMPLES
 
@@ -165,10 +209,10 @@
 #define MPT_FILEREADER_STD_ISTREAM
 //#define MPT_EXTERNAL_SAMPLES
 #define NO_ARCHIVE_SUPPORT
-#define NO_REVERB
-#define NO_DSP
-#define NO_EQ
-#define NO_AGC
+//#define NO_REVERB
+//#define NO_DSP
+//#define NO_EQ
+//#define NO_AGC
 #define NO_ASIO
 #define NO_VST
 #define NO_PORTAUDIO
@@ -184,6 +228,11 @@
 #define NO_ZLIB
 #endif
 #endif
+#if !defined(MPT_WITH_THREADS)
+#ifndef NO_THREADS
+#define NO_THREADS
+#endif
+#endif
 //#define NO_MINIZ
 #define NO_MP3_SAMPLES
 //#define NO_LIBOPENMPT_C
@@ -291,14 +340,6 @@
 
 // fixing stuff up
 
-#if !defined(ENABLE_MMX) && !defined(NO_REVERB)
-#define NO_REVERB // reverb requires mmx
-#endif
-
-#if !defined(ENABLE_X86) && !defined(NO_DSP)
-#define NO_DSP // DSP requires x86 inline asm
-#endif
-
 #if defined(ENABLE_TESTS) && defined(MODPLUG_NO_FILESAVE)
 #undef MODPLUG_NO_FILESAVE // tests recommend file saving
 #endif
@@ -336,6 +377,10 @@
 #define MPT_WITH_PATHSTRING // disk file io requires PathString
 #endif
 
+#if defined(MPT_FILEREADER_STD_ISTREAM) && !MPT_OS_WINDOWS && !MPT_OS_EMSCRIPTEN && !MPT_OS_UNKNOWN
+#define MPT_FILEREADER_MMAP // POSIX systems can map module files into memory
+#endif
+
 #if defined(MPT_WITH_DYNBIND) && !defined(MPT_WITH_PATHSTRING)
 #define MPT_WITH_PATHSTRING // dynamic library loading requires PathString
 #endif
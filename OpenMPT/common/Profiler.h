@@ -35,6 +35,7 @@ public:
 		GUI,
 		Audio,
 		Notify,
+		Mixer,
 		CategoriesCount
 	};
 	static std::vector<std::string> GetCategoryNames()
@@ -43,6 +44,7 @@ public:
 		ret.push_back("GUI");
 		ret.push_back("Audio");
 		ret.push_back("Notify");
+		ret.push_back("Mixer");
 		return ret;
 	}
 public:
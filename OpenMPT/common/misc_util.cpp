@@ -15,6 +15,9 @@
 #include <sstream>
 
 #include <time.h>
+#if !MPT_OS_WINDOWS
+#include <sys/time.h>
+#endif
 
 #if defined(MPT_WITH_DYNBIND)
 #if !MPT_OS_WINDOWS
@@ -139,6 +142,40 @@ time_t MakeGmTime(tm *timeUtc)
 	#endif // MPT_COMPILER_MSVC
 }
 
+
+uint64 GetTimestampMicroseconds()
+//-------------------------------
+{
+	#if MPT_OS_WINDOWS
+		LARGE_INTEGER frequency, counter;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&counter);
+		return static_cast<uint64>(counter.QuadPart / frequency.QuadPart) * 1000000 + static_cast<uint64>(counter.QuadPart % frequency.QuadPart) * 1000000 / static_cast<uint64>(frequency.QuadPart);
+	#else // !MPT_OS_WINDOWS
+		timeval tv;
+		gettimeofday(&tv, nullptr);
+		return static_cast<uint64>(tv.tv_sec) * 1000000 + static_cast<uint64>(tv.tv_usec);
+	#endif // MPT_OS_WINDOWS
+}
+
+
+uint64 GetTimestampNanoseconds()
+//------------------------------
+{
+	#if MPT_OS_WINDOWS
+		LARGE_INTEGER frequency, counter;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&counter);
+		return static_cast<uint64>(counter.QuadPart / frequency.QuadPart) * 1000000000 + static_cast<uint64>(counter.QuadPart % frequency.QuadPart) * 1000000000 / static_cast<uint64>(frequency.QuadPart);
+	#elif defined(CLOCK_MONOTONIC)
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<uint64>(ts.tv_sec) * 1000000000 + static_cast<uint64>(ts.tv_nsec);
+	#else
+		return GetTimestampMicroseconds() * 1000;
+	#endif // MPT_OS_WINDOWS
+}
+
 } // namespace Util
 
 
@@ -232,16 +269,28 @@ uint64 MultimediaClock::NowNanoseconds() const
 #endif // MODPLUG_TRACKER
 
 
-#if defined(ENABLE_ASM)
+#if defined(ENABLE_ASM) || defined(ENABLE_SSE4)
 
 
 uint32 ProcSupport = 0;
 
 
-#if MPT_COMPILER_MSVC && (defined(ENABLE_X86) || defined(ENABLE_X64))
+#if !defined(MODPLUG_TRACKER)
+// Library builds have no central initialization point, so the processor features are detected when the library is loaded.
+static struct ProcSupportInitializer
+{
+	ProcSupportInitializer() { InitProcSupport(); }
+} procSupportInitializer;
+#endif // !MODPLUG_TRACKER
+
+
+#if MPT_COMPILER_MSVC && (defined(ENABLE_X86) || defined(ENABLE_X64) || defined(ENABLE_SSE4))
 
 
 #include <intrin.h>
+#ifdef ENABLE_AVX2
+#include <immintrin.h>
+#endif
 
 
 typedef char cpuid_result_string[12];
@@ -286,6 +335,22 @@ static cpuid_result cpuid(uint32 function)
 }
 
 
+#ifdef ENABLE_AVX2
+static cpuid_result cpuidex(uint32 function, uint32 subfunction)
+//--------------------------------------------------------------
+{
+	cpuid_result result;
+	int CPUInfo[4];
+	__cpuidex(CPUInfo, function, subfunction);
+	result.a = CPUInfo[0];
+	result.b = CPUInfo[1];
+	result.c = CPUInfo[2];
+	result.d = CPUInfo[3];
+	return result;
+}
+#endif // ENABLE_AVX2
+
+
 static bool has_cpuid()
 //---------------------
 {
@@ -313,6 +378,16 @@ void InitProcSupport()
 		if(StandardFeatureFlags.d & (1<<25)) ProcSupport |= PROCSUPPORT_SSE;
 		if(StandardFeatureFlags.d & (1<<26)) ProcSupport |= PROCSUPPORT_SSE2;
 		if(StandardFeatureFlags.c & (1<< 0)) ProcSupport |= PROCSUPPORT_SSE3;
+		if(StandardFeatureFlags.c & (1<<19)) ProcSupport |= PROCSUPPORT_SSE4_1;
+
+#ifdef ENABLE_AVX2
+		// AVX2 also requires the operating system to save the YMM registers (OSXSAVE and AVX flags, XCR0 bits 1 and 2)
+		if(VendorString.a >= 0x00000007u && (StandardFeatureFlags.c & (1<<27)) && (StandardFeatureFlags.c & (1<<28)) && (_xgetbv(0) & 0x6) == 0x6)
+		{
+			cpuid_result ExtendedFeatureFlags = cpuidex(0x00000007u, 0);
+			if(ExtendedFeatureFlags.b & (1<< 5)) ProcSupport |= PROCSUPPORT_AVX2;
+		}
+#endif // ENABLE_AVX2
 
 		if(VendorString.as_string() == "AuthenticAMD")
 		{
@@ -329,6 +404,25 @@ void InitProcSupport()
 }
 
 
+#elif (MPT_COMPILER_GCC || MPT_COMPILER_CLANG) && defined(ENABLE_SSE4)
+
+
+void InitProcSupport()
+//--------------------
+{
+	ProcSupport = 0;
+
+	// The avx2 check includes the operating system support check.
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("mmx")) ProcSupport |= PROCSUPPORT_MMX;
+	if(__builtin_cpu_supports("sse")) ProcSupport |= PROCSUPPORT_SSE;
+	if(__builtin_cpu_supports("sse2")) ProcSupport |= PROCSUPPORT_SSE2;
+	if(__builtin_cpu_supports("sse3")) ProcSupport |= PROCSUPPORT_SSE3;
+	if(__builtin_cpu_supports("sse4.1")) ProcSupport |= PROCSUPPORT_SSE4_1;
+	if(__builtin_cpu_supports("avx2")) ProcSupport |= PROCSUPPORT_AVX2;
+}
+
+
 #else // !( MPT_COMPILER_MSVC && ENABLE_X86 )
 
 
@@ -342,7 +436,7 @@ void InitProcSupport()
 #endif // MPT_COMPILER_MSVC && ENABLE_X86
 
 
-#endif // ENABLE_ASM
+#endif // ENABLE_ASM || ENABLE_SSE4
 
 
 
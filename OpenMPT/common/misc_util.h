@@ -379,6 +379,12 @@ namespace Util
 
 	time_t MakeGmTime(tm *timeUtc);
 
+	// Returns a timestamp in microseconds for measuring processing times. The epoch is undefined.
+	uint64 GetTimestampMicroseconds();
+
+	// Returns a monotonic timestamp in nanoseconds for measuring short processing times. The epoch is undefined.
+	uint64 GetTimestampNanoseconds();
+
 	// Minimum of 3 values
 	template <class T> inline const T& Min(const T& a, const T& b, const T& c) {return std::min(std::min(a, b), c);}
 
@@ -641,11 +647,13 @@ public:
 
 #endif
 
-#ifdef ENABLE_ASM
+#if defined(ENABLE_ASM) || defined(ENABLE_SSE4)
 #define PROCSUPPORT_MMX        0x00001 // Processor supports MMX instructions
 #define PROCSUPPORT_SSE        0x00010 // Processor supports SSE instructions
 #define PROCSUPPORT_SSE2       0x00020 // Processor supports SSE2 instructions
 #define PROCSUPPORT_SSE3       0x00040 // Processor supports SSE3 instructions
+#define PROCSUPPORT_SSE4_1     0x00080 // Processor supports SSE4.1 instructions
+#define PROCSUPPORT_AVX2       0x00100 // Processor and operating system support AVX2 instructions
 #define PROCSUPPORT_AMD_MMXEXT 0x10000 // Processor supports AMD MMX extensions
 #define PROCSUPPORT_AMD_3DNOW  0x20000 // Processor supports AMD 3DNow! instructions
 #define PROCSUPPORT_AMD_3DNOW2 0x40000 // Processor supports AMD 3DNow!2 instructions
@@ -655,7 +663,7 @@ static inline uint32 GetProcSupport()
 {
 	return ProcSupport;
 }
-#endif // ENABLE_ASM
+#endif // ENABLE_ASM || ENABLE_SSE4
 
 
 #ifdef MODPLUG_TRACKER
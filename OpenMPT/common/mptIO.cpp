@@ -22,6 +22,13 @@
 
 #include <stdio.h>
 
+#if defined(MPT_FILEREADER_MMAP)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 
 OPENMPT_NAMESPACE_BEGIN
 
@@ -249,6 +256,109 @@ IFileDataContainer::off_t FileDataContainerStdStream::GetReadableLength(IFileDat
 	return std::min<IFileDataContainer::off_t>(cache.size() - pos, length);
 }
 
+#if defined(MPT_FILEREADER_MMAP)
+
+FileDataContainerMMap::FileDataContainerMMap(const char *filename)
+	: mappedData(nullptr), mappedLength(0)
+{
+	int fd = open(filename, O_RDONLY);
+	if(fd == -1)
+	{
+		return;
+	}
+	Map(fd);
+	close(fd);
+}
+
+FileDataContainerMMap::FileDataContainerMMap(int fd)
+	: mappedData(nullptr), mappedLength(0)
+{
+	Map(fd);
+}
+
+FileDataContainerMMap::~FileDataContainerMMap()
+{
+	if(mappedData)
+	{
+		munmap(const_cast<char *>(mappedData), mappedLength);
+	}
+}
+
+void FileDataContainerMMap::Map(int fd)
+{
+	struct stat st;
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		return;
+	}
+	// Empty files cannot be mapped, and files that do not fit into the address space are not worth trying.
+	if(st.st_size <= 0 || static_cast<uint64>(st.st_size) > static_cast<uint64>(std::numeric_limits<std::size_t>::max()))
+	{
+		return;
+	}
+	const std::size_t length = static_cast<std::size_t>(st.st_size);
+	void *data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	if(data == MAP_FAILED)
+	{
+		return;
+	}
+	// Loaders usually touch most of the file anyway, so ask for read-ahead of the whole mapping.
+	posix_madvise(data, length, POSIX_MADV_WILLNEED);
+	mappedData = static_cast<const char *>(data);
+	mappedLength = length;
+}
+
+bool FileDataContainerMMap::IsValid() const
+{
+	return mappedData != nullptr;
+}
+
+const char *FileDataContainerMMap::GetRawData() const
+{
+	return mappedData;
+}
+
+IFileDataContainer::off_t FileDataContainerMMap::GetLength() const
+{
+	return mappedLength;
+}
+
+IFileDataContainer::off_t FileDataContainerMMap::Read(char *dst, IFileDataContainer::off_t pos, IFileDataContainer::off_t count) const
+{
+	if(pos >= mappedLength)
+	{
+		return 0;
+	}
+	IFileDataContainer::off_t avail = std::min<IFileDataContainer::off_t>(mappedLength - pos, count);
+	std::copy(mappedData + pos, mappedData + pos + avail, dst);
+	return avail;
+}
+
+const char *FileDataContainerMMap::GetPartialRawData(IFileDataContainer::off_t pos, IFileDataContainer::off_t length) const
+{
+	if(pos + length > mappedLength)
+	{
+		return nullptr;
+	}
+	return mappedData + pos;
+}
+
+bool FileDataContainerMMap::CanRead(IFileDataContainer::off_t pos, IFileDataContainer::off_t length) const
+{
+	return pos + length <= mappedLength;
+}
+
+IFileDataContainer::off_t FileDataContainerMMap::GetReadableLength(IFileDataContainer::off_t pos, IFileDataContainer::off_t length) const
+{
+	if(pos >= mappedLength)
+	{
+		return 0;
+	}
+	return std::min<IFileDataContainer::off_t>(mappedLength - pos, length);
+}
+
+#endif // MPT_FILEREADER_MMAP
+
 #endif
 
 
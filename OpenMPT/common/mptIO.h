@@ -571,6 +571,43 @@ public:
 
 };
 
+#if defined(MPT_FILEREADER_MMAP)
+
+// Maps a whole regular file read-only into memory, so GetRawData() is valid without copying the file.
+// The mapping is shared, i.e. processes that load the same file share its pages.
+// The file must not be truncated while it is mapped.
+class FileDataContainerMMap : public IFileDataContainer {
+
+private:
+
+	const char *mappedData;
+	off_t mappedLength;
+
+public:
+
+	FileDataContainerMMap(const char *filename);
+	// The file descriptor is not required to stay open after construction.
+	FileDataContainerMMap(int fd);
+	virtual ~FileDataContainerMMap();
+
+private:
+
+	void Map(int fd);
+
+public:
+
+	bool IsValid() const;
+	const char *GetRawData() const;
+	off_t GetLength() const;
+	off_t Read(char *dst, off_t pos, off_t count) const;
+	const char *GetPartialRawData(off_t pos, off_t length) const;
+	bool CanRead(off_t pos, off_t length) const;
+	off_t GetReadableLength(off_t pos, off_t length) const;
+
+};
+
+#endif // MPT_FILEREADER_MMAP
+
 #endif
 
 
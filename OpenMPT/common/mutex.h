@@ -9,19 +9,21 @@
 
 #pragma once
 
-#ifdef MODPLUG_TRACKER
+#if defined(MODPLUG_TRACKER)
 #define WIN32_LEAN_AND_MEAN
 #define VC_EXTRALEAN
 #define NOMINMAX
 #include <windows.h>
+#elif !defined(NO_THREADS)
+#include <mutex>
 #endif // MODPLUG_TRACKER
 
 OPENMPT_NAMESPACE_BEGIN
 
-#ifdef MODPLUG_TRACKER
-
 namespace Util {
 
+#if defined(MODPLUG_TRACKER)
+
 // compatible with c++11 std::mutex, can eventually be replaced without touching any usage site
 class mutex {
 private:
@@ -44,6 +46,32 @@ public:
 	void unlock() { LeaveCriticalSection(&impl); }
 };
 
+#elif !defined(NO_THREADS)
+
+typedef std::mutex mutex;
+typedef std::recursive_mutex recursive_mutex;
+
+#else // NO_THREADS
+
+// Dummy mutexes for builds without thread support, where no locking is required.
+class mutex {
+public:
+	mutex() { }
+	~mutex() { }
+	void lock() { }
+	void unlock() { }
+};
+
+class recursive_mutex {
+public:
+	recursive_mutex() { }
+	~recursive_mutex() { }
+	void lock() { }
+	void unlock() { }
+};
+
+#endif // MODPLUG_TRACKER
+
 // compatible with c++11 std::lock_guard, can eventually be replaced without touching any usage site
 template< typename mutex_type >
 class lock_guard {
@@ -56,6 +84,4 @@ public:
 
 } // namespace Util
 
-#endif // MODPLUG_TRACKER
-
 OPENMPT_NAMESPACE_END
@@ -236,6 +236,28 @@ LIBOPENMPT_API openmpt_module * openmpt_module_create( openmpt_stream_callbacks
 
 LIBOPENMPT_API openmpt_module * openmpt_module_create_from_memory( const void * filedata, size_t filesize, openmpt_log_func logfunc, void * user, const openmpt_module_initial_ctl * ctls );
 
+/*! \brief Construct an openmpt_module from a file on disk
+ *
+ * On POSIX systems, regular files are memory-mapped while loading instead of being read into an intermediate buffer.
+ * \param filename Path of the file to load the module from.
+ * \param logfunc Logging function where warning and errors are written. May be NULL.
+ * \param user Logging function user context.
+ * \param ctls An array of initial ctl and value pairs stored in openmpt_module_initial_ctl, terminated by {NULL,NULL}. May be NULL.
+ * \return A pointer to the constructed openmpt_module, or NULL on failure.
+ */
+LIBOPENMPT_API openmpt_module * openmpt_module_create_from_filename( const char * filename, openmpt_log_func logfunc, void * user, const openmpt_module_initial_ctl * ctls );
+
+/*! \brief Construct an openmpt_module from an open file descriptor
+ *
+ * The whole file is memory-mapped while loading, independent of the current file position. The file descriptor can be closed after this function returns.
+ * \param fd Readable file descriptor of a regular file.
+ * \param logfunc Logging function where warning and errors are written. May be NULL.
+ * \param user Logging function user context.
+ * \param ctls An array of initial ctl and value pairs stored in openmpt_module_initial_ctl, terminated by {NULL,NULL}. May be NULL.
+ * \return A pointer to the constructed openmpt_module, or NULL on failure, which includes systems without mmap support.
+ */
+LIBOPENMPT_API openmpt_module * openmpt_module_create_from_fd( int fd, openmpt_log_func logfunc, void * user, const openmpt_module_initial_ctl * ctls );
+
 LIBOPENMPT_API void openmpt_module_destroy( openmpt_module * mod );
 
 #define OPENMPT_MODULE_RENDER_MASTERGAIN_MILLIBEL        1
@@ -140,6 +140,128 @@ LIBOPENMPT_CXX_API bool is_extension_supported( const std::string & extension );
 */
 LIBOPENMPT_CXX_API double could_open_propability( std::istream & stream, double effort = 1.0, std::ostream & log = std::clog );
 
+//! Basic information about a module, as returned by openmpt::probe
+struct module_info {
+	//! Short format type (see openmpt::module::get_metadata, key "type")
+	std::string type;
+	//! Long format type (see openmpt::module::get_metadata, key "type_long")
+	std::string type_long;
+	//! Module title (see openmpt::module::get_metadata, key "title")
+	std::string title;
+	//! Module author (see openmpt::module::get_metadata, key "artist")
+	std::string artist;
+	//! Song message (see openmpt::module::get_metadata, key "message")
+	std::string message;
+	//! Number of pattern channels. Some formats (e.g. IT) only store this implicitly in the pattern data, so this may be inaccurate if the duration was not calculated.
+	std::int32_t num_channels;
+	//! Number of orders
+	std::int32_t num_orders;
+	//! Number of patterns. May be 0 if the duration was not calculated, as the pattern data is not loaded in that case.
+	std::int32_t num_patterns;
+	//! Number of instruments
+	std::int32_t num_instruments;
+	//! Number of samples
+	std::int32_t num_samples;
+	//! Instrument names
+	std::vector<std::string> instrument_names;
+	//! Sample names
+	std::vector<std::string> sample_names;
+	//! Duration of the first subsong in seconds, or 0.0 if it was not calculated.
+	double duration_seconds;
+}; // struct module_info
+
+//! Probe a module for its metadata without decoding any sample data
+/*!
+  Reads the basic module information that would be returned by openmpt::module without constructing a playable module.
+  Sample data is always skipped, no memory is allocated for it. Pattern data is only decoded if the duration is requested.
+  This is much faster than loading the complete module when indexing large module collections.
+  \param stream Input stream from which the module is loaded.
+  \param calculate_duration If true, the pattern data is also loaded in order to calculate the duration of the first subsong.
+  \param log Log where any warnings or errors are printed to.
+  \return The module information.
+  \throws openmpt::exception Throws an exception derived from openmpt::exception if the provided stream is invalid.
+  \remarks The same information can be obtained from an openmpt::module that was constructed with the ctls load.skip_samples=1 and load.skip_patterns=1, which also works with the C API.
+  \sa openmpt::could_open_propability
+*/
+LIBOPENMPT_CXX_API module_info probe( std::istream & stream, bool calculate_duration = false, std::ostream & log = std::clog );
+
+//! A module file stored in an archive, as returned by openmpt::archive::get_entries
+struct archive_entry {
+	//! Path of the file inside the archive
+	std::string filename;
+	//! Uncompressed size in bytes
+	std::uint64_t size;
+}; // struct archive_entry
+
+class archive_impl;
+
+class module;
+
+//! A ZIP archive containing module files
+/*!
+  Only the central directory is read when an openmpt::archive is constructed. Each module file is decompressed when it is extracted, probed or loaded.
+  Files that are stored uncompressed are read in place without copying them.
+  All member functions are const and can be called concurrently from several threads, e.g. to load the module files of an archive in parallel.
+  \remarks Only ZIP archives with stored or deflated files are supported. Multi-volume archives, ZIP64 and encrypted files are not supported.
+*/
+class LIBOPENMPT_CXX_API archive {
+
+	friend class module;
+
+private:
+	archive_impl * impl;
+private:
+	// non-copyable
+	archive( const archive & );
+	void operator = ( const archive & );
+public:
+	//! Open a ZIP archive
+	/*!
+	  \param data Archive data. The data is not copied, it has to stay valid and unchanged as long as the openmpt::archive exists.
+	  \param size Size of the archive data in bytes.
+	  \throws openmpt::exception Throws an exception derived from openmpt::exception if data is not a ZIP archive.
+	*/
+	archive( const void * data, std::size_t size );
+	/*!
+	  \param data Archive data. The data is not copied, it has to stay valid and unchanged as long as the openmpt::archive exists.
+	  \throws openmpt::exception Throws an exception derived from openmpt::exception if data is not a ZIP archive.
+	*/
+	archive( const std::vector<std::uint8_t> & data );
+	~archive();
+
+	//! Get the module files stored in the archive
+	/*!
+	  \return All files with an extension supported by libopenmpt (see openmpt::get_supported_extensions) or an Amiga-style prefix (e.g. "mod.title"), in the order in which they are stored in the archive. The position of a file in this list is the index that has to be passed to the other functions.
+	*/
+	std::vector<archive_entry> get_entries() const;
+	//! Decompress a module file
+	/*!
+	  \param index Index of the file, see openmpt::archive::get_entries.
+	  \return The uncompressed file data.
+	  \throws openmpt::exception Throws an exception derived from openmpt::exception if the index is invalid or the file data is corrupted.
+	*/
+	std::vector<std::uint8_t> extract( std::size_t index ) const;
+	//! Probe a module file without decoding any sample data
+	/*!
+	  \param index Index of the file, see openmpt::archive::get_entries.
+	  \param calculate_duration If true, the pattern data is also loaded in order to calculate the duration of the first subsong.
+	  \param log Log where any warnings or errors are printed to.
+	  \return The module information.
+	  \throws openmpt::exception Throws an exception derived from openmpt::exception if the file cannot be decompressed or is not a module.
+	  \sa openmpt::probe
+	*/
+	module_info probe( std::size_t index, bool calculate_duration = false, std::ostream & log = std::clog ) const;
+	//! Probe all module files in the archive
+	/*!
+	  \param calculate_duration If true, the pattern data is also loaded in order to calculate the duration of the first subsong of each module.
+	  \param threads Number of threads that decompress and probe the files. 0 uses one thread per CPU core. Ignored if libopenmpt has been built without thread support.
+	  \param log Log where any warnings or errors are printed to. Errors are prefixed with the name of the file that caused them.
+	  \return The module information of every file returned by openmpt::archive::get_entries, in the same order. The type of files that cannot be loaded is empty.
+	*/
+	std::vector<module_info> probe_all( bool calculate_duration = false, std::int32_t threads = 1, std::ostream & log = std::clog ) const;
+
+}; // class archive
+
 class module_impl;
 
 class module_ext;
@@ -287,6 +409,23 @@ public:
 	  \remarks The input data can be discarded after an openmpt::module has been constructed succesfully.
 	*/
 	module( const void * data, std::size_t size, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
+	/*!
+	  \param filename Path of the file to load the module from.
+	  \param log Log where any warnings or errors are printed to. The lifetime of the reference has to be as long as the lifetime of the module instance.
+	  \param ctls A map of initial ctl values, see openmpt::module::get_ctls.
+	  \throws openmpt::exception Throws an exception derived from openmpt::exception in case the provided file cannot be opened.
+	  \remarks On POSIX systems, regular files are memory-mapped while loading instead of being read into an intermediate buffer. The file is not accessed anymore after an openmpt::module has been constructed succesfully.
+	*/
+	module( const std::string & filename, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
+	/*!
+	  \param arc Archive to load the module from.
+	  \param index Index of the module file in the archive, see openmpt::archive::get_entries.
+	  \param log Log where any warnings or errors are printed to. The lifetime of the reference has to be as long as the lifetime of the module instance.
+	  \param ctls A map of initial ctl values, see openmpt::module::get_ctls.
+	  \throws openmpt::exception Throws an exception derived from openmpt::exception in case the file cannot be decompressed or opened.
+	  \remarks The archive can be destroyed after an openmpt::module has been constructed succesfully.
+	*/
+	module( const archive & arc, std::size_t index, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
 	virtual ~module();
 public:
 
@@ -671,9 +810,29 @@ public:
 	  \remarks Currently supported ctl values are:
 	           - load.skip_samples: Set to "1" to avoid loading samples into memory
 	           - load.skip_patterns: Set to "1" to avoid loading patterns into memory
+	           - load.share_samples: Set to "1" to share the memory of identical sample data with all other modules in the same process that have been loaded with this ctl, even if they have been loaded from different files. The shared sample data is only copied if it needs to be modified during playback (MOD EFx command).
+	           - load.lazy_samples: Set to "1" to keep compressed IT sample data in memory as it is and only decode a sample the first time it is played. This makes loading sample-heavy modules faster and saves memory if not all samples are played. Samples that are decoded this way do not take part in load.share_samples.
 	           - seek.sync_samples: Set to "1" to sync sample playback when using openmpt::module::set_position_seconds or openmpt::module::set_position_order_row.
+	           - seek.index_memory_kb: Set the maximum amount of memory in KiB that may be used for a seek index, which makes openmpt::module::set_position_seconds and openmpt::module::set_position_order_row much faster for long modules. The index is built when the subsong durations are calculated. "0" (default) disables the index. Has no effect if seek.sync_samples is set.
+	           - subsong.scan_threads: Set the number of threads that are used for calculating the subsong durations. Sequences are scanned independently of each other, so this only helps modules with multiple sequences. "1" (default) scans on the calling thread only, "0" uses one thread per CPU core. The results do not depend on this setting. Has no effect if libopenmpt has been built without thread support.
 	           - play.tempo_factor: Set a floating point tempo factor. "1.0" is the default tempo.
 	           - play.pitch_factor: Set a floating point pitch factor. "1.0" is the default pitch.
+	           - render.mixer_threads: Set the number of threads that are used for mixing the sample voices. "1" (default) mixes on the calling thread only, "0" uses one thread per CPU core. The output does not depend on this setting. Only voices that are not routed through plugins are mixed in parallel, and only while fewer voices are playing than the voice limit. Has no effect if libopenmpt has been built without thread support.
+	           - render.mixer_threads.stats: Read-only. Statistics of the last rendered chunk that was mixed in parallel, as space-separated integers: number of voices, number of threads, followed by the time each thread spent mixing in microseconds.
+	           - render.voice_culling: Set to "0" to mix sample voices even if they are provably silent (zero volume or digital silence in the sample data). "1" (default) skips them. The output does not depend on this setting.
+	           - render.voice_culling.stats: Read-only. Statistics of the last rendered chunk as space-separated integers: number of voices that have been mixed, number of voices that have been skipped because they were silent.
+	           - render.max_voices: Set the maximum number of sample voices from "1" to "256" (default). Every pattern channel always has its own voice; the remaining voices are used for notes that keep playing after a new note (New Note Actions). If all of them are in use, the quietest one is replaced. Lower values make dense modules cheaper to render, but may cut off notes. When the limit is lowered, the voices above it are faded out quickly.
+	           - render.profiling: Set to "1" to measure the time spent in each stage of rendering. Setting this ctl resets the statistics.
+	           - render.profiling.stats: Read-only. Statistics of everything that has been rendered since the module has been loaded or render.profiling has been set, as space-separated integers: number of rendered frames, number of ticks, number of chunks, sum of the voices mixed in each chunk, sum of the silent voices skipped in each chunk, followed by the time in microseconds spent in tick processing (including pattern effects), pattern effects, mixing, plugins, DSP effects (reverb, plugins, equalizer etc.) and output conversion (gain, dithering and sample format conversion). The times are estimates, as only one stage is timed per tick. The counters are always updated; the times are 0 unless render.profiling is set.
+	           - render.dsp.reverb: Set to "1" to enable the reverb DSP effect.
+	           - render.dsp.reverb.depth: Set the reverb depth from "1" to "16". "8" is the default.
+	           - render.dsp.reverb.type: Set the reverb preset from "0" to "28" (the presets of the OpenMPT reverb settings, in the same order). "0" is the default.
+	           - render.dsp.reverb.cost: Read-only. Time spent processing the reverb in microseconds per second of rendered audio, averaged over everything that has been rendered with the reverb enabled. The statistics are reset when the sample rate or the number of channels changes.
+	           - render.dsp.megabass: Set to "1" to enable the bass expansion DSP effect.
+	           - render.dsp.surround: Set to "1" to enable the surround DSP effect.
+	           - render.dsp.agc: Set to "1" to enable automatic gain control.
+	           - render.dsp.eq: Set to "1" to enable the 6-band equalizer.
+	           - render.dsp.eq.gains: Set the gains of the 6 equalizer bands (125, 300, 600, 1250, 4000 and 8000 Hz) as space-separated integers from "0" (-12dB) to "32" (+12dB). "16 16 16 16 16 16" (default) is flat.
 	           - dither: Set the dither algorithm that is used for the 16 bit versions of openmpt::module::read. Supported values are:
 	                     - 0: No dithering.
 	                     - 1: Default mode. Chosen by OpenMPT code, might change.
@@ -345,6 +345,77 @@ openmpt_module * openmpt_module_create_from_memory( const void * filedata, size_
 	return NULL;
 }
 
+openmpt_module * openmpt_module_create_from_filename( const char * filename, openmpt_log_func logfunc, void * user, const openmpt_module_initial_ctl * ctls ) {
+	try {
+		OPENMPT_INTERFACE_CHECK_POINTER( filename );
+		openmpt_module * mod = (openmpt_module*)std::malloc( sizeof( openmpt_module ) );
+		if ( !mod ) {
+			throw std::bad_alloc();
+		}
+		mod->logfunc = logfunc ? logfunc : openmpt_log_func_default;
+		mod->user = user;
+		mod->impl = 0;
+		try {
+			std::map< std::string, std::string > ctls_map;
+			if ( ctls ) {
+				for ( const openmpt_module_initial_ctl * it = ctls; it->ctl; ++it ) {
+					if ( it->value ) {
+						ctls_map[ it->ctl ] = it->value;
+					} else {
+						ctls_map.erase( it->ctl );
+					}
+				}
+			}
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+			mod->impl = new openmpt::module_impl( std::string( filename ), std::tr1::shared_ptr<openmpt::logfunc_logger>( new openmpt::logfunc_logger( mod->logfunc, mod->user ) ), ctls_map );
+#else
+			mod->impl = new openmpt::module_impl( std::string( filename ), std::make_shared<openmpt::logfunc_logger>( mod->logfunc, mod->user ), ctls_map );
+#endif
+			return mod;
+		} OPENMPT_INTERFACE_CATCH_TO_MOD_LOG_FUNC;
+		delete mod->impl;
+		mod->impl = 0;
+		std::free( (void*)mod );
+		mod = NULL;
+	} OPENMPT_INTERFACE_CATCH;
+	return NULL;
+}
+
+openmpt_module * openmpt_module_create_from_fd( int fd, openmpt_log_func logfunc, void * user, const openmpt_module_initial_ctl * ctls ) {
+	try {
+		openmpt_module * mod = (openmpt_module*)std::malloc( sizeof( openmpt_module ) );
+		if ( !mod ) {
+			throw std::bad_alloc();
+		}
+		mod->logfunc = logfunc ? logfunc : openmpt_log_func_default;
+		mod->user = user;
+		mod->impl = 0;
+		try {
+			std::map< std::string, std::string > ctls_map;
+			if ( ctls ) {
+				for ( const openmpt_module_initial_ctl * it = ctls; it->ctl; ++it ) {
+					if ( it->value ) {
+						ctls_map[ it->ctl ] = it->value;
+					} else {
+						ctls_map.erase( it->ctl );
+					}
+				}
+			}
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+			mod->impl = new openmpt::module_impl( fd, std::tr1::shared_ptr<openmpt::logfunc_logger>( new openmpt::logfunc_logger( mod->logfunc, mod->user ) ), ctls_map );
+#else
+			mod->impl = new openmpt::module_impl( fd, std::make_shared<openmpt::logfunc_logger>( mod->logfunc, mod->user ), ctls_map );
+#endif
+			return mod;
+		} OPENMPT_INTERFACE_CATCH_TO_MOD_LOG_FUNC;
+		delete mod->impl;
+		mod->impl = 0;
+		std::free( (void*)mod );
+		mod = NULL;
+	} OPENMPT_INTERFACE_CATCH;
+	return NULL;
+}
+
 void openmpt_module_destroy( openmpt_module * mod ) {
 	try {
 		OPENMPT_INTERFACE_CHECK_SOUNDFILE( mod );
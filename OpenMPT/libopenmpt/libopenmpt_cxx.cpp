@@ -84,6 +84,59 @@ double could_open_propability( std::istream & stream, double effort, std::ostrea
 #endif
 }
 
+module_info probe( std::istream & stream, bool calculate_duration, std::ostream & log ) {
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	return openmpt::module_impl::probe( stream, calculate_duration, std::tr1::shared_ptr<std_ostream_log>( new std_ostream_log( log ) ) );
+#else
+	return openmpt::module_impl::probe( stream, calculate_duration, std::make_shared<std_ostream_log>( log ) );
+#endif
+}
+
+archive::archive( const archive & ) {
+	throw exception("openmpt::archive is non-copyable");
+}
+
+void archive::operator = ( const archive & ) {
+	throw exception("openmpt::archive is non-copyable");
+}
+
+archive::archive( const void * data, std::size_t size ) : impl(0) {
+	impl = new archive_impl( data, size );
+}
+
+archive::archive( const std::vector<std::uint8_t> & data ) : impl(0) {
+	impl = new archive_impl( data.empty() ? 0 : &(data[0]), data.size() );
+}
+
+archive::~archive() {
+	delete impl;
+	impl = 0;
+}
+
+std::vector<archive_entry> archive::get_entries() const {
+	return impl->get_entries();
+}
+
+std::vector<std::uint8_t> archive::extract( std::size_t index ) const {
+	return impl->extract( index );
+}
+
+module_info archive::probe( std::size_t index, bool calculate_duration, std::ostream & log ) const {
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	return impl->probe( index, calculate_duration, std::tr1::shared_ptr<std_ostream_log>( new std_ostream_log( log ) ) );
+#else
+	return impl->probe( index, calculate_duration, std::make_shared<std_ostream_log>( log ) );
+#endif
+}
+
+std::vector<module_info> archive::probe_all( bool calculate_duration, std::int32_t threads, std::ostream & log ) const {
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	return impl->probe_all( calculate_duration, threads, std::tr1::shared_ptr<std_ostream_log>( new std_ostream_log( log ) ) );
+#else
+	return impl->probe_all( calculate_duration, threads, std::make_shared<std_ostream_log>( log ) );
+#endif
+}
+
 module::module( const module & ) {
 	throw exception("openmpt::module is non-copyable");
 }
@@ -164,6 +217,22 @@ module::module( const void * data, std::size_t size, std::ostream & log, const s
 #endif
 }
 
+module::module( const std::string & filename, std::ostream & log, const std::map< std::string, std::string > & ctls ) : impl(0) {
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	impl = new module_impl( filename, std::tr1::shared_ptr<std_ostream_log>( new std_ostream_log( log ) ), ctls );
+#else
+	impl = new module_impl( filename, std::make_shared<std_ostream_log>( log ), ctls );
+#endif
+}
+
+module::module( const archive & arc, std::size_t index, std::ostream & log, const std::map< std::string, std::string > & ctls ) : impl(0) {
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	impl = new module_impl( *arc.impl, index, std::tr1::shared_ptr<std_ostream_log>( new std_ostream_log( log ) ), ctls );
+#else
+	impl = new module_impl( *arc.impl, index, std::make_shared<std_ostream_log>( log ), ctls );
+#endif
+}
+
 module::~module() {
 	delete impl;
 	impl = 0;
@@ -8,6 +8,11 @@
 #include "libopenmpt_impl.hpp"
 
 #include <stdexcept>
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+#include <ctime>
+#else
+#include <chrono>
+#endif
 
 #include "soundlib/Sndfile.h"
 
@@ -21,6 +26,7 @@ class module_ext_impl
 	: public module_impl
 	, public ext::pattern_vis
 	, public ext::interactive
+	, public ext::offline_render
 
 
 
@@ -58,10 +64,19 @@ public:
 #endif
 		ctor();
 	}
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	module_ext_impl( const std::string & filename, std::ostream & log, const std::map< std::string, std::string > & ctls ) : module_impl( filename, std::tr1::shared_ptr<std_ostream_log>( new std_ostream_log( log ) ), ctls ) {
+#else
+	module_ext_impl( const std::string & filename, std::ostream & log, const std::map< std::string, std::string > & ctls ) : module_impl( filename, std::make_shared<std_ostream_log>( log ), ctls ) {
+#endif
+		ctor();
+	}
 
 private:
 
-
+	// offline_render statistics
+	double m_render_audio_seconds;
+	double m_render_wallclock_seconds;
 
 	/* add stuff here */
 
@@ -71,7 +86,8 @@ private:
 
 	void ctor() {
 
-
+		m_render_audio_seconds = 0.0;
+		m_render_wallclock_seconds = 0.0;
 
 		/* add stuff here */
 
@@ -100,6 +116,8 @@ public:
 			return dynamic_cast< ext::pattern_vis * >( this );
 		} else if ( interface_id == ext::interactive_id ) {
 			return dynamic_cast< ext::interactive * >( this );
+		} else if ( interface_id == ext::offline_render_id ) {
+			return dynamic_cast< ext::offline_render * >( this );
 
 
 
@@ -212,6 +230,8 @@ public:
 		}
 		m_sndFile->ChnSettings[channel].dwFlags.set( CHN_MUTE | CHN_SYNCMUTE , mute );
 		m_sndFile->m_PlayState.Chn[channel].dwFlags.set( CHN_MUTE | CHN_SYNCMUTE , mute );
+		// muted S3M channels do not process any effects, so old seek index checkpoints might be wrong now
+		m_sndFile->m_SeekIndex.Clear();
 
 		// Also update NNA channels
 		for ( CHANNELINDEX i = m_sndFile->GetNumChannels(); i < MAX_CHANNELS; i++)
@@ -310,6 +330,72 @@ public:
 		chn.pCurrentSample = nullptr;
 	}
 
+	// offline_render
+
+private:
+
+	// Renders like module_impl::read_interleaved_*, with the module in rendering to disc mode for the duration of the call
+	template < typename Tsample >
+	std::size_t render_interleaved( std::int32_t samplerate, std::size_t count, std::size_t channels, Tsample * interleaved ) {
+		if ( !interleaved ) {
+			throw openmpt::exception("null pointer");
+		}
+		apply_mixer_settings( samplerate, static_cast<int>( channels ) );
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+		const std::clock_t start = std::clock();
+#else
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#endif
+		const bool was_rendering = m_sndFile->m_bIsRendering;
+		m_sndFile->m_bIsRendering = true;
+		try {
+			count = read_interleaved_wrapper( count, channels, interleaved );
+		} catch ( ... ) {
+			m_sndFile->m_bIsRendering = was_rendering;
+			throw;
+		}
+		m_sndFile->m_bIsRendering = was_rendering;
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+		m_render_wallclock_seconds += static_cast<double>( std::clock() - start ) / CLOCKS_PER_SEC;
+#else
+		m_render_wallclock_seconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+#endif
+		const double seconds = static_cast<double>( count ) / static_cast<double>( samplerate );
+		m_render_audio_seconds += seconds;
+		m_currentPositionSeconds += seconds;
+		return count;
+	}
+
+public:
+
+	virtual std::size_t render_interleaved_stereo( std::int32_t samplerate, std::size_t count, std::int16_t * interleaved_stereo ) {
+		return render_interleaved( samplerate, count, 2, interleaved_stereo );
+	}
+
+	virtual std::size_t render_interleaved_stereo( std::int32_t samplerate, std::size_t count, float * interleaved_stereo ) {
+		return render_interleaved( samplerate, count, 2, interleaved_stereo );
+	}
+
+	virtual std::size_t render_interleaved_quad( std::int32_t samplerate, std::size_t count, std::int16_t * interleaved_quad ) {
+		return render_interleaved( samplerate, count, 4, interleaved_quad );
+	}
+
+	virtual std::size_t render_interleaved_quad( std::int32_t samplerate, std::size_t count, float * interleaved_quad ) {
+		return render_interleaved( samplerate, count, 4, interleaved_quad );
+	}
+
+	virtual double get_render_speed() const {
+		if ( m_render_wallclock_seconds <= 0.0 ) {
+			return 0.0;
+		}
+		return m_render_audio_seconds / m_render_wallclock_seconds;
+	}
+
+	virtual void reset_render_speed() {
+		m_render_audio_seconds = 0.0;
+		m_render_wallclock_seconds = 0.0;
+	}
+
 
 	/* add stuff here */
 
@@ -333,6 +419,10 @@ module_ext::module_ext( const void * data, std::size_t size, std::ostream & log,
 	ext_impl = new module_ext_impl( data, size, log, ctls );
 	set_impl( ext_impl );
 }
+module_ext::module_ext( const std::string & filename, std::ostream & log, const std::map< std::string, std::string > & ctls ) : ext_impl(0) {
+	ext_impl = new module_ext_impl( filename, log, ctls );
+	set_impl( ext_impl );
+}
 module_ext::~module_ext() {
 	set_impl( 0 );
 	delete ext_impl;
@@ -69,6 +69,7 @@ public:
 	module_ext( const std::vector<char> & data, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
 	module_ext( const char * data, std::size_t size, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
 	module_ext( const void * data, std::size_t size, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
+	module_ext( const std::string & filename, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
 	virtual ~module_ext();
 
 public:
@@ -298,6 +299,62 @@ class interactive {
 }; // class interactive
 
 
+#define LIBOPENMPT_EXT_INTERFACE_OFFLINE_RENDER
+
+LIBOPENMPT_DECLARE_EXT_INTERFACE(offline_render)
+
+class offline_render {
+
+	LIBOPENMPT_EXT_INTERFACE(offline_render)
+
+	//! Render audio data for offline processing
+	/*!
+	  Renders the current subsong into the caller-provided buffer like openmpt::module::read_interleaved_stereo, but as if the module was rendered to disc:
+	  The song is not faded out when the end is reached, and XM modules that end with an F00 command stop as soon as all voices have become silent.
+	  The whole buffer is rendered in a single call into the mixer, so that per-call overhead is only paid once. Pass a buffer that is large enough to hold the whole subsong (see openmpt::module::get_duration_seconds) to render it in one go.
+	  \param samplerate Sample rate to render output. Should be in [8000,192000], but this is not enforced.
+	  \param count Number of audio frames to render per channel (number of frames fitting in the buffer).
+	  \param interleaved_stereo Pointer to a buffer of at least count*2 elements that receives the interleaved stereo output in the order (L,R).
+	  \return The number of frames actually rendered. Can be less than count if the end of the subsong was reached.
+	  \sa openmpt::ext::offline_render::get_render_speed
+	*/
+	virtual std::size_t render_interleaved_stereo( std::int32_t samplerate, std::size_t count, std::int16_t * interleaved_stereo ) = 0;
+	//! Render audio data for offline processing
+	/*!
+	  \sa openmpt::ext::offline_render::render_interleaved_stereo( std::int32_t, std::size_t, std::int16_t * )
+	*/
+	virtual std::size_t render_interleaved_stereo( std::int32_t samplerate, std::size_t count, float * interleaved_stereo ) = 0;
+	//! Render audio data for offline processing
+	/*!
+	  \param samplerate Sample rate to render output. Should be in [8000,192000], but this is not enforced.
+	  \param count Number of audio frames to render per channel (number of frames fitting in the buffer).
+	  \param interleaved_quad Pointer to a buffer of at least count*4 elements that receives the interleaved quad surround output in the order (L,R,RL,RR).
+	  \return The number of frames actually rendered. Can be less than count if the end of the subsong was reached.
+	  \sa openmpt::ext::offline_render::render_interleaved_stereo( std::int32_t, std::size_t, std::int16_t * )
+	*/
+	virtual std::size_t render_interleaved_quad( std::int32_t samplerate, std::size_t count, std::int16_t * interleaved_quad ) = 0;
+	//! Render audio data for offline processing
+	/*!
+	  \sa openmpt::ext::offline_render::render_interleaved_quad( std::int32_t, std::size_t, std::int16_t * )
+	*/
+	virtual std::size_t render_interleaved_quad( std::int32_t samplerate, std::size_t count, float * interleaved_quad ) = 0;
+
+	//! Get the render speed
+	/*!
+	  \return The duration of the audio rendered through this interface divided by the time it took to render it, i.e. the render speed as a multiple of realtime. Returns 0.0 if nothing has been rendered yet.
+	  \remarks The statistics are accumulated over all render calls since the module was loaded or since the last call to openmpt::ext::offline_render::reset_render_speed.
+	*/
+	virtual double get_render_speed() const = 0;
+
+	//! Reset the render speed statistics
+	/*!
+	  \sa openmpt::ext::offline_render::get_render_speed
+	*/
+	virtual void reset_render_speed() = 0;
+
+}; // class offline_render
+
+
 /* add stuff here */
 
 
@@ -15,21 +15,44 @@
 #include "libopenmpt_impl.hpp"
 
 #include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <istream>
 #include <iterator>
 #include <limits>
 #include <ostream>
+#include <sstream>
 
+#include <cctype>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 
+#ifndef NO_THREADS
+#include <exception>
+#include <functional>
+#include <system_error>
+#include <thread>
+#endif // NO_THREADS
+
 #include "common/version.h"
 #include "common/misc_util.h"
+#include "common/mutex.h"
 #include "soundlib/Sndfile.h"
 #include "soundlib/AudioReadTarget.h"
 #include "soundlib/FileReader.h"
+#include "soundlib/SampleDataStore.h"
+
+#if !defined(NO_ZLIB)
+#if MPT_COMPILER_MSVC
+#include <zlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+#elif !defined(NO_MINIZ)
+#define MINIZ_HEADER_FILE_ONLY
+#include "miniz/miniz.c"
+#endif
 
 using namespace OpenMPT;
 
@@ -313,6 +336,20 @@ void module_impl::apply_libopenmpt_defaults() {
 	set_render_param( module::RENDER_STEREOSEPARATION_PERCENT, 100 );
 	m_sndFile->Order.SetSequence( 0 );
 }
+bool module_impl::get_dsp_effect( std::uint32_t flag ) const {
+	return ( m_sndFile->m_MixerSettings.DSPMask & flag ) ? true : false;
+}
+void module_impl::set_dsp_effect( std::uint32_t flag, bool enable ) {
+	DWORD mask = m_sndFile->m_MixerSettings.DSPMask;
+	if ( enable ) {
+		mask |= flag;
+	} else {
+		mask &= ~flag;
+	}
+	if ( mask != m_sndFile->m_MixerSettings.DSPMask ) {
+		m_sndFile->SetDspEffects( mask );
+	}
+}
 void module_impl::ctor( const std::map< std::string, std::string > & ctls ) {
 #ifdef LIBOPENMPT_ANCIENT_COMPILER
 	m_sndFile = std::tr1::shared_ptr<CSoundFile>(new CSoundFile());
@@ -335,7 +372,12 @@ void module_impl::ctor( const std::map< std::string, std::string > & ctls ) {
 	m_Gain = 1.0f;
 	m_ctl_load_skip_samples = false;
 	m_ctl_load_skip_patterns = false;
+	m_ctl_load_share_samples = false;
+	m_ctl_load_lazy_samples = false;
 	m_ctl_seek_sync_samples = false;
+	m_ctl_subsong_scan_threads = 1;
+	m_ctl_render_mixer_threads = 1;
+	m_ctl_render_dsp_eq_gains.assign( 6, 16 );
 	m_current_subsong = 0;
 	// init member variables that correspond to ctls
 	for ( std::map< std::string, std::string >::const_iterator i = ctls.begin(); i != ctls.end(); ++i ) {
@@ -353,11 +395,19 @@ void module_impl::load( const FileReader & file, const std::map< std::string, st
 		if ( m_ctl_load_skip_patterns ) {
 			load_flags &= ~CSoundFile::loadPatternData;
 		}
+		if ( m_ctl_load_lazy_samples ) {
+			load_flags |= CSoundFile::decodeSamplesLazily;
+		}
 		if ( !m_sndFile->Create( file, static_cast<CSoundFile::ModLoadingFlags>( load_flags ) ) ) {
 			throw openmpt::exception("error loading file");
 		}
 		m_loaded = true;
 	}
+	if ( m_ctl_load_share_samples ) {
+		for ( SAMPLEINDEX smp = 1; smp <= m_sndFile->GetNumSamples(); ++smp ) {
+			SampleDataStore::Share( m_sndFile->GetSample( smp ) );
+		}
+	}
 	m_sndFile->SetCustomLog( m_LogForwarder.get() );
 	std::vector<std::pair<LogLevel,std::string> > loaderMessages = loaderlog.GetMessages();
 	for ( std::vector<std::pair<LogLevel,std::string> >::iterator i = loaderMessages.begin(); i != loaderMessages.end(); ++i ) {
@@ -501,6 +551,39 @@ double module_impl::could_open_propability( std::istream & stream, double effort
 	}
 
 }
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+module_info module_impl::probe( std::istream & stream, bool calculate_duration, std::tr1::shared_ptr<log_interface> log ) {
+#else
+module_info module_impl::probe( std::istream & stream, bool calculate_duration, std::shared_ptr<log_interface> log ) {
+#endif
+	module_impl mod( stream, log, get_probe_ctls( calculate_duration ) );
+	return mod.get_probe_info( calculate_duration );
+}
+std::map< std::string, std::string > module_impl::get_probe_ctls( bool calculate_duration ) {
+	// Skipping the sample data means that the loaders neither decode nor allocate it.
+	// Pattern data (which is also required to find out the number of channels in some formats) is only needed for the duration.
+	std::map< std::string, std::string > ctls;
+	ctls["load.skip_samples"] = "1";
+	ctls["load.skip_patterns"] = calculate_duration ? "0" : "1";
+	return ctls;
+}
+module_info module_impl::get_probe_info( bool calculate_duration ) const {
+	module_info info;
+	info.type = get_metadata( "type" );
+	info.type_long = get_metadata( "type_long" );
+	info.title = get_metadata( "title" );
+	info.artist = get_metadata( "artist" );
+	info.message = get_metadata( "message" );
+	info.num_channels = get_num_channels();
+	info.num_orders = get_num_orders();
+	info.num_patterns = get_num_patterns();
+	info.num_instruments = get_num_instruments();
+	info.num_samples = get_num_samples();
+	info.instrument_names = get_instrument_names();
+	info.sample_names = get_sample_names();
+	info.duration_seconds = calculate_duration ? get_duration_seconds() : 0.0;
+	return info;
+}
 
 #ifdef LIBOPENMPT_ANCIENT_COMPILER
 module_impl::module_impl( std::istream & stream, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
@@ -564,6 +647,57 @@ module_impl::module_impl( const void * data, std::size_t size, std::shared_ptr<l
 	load( FileReader( data, size ), ctls );
 	apply_libopenmpt_defaults();
 }
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+module_impl::module_impl( const std::string & filename, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
+#else
+module_impl::module_impl( const std::string & filename, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
+#endif
+	ctor( ctls );
+#if defined(MPT_FILEREADER_MMAP)
+	MPT_SHARED_PTR<IFileDataContainer> mapping( new FileDataContainerMMap( filename.c_str() ) );
+	if ( mapping->IsValid() ) {
+		load( FileReader( mapping ), ctls );
+		apply_libopenmpt_defaults();
+		return;
+	}
+#endif
+	// not mappable (e.g. empty, not a regular file or no mmap support), read it like any other stream
+	std::ifstream stream( filename.c_str(), std::ios::binary );
+	if ( !stream ) {
+		throw openmpt::exception("cannot open file");
+	}
+	load( FileReader( &stream ), ctls );
+	apply_libopenmpt_defaults();
+}
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+module_impl::module_impl( int fd, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
+#else
+module_impl::module_impl( int fd, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
+#endif
+	ctor( ctls );
+#if defined(MPT_FILEREADER_MMAP)
+	MPT_SHARED_PTR<IFileDataContainer> mapping( new FileDataContainerMMap( fd ) );
+	if ( !mapping->IsValid() ) {
+		throw openmpt::exception("cannot map file descriptor");
+	}
+	load( FileReader( mapping ), ctls );
+	apply_libopenmpt_defaults();
+#else
+	MPT_UNREFERENCED_PARAMETER( fd );
+	throw openmpt::exception("loading from file descriptors is not supported on this platform");
+#endif
+}
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+module_impl::module_impl( const archive_impl & arc, std::size_t index, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
+#else
+module_impl::module_impl( const archive_impl & arc, std::size_t index, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
+#endif
+	ctor( ctls );
+	// the loaders copy everything they need, so the decompressed file can be discarded afterwards
+	std::vector<char> buffer;
+	load( arc.get_file( index, buffer ), ctls );
+	apply_libopenmpt_defaults();
+}
 module_impl::~module_impl() {
 	m_sndFile->Destroy();
 }
@@ -1197,9 +1331,29 @@ std::vector<std::string> module_impl::get_ctls() const {
 	std::vector<std::string> retval;
 	retval.push_back( "load.skip_samples" );
 	retval.push_back( "load.skip_patterns" );
+	retval.push_back( "load.share_samples" );
+	retval.push_back( "load.lazy_samples" );
 	retval.push_back( "seek.sync_samples" );
+	retval.push_back( "seek.index_memory_kb" );
+	retval.push_back( "subsong.scan_threads" );
 	retval.push_back( "play.tempo_factor" );
 	retval.push_back( "play.pitch_factor" );
+	retval.push_back( "render.mixer_threads" );
+	retval.push_back( "render.mixer_threads.stats" );
+	retval.push_back( "render.voice_culling" );
+	retval.push_back( "render.voice_culling.stats" );
+	retval.push_back( "render.max_voices" );
+	retval.push_back( "render.profiling" );
+	retval.push_back( "render.profiling.stats" );
+	retval.push_back( "render.dsp.reverb" );
+	retval.push_back( "render.dsp.reverb.depth" );
+	retval.push_back( "render.dsp.reverb.type" );
+	retval.push_back( "render.dsp.reverb.cost" );
+	retval.push_back( "render.dsp.megabass" );
+	retval.push_back( "render.dsp.surround" );
+	retval.push_back( "render.dsp.agc" );
+	retval.push_back( "render.dsp.eq" );
+	retval.push_back( "render.dsp.eq.gains" );
 	retval.push_back( "dither" );
 	return retval;
 }
@@ -1210,8 +1364,16 @@ std::string module_impl::ctl_get( const std::string & ctl ) const {
 		return mpt::ToString( m_ctl_load_skip_samples );
 	} else if ( ctl == "load.skip_patterns" || ctl == "load_skip_patterns" ) {
 		return mpt::ToString( m_ctl_load_skip_patterns );
+	} else if ( ctl == "load.share_samples" ) {
+		return mpt::ToString( m_ctl_load_share_samples );
+	} else if ( ctl == "load.lazy_samples" ) {
+		return mpt::ToString( m_ctl_load_lazy_samples );
 	} else if ( ctl == "seek.sync_samples" ) {
 		return mpt::ToString( m_ctl_seek_sync_samples );
+	} else if ( ctl == "seek.index_memory_kb" ) {
+		return mpt::ToString( m_sndFile->m_SeekIndex.GetMemoryLimit() / 1024 );
+	} else if ( ctl == "subsong.scan_threads" ) {
+		return mpt::ToString( m_ctl_subsong_scan_threads );
 	} else if ( ctl == "play.tempo_factor" ) {
 		if ( !is_loaded() ) {
 			return "1.0";
@@ -1222,6 +1384,72 @@ std::string module_impl::ctl_get( const std::string & ctl ) const {
 			return "1.0";
 		}
 		return mpt::ToString( m_sndFile->m_nFreqFactor / 65536.0 );
+	} else if ( ctl == "render.mixer_threads" ) {
+		return mpt::ToString( m_ctl_render_mixer_threads );
+	} else if ( ctl == "render.mixer_threads.stats" ) {
+#ifndef NO_THREADS
+		std::string stats = mpt::ToString( m_sndFile->m_ParallelMixer.GetLastNumVoices() ) + " " + mpt::ToString( m_sndFile->m_ParallelMixer.GetNumWorkers() );
+		const std::vector<uint32> times = m_sndFile->m_ParallelMixer.GetLastMixTimes();
+		for ( std::vector<uint32>::const_iterator t = times.begin(); t != times.end(); ++t ) {
+			stats += " " + mpt::ToString( *t );
+		}
+		return stats;
+#else
+		return "0 0";
+#endif
+	} else if ( ctl == "render.voice_culling" ) {
+		return mpt::ToString( ( m_sndFile->m_MixerSettings.MixerFlags & SNDMIX_NOVOICECULLING ) == 0 );
+	} else if ( ctl == "render.voice_culling.stats" ) {
+		return mpt::ToString( m_sndFile->GetNumMixedVoices() ) + " " + mpt::ToString( m_sndFile->GetNumCulledVoices() );
+	} else if ( ctl == "render.max_voices" ) {
+		return mpt::ToString( m_sndFile->GetMaxVoices() );
+	} else if ( ctl == "render.profiling" ) {
+		return mpt::ToString( m_sndFile->m_RenderStats.timingEnabled );
+	} else if ( ctl == "render.profiling.stats" ) {
+		const RenderStats & stats = m_sndFile->m_RenderStats;
+		std::string result = mpt::ToString( stats.renderedFrames ) + " " + mpt::ToString( stats.ticks ) + " " + mpt::ToString( stats.chunks ) + " " + mpt::ToString( stats.mixedVoices ) + " " + mpt::ToString( stats.culledVoices );
+		for ( int stage = 0; stage < RenderStats::numStages; ++stage ) {
+			result += " " + mpt::ToString( stats.GetTime( static_cast<RenderStats::Stage>( stage ) ) / 1000 );
+		}
+		return result;
+	} else if ( ctl == "render.dsp.reverb" ) {
+		return mpt::ToString( get_dsp_effect( SNDDSP_REVERB ) );
+	} else if ( ctl == "render.dsp.reverb.depth" ) {
+#ifndef NO_REVERB
+		return mpt::ToString( m_sndFile->m_Reverb.m_Settings.m_nReverbDepth );
+#else
+		return "0";
+#endif
+	} else if ( ctl == "render.dsp.reverb.type" ) {
+#ifndef NO_REVERB
+		return mpt::ToString( m_sndFile->m_Reverb.m_Settings.m_nReverbType );
+#else
+		return "0";
+#endif
+	} else if ( ctl == "render.dsp.reverb.cost" ) {
+#ifndef NO_REVERB
+		const uint64 frames = m_sndFile->m_Reverb.GetProcessedFrames();
+		if ( frames == 0 ) {
+			return "0";
+		}
+		return mpt::ToString( Util::Round<std::int64_t>( static_cast<double>( m_sndFile->m_Reverb.GetProcessingTime() ) / 1000.0 * m_sndFile->m_MixerSettings.gdwMixingFreq / frames ) );
+#else
+		return "0";
+#endif
+	} else if ( ctl == "render.dsp.megabass" ) {
+		return mpt::ToString( get_dsp_effect( SNDDSP_MEGABASS ) );
+	} else if ( ctl == "render.dsp.surround" ) {
+		return mpt::ToString( get_dsp_effect( SNDDSP_SURROUND ) );
+	} else if ( ctl == "render.dsp.agc" ) {
+		return mpt::ToString( get_dsp_effect( SNDDSP_AGC ) );
+	} else if ( ctl == "render.dsp.eq" ) {
+		return mpt::ToString( get_dsp_effect( SNDDSP_EQ ) );
+	} else if ( ctl == "render.dsp.eq.gains" ) {
+		std::string gains;
+		for ( std::size_t i = 0; i < m_ctl_render_dsp_eq_gains.size(); ++i ) {
+			gains += ( i > 0 ? " " : "" ) + mpt::ToString( m_ctl_render_dsp_eq_gains[i] );
+		}
+		return gains;
 	} else if ( ctl == "dither" ) {
 		return mpt::ToString( static_cast<int>( m_Dither->GetMode() ) );
 	} else {
@@ -1235,8 +1463,23 @@ void module_impl::ctl_set( const std::string & ctl, const std::string & value )
 		m_ctl_load_skip_samples = ConvertStrTo<bool>( value );
 	} else if ( ctl == "load.skip_patterns" || ctl == "load_skip_patterns" ) {
 		m_ctl_load_skip_patterns = ConvertStrTo<bool>( value );
+	} else if ( ctl == "load.share_samples" ) {
+		m_ctl_load_share_samples = ConvertStrTo<bool>( value );
+	} else if ( ctl == "load.lazy_samples" ) {
+		m_ctl_load_lazy_samples = ConvertStrTo<bool>( value );
 	} else if ( ctl == "seek.sync_samples" ) {
 		m_ctl_seek_sync_samples = ConvertStrTo<bool>( value );
+	} else if ( ctl == "seek.index_memory_kb" ) {
+		m_sndFile->m_SeekIndex.SetMemoryLimit( static_cast<std::size_t>( ConvertStrTo<uint32>( value ) ) * 1024 );
+		m_sndFile->m_SeekIndex.Clear();
+		// the index is recorded along with the subsong durations
+		m_subsongs.clear();
+	} else if ( ctl == "subsong.scan_threads" ) {
+		std::int32_t threads = ConvertStrTo<std::int32_t>( value );
+		if ( threads < 0 ) {
+			throw openmpt::exception("invalid number of threads");
+		}
+		m_ctl_subsong_scan_threads = threads;
 	} else if ( ctl == "play.tempo_factor" ) {
 		if ( !is_loaded() ) {
 			return;
@@ -1257,6 +1500,85 @@ void module_impl::ctl_set( const std::string & ctl, const std::string & value )
 		}
 		m_sndFile->m_nFreqFactor = Util::Round<uint32_t>( 65536.0 * factor );
 		m_sndFile->RecalculateSamplesPerTick();
+	} else if ( ctl == "render.mixer_threads" ) {
+		std::int32_t threads = ConvertStrTo<std::int32_t>( value );
+		if ( threads < 0 ) {
+			throw openmpt::exception("invalid number of threads");
+		}
+		m_ctl_render_mixer_threads = threads;
+#ifndef NO_THREADS
+		m_sndFile->m_ParallelMixer.SetNumWorkers( threads == 0 ? std::thread::hardware_concurrency() : threads );
+#endif
+	} else if ( ctl == "render.mixer_threads.stats" ) {
+		throw openmpt::exception("read-only ctl: " + ctl);
+	} else if ( ctl == "render.voice_culling" ) {
+		if ( ConvertStrTo<bool>( value ) ) {
+			m_sndFile->m_MixerSettings.MixerFlags &= ~SNDMIX_NOVOICECULLING;
+		} else {
+			m_sndFile->m_MixerSettings.MixerFlags |= SNDMIX_NOVOICECULLING;
+		}
+	} else if ( ctl == "render.voice_culling.stats" ) {
+		throw openmpt::exception("read-only ctl: " + ctl);
+	} else if ( ctl == "render.max_voices" ) {
+		std::int32_t voices = ConvertStrTo<std::int32_t>( value );
+		if ( voices < 1 || voices > MAX_CHANNELS ) {
+			throw openmpt::exception("invalid number of voices");
+		}
+		m_sndFile->SetMaxVoices( static_cast<CHANNELINDEX>( voices ) );
+	} else if ( ctl == "render.profiling" ) {
+		m_sndFile->m_RenderStats.timingEnabled = ConvertStrTo<bool>( value );
+		m_sndFile->m_RenderStats.Reset();
+	} else if ( ctl == "render.profiling.stats" ) {
+		throw openmpt::exception("read-only ctl: " + ctl);
+	} else if ( ctl == "render.dsp.reverb" ) {
+		set_dsp_effect( SNDDSP_REVERB, ConvertStrTo<bool>( value ) );
+	} else if ( ctl == "render.dsp.reverb.depth" ) {
+		std::int32_t depth = ConvertStrTo<std::int32_t>( value );
+		if ( depth < 1 || depth > 16 ) {
+			throw openmpt::exception("invalid reverb depth");
+		}
+#ifndef NO_REVERB
+		m_sndFile->m_Reverb.m_Settings.m_nReverbDepth = depth;
+#endif
+	} else if ( ctl == "render.dsp.reverb.type" ) {
+		std::int32_t type = ConvertStrTo<std::int32_t>( value );
+		if ( type < 0 || type >= NUM_REVERBTYPES ) {
+			throw openmpt::exception("invalid reverb type");
+		}
+#ifndef NO_REVERB
+		m_sndFile->m_Reverb.m_Settings.m_nReverbType = type;
+		m_sndFile->m_Reverb.Initialize( false, m_sndFile->m_MixerSettings.gdwMixingFreq );
+#endif
+	} else if ( ctl == "render.dsp.reverb.cost" ) {
+		throw openmpt::exception("read-only ctl: " + ctl);
+	} else if ( ctl == "render.dsp.megabass" ) {
+		set_dsp_effect( SNDDSP_MEGABASS, ConvertStrTo<bool>( value ) );
+	} else if ( ctl == "render.dsp.surround" ) {
+		set_dsp_effect( SNDDSP_SURROUND, ConvertStrTo<bool>( value ) );
+	} else if ( ctl == "render.dsp.agc" ) {
+		set_dsp_effect( SNDDSP_AGC, ConvertStrTo<bool>( value ) );
+	} else if ( ctl == "render.dsp.eq" ) {
+		set_dsp_effect( SNDDSP_EQ, ConvertStrTo<bool>( value ) );
+	} else if ( ctl == "render.dsp.eq.gains" ) {
+		std::istringstream str( value );
+		std::vector<std::int32_t> gains;
+		std::int32_t gain = 0;
+		while ( str >> gain ) {
+			if ( gain < 0 || gain > 32 ) {
+				throw openmpt::exception("invalid eq gain");
+			}
+			gains.push_back( gain );
+		}
+		if ( !str.eof() || gains.size() != m_ctl_render_dsp_eq_gains.size() ) {
+			throw openmpt::exception("invalid number of eq gains");
+		}
+		m_ctl_render_dsp_eq_gains = gains;
+#ifndef NO_EQ
+		static const UINT freqs[6] = { 125, 300, 600, 1250, 4000, 8000 };
+		UINT eqGains[6];
+		std::copy( gains.begin(), gains.end(), eqGains );
+		m_sndFile->SetEQGains( eqGains, 6, freqs, false );
+#endif
 	} else if ( ctl == "dither" ) {
 		m_Dither->SetMode( static_cast<DitherMode>( ConvertStrTo<int>( value ) ) );
 	} else {
@@ -1264,19 +1586,415 @@ void module_impl::ctl_set( const std::string & ctl, const std::string & value )
 	}
 }
 
+#ifndef NO_THREADS
+
+// Calculates the subsong durations of all sequences, with every worker thread picking the next sequence that has not been scanned yet.
+// The subsongs of a sequence depend on each other (a new subsong starts at the first row that has not been played yet), so a sequence is always scanned as a whole.
+class subsong_scanner {
+private:
+	CSoundFile & m_sndFile;
+	std::vector< std::vector<GetLengthType> > & m_lengths;
+	Util::mutex m_mutex;
+	std::size_t m_next_sequence;
+	std::exception_ptr m_exception;
+public:
+	subsong_scanner( CSoundFile & sndFile, std::vector< std::vector<GetLengthType> > & lengths )
+		: m_sndFile(sndFile)
+		, m_lengths(lengths)
+		, m_next_sequence(0)
+	{
+		return;
+	}
+	void operator () () {
+		for ( ;; ) {
+			std::size_t seq = 0;
+			{
+				Util::lock_guard<Util::mutex> guard( m_mutex );
+				if ( m_exception || m_next_sequence >= m_lengths.size() ) {
+					return;
+				}
+				seq = m_next_sequence++;
+			}
+			try {
+				// without eAdjust, GetLength() does not modify the module and can be called concurrently for different sequences
+				m_lengths[seq] = m_sndFile.GetLength( eNoAdjust, GetLengthTarget( true ).StartPos( static_cast<SEQUENCEINDEX>( seq ), 0, 0 ) );
+			} catch ( ... ) {
+				Util::lock_guard<Util::mutex> guard( m_mutex );
+				if ( !m_exception ) {
+					m_exception = std::current_exception();
+				}
+				return;
+			}
+		}
+	}
+	void run( std::size_t num_threads ) {
+		std::vector<std::thread> threads;
+		for ( std::size_t i = 1; i < num_threads; ++i ) {
+			try {
+				threads.push_back( std::thread( std::ref( *this ) ) );
+			} catch ( const std::system_error & ) {
+				// continue with the threads we already have
+				break;
+			}
+		}
+		// the calling thread takes part in the scan as well
+		( *this )();
+		for ( std::vector<std::thread>::iterator thread = threads.begin(); thread != threads.end(); ++thread ) {
+			thread->join();
+		}
+		if ( m_exception ) {
+			std::rethrow_exception( m_exception );
+		}
+	}
+}; // class subsong_scanner
+
+#endif // NO_THREADS
+
 void module_impl::cache_subsongs() const {
 	if ( !m_subsongs.empty() ) {
 		return;
 	}
 
-	m_subsongs.reserve( m_sndFile->Order.GetNumSequences() );
+	const SEQUENCEINDEX num_sequences = m_sndFile->Order.GetNumSequences();
+	std::vector< std::vector<GetLengthType> > lengths( num_sequences );
 
-	for ( SEQUENCEINDEX seq = 0; seq < m_sndFile->Order.GetNumSequences(); ++seq ) {
-		const std::vector<GetLengthType> lengths = m_sndFile->GetLength( eNoAdjust, GetLengthTarget( true ).StartPos( seq, 0, 0 ) );
-		for ( std::vector<GetLengthType>::const_iterator l = lengths.begin(); l != lengths.end(); ++l ) {
+#ifndef NO_THREADS
+	std::size_t num_threads = m_ctl_subsong_scan_threads;
+	if ( num_threads == 0 ) {
+		num_threads = std::thread::hardware_concurrency();
+	}
+	num_threads = std::min<std::size_t>( num_threads, num_sequences );
+	if ( num_threads > 1 ) {
+		subsong_scanner scanner( *m_sndFile, lengths );
+		scanner.run( num_threads );
+	} else
+#endif // NO_THREADS
+	{
+		for ( SEQUENCEINDEX seq = 0; seq < num_sequences; ++seq ) {
+			lengths[seq] = m_sndFile->GetLength( eNoAdjust, GetLengthTarget( true ).StartPos( seq, 0, 0 ) );
+		}
+	}
+
+	// merge in sequence order, so that the result does not depend on the number of threads
+	m_subsongs.reserve( num_sequences );
+	for ( SEQUENCEINDEX seq = 0; seq < num_sequences; ++seq ) {
+		for ( std::vector<GetLengthType>::const_iterator l = lengths[seq].begin(); l != lengths[seq].end(); ++l ) {
 			m_subsongs.push_back( subsong_data( l->duration, l->startRow, l->startOrder, seq ) );
 		}
 	}
 }
 
+// ZIP archive reading, see the PKWARE APPNOTE.TXT for the format.
+
+static const std::uint32_t zip_local_header_magic = 0x04034b50;
+static const std::uint32_t zip_central_header_magic = 0x02014b50;
+static const std::uint32_t zip_end_of_central_directory_magic = 0x06054b50;
+static const std::size_t zip_end_of_central_directory_size = 22;
+static const std::uint16_t zip_method_stored = 0;
+static const std::uint16_t zip_method_deflated = 8;
+static const std::uint16_t zip_flag_encrypted = 0x0001;
+static const std::uint16_t zip_flag_utf8 = 0x0800;
+// Deflate cannot compress data by more than about 1:1032.
+static const std::uint32_t zip_max_deflate_ratio = 1032;
+
+static bool is_module_filename( const std::string & filename, const std::vector<std::string> & extensions ) {
+	std::string name = filename.substr( filename.find_last_of( "/\\" ) + 1 );
+	for ( std::string::iterator c = name.begin(); c != name.end(); ++c ) {
+		// File names may contain any bytes, and tolower() is undefined for negative values other than EOF.
+		*c = static_cast<char>( std::tolower( static_cast<unsigned char>( *c ) ) );
+	}
+	const std::string::size_type first_dot = name.find( '.' );
+	const std::string::size_type last_dot = name.rfind( '.' );
+	if ( last_dot == std::string::npos ) {
+		return false;
+	}
+	// Amiga module collections often name files "mod.title" instead of "title.mod"
+	return std::find( extensions.begin(), extensions.end(), name.substr( last_dot + 1 ) ) != extensions.end()
+		|| std::find( extensions.begin(), extensions.end(), name.substr( 0, first_dot ) ) != extensions.end();
+}
+
+archive_impl::archive_impl( const void * data, std::size_t size ) : m_data(static_cast<const char *>( data )), m_size(data ? size : 0) {
+	read_central_directory();
+}
+archive_impl::~archive_impl() {
+	return;
+}
+
+void archive_impl::read_central_directory() {
+	FileReader file( m_data, m_size );
+	if ( m_size < zip_end_of_central_directory_size ) {
+		throw openmpt::exception("not a ZIP archive");
+	}
+	// The end of central directory record is followed by an archive comment of up to 65535 bytes.
+	std::size_t eocd_pos = m_size - zip_end_of_central_directory_size;
+	const std::size_t eocd_min_pos = ( eocd_pos > 65535 ) ? ( eocd_pos - 65535 ) : 0;
+	for ( ;; ) {
+		file.Seek( eocd_pos );
+		if ( file.ReadUint32LE() == zip_end_of_central_directory_magic ) {
+			break;
+		}
+		if ( eocd_pos == eocd_min_pos ) {
+			throw openmpt::exception("not a ZIP archive");
+		}
+		--eocd_pos;
+	}
+	const std::uint16_t disk = file.ReadUint16LE();
+	const std::uint16_t central_directory_disk = file.ReadUint16LE();
+	const std::uint16_t num_disk_entries = file.ReadUint16LE();
+	const std::uint16_t num_entries = file.ReadUint16LE();
+	file.Skip( 4 ); // central directory size
+	const std::uint32_t central_directory_offset = file.ReadUint32LE();
+	if ( disk != 0 || central_directory_disk != 0 || num_disk_entries != num_entries ) {
+		throw openmpt::exception("multi-volume ZIP archives are not supported");
+	}
+	if ( central_directory_offset == 0xFFFFFFFFu ) {
+		throw openmpt::exception("ZIP64 archives are not supported");
+	}
+	if ( !file.Seek( central_directory_offset ) ) {
+		throw openmpt::exception("corrupted ZIP central directory");
+	}
+
+	const std::vector<std::string> extensions = module_impl::get_supported_extensions();
+	for ( std::uint16_t i = 0; i < num_entries; ++i ) {
+		if ( file.ReadUint32LE() != zip_central_header_magic ) {
+			throw openmpt::exception("corrupted ZIP central directory");
+		}
+		file.Skip( 4 ); // version made by, version needed to extract
+		const std::uint16_t flags = file.ReadUint16LE();
+		file_entry entry;
+		entry.method = file.ReadUint16LE();
+		file.Skip( 4 ); // modification time and date
+		entry.crc = file.ReadUint32LE();
+		entry.compressed_size = file.ReadUint32LE();
+		entry.size = file.ReadUint32LE();
+		const std::uint16_t filename_length = file.ReadUint16LE();
+		const std::uint16_t extra_length = file.ReadUint16LE();
+		const std::uint16_t comment_length = file.ReadUint16LE();
+		file.Skip( 8 ); // disk number, internal and external attributes
+		entry.local_header_offset = file.ReadUint32LE();
+		if ( !file.ReadString<mpt::String::maybeNullTerminated>( entry.filename, filename_length ) || !file.Skip( extra_length + comment_length ) ) {
+			throw openmpt::exception("corrupted ZIP central directory");
+		}
+		if ( entry.filename.empty() || entry.filename[entry.filename.length() - 1] == '/' ) {
+			continue; // directory
+		}
+		if ( ( flags & zip_flag_encrypted ) || ( entry.method != zip_method_stored && entry.method != zip_method_deflated ) ) {
+			continue;
+		}
+		if ( entry.size == 0 || entry.size == 0xFFFFFFFFu || entry.compressed_size == 0xFFFFFFFFu || entry.local_header_offset == 0xFFFFFFFFu ) {
+			continue; // empty or ZIP64
+		}
+		if ( !( flags & zip_flag_utf8 ) ) {
+			entry.filename = mpt::ToCharset( mpt::CharsetUTF8, mpt::CharsetCP437, entry.filename );
+		}
+		if ( !is_module_filename( entry.filename, extensions ) ) {
+			continue;
+		}
+		m_entries.push_back( entry );
+	}
+}
+
+std::vector<archive_entry> archive_impl::get_entries() const {
+	std::vector<archive_entry> result;
+	result.reserve( m_entries.size() );
+	for ( std::vector<file_entry>::const_iterator i = m_entries.begin(); i != m_entries.end(); ++i ) {
+		archive_entry entry;
+		entry.filename = i->filename;
+		entry.size = i->size;
+		result.push_back( entry );
+	}
+	return result;
+}
+
+FileReader archive_impl::get_file( std::size_t index, std::vector<char> & buffer ) const {
+	if ( index >= m_entries.size() ) {
+		throw openmpt::exception("invalid archive entry index");
+	}
+	const file_entry & entry = m_entries[index];
+	FileReader file( m_data, m_size );
+	if ( !file.Seek( static_cast<FileReader::off_t>( entry.local_header_offset ) ) || file.ReadUint32LE() != zip_local_header_magic ) {
+		throw openmpt::exception("corrupted ZIP file header");
+	}
+	// The sizes in the local header may be zero if they are stored in a data descriptor after the file data, so only the central directory sizes are used.
+	file.Skip( 22 );
+	const std::uint16_t filename_length = file.ReadUint16LE();
+	const std::uint16_t extra_length = file.ReadUint16LE();
+	if ( !file.Skip( filename_length + extra_length ) || !file.CanRead( static_cast<FileReader::off_t>( entry.compressed_size ) ) ) {
+		throw openmpt::exception("truncated ZIP file data");
+	}
+	const std::size_t data_offset = file.GetPosition();
+
+	if ( entry.method == zip_method_stored ) {
+		if ( entry.compressed_size != entry.size ) {
+			throw openmpt::exception("corrupted ZIP file header");
+		}
+		// Stored files are passed on without a CRC check so that they never have to be copied; the loaders check all bounds anyway.
+		return file.GetChunk( data_offset, static_cast<FileReader::off_t>( entry.size ) );
+	}
+
+#if !defined(NO_ZLIB) || !defined(NO_MINIZ)
+	// Do not trust the declared size of a deflated file before allocating a buffer for it.
+	if ( entry.size / zip_max_deflate_ratio > entry.compressed_size ) {
+		throw openmpt::exception("corrupted ZIP file header");
+	}
+	try {
+		buffer.resize( static_cast<std::size_t>( entry.size ) );
+	} catch ( const std::bad_alloc & ) {
+		throw openmpt::exception("out of memory");
+	}
+	z_stream strm;
+	std::memset( &strm, 0, sizeof( strm ) );
+	if ( inflateInit2( &strm, -MAX_WBITS ) != Z_OK ) {
+		throw openmpt::exception("cannot initialize inflate");
+	}
+	strm.next_in = reinterpret_cast<Bytef *>( const_cast<char *>( m_data + data_offset ) );
+	strm.avail_in = static_cast<uInt>( entry.compressed_size );
+	strm.next_out = reinterpret_cast<Bytef *>( &buffer[0] );
+	strm.avail_out = static_cast<uInt>( buffer.size() );
+	const int result = inflate( &strm, Z_FINISH );
+	const uLong total_out = strm.total_out;
+	inflateEnd( &strm );
+	if ( result != Z_STREAM_END || total_out != entry.size || crc32( 0, reinterpret_cast<const Bytef *>( &buffer[0] ), static_cast<uInt>( buffer.size() ) ) != entry.crc ) {
+		throw openmpt::exception("corrupted ZIP file data");
+	}
+	return FileReader( &buffer[0], buffer.size() );
+#else
+	MPT_UNREFERENCED_PARAMETER( buffer );
+	throw openmpt::exception("deflated ZIP files are not supported in this build");
+#endif
+}
+
+std::vector<std::uint8_t> archive_impl::extract( std::size_t index ) const {
+	std::vector<char> buffer;
+	FileReader file = get_file( index, buffer );
+	std::vector<std::uint8_t> result;
+	file.ReadVector( result, file.BytesLeft() );
+	return result;
+}
+
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+module_info archive_impl::probe( std::size_t index, bool calculate_duration, std::tr1::shared_ptr<log_interface> log ) const {
+#else
+module_info archive_impl::probe( std::size_t index, bool calculate_duration, std::shared_ptr<log_interface> log ) const {
+#endif
+	module_impl mod( *this, index, log, module_impl::get_probe_ctls( calculate_duration ) );
+	return mod.get_probe_info( calculate_duration );
+}
+
+// Probes the file at index into results[index]. Errors are logged instead of thrown, so that one broken file does not stop the others.
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+static void probe_archive_entry( const archive_impl & arc, const std::vector<archive_entry> & entries, std::size_t index, bool calculate_duration, std::tr1::shared_ptr<log_interface> log, std::vector<module_info> & results ) {
+#else
+static void probe_archive_entry( const archive_impl & arc, const std::vector<archive_entry> & entries, std::size_t index, bool calculate_duration, std::shared_ptr<log_interface> log, std::vector<module_info> & results ) {
+#endif
+	try {
+		results[index] = arc.probe( index, calculate_duration, log );
+	} catch ( const std::exception & e ) {
+		log->log( entries[index].filename + ": " + e.what() );
+	}
+}
+
+#ifndef NO_THREADS
+
+// Serializes the log output of several threads.
+class locked_log : public log_interface {
+private:
+	std::shared_ptr<log_interface> m_log;
+	mutable Util::mutex m_mutex;
+public:
+	locked_log( std::shared_ptr<log_interface> log ) : m_log(log) {
+		return;
+	}
+	virtual ~locked_log() {
+		return;
+	}
+	virtual void log( const std::string & message ) const {
+		Util::lock_guard<Util::mutex> guard( m_mutex );
+		m_log->log( message );
+	}
+}; // class locked_log
+
+// Probes all files of an archive, with every worker thread picking the next file that has not been probed yet.
+class archive_prober {
+private:
+	const archive_impl & m_archive;
+	const std::vector<archive_entry> & m_entries;
+	std::vector<module_info> & m_results;
+	bool m_calculate_duration;
+	std::shared_ptr<log_interface> m_log;
+	Util::mutex m_mutex;
+	std::size_t m_next_entry;
+public:
+	archive_prober( const archive_impl & arc, const std::vector<archive_entry> & entries, std::vector<module_info> & results, bool calculate_duration, std::shared_ptr<log_interface> log )
+		: m_archive(arc)
+		, m_entries(entries)
+		, m_results(results)
+		, m_calculate_duration(calculate_duration)
+		, m_log(std::make_shared<locked_log>( log ))
+		, m_next_entry(0)
+	{
+		return;
+	}
+	void operator () () {
+		for ( ;; ) {
+			std::size_t index = 0;
+			{
+				Util::lock_guard<Util::mutex> guard( m_mutex );
+				if ( m_next_entry >= m_entries.size() ) {
+					return;
+				}
+				index = m_next_entry++;
+			}
+			probe_archive_entry( m_archive, m_entries, index, m_calculate_duration, m_log, m_results );
+		}
+	}
+	void run( std::size_t num_threads ) {
+		std::vector<std::thread> threads;
+		for ( std::size_t i = 1; i < num_threads; ++i ) {
+			try {
+				threads.push_back( std::thread( std::ref( *this ) ) );
+			} catch ( const std::system_error & ) {
+				// continue with the threads we already have
+				break;
+			}
+		}
+		// the calling thread takes part as well
+		( *this )();
+		for ( std::vector<std::thread>::iterator thread = threads.begin(); thread != threads.end(); ++thread ) {
+			thread->join();
+		}
+	}
+}; // class archive_prober
+
+#endif // NO_THREADS
+
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+std::vector<module_info> archive_impl::probe_all( bool calculate_duration, std::int32_t threads, std::tr1::shared_ptr<log_interface> log ) const {
+#else
+std::vector<module_info> archive_impl::probe_all( bool calculate_duration, std::int32_t threads, std::shared_ptr<log_interface> log ) const {
+#endif
+	if ( threads < 0 ) {
+		throw openmpt::exception("invalid number of threads");
+	}
+	const std::vector<archive_entry> entries = get_entries();
+	std::vector<module_info> results( entries.size(), module_info() );
+#ifndef NO_THREADS
+	std::size_t num_threads = threads;
+	if ( num_threads == 0 ) {
+		num_threads = std::thread::hardware_concurrency();
+	}
+	num_threads = std::min<std::size_t>( num_threads, entries.size() );
+	if ( num_threads > 1 ) {
+		archive_prober prober( *this, entries, results, calculate_duration, log );
+		prober.run( num_threads );
+	} else
+#endif // NO_THREADS
+	{
+		for ( std::size_t i = 0; i < entries.size(); ++i ) {
+			probe_archive_entry( *this, entries, i, calculate_duration, log, results );
+		}
+	}
+	return results;
+}
+
 } // namespace openmpt
@@ -57,6 +57,38 @@ public:
 
 class log_forwarder;
 
+class archive_impl {
+protected:
+	struct file_entry {
+		std::string filename;
+		std::uint64_t size;
+		std::uint64_t compressed_size;
+		std::uint64_t local_header_offset;
+		std::uint32_t crc;
+		std::uint16_t method;
+	}; // struct file_entry
+	const char * m_data;
+	std::size_t m_size;
+	std::vector<file_entry> m_entries;
+protected:
+	void read_central_directory();
+public:
+	archive_impl( const void * data, std::size_t size );
+	~archive_impl();
+public:
+	std::vector<archive_entry> get_entries() const;
+	// Returns a reader for the uncompressed file data. Stored files are read in place, deflated files are decompressed into buffer.
+	OpenMPT::FileReader get_file( std::size_t index, std::vector<char> & buffer ) const;
+	std::vector<std::uint8_t> extract( std::size_t index ) const;
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	module_info probe( std::size_t index, bool calculate_duration, std::tr1::shared_ptr<log_interface> log ) const;
+	std::vector<module_info> probe_all( bool calculate_duration, std::int32_t threads, std::tr1::shared_ptr<log_interface> log ) const;
+#else
+	module_info probe( std::size_t index, bool calculate_duration, std::shared_ptr<log_interface> log ) const;
+	std::vector<module_info> probe_all( bool calculate_duration, std::int32_t threads, std::shared_ptr<log_interface> log ) const;
+#endif
+}; // class archive_impl
+
 class module_impl {
 protected:
 	struct subsong_data {
@@ -93,7 +125,12 @@ protected:
 	float m_Gain;
 	bool m_ctl_load_skip_samples;
 	bool m_ctl_load_skip_patterns;
+	bool m_ctl_load_share_samples;
+	bool m_ctl_load_lazy_samples;
 	bool m_ctl_seek_sync_samples;
+	std::int32_t m_ctl_subsong_scan_threads;
+	std::int32_t m_ctl_render_mixer_threads;
+	std::vector<std::int32_t> m_ctl_render_dsp_eq_gains;
 	std::vector<std::string> m_loaderMessages;
 	mutable std::vector<subsong_data> m_subsongs;
 	std::int32_t m_current_subsong;
@@ -104,6 +141,8 @@ protected:
 	std::string mod_string_to_utf8( const std::string & encoded ) const;
 	void apply_mixer_settings( std::int32_t samplerate, int channels );
 	void apply_libopenmpt_defaults();
+	bool get_dsp_effect( std::uint32_t flag ) const;
+	void set_dsp_effect( std::uint32_t flag, bool enable );
 	void ctor( const std::map< std::string, std::string > & ctls );
 	void load( const OpenMPT::FileReader & file, const std::map< std::string, std::string > & ctls );
 	bool is_loaded() const;
@@ -122,6 +161,13 @@ public:
 #else
 	static double could_open_propability( std::istream & stream, double effort, std::shared_ptr<log_interface> log );
 #endif
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	static module_info probe( std::istream & stream, bool calculate_duration, std::tr1::shared_ptr<log_interface> log );
+#else
+	static module_info probe( std::istream & stream, bool calculate_duration, std::shared_ptr<log_interface> log );
+#endif
+	static std::map< std::string, std::string > get_probe_ctls( bool calculate_duration );
+	module_info get_probe_info( bool calculate_duration ) const;
 #ifdef LIBOPENMPT_ANCIENT_COMPILER
 	module_impl( std::istream & stream, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
 #else
@@ -151,6 +197,21 @@ public:
 	module_impl( const void * data, std::size_t size, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
 #else
 	module_impl( const void * data, std::size_t size, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
+#endif
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	module_impl( const std::string & filename, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
+#else
+	module_impl( const std::string & filename, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
+#endif
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	module_impl( int fd, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
+#else
+	module_impl( int fd, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
+#endif
+#ifdef LIBOPENMPT_ANCIENT_COMPILER
+	module_impl( const archive_impl & arc, std::size_t index, std::tr1::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
+#else
+	module_impl( const archive_impl & arc, std::size_t index, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
 #endif
 	~module_impl();
 public:
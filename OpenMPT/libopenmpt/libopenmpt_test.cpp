@@ -15,6 +15,7 @@
 
 #include <iostream>
 #include <locale>
+#include <string>
 
 #include <clocale>
 #include <cstdlib>
@@ -28,11 +29,18 @@ using namespace OpenMPT;
 // mingw64 does only default to special C linkage for "main", but not for "wmain".
 extern "C"
 #endif
-int wmain( int /*argc*/ , wchar_t * /*argv*/ [] ) {
+int wmain( int argc, wchar_t * argv [] ) {
+	const bool benchmark = ( argc > 1 ) && ( std::wstring( argv[1] ) == L"--benchmark" );
 #else
-int main( int /*argc*/ , char * /*argv*/ [] ) {
+int main( int argc, char * argv [] ) {
+	const bool benchmark = ( argc > 1 ) && ( std::string( argv[1] ) == "--benchmark" );
 #endif
 	try {
+
+		if ( benchmark ) {
+			Test::DoBenchmarks();
+			return 0;
+		}
 	
 		// run test with "C" / classic() locale
 		Test::DoTests();
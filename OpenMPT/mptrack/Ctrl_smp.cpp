@@ -1249,6 +1249,14 @@ void CCtrlSamples::OnNormalize()
 				}
 			}
 
+			// Samples that already use the full range can be skipped without scanning them
+			const SampleIndex *index = m_sndFile.GetSampleIndex(sample);
+			if(index != nullptr && selStart == 0 && selEnd == sample.nLength
+				&& index->GetRangePeak(0, sample.nLength - 1) >= (sample.uFlags[CHN_16BIT] ? 32767 : (127 << 8)))
+			{
+				continue;
+			}
+
 			m_modDoc.GetSampleUndo().PrepareUndo(iSmp, sundo_update, "Normalize", selStart, selEnd);
 
 			if(sample.uFlags[CHN_STEREO]) { selStart *= 2; selEnd *= 2; }
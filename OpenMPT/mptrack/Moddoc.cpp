@@ -154,6 +154,9 @@ CModDoc::CModDoc() : m_LogMode(LogModeInstantReporting), m_PatternUndo(*this), m
 // -! NEW_FEATURE#0015
 	m_ShowSavedialog = false;
 
+	// All pattern edits are reported to the song length cache through the pattern undo buffer.
+	m_SndFile.m_SongLengthCache.SetEnabled(true);
+
 	CMainFrame::UpdateAudioParameters(m_SndFile, true);
 }
 
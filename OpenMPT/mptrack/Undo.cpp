@@ -106,6 +106,9 @@ bool CPatternUndo::PrepareBuffer(undobuf_t &buffer, PATTERNINDEX pattern, CHANNE
 
 	buffer.push_back(undo);
 
+	// The pattern is about to be modified (or restored by Undo()), so it has to be played again when the song length is recalculated.
+	modDoc.GetrSoundFile().m_SongLengthCache.InvalidatePattern(pattern);
+
 	modDoc.UpdateAllViews(NULL, HINT_UNDO);
 	return true;
 }
@@ -51,6 +51,12 @@ static const char * const license =
 #include <string>
 #include <vector>
 
+#if defined(MPT_WITH_THREADS)
+#include <chrono>
+#include <mutex>
+#include <thread>
+#endif
+
 #include <cmath>
 #if !defined(OPENMPT123_ANCIENT_COMPILER)
 #include <cstdint>
@@ -166,9 +172,11 @@ static void set_input_mode() {
 class file_audio_stream_raii : public file_audio_stream_base {
 private:
 	file_audio_stream_base * impl;
+	std::uint64_t frames_written;
 public:
 	file_audio_stream_raii( const commandlineflags & flags, const std::string & filename, std::ostream & log )
 		: impl(0)
+		, frames_written(0)
 	{
 		if ( !flags.force_overwrite ) {
 #if defined(OPENMPT123_ANCIENT_COMPILER)
@@ -215,9 +223,14 @@ public:
 	}
 	virtual void write( const std::vector<float*> buffers, std::size_t frames ) {
 		impl->write( buffers, frames );
+		frames_written += frames;
 	}
 	virtual void write( const std::vector<std::int16_t*> buffers, std::size_t frames ) {
 		impl->write( buffers, frames );
+		frames_written += frames;
+	}
+	std::uint64_t get_frames_written() const {
+		return frames_written;
 	}
 };                                                                                                                
 
@@ -284,6 +297,7 @@ static std::ostream & operator << ( std::ostream & s, const commandlineflags & f
 	s << "Standard output: " << flags.use_stdout << std::endl;
 	s << "Output filename: " << flags.output_filename << std::endl;
 	s << "Force overwrite output file: " << flags.force_overwrite << std::endl;
+	s << "Jobs: " << flags.jobs << std::endl;
 	s << "Ctls: " << ctls_to_string( flags.ctls ) << std::endl;
 	s << std::endl;
 	s << "Files: " << std::endl;
@@ -532,6 +546,7 @@ static void show_help( textout & log, bool with_info = true, bool longhelp = fal
 		log << "     --output-type t        Use output format t when writing to a PCM file [default: " << commandlineflags().output_extension << "]" << std::endl;
 		log << " -o, --output f             Write PCM output to file f instead of streaming to audio device [default: " << commandlineflags().output_filename << "]" << std::endl;
 		log << "     --force                Force overwriting of output file [default: " << commandlineflags().force_overwrite << "]" << std::endl;
+		log << "     --jobs n               Render n files in parallel in --render mode (0 means one per CPU) [default: " << commandlineflags().jobs << "]" << std::endl;
 		log << std::endl;
 		log << "     --                     Interpret further arguments as filenames" << std::endl;
 		log << std::endl;
@@ -1405,12 +1420,14 @@ void render_mod_file( commandlineflags & flags, const std::string & filename, st
 
 }
 
-static void render_file( commandlineflags & flags, const std::string & filename, textout & log, write_buffers_interface & audio_stream ) {
+static bool render_file( commandlineflags & flags, const std::string & filename, textout & log, write_buffers_interface & audio_stream ) {
 
 	log.writeout();
 
 	std::ostringstream silentlog;
 
+	bool success = false;
+
 	try {
 
 #if defined(WIN32) && defined(UNICODE) && !defined(_MSC_VER)
@@ -1468,6 +1485,7 @@ static void render_file( commandlineflags & flags, const std::string & filename,
 			mod.select_subsong( -1 ); // play all subsongs consecutively
 			silentlog.str( std::string() ); // clear, loader messages get stored to get_metadata( "warnings" ) by libopenmpt internally
 			render_mod_file( flags, filename, filesize, mod, log, audio_stream );
+			success = true;
 		} 
 
 	} catch ( prev_file & ) {
@@ -1496,6 +1514,8 @@ static void render_file( commandlineflags & flags, const std::string & filename,
 
 	log.writeout();
 
+	return success;
+
 }
 
 
@@ -1532,6 +1552,106 @@ static void render_files( commandlineflags & flags, textout & log, write_buffers
 }
 
 
+#if defined(MPT_WITH_THREADS)
+
+struct parallel_render_state {
+	std::mutex mutex;
+	std::size_t next_file;
+	std::size_t files_done;
+	std::size_t files_failed;
+	std::uint64_t frames_rendered;
+	parallel_render_state()
+		: next_file(0)
+		, files_done(0)
+		, files_failed(0)
+		, frames_rendered(0)
+	{
+		return;
+	}
+};
+
+// Renders files from the shared list until none are left.
+// Each worker only holds one module and one output file at a time, so memory usage is bounded by the number of workers.
+// The output for each file is collected and written to the log as a whole once the file is done.
+static void render_files_worker( commandlineflags flags, parallel_render_state & state, textout & log ) {
+	// Progress lines of different files would be interleaved
+	flags.show_progress = false;
+	flags.show_details = false;
+	while ( true ) {
+		std::size_t index = 0;
+		{
+			std::lock_guard<std::mutex> guard( state.mutex );
+			if ( state.next_file >= flags.filenames.size() ) {
+				break;
+			}
+			index = state.next_file++;
+		}
+		flags.playlist_index = index;
+		const std::string & filename = flags.filenames[ index ];
+		const std::string output_filename = filename + std::string(".") + flags.output_extension;
+		textout_string file_log;
+		bool success = false;
+		std::uint64_t frames = 0;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		try {
+			file_audio_stream_raii file_audio_stream( flags, output_filename, file_log );
+			success = render_file( flags, filename, file_log, file_audio_stream );
+			frames = file_audio_stream.get_frames_written();
+		} catch ( std::exception & e ) {
+			file_log << "error rendering '" << filename << "': " << e.what() << std::endl;
+		} catch ( ... ) {
+			file_log << "unknown error rendering '" << filename << "'" << std::endl;
+		}
+		const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+		const double audio_seconds = static_cast<double>( frames ) / static_cast<double>( flags.samplerate );
+		std::lock_guard<std::mutex> guard( state.mutex );
+		state.files_done++;
+		if ( !success ) {
+			state.files_failed++;
+		}
+		state.frames_rendered += frames;
+		file_log << "[" << state.files_done << "/" << flags.filenames.size() << "] ";
+		if ( success ) {
+			file_log << "Rendered '" << output_filename << "': " << seconds_to_string( audio_seconds ) << " in " << std::fixed << std::setprecision(2) << seconds << "s";
+			if ( seconds > 0.0 ) {
+				file_log << " (" << audio_seconds / seconds << "x realtime)";
+			}
+		} else {
+			file_log << "Failed to render '" << filename << "'";
+		}
+		file_log << std::endl << std::endl;
+		log << file_log.get_text();
+		log.writeout();
+	}
+}
+
+// Renders independent files on flags.jobs worker threads and shows the overall throughput at the end.
+static void render_files_parallel( commandlineflags & flags, textout & log ) {
+	log.writeout();
+	parallel_render_state state;
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const std::size_t num_workers = std::min( static_cast<std::size_t>( flags.jobs ), flags.filenames.size() );
+	std::vector<std::thread> workers;
+	for ( std::size_t worker = 0; worker < num_workers; ++worker ) {
+		workers.push_back( std::thread( render_files_worker, flags, std::ref( state ), std::ref( log ) ) );
+	}
+	for ( std::vector<std::thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker ) {
+		worker->join();
+	}
+	const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	const double audio_seconds = static_cast<double>( state.frames_rendered ) / static_cast<double>( flags.samplerate );
+	std::ostringstream summary;
+	summary << "Rendered " << state.files_done - state.files_failed << " of " << state.files_done << " files";
+	summary << " (" << seconds_to_string( audio_seconds ) << ") in " << std::fixed << std::setprecision(2) << seconds << "s with " << num_workers << " jobs";
+	if ( seconds > 0.0 ) {
+		summary << ": " << state.files_done / seconds << " files/s, " << audio_seconds / seconds << "x realtime";
+	}
+	log << summary.str() << std::endl;
+	log.writeout();
+}
+
+#endif // MPT_WITH_THREADS
+
 static commandlineflags parse_openmpt123( const std::vector<std::string> & args, std::ostream & log ) {
 
 	log.flush();
@@ -1678,6 +1798,10 @@ static commandlineflags parse_openmpt123( const std::vector<std::string> & args,
 				++i;
 			} else if ( arg == "--force" ) {
 				flags.force_overwrite = true;
+			} else if ( arg == "--jobs" && nextarg != "" ) {
+				std::istringstream istr( nextarg );
+				istr >> flags.jobs;
+				++i;
 			} else if ( arg == "--output-type" && nextarg != "" ) {
 				flags.output_extension = nextarg;
 				++i;
@@ -1955,6 +2079,13 @@ static int main( int argc, char * argv [] ) {
 				}
 			} break;
 			case ModeRender: {
+#if defined(MPT_WITH_THREADS)
+				if ( flags.jobs > 1 ) {
+					flags.apply_default_buffer_sizes();
+					render_files_parallel( flags, log );
+					break;
+				}
+#endif
 				for ( std::vector<std::string>::iterator filename = flags.filenames.begin(); filename != flags.filenames.end(); ++filename ) {
 					flags.apply_default_buffer_sizes();
 					file_audio_stream_raii file_audio_stream( flags, *filename + std::string(".") + flags.output_extension, log );
@@ -152,6 +152,26 @@ public:
 	}
 };
 
+class textout_string : public textout {
+private:
+	std::string text;
+public:
+	textout_string() {
+		return;
+	}
+	virtual ~textout_string() {
+		return;
+	}
+public:
+	virtual void write( const std::string & text_ ) {
+		text += text_;
+	}
+	std::string get_text() {
+		writeout();
+		return text;
+	}
+};
+
 #if defined(WIN32)
 
 class textout_console : public textout {
@@ -271,6 +291,7 @@ struct commandlineflags {
 	bool use_float;
 	bool use_stdout;
 	bool shuffle;
+	std::int32_t jobs;
 	std::size_t playlist_index;
 	std::vector<std::string> filenames;
 	std::string output_filename;
@@ -372,6 +393,7 @@ struct commandlineflags {
 		show_pattern = false;
 		use_stdout = false;
 		shuffle = false;
+		jobs = 1;
 		playlist_index = 0;
 		output_extension = "wav";
 		force_overwrite = false;
@@ -453,6 +475,19 @@ struct commandlineflags {
 		if ( mode == ModeRender && output_extension.empty() ) {
 			throw args_error_exception();
 		}
+		if ( jobs < 0 ) {
+			throw args_error_exception();
+		}
+#if defined(MPT_WITH_THREADS)
+		if ( jobs == 0 ) {
+			jobs = std::max( 1u, std::thread::hardware_concurrency() );
+		}
+#else
+		jobs = 1;
+#endif
+		if ( mode != ModeRender ) {
+			jobs = 1;
+		}
 	}
 };
 
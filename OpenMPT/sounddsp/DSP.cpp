@@ -16,11 +16,6 @@
 
 OPENMPT_NAMESPACE_BEGIN
 
-#if MPT_COMPILER_MSVC
-#pragma warning(disable: 4725) // instruction may be inaccurate on some Pentiums
-#endif
-
-
 #ifndef NO_DSP
 
 
@@ -35,8 +30,8 @@ OPENMPT_NAMESPACE_BEGIN
 
 extern void X86_InitMixBuffer(int *pBuffer, UINT nSamples);
 
-static void X86_StereoDCRemoval(int *, UINT count, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l, LONG *nDCRFlt_Y1r, LONG *nDCRFlt_X1r);
-static void X86_MonoDCRemoval(int *, UINT count, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l);
+static void StereoDCRemoval(int *, UINT count, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l, LONG *nDCRFlt_Y1r, LONG *nDCRFlt_X1r);
+static void MonoDCRemoval(int *, UINT count, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l);
 
 ///////////////////////////////////////////////////////////////////////////////////
 //
@@ -55,25 +50,10 @@ static void ShelfEQ(LONG scale,
 	float alpha, beta0, beta1, rho;
 	float wT, quad;
 
-	_asm {
-	// wT = PI*Fc/Fs
-	fild F_c
-	fldpi
-	fmulp ST(1), ST(0)
-	fild F_s
-	fdivp ST(1), ST(0)
-	fstp wT
-	// gain^2
-	fld gainDC
-	fld gainFT
-	fld gainPI
-	fmul ST(0), ST(0)
-	fstp gainPI2
-	fmul ST(0), ST(0)
-	fstp gainFT2
-	fmul ST(0), ST(0)
-	fstp gainDC2
-	}
+	wT = PI * F_c / F_s;
+	gainPI2 = gainPI * gainPI;
+	gainFT2 = gainFT * gainFT;
+	gainDC2 = gainDC * gainDC;
 
 	quad = gainPI2 + gainDC2 - (gainFT2*2);
 
@@ -95,22 +75,9 @@ static void ShelfEQ(LONG scale,
 	b1 = ((beta1 + rho*beta0) * quad);
 	a1 = - ((rho + alpha) * quad);
 
-	_asm {
-	fild scale
-	fld a1
-	mov eax, outA1
-	fmul ST(0), ST(1)
-	fistp dword ptr [eax]
-	fld b0
-	mov eax, outB0
-	fmul ST(0), ST(1)
-	fistp dword ptr [eax]
-	fld b1
-	mov eax, outB1
-	fmul ST(0), ST(1)
-	fistp dword ptr [eax]
-	fstp rho
-	}
+	*outA1 = Util::Round<LONG>(a1 * scale);
+	*outB0 = Util::Round<LONG>(b0 * scale);
+	*outB1 = Util::Round<LONG>(b1 * scale);
 }
 
 
@@ -293,7 +260,7 @@ void CDSP::Process(int * MixSoundBuffer, int * MixRearBuffer, int count, UINT nC
 	// Bass Expansion
 	if (DSPMask & SNDDSP_MEGABASS)
 	{
-		X86_StereoDCRemoval(MixSoundBuffer, count, &nDCRFlt_Y1l, &nDCRFlt_X1l, &nDCRFlt_Y1r, &nDCRFlt_X1r);
+		StereoDCRemoval(MixSoundBuffer, count, &nDCRFlt_Y1l, &nDCRFlt_X1l, &nDCRFlt_Y1r, &nDCRFlt_X1r);
 		int *px = MixSoundBuffer;
 		int x1 = nXBassFlt_X1;
 		int y1 = nXBassFlt_Y1;
@@ -320,7 +287,7 @@ void CDSP::Process(int * MixSoundBuffer, int * MixRearBuffer, int count, UINT nC
 	// Bass Expansion
 	if (DSPMask & SNDDSP_MEGABASS)
 	{
-		X86_MonoDCRemoval(MixSoundBuffer, count, &nDCRFlt_Y1l, &nDCRFlt_X1l);
+		MonoDCRemoval(MixSoundBuffer, count, &nDCRFlt_Y1l, &nDCRFlt_X1l);
 		int *px = MixSoundBuffer;
 		int x1 = nXBassFlt_X1;
 		int y1 = nXBassFlt_Y1;
@@ -353,45 +320,26 @@ void CDSP::Process(int * MixSoundBuffer, int * MixRearBuffer, int count, UINT nC
 
 #define DCR_AMOUNT		9
 
-static void X86_StereoDCRemoval(int *pBuffer, UINT nSamples, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l, LONG *nDCRFlt_Y1r, LONG *nDCRFlt_X1r)
+// y(n) = (x(n) - x(n-1)) * (1 - 2^-(DCR_AMOUNT+1)) + y(n-1) * (1 - 2^-DCR_AMOUNT)
+static void StereoDCRemoval(int *pBuffer, UINT nSamples, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l, LONG *nDCRFlt_Y1r, LONG *nDCRFlt_X1r)
 {
 	int y1l=*nDCRFlt_Y1l, x1l=*nDCRFlt_X1l;
 	int y1r=*nDCRFlt_Y1r, x1r=*nDCRFlt_X1r;
 
-	_asm {
-	mov esi, pBuffer
-	mov ecx, nSamples
-stereodcr:
-	mov eax, [esi]
-	mov ebx, x1l
-	mov edx, [esi+4]
-	mov edi, x1r
-	add esi, 8
-	sub ebx, eax
-	mov x1l, eax
-	mov eax, ebx
-	sar eax, DCR_AMOUNT+1
-	sub edi, edx
-	sub eax, ebx
-	mov x1r, edx
-	add eax, y1l
-	mov edx, edi
-	sar edx, DCR_AMOUNT+1
-	mov [esi-8], eax
-	sub edx, edi
-	mov ebx, eax
-	add edx, y1r
-	sar ebx, DCR_AMOUNT
-	mov [esi-4], edx
-	mov edi, edx
-	sub eax, ebx
-	sar edi, DCR_AMOUNT
-	mov y1l, eax
-	sub edx, edi
-	dec ecx
-	mov y1r, edx
-	jnz stereodcr
+	for(UINT i=0; i<nSamples; i++)
+	{
+		int inL = pBuffer[i*2], inR = pBuffer[i*2+1];
+		int diffL = x1l - inL, diffR = x1r - inR;
+		x1l = inL;
+		x1r = inR;
+		int outL = (diffL >> (DCR_AMOUNT+1)) - diffL + y1l;
+		int outR = (diffR >> (DCR_AMOUNT+1)) - diffR + y1r;
+		pBuffer[i*2] = outL;
+		pBuffer[i*2+1] = outR;
+		y1l = outL - (outL >> DCR_AMOUNT);
+		y1r = outR - (outR >> DCR_AMOUNT);
 	}
+
 	*nDCRFlt_Y1l = y1l;
 	*nDCRFlt_X1l = x1l;
 	*nDCRFlt_Y1r = y1r;
@@ -399,34 +347,20 @@ stereodcr:
 }
 
 
-static void X86_MonoDCRemoval(int *pBuffer, UINT nSamples, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l)
+static void MonoDCRemoval(int *pBuffer, UINT nSamples, LONG *nDCRFlt_Y1l, LONG *nDCRFlt_X1l)
 {
 	int y1l=*nDCRFlt_Y1l, x1l=*nDCRFlt_X1l;
-	_asm {
-	mov esi, pBuffer
-	mov ecx, nSamples
-	mov edx, x1l
-	mov edi, y1l
-stereodcr:
-	mov eax, [esi]
-	mov ebx, edx
-	add esi, 4
-	sub ebx, eax
-	mov edx, eax
-	mov eax, ebx
-	sar eax, DCR_AMOUNT+1
-	sub eax, ebx
-	add eax, edi
-	mov [esi-4], eax
-	mov ebx, eax
-	sar ebx, DCR_AMOUNT
-	sub eax, ebx
-	dec ecx
-	mov edi, eax
-	jnz stereodcr
-	mov x1l, edx
-	mov y1l, edi
+
+	for(UINT i=0; i<nSamples; i++)
+	{
+		int in = pBuffer[i];
+		int diff = x1l - in;
+		x1l = in;
+		int out = (diff >> (DCR_AMOUNT+1)) - diff + y1l;
+		pBuffer[i] = out;
+		y1l = out - (out >> DCR_AMOUNT);
 	}
+
 	*nDCRFlt_Y1l = y1l;
 	*nDCRFlt_X1l = x1l;
 }
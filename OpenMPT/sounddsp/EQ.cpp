@@ -13,6 +13,9 @@
 #include "../soundlib/Sndfile.h"
 #include "../soundlib/MixerLoops.h"
 #include "../sounddsp/EQ.h"
+#if defined(MPT_INTRINSICS_X86)
+#include <xmmintrin.h>
+#endif
 
 
 OPENMPT_NAMESPACE_BEGIN
@@ -195,102 +198,6 @@ mainloop:
 #endif // ENABLE_X86_AMD
 
 
-#ifdef ENABLE_SSE
-
-static void SSE_StereoEQ(EQBANDSTRUCT *pbl, EQBANDSTRUCT *pbr, float32 *pbuffer, UINT nCount)
-//-------------------------------------------------------------------------------------------
-{
-	static const float gk1 = 1.0f;
-	_asm {
-	mov eax, pbl
-	mov edx, pbr
-	mov ebx, pbuffer
-	mov ecx, nCount
-	movss xmm0, [eax+EQBANDSTRUCT.Gain]
-	movss xmm1, gk1
-	comiss xmm0, xmm1
-	jne doeq
-	movss xmm0, [edx+EQBANDSTRUCT.Gain]
-	comiss xmm0, xmm1
-	je done
-doeq:
-	test ecx, ecx
-	jz done
-	movss xmm6, [eax+EQBANDSTRUCT.a1]
-	movss xmm7, [eax+EQBANDSTRUCT.a2]
-	movss xmm4, [eax+EQBANDSTRUCT.x1]
-	movss xmm5, [eax+EQBANDSTRUCT.x2]
-	movlhps xmm6, xmm7		// xmm6 = [  0 | a2 |  0 | a1 ]
-	movlhps xmm4, xmm5		// xmm4 = [  0 | x2 |  0 | x1 ]
-	movss xmm2, [edx+EQBANDSTRUCT.a1]
-	movss xmm3, [edx+EQBANDSTRUCT.a2]
-	movss xmm0, [edx+EQBANDSTRUCT.x1]
-	movss xmm1, [edx+EQBANDSTRUCT.x2]
-	movlhps xmm2, xmm3		// xmm2 = [ 0 | a'2 | 0 | a'1 ]
-	movlhps xmm0, xmm1		// xmm0 = [ 0 | x'2 | 0 | x'1 ]
-	shufps xmm6, xmm2, 0x88	// xmm6 = [ a'2 | a'1 | a2 | a1 ]
-	shufps xmm4, xmm0, 0x88 // xmm4 = [ x'2 | x'1 | x2 | x1 ]
-	shufps xmm6, xmm6, 0xD8	// xmm6 = [ a'2 | a2 | a'1 | a1 ]
-	shufps xmm4, xmm4, 0xD8	// xmm4 = [ x'2 | x2 | x'1 | x1 ]
-	movss xmm7, [eax+EQBANDSTRUCT.b1]
-	movss xmm0, [eax+EQBANDSTRUCT.b2]
-	movss xmm2, [edx+EQBANDSTRUCT.b1]
-	movss xmm1, [edx+EQBANDSTRUCT.b2]
-	movlhps xmm7, xmm0		// xmm7 = [ 0 |  b2 | 0 |  b1 ]
-	movlhps xmm2, xmm1		// xmm2 = [  0 | b'2 |  0 | b'1 ]
-	shufps xmm7, xmm2, 0x88	// xmm7 = [ b'2 | b'1 | b2 | b1 ]
-	shufps xmm7, xmm7, 0xD8 // xmm7 = [ b'2 | b2 | b'1 | b1 ]
-	movss xmm5, [eax+EQBANDSTRUCT.y1]
-	movss xmm1, [eax+EQBANDSTRUCT.y2]
-	movss xmm3, [edx+EQBANDSTRUCT.y1]
-	movss xmm0, [edx+EQBANDSTRUCT.y2]
-	movlhps xmm5, xmm1		// xmm5 = [  0 |  y2 |  0 |  y1 ]
-	movlhps xmm3, xmm0		// xmm3 = [  0 | y'2 |  0 | y'1 ]
-	shufps xmm5, xmm3, 0x88 // xmm5 = [ y'2 | y'1 | y2 | y1 ]
-	shufps xmm5, xmm5, 0xD8 // xmm5 = [ y'2 |  y2 | y'1 |  y1 ]
-	movss xmm3, [eax+EQBANDSTRUCT.a0]
-	movss xmm2, [edx+EQBANDSTRUCT.a0]
-	shufps xmm3, xmm2, 0x88
-	shufps xmm3, xmm3, 0xD8	// xmm3 = [  0 |  0 | a'0 | a0 ]
-mainloop:
-	movlps xmm0, qword ptr [ebx]
-	add ebx, 8
-	movaps xmm1, xmm5		// xmm1 = [ y2r | y2l | y1r | y1l ]
-	mulps xmm1, xmm7		// xmm1 = [b2r*y2r|b2l*y2l|b1r*y1r|b1l*y1l]
-	movaps xmm2, xmm4		// xmm2 = [ x2r | x2l | x1r | x1l ]
-	mulps xmm2, xmm6		// xmm6 = [a2r*x2r|a2l*x2l|a1r*x1r|a1l*x1l]
-	shufps xmm4, xmm0, 0x44 // xmm4 = [  xr |  xl | x1r | x1l ]
-	mulps xmm0, xmm3		// xmm0 = [   0 |   0 |a0r*xr|a0l*xl]
-	shufps xmm4, xmm4, 0x4E // xmm4 = [ x1r | x1l |  xr |  xl ]
-	addps xmm1, xmm2		// xmm1 = [b2r*y2r+a2r*x2r|b2l*y2l+a2l*x2l|b1r*y1r+a1r*x1r|b1l*y1l+a1l*x1l]
-	addps xmm1, xmm0		// xmm1 = [b2r*y2r+a2r*x2r|b2l*y2l+a2l*x2l|b1r*y1r+a1r*x1r+a0r*xr|b1l*y1l+a1l*x1l+a0l*xl]
-	sub ecx, 1
-	movhlps xmm0, xmm1
-	addps xmm0, xmm1		// xmm0 = [  ? |  ? | yr(n) | yl(n) ]
-	movlps [ebx-8], xmm0
-	shufps xmm0, xmm5, 0x44
-	movaps xmm5, xmm0
-	jnz mainloop
-	movhlps xmm0, xmm4
-	movhlps xmm1, xmm5
-	movss [eax+EQBANDSTRUCT.x1], xmm4
-	movss [eax+EQBANDSTRUCT.x2], xmm0
-	movss [eax+EQBANDSTRUCT.y1], xmm5
-	movss [eax+EQBANDSTRUCT.y2], xmm1
-	shufps xmm4, xmm4, 0x01
-	shufps xmm0, xmm0, 0x01
-	shufps xmm5, xmm5, 0x01
-	shufps xmm1, xmm1, 0x01
-	movss [edx+EQBANDSTRUCT.x1], xmm4
-	movss [edx+EQBANDSTRUCT.x2], xmm0
-	movss [edx+EQBANDSTRUCT.y1], xmm5
-	movss [edx+EQBANDSTRUCT.y2], xmm1
-done:;
-	}
-}
-
-#endif // ENABLE_SSE
-
 #pragma warning(default:4100)
 
 #else
@@ -313,6 +220,56 @@ static void EQFilter(EQBANDSTRUCT *pbs, float32 *pbuffer, UINT nCount)
 #endif
 
 
+#if defined(MPT_INTRINSICS_X86)
+
+// Processes both channels of a band in parallel: lanes are [ left | right | left | right ] for the current and previous samples.
+MPT_TARGET_SSE2 static void SSE2_StereoEQ(EQBANDSTRUCT *pbl, EQBANDSTRUCT *pbr, float32 *pbuffer, UINT nCount)
+//------------------------------------------------------------------------------------------------------------
+{
+	if(pbl->Gain == 1.0f && pbr->Gain == 1.0f)
+	{
+		return;
+	}
+	const __m128 a0 = _mm_setr_ps(pbl->a0, pbr->a0, 0.0f, 0.0f);
+	const __m128 a12 = _mm_setr_ps(pbl->a1, pbr->a1, pbl->a2, pbr->a2);
+	const __m128 b12 = _mm_setr_ps(pbl->b1, pbr->b1, pbl->b2, pbr->b2);
+	__m128 x12 = _mm_setr_ps(pbl->x1, pbr->x1, pbl->x2, pbr->x2);
+	__m128 y12 = _mm_setr_ps(pbl->y1, pbr->y1, pbl->y2, pbr->y2);
+	for(UINT i = 0; i < nCount; i++)
+	{
+		const __m128 x = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(pbuffer + i * 2));
+		// [ b1*y1 + a1*x1 + a0*x | b2*y2 + a2*x2 ]
+		__m128 sum = _mm_add_ps(_mm_mul_ps(y12, b12), _mm_mul_ps(x12, a12));
+		sum = _mm_add_ps(sum, _mm_mul_ps(x, a0));
+		const __m128 y = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		_mm_storel_pi(reinterpret_cast<__m64 *>(pbuffer + i * 2), y);
+		x12 = _mm_movelh_ps(x, x12);
+		y12 = _mm_movelh_ps(y, y12);
+	}
+	float32 x[4], y[4];
+	_mm_storeu_ps(x, x12);
+	_mm_storeu_ps(y, y12);
+	pbl->x1 = x[0]; pbr->x1 = x[1]; pbl->x2 = x[2]; pbr->x2 = x[3];
+	pbl->y1 = y[0]; pbr->y1 = y[1]; pbl->y2 = y[2]; pbr->y2 = y[3];
+}
+
+
+MPT_TARGET_SSE2 static void SSE2_ProcessStereoEQ(EQBANDSTRUCT *pEQ, float32 *pbuffer, UINT nCount)
+//------------------------------------------------------------------------------------------------
+{
+	const unsigned int sse_state = _mm_getcsr();
+	_mm_setcsr(sse_state | 0xFF80); // set flush-to-zero, round-to-zero, mask all exception, leave flags alone
+	for (UINT b=0; b<MAX_EQ_BANDS; b++)
+	{
+		if ((pEQ[b].bEnable) || (pEQ[b+MAX_EQ_BANDS].bEnable))
+			SSE2_StereoEQ(&pEQ[b], &pEQ[b+MAX_EQ_BANDS], pbuffer, nCount);
+	}
+	_mm_setcsr(sse_state);
+}
+
+#endif // MPT_INTRINSICS_X86
+
+
 void CEQ::ProcessMono(int *pbuffer, float *MixFloatBuffer, UINT nCount)
 //---------------------------------------------------------------------
 {
@@ -329,28 +286,16 @@ void CEQ::ProcessStereo(int *pbuffer, float *MixFloatBuffer, UINT nCount)
 //-----------------------------------------------------------------------
 {
 
-#ifdef ENABLE_SSE
+#if defined(MPT_INTRINSICS_X86)
 
-	if(GetProcSupport() & PROCSUPPORT_SSE)
+	if(GetProcSupport() & PROCSUPPORT_SSE2)
 	{
-		int sse_state, sse_eqstate;
 		MonoMixToFloat(pbuffer, MixFloatBuffer, nCount*2, 1.0f/MIXING_SCALEF);
-
-		_asm stmxcsr sse_state;
-		sse_eqstate = sse_state | 0xFF80; // set flush-to-zero, denormals-are-zero, round-to-zero, mask all exception, leave flags alone
-		_asm ldmxcsr sse_eqstate;
-		for (UINT b=0; b<MAX_EQ_BANDS; b++)
-		{
-			if ((gEQ[b].bEnable) || (gEQ[b+MAX_EQ_BANDS].bEnable))
-				SSE_StereoEQ(&gEQ[b], &gEQ[b+MAX_EQ_BANDS], MixFloatBuffer, nCount);
-		}
-		_asm ldmxcsr sse_state;
-
+		SSE2_ProcessStereoEQ(gEQ, MixFloatBuffer, nCount);
 		FloatToMonoMix(MixFloatBuffer, pbuffer, nCount*2, MIXING_SCALEF);
-
 	} else
 
-#endif // ENABLE_SSE
+#endif // MPT_INTRINSICS_X86
 
 #ifdef ENABLE_X86_AMD
 
@@ -392,10 +337,10 @@ void CEQ::ProcessStereo(int *pbuffer, float *MixFloatBuffer, UINT nCount)
 CEQ::CEQ()
 //--------
 {
-	#if defined(ENABLE_SSE) || defined(ENABLE_X86_AMD)
+	#if defined(ENABLE_X86_AMD)
 		MPT_ASSERT_ALWAYS(((uintptr_t)&(gEQ[0])) % 4 == 0);
 		MPT_ASSERT_ALWAYS(((uintptr_t)&(gEQ[1])) % 4 == 0);
-	#endif // ENABLE_SSE || ENABLE_X86_AMD
+	#endif // ENABLE_X86_AMD
 	memcpy(gEQ, gEQDefaults, sizeof(gEQ));
 }
 
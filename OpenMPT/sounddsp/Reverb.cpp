@@ -12,6 +12,11 @@
 #include "stdafx.h"
 #include "../soundlib/Sndfile.h"
 #include "Reverb.h"
+#include <cmath>
+#include <cstring>
+#if defined(MPT_INTRINSICS_X86)
+#include <emmintrin.h>
+#endif
 
 
 OPENMPT_NAMESPACE_BEGIN
@@ -19,8 +24,9 @@ OPENMPT_NAMESPACE_BEGIN
 
 #ifndef NO_REVERB
 
-#pragma warning(disable:4725)	// Pentium fdiv bug
-#pragma warning(disable:4731)	// ebp modified
+#ifndef M_PI
+#define M_PI 3.1415926535897932385
+#endif
 
 extern void StereoFill(int *pBuffer, uint32 nSamples, mixsample_t &lpROfs, mixsample_t &lpLOfs);
 
@@ -51,6 +57,12 @@ CReverb::CReverb()
 	gnReverbSamples = 0;
 	gnReverbDecaySamples = 0;
 
+	m_nCurrentPreset = NUM_REVERBTYPES;
+	m_nCurrentMixingFreq = 0;
+
+	m_nProcessedFrames = 0;
+	m_nProcessingTime = 0;
+
 	// Internal reverb state
 	g_bLastInPresent = 0;
 	g_bLastOutPresent = 0;
@@ -60,8 +72,8 @@ CReverb::CReverb()
 	g_nLastRvbIn_yr = 0;
 	g_nLastRvbOut_xl = 0;
 	g_nLastRvbOut_xr = 0;
-	gnDCRRvb_Y1 = 0;
-	gnDCRRvb_X1 = 0;
+	MemsetZero(gnDCRRvb_Y1);
+	MemsetZero(gnDCRRvb_X1);
 
 	// Reverb mix buffers
 	MemsetZero(g_RefDelay);
@@ -268,8 +280,8 @@ void CReverb::Shutdown()
 	g_nLastRvbIn_xl = g_nLastRvbIn_xr = 0;
 	g_nLastRvbIn_yl = g_nLastRvbIn_yr = 0;
 	g_nLastRvbOut_xl = g_nLastRvbOut_xr = 0;
-	gnDCRRvb_X1 = 0;
-	gnDCRRvb_Y1 = 0;
+	MemsetZero(gnDCRRvb_X1);
+	MemsetZero(gnDCRRvb_Y1);
 
 	// Zero internal buffers
 	MemsetZero(g_LateReverb.Diffusion1);
@@ -279,6 +291,10 @@ void CReverb::Shutdown()
 	MemsetZero(g_RefDelay.RefDelayBuffer);
 	MemsetZero(g_RefDelay.PreDifBuffer);
 	MemsetZero(g_RefDelay.RefOut);
+	MemsetZero(g_RefDelay.History);
+	MemsetZero(g_LateReverb.LPHistory);
+	g_RefDelay.nDelayPos = g_RefDelay.nPreDifPos = g_RefDelay.nRefOutPos = 0;
+	g_LateReverb.nDelayPos = 0;
 }
 
 
@@ -286,17 +302,17 @@ void CReverb::Initialize(bool bReset, uint32 MixingFreq)
 //------------------------------------------------------
 {
 	if (m_Settings.m_nReverbType >= NUM_REVERBTYPES) m_Settings.m_nReverbType = 0;
-	static PSNDMIX_REVERB_PROPERTIES spCurrentPreset = NULL;
 	PSNDMIX_REVERB_PROPERTIES pRvbPreset = &gRvbPresets[m_Settings.m_nReverbType].Preset;
 
-	if ((pRvbPreset != spCurrentPreset) || (bReset))
+	if ((m_Settings.m_nReverbType != m_nCurrentPreset) || (MixingFreq != m_nCurrentMixingFreq) || (bReset))
 	{
 		// Reverb output frequency is half of the dry output rate
 		float flOutputFrequency = (float)MixingFreq;
 		ENVIRONMENTREVERB rvb;
 
 		// Reset reverb parameters
-		spCurrentPreset = pRvbPreset;
+		m_nCurrentPreset = m_Settings.m_nReverbType;
+		m_nCurrentMixingFreq = MixingFreq;
 		I3dl2_to_Generic(pRvbPreset, &rvb, flOutputFrequency,
 							RVBMINREFDELAY, RVBMAXREFDELAY,
 							RVBMINRVBDELAY, RVBMAXRVBDELAY,
@@ -385,6 +401,8 @@ void CReverb::Initialize(bool bReset, uint32 MixingFreq)
 	{
 		gnReverbSamples = 0;
 		Shutdown();
+		m_nProcessedFrames = 0;
+		m_nProcessingTime = 0;
 	}
 	// Wait at least 5 seconds before shutting down the reverb
 	if (gnReverbDecaySamples < MixingFreq*5)
@@ -424,11 +442,12 @@ int *CReverb::GetReverbSendBuffer(uint32 nSamples)
 void CReverb::Process(int *MixSoundBuffer, uint32 nSamples)
 //---------------------------------------------------------
 {
-	if(!(GetProcSupport() & PROCSUPPORT_MMX)) return;
+	m_nProcessedFrames += nSamples;
 	if((!gnReverbSend) && (!gnReverbSamples))
 	{ // no data is sent to reverb and reverb decayed completely
 		return;
 	}
+	const uint64 startTime = Util::GetTimestampNanoseconds();
 	if(!gnReverbSend)
 	{ // no input data in MixReverbBuffer, so the buffer got not cleared in GetReverbSendBuffer(), do it now for decay
 		StereoFill(MixReverbBuffer, nSamples, gnRvbROfsVol, gnRvbLOfsVol);
@@ -460,7 +479,7 @@ void CReverb::Process(int *MixSoundBuffer, uint32 nSamples)
 	nOut = nIn;
 	// Main reverb processing: split into small chunks (needed for short reverb delays)
 	// Reverb Input + Low-Pass stage #2 + Pre-diffusion
-	if (nIn > 0) MMX_ProcessPreDelay(&g_RefDelay, MixReverbBuffer, nIn);
+	if (nIn > 0) ProcessPreDelay(&g_RefDelay, MixReverbBuffer, nIn);
 	// Process Reverb Reflections and Late Reverberation
 	int *pRvbOut = MixReverbBuffer;
 	uint32 nRvbSamples = nOut, nCount = 0;
@@ -475,9 +494,9 @@ void CReverb::Process(int *MixSoundBuffer, uint32 nSamples)
 		if (n > nmax1) n = nmax1;
 		if (n > 64) n = 64;
 		// Reflections output + late reverb delay
-		MMX_ProcessReflections(&g_RefDelay, &g_RefDelay.RefOut[nPosRef*2], pRvbOut, n);
+		ProcessReflections(&g_RefDelay, &g_RefDelay.RefOut[nPosRef*2], pRvbOut, n);
 		// Late Reverberation
-		MMX_ProcessLateReverb(&g_LateReverb, &g_RefDelay.RefOut[nPosRvb*2], pRvbOut, n);
+		ProcessLateReverb(&g_LateReverb, &g_RefDelay.RefOut[nPosRvb*2], pRvbOut, n);
 		// Update delay positions
 		g_RefDelay.nRefOutPos = (g_RefDelay.nRefOutPos + n) & SNDMIX_REVERB_DELAY_MASK;
 		g_RefDelay.nDelayPos = (g_RefDelay.nDelayPos + n) & SNDMIX_REFLECTIONS_DELAY_MASK;
@@ -488,7 +507,7 @@ void CReverb::Process(int *MixSoundBuffer, uint32 nSamples)
 	// Adjust nDelayPos, in case nIn != nOut
 	g_RefDelay.nDelayPos = (g_RefDelay.nDelayPos - nOut + nIn) & SNDMIX_REFLECTIONS_DELAY_MASK;
 	// Upsample 2x
-	MMX_ReverbProcessPostFiltering1x(MixReverbBuffer, MixSoundBuffer, nSamples);
+	ReverbProcessPostFiltering1x(MixReverbBuffer, MixSoundBuffer, nSamples);
 	// Automatically shut down if needed
 	if(gnReverbSend) gnReverbSamples = gnReverbDecaySamples; // reset decay counter
 	else if(gnReverbSamples > nSamples) gnReverbSamples -= nSamples; // decay
@@ -498,6 +517,7 @@ void CReverb::Process(int *MixSoundBuffer, uint32 nSamples)
 		gnReverbSamples = 0;
 	}
 	gnReverbSend = 0; // no input data in MixReverbBuffer
+	m_nProcessingTime += Util::GetTimestampNanoseconds() - startTime;
 }
 
 
@@ -624,76 +644,261 @@ void CReverb::X86_ReverbProcessPostFiltering2x(const int *pRvb, int *pDry, uint3
 
 #define DCR_AMOUNT		9
 
-// Stereo Add + DC removal
-void CReverb::MMX_ReverbProcessPostFiltering1x(const int *pRvb, int *pDry, uint32 nSamples)
-//-----------------------------------------------------------------------------------------
+
+//////////////////////////////////////////////////////////////////////////
+//
+// The reverb was originally written in MMX assembly. The portable code
+// below emulates the MMX instructions that were used (saturating 16-bit
+// arithmetic, pmulhw, pmaddwd), and the SSE2 code uses the corresponding
+// instructions on the lower half of the XMM registers, so all versions
+// produce bit-identical output.
+//
+
+static inline int16 Sat16(int32 x)
+{
+	return static_cast<int16>(Clamp(x, int32(int16_min), int32(int16_max)));
+}
+
+// paddsw
+static inline int16 AddSat16(int16 a, int16 b)
+{
+	return Sat16(int32(a) + int32(b));
+}
+
+// psubsw
+static inline int16 SubSat16(int16 a, int16 b)
+{
+	return Sat16(int32(a) - int32(b));
+}
+
+// pmulhw
+static inline int16 MulHigh16(int16 a, int16 b)
+{
+	return static_cast<int16>((int32(a) * int32(b)) >> 16);
+}
+
+// pmaddwd (wraps around like the original instruction)
+static inline uint32 MulAdd16(int16 a0, int16 b0, int16 a1, int16 b1)
+{
+	return static_cast<uint32>(int32(a0) * int32(b0)) + static_cast<uint32>(int32(a1) * int32(b1));
+}
+
+// Read / write a stereo pair of 16-bit values as one 32-bit value
+static inline int32 Load16x2(const int16 *p)
+{
+	int32 v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline void Store16x2(int16 *p, int32 v)
 {
-	int64 nDCRRvb_X1 = gnDCRRvb_X1;
-	int64 nDCRRvb_Y1 = gnDCRRvb_Y1;
-	_asm {
-	movq mm4, nDCRRvb_Y1	// mm4 = [ y1r | y1l ]
-	movq mm1, nDCRRvb_X1	// mm5 = [ x1r | x1l ]
-	mov ebx, pDry
-	mov ecx, pRvb
-	mov edx, nSamples
-stereodcr:
-	movq mm5, qword ptr [ecx]	// mm0 = [ xr | xl ]
-	movq mm3, qword ptr [ebx]	// mm3 = dry mix
-	add ecx, 8
-	psubd mm1, mm5				// mm1 = x(n-1) - x(n)
-	add ebx, 8
-	movq mm0, mm1
-	psrad mm0, DCR_AMOUNT+1
-	psubd mm0, mm1
-	paddd mm4, mm0
-	dec edx
-	paddd mm3, mm4				// add with dry mix
-	movq mm0, mm4
-	psrad mm0, DCR_AMOUNT
-	movq mm1, mm5
-	psubd mm4, mm0
-	movq qword ptr [ebx-8], mm3
-	jnz stereodcr
-	movq nDCRRvb_Y1, mm4
-	movq nDCRRvb_X1, mm5
-	emms
+	std::memcpy(p, &v, sizeof(v));
+}
+
+
+#if defined(MPT_INTRINSICS_X86)
+
+MPT_TARGET_SSE2 static void SSE2_ReverbProcessPostFiltering1x(const int *pRvb, int *pDry, uint32 nSamples, int32 *nDCRRvb_X1, int32 *nDCRRvb_Y1)
+//--------------------------------------------------------------------------------------------------------------------------------------------
+{
+	__m128i y1 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(nDCRRvb_Y1));
+	__m128i x1 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(nDCRRvb_X1));
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pRvb + i * 2));
+		const __m128i diff = _mm_sub_epi32(x1, x);
+		y1 = _mm_add_epi32(y1, _mm_sub_epi32(_mm_srai_epi32(diff, DCR_AMOUNT + 1), diff));
+		const __m128i dry = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pDry + i * 2));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(pDry + i * 2), _mm_add_epi32(dry, y1));
+		y1 = _mm_sub_epi32(y1, _mm_srai_epi32(y1, DCR_AMOUNT));
+		x1 = x;
 	}
-	gnDCRRvb_X1 = nDCRRvb_X1;
-	gnDCRRvb_Y1 = nDCRRvb_Y1;
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(nDCRRvb_Y1), y1);
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(nDCRRvb_X1), x1);
 }
 
 
-void CReverb::MMX_ReverbDCRemoval(int *pBuffer, uint32 nSamples)
-//--------------------------------------------------------------
+MPT_TARGET_SSE2 static void SSE2_ProcessPreDelay(PSWRVBREFDELAY pPreDelay, const int *pIn, uint32 nSamples)
+//---------------------------------------------------------------------------------------------------------
 {
-	int64 nDCRRvb_X1 = gnDCRRvb_X1;
-	int64 nDCRRvb_Y1 = gnDCRRvb_Y1;
-	_asm {
-	movq mm4, nDCRRvb_Y1	// mm4 = [ y1r | y1l ]
-	movq mm1, nDCRRvb_X1	// mm5 = [ x1r | x1l ]
-	mov ecx, pBuffer
-	mov edx, nSamples
-stereodcr:
-	movq mm5, qword ptr [ecx]	// mm0 = [ xr | xl ]
-	add ecx, 8
-	psubd mm1, mm5				// mm1 = x(n-1) - x(n)
-	movq mm0, mm1
-	psrad mm0, DCR_AMOUNT+1
-	psubd mm0, mm1
-	paddd mm4, mm0
-	dec edx
-	movq qword ptr [ecx-8], mm4
-	movq mm0, mm4
-	psrad mm0, DCR_AMOUNT
-	movq mm1, mm5
-	psubd mm4, mm0
-	jnz stereodcr
-	movq nDCRRvb_Y1, mm4
-	movq nDCRRvb_X1, mm5
-	emms
+	const __m128i coeffs = _mm_cvtsi32_si128(Load16x2(pPreDelay->nCoeffs));
+	const __m128i preDifCoeffs = _mm_cvtsi32_si128(Load16x2(pPreDelay->nPreDifCoeffs));
+	__m128i history = _mm_cvtsi32_si128(Load16x2(pPreDelay->History));
+	uint32 delayPos = pPreDelay->nDelayPos;
+	uint32 preDifPos = pPreDelay->nPreDifPos;
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		// 16-bit unsaturated reverb input [ r | l | r | l ]
+		__m128i in = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pIn + i * 2));
+		in = _mm_packs_epi32(in, in);
+		// Low-pass
+		history = _mm_mulhi_epi16(_mm_subs_epi16(history, in), coeffs);
+		history = _mm_adds_epi16(_mm_adds_epi16(history, history), in);
+		// Pre-Diffusion
+		const __m128i delayed = _mm_cvtsi32_si128(Load16x2(&pPreDelay->PreDifBuffer[preDifPos * 2]));	// Xd(n-D)
+		preDifPos = (preDifPos + 1) & SNDMIX_PREDIFFUSION_DELAY_MASK;
+		const __m128i diffused = _mm_subs_epi16(history, _mm_mulhi_epi16(delayed, preDifCoeffs));		// X(n) - k.Xd(n-D) = Xd(n)
+		const __m128i out = _mm_adds_epi16(_mm_mulhi_epi16(preDifCoeffs, diffused), delayed);			// Xd(n-D) + k.Xd(n)
+		Store16x2(&pPreDelay->PreDifBuffer[preDifPos * 2], _mm_cvtsi128_si32(diffused));
+		Store16x2(&pPreDelay->RefDelayBuffer[delayPos * 2], _mm_cvtsi128_si32(out));
+		delayPos = (delayPos + 1) & SNDMIX_REFLECTIONS_DELAY_MASK;
+	}
+	pPreDelay->nPreDifPos = preDifPos;
+	Store16x2(pPreDelay->History, _mm_cvtsi128_si32(history));
+}
+
+
+// Apply the 2x2 gain matrix of a reflection to a stereo sample from the reflections delay buffer
+MPT_TARGET_SSE2 static inline __m128i SSE2_Reflection(const int16 *pIn, __m128i gains)
+//-------------------------------------------------------------------------------------
+{
+	const __m128i in = _mm_cvtsi32_si128(Load16x2(pIn));
+	return _mm_madd_epi16(_mm_unpacklo_epi32(in, in), gains);
+}
+
+
+MPT_TARGET_SSE2 static void SSE2_ProcessReflections(PSWRVBREFDELAY pPreDelay, int16 *pRefOut, int *pOut, uint32 nSamples)
+//----------------------------------------------------------------------------------------------------------------------
+{
+	const int16 *pDelay = pPreDelay->RefDelayBuffer;
+	__m128i gains[7];
+	uint32 pos[7];
+	for(int r = 0; r < 7; r++)
+	{
+		gains[r] = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pPreDelay->Reflections[r].Gains));
+		pos[r] = (pPreDelay->nDelayPos - pPreDelay->Reflections[r].Delay) & SNDMIX_REFLECTIONS_DELAY_MASK;
+	}
+
+	// First stage: reflections 1-4
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		__m128i sum = _mm_add_epi32(
+			_mm_add_epi32(SSE2_Reflection(pDelay + pos[0] * 2, gains[0]), SSE2_Reflection(pDelay + pos[1] * 2, gains[1])),
+			_mm_add_epi32(SSE2_Reflection(pDelay + pos[2] * 2, gains[2]), SSE2_Reflection(pDelay + pos[3] * 2, gains[3])));
+		for(int r = 0; r < 4; r++)
+		{
+			pos[r] = (pos[r] + 1) & SNDMIX_REFLECTIONS_DELAY_MASK;
+		}
+		sum = _mm_srai_epi32(sum, 15);
+		Store16x2(pRefOut + i * 2, _mm_cvtsi128_si32(_mm_packs_epi32(sum, sum)));
+	}
+
+	// Second stage: reflections 5-7
+	// For 28-bit final output: 16+15-3 = 28
+	const __m128i masterGain = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_cvtsi32_si128(Load16x2(pPreDelay->ReflectionsGain)), _mm_setzero_si128()), 3);
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		__m128i sum = _mm_add_epi32(
+			_mm_add_epi32(SSE2_Reflection(pDelay + pos[4] * 2, gains[4]), SSE2_Reflection(pDelay + pos[6] * 2, gains[6])),
+			SSE2_Reflection(pDelay + pos[5] * 2, gains[5]));
+		for(int r = 4; r < 7; r++)
+		{
+			pos[r] = (pos[r] + 1) & SNDMIX_REFLECTIONS_DELAY_MASK;
+		}
+		sum = _mm_srai_epi32(sum, 15);
+		// Add output of previous reflections; this is the late reverb stereo input
+		__m128i out = _mm_adds_epi16(_mm_packs_epi32(sum, sum), _mm_cvtsi32_si128(Load16x2(pRefOut + i * 2)));
+		Store16x2(pRefOut + i * 2, _mm_cvtsi128_si32(out));
+		// Apply reflections gain. At this point, this is the only output of the reverb
+		out = _mm_madd_epi16(_mm_unpacklo_epi16(out, out), masterGain);
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(pOut + i * 2), out);
+	}
+}
+
+
+MPT_TARGET_SSE2 static void SSE2_ProcessLateReverb(PSWLATEREVERB pReverb, const int16 *pRefOut, int *pMixOut, uint32 nSamples)
+//----------------------------------------------------------------------------------------------------------------------------
+{
+	const __m128i outGains = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pReverb->RvbOutGains));
+	const __m128i difCoeffs = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pReverb->nDifCoeffs));
+	const __m128i decayDC = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pReverb->nDecayDC));
+	const __m128i decayLP = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pReverb->nDecayLP));
+	const __m128i dif2InGains = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pReverb->Dif2InGains));
+	__m128i history = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pReverb->LPHistory));
+	uint32 pos = pReverb->nDelayPos;
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		// Stereo input [ r | l | r | l ]
+		__m128i in = _mm_cvtsi32_si128(Load16x2(pRefOut + i * 2));
+		in = _mm_srai_epi16(_mm_unpacklo_epi32(in, in), 2);
+		// Low-passed decay
+		const __m128i tank = _mm_unpacklo_epi32(
+			_mm_cvtsi32_si128(Load16x2(&pReverb->Delay2[((pos - RVBDLY2L_LEN) & RVBDLY_MASK) * 2])),
+			_mm_cvtsi32_si128(Load16x2(&pReverb->Delay2[((pos - RVBDLY2R_LEN) & RVBDLY_MASK) * 2])));
+		history = _mm_mulhi_epi16(_mm_subs_epi16(history, tank), decayLP);
+		history = _mm_adds_epi16(_mm_adds_epi16(history, history), tank);
+		// Apply decay gain
+		// Unlike MMX packssdw, _mm_packs_epi32 does not repeat the result in the upper half of the 64-bit value, so do that explicitly.
+		__m128i decay = _mm_srai_epi32(_mm_madd_epi16(decayDC, history), 15);
+		decay = _mm_packs_epi32(decay, decay);
+		decay = _mm_adds_epi16(_mm_unpacklo_epi32(decay, decay), in);	// input + decay [ r | l | r | l ]
+		__m128i out = decay;
+		// First diffuser
+		const __m128i dif1 = _mm_cvtsi32_si128(
+			static_cast<uint16>(pReverb->Diffusion1[((pos - RVBDIF1L_LEN) & RVBDLY_MASK) * 2])
+			| (static_cast<uint16>(pReverb->Diffusion1[((pos - RVBDIF1R_LEN) & RVBDLY_MASK) * 2 + 1]) << 16));	// Xd(n-D)
+		__m128i diffused = _mm_subs_epi16(decay, _mm_mulhi_epi16(dif1, difCoeffs));	// X(n) - k.Xd(n-D) = Xd(n)
+		Store16x2(&pReverb->Diffusion1[pos * 2], _mm_cvtsi128_si32(diffused));
+		__m128i dif = _mm_adds_epi16(_mm_mulhi_epi16(difCoeffs, diffused), dif1);		// Xd(n-D) + k.Xd(n)
+		// Insert the diffusion output in the reverb delay line
+		Store16x2(&pReverb->Delay1[pos * 2], _mm_cvtsi128_si32(dif));
+		out = _mm_adds_epi16(out, _mm_unpacklo_epi32(dif, dif));
+		// Input to second diffuser
+		const __m128i dly1 = _mm_unpacklo_epi32(
+			_mm_cvtsi32_si128(Load16x2(&pReverb->Delay1[((pos - RVBDLY1L_LEN) & RVBDLY_MASK) * 2])),
+			_mm_cvtsi32_si128(Load16x2(&pReverb->Delay1[((pos - RVBDLY1R_LEN) & RVBDLY_MASK) * 2])));
+		out = _mm_adds_epi16(out, dly1);
+		__m128i dif2In = _mm_srai_epi32(_mm_madd_epi16(dly1, dif2InGains), 15);
+		dif2In = _mm_packs_epi32(dif2In, dif2In);
+		dif2In = _mm_unpacklo_epi32(dif2In, dif2In);
+		out = _mm_subs_epi16(out, dif2In);
+		// Second diffuser
+		const __m128i dif2 = _mm_cvtsi32_si128(
+			static_cast<uint16>(pReverb->Diffusion2[((pos - RVBDIF2L_LEN) & RVBDLY_MASK) * 2])
+			| (static_cast<uint16>(pReverb->Diffusion2[((pos - RVBDIF2R_LEN) & RVBDLY_MASK) * 2 + 1]) << 16));
+		diffused = _mm_subs_epi16(dif2In, _mm_mulhi_epi16(dif2, difCoeffs));
+		Store16x2(&pReverb->Diffusion2[pos * 2], _mm_cvtsi128_si32(diffused));
+		dif = _mm_adds_epi16(_mm_mulhi_epi16(difCoeffs, diffused), dif2);
+		out = _mm_adds_epi16(out, dif);
+		Store16x2(&pReverb->Delay2[pos * 2], _mm_cvtsi128_si32(dif));
+		// Apply output gains and mix
+		out = _mm_madd_epi16(out, outGains);
+		out = _mm_add_epi32(out, _mm_loadl_epi64(reinterpret_cast<const __m128i *>(pMixOut + i * 2)));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(pMixOut + i * 2), out);
+		pos = (pos + 1) & RVBDLY_MASK;
+	}
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(pReverb->LPHistory), history);
+	pReverb->nDelayPos = pos;
+}
+
+#endif // MPT_INTRINSICS_X86
+
+
+// Stereo Add + DC removal
+void CReverb::ReverbProcessPostFiltering1x(const int *pRvb, int *pDry, uint32 nSamples)
+//-------------------------------------------------------------------------------------
+{
+#if defined(MPT_INTRINSICS_X86)
+	if(GetProcSupport() & PROCSUPPORT_SSE2)
+	{
+		SSE2_ReverbProcessPostFiltering1x(pRvb, pDry, nSamples, gnDCRRvb_X1, gnDCRRvb_Y1);
+		return;
+	}
+#endif // MPT_INTRINSICS_X86
+
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		for(int c = 0; c < 2; c++)
+		{
+			const int x = pRvb[i * 2 + c];
+			const int diff = gnDCRRvb_X1[c] - x;
+			gnDCRRvb_Y1[c] += (diff >> (DCR_AMOUNT + 1)) - diff;
+			pDry[i * 2 + c] += gnDCRRvb_Y1[c];
+			gnDCRRvb_Y1[c] -= gnDCRRvb_Y1[c] >> DCR_AMOUNT;
+			gnDCRRvb_X1[c] = x;
+		}
 	}
-	gnDCRRvb_X1 = nDCRRvb_X1;
-	gnDCRRvb_Y1 = nDCRRvb_Y1;
 }
 
 
@@ -706,52 +911,39 @@ stereodcr:
 // 3. Insert the result in the reflections delay buffer
 //
 
-void CReverb::MMX_ProcessPreDelay(PSWRVBREFDELAY pPreDelay, const int *pIn, uint32 nSamples)
-//------------------------------------------------------------------------------------------
+void CReverb::ProcessPreDelay(PSWRVBREFDELAY pPreDelay, const int *pIn, uint32 nSamples)
+//--------------------------------------------------------------------------------------
 {
-	_asm {
-	mov eax, pPreDelay
-	mov ecx, pIn
-	mov esi, nSamples
-	lea edi, [eax+SWRVBREFDELAY.RefDelayBuffer]
-	mov ebx, dword ptr [eax+SWRVBREFDELAY.nDelayPos]
-	mov edx, dword ptr [eax+SWRVBREFDELAY.nPreDifPos]
-	movd mm6, dword ptr [eax+SWRVBREFDELAY.nCoeffs]
-	movd mm7, dword ptr [eax+SWRVBREFDELAY.History]
-	movd mm4, dword ptr [eax+SWRVBREFDELAY.nPreDifCoeffs]
-	lea eax, [eax+SWRVBREFDELAY.PreDifBuffer]
-	dec ebx
-rvbloop:
-	movq mm0, qword ptr [ecx]	// mm0 = 16-bit unsaturated reverb input [  r  |  l  ]
-	inc ebx
-	add ecx, 8
-	packssdw mm0, mm0	// mm0 = [ r | l | r | l ]
-	and ebx, SNDMIX_REFLECTIONS_DELAY_MASK
-	// Low-pass
-	psubsw mm7, mm0
-	pmulhw mm7, mm6
-	movd mm5, dword ptr [eax+edx*4]	// mm5 = [ 0 | 0 |rd |ld ] XD(n-D)
-	paddsw mm7, mm7
-	paddsw mm7, mm0
-	// Pre-Diffusion
-	movq mm0, mm7					// mm0 = [ ? | ? | r | l ] X(n)
-	inc edx
-	movq mm3, mm5
-	and edx, SNDMIX_PREDIFFUSION_DELAY_MASK
-	pmulhw mm3, mm4					// mm3 = k.Xd(n-D)
-	movq mm2, mm4
-	dec esi
-	psubsw mm0, mm3					// mm0 = X(n) - k.Xd(n-D) = Xd(n)
-	pmulhw mm2, mm0					// mm2 = k.Xd(n)
-	paddsw mm2, mm5					// mm2 = Xd(n-D) + k.Xd(n)
-	movd dword ptr [eax+edx*4], mm0
-	movd dword ptr [edi+ebx*4], mm2
-	jnz rvbloop
-	mov eax, pPreDelay
-	mov dword ptr [eax+SWRVBREFDELAY.nPreDifPos], edx
-	movd dword ptr [eax+SWRVBREFDELAY.History], mm7
-	emms
+#if defined(MPT_INTRINSICS_X86)
+	if(GetProcSupport() & PROCSUPPORT_SSE2)
+	{
+		SSE2_ProcessPreDelay(pPreDelay, pIn, nSamples);
+		return;
 	}
+#endif // MPT_INTRINSICS_X86
+
+	uint32 delayPos = pPreDelay->nDelayPos;
+	uint32 preDifPos = pPreDelay->nPreDifPos;
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		const uint32 nextPreDifPos = (preDifPos + 1) & SNDMIX_PREDIFFUSION_DELAY_MASK;
+		for(int c = 0; c < 2; c++)
+		{
+			const int16 in = Sat16(pIn[i * 2 + c]);
+			// Low-pass
+			int16 history = MulHigh16(SubSat16(pPreDelay->History[c], in), pPreDelay->nCoeffs[c]);
+			history = AddSat16(AddSat16(history, history), in);
+			pPreDelay->History[c] = history;
+			// Pre-Diffusion
+			const int16 delayed = pPreDelay->PreDifBuffer[preDifPos * 2 + c];
+			const int16 diffused = SubSat16(history, MulHigh16(delayed, pPreDelay->nPreDifCoeffs[c]));
+			pPreDelay->PreDifBuffer[nextPreDifPos * 2 + c] = diffused;
+			pPreDelay->RefDelayBuffer[delayPos * 2 + c] = AddSat16(MulHigh16(pPreDelay->nPreDifCoeffs[c], diffused), delayed);
+		}
+		preDifPos = nextPreDifPos;
+		delayPos = (delayPos + 1) & SNDMIX_REFLECTIONS_DELAY_MASK;
+	}
+	pPreDelay->nPreDifPos = preDifPos;
 }
 
 
@@ -767,136 +959,63 @@ rvbloop:
 //	- apply reflections master gain and accumulate in the given output
 //
 
-typedef struct _DUMMYREFARRAY
+void CReverb::ProcessReflections(PSWRVBREFDELAY pPreDelay, int16 *pRefOut, int *pOut, uint32 nSamples)
+//----------------------------------------------------------------------------------------------------
 {
-	SWRVBREFLECTION Ref1;
-	SWRVBREFLECTION Ref2;
-	SWRVBREFLECTION Ref3;
-	SWRVBREFLECTION Ref4;
-	SWRVBREFLECTION Ref5;
-	SWRVBREFLECTION Ref6;
-	SWRVBREFLECTION Ref7;
-	SWRVBREFLECTION Ref8;
-} DUMMYREFARRAY, *PDUMMYREFARRAY;
-
-
-void CReverb::MMX_ProcessReflections(PSWRVBREFDELAY pPreDelay, short int *pRefOut, int *pOut, uint32 nSamples)
-//------------------------------------------------------------------------------------------------------------
-{
-	_asm {
-	// First stage
-	push ebp
-	mov edi, pPreDelay
-	mov eax, pRefOut
-	mov ebp, nSamples
-	push eax
-	lea esi, [edi+SWRVBREFDELAY.RefDelayBuffer]
-	mov eax, dword ptr [edi+SWRVBREFDELAY.nDelayPos]
-	lea edi, [edi+SWRVBREFDELAY.Reflections]
-	mov ebx, eax
-	mov ecx, eax
-	mov edx, eax
-	sub eax, dword ptr [edi+DUMMYREFARRAY.Ref1.Delay]
-	movq mm4, qword ptr [edi+DUMMYREFARRAY.Ref1.Gains]
-	sub ebx, dword ptr [edi+DUMMYREFARRAY.Ref2.Delay]
-	movq mm5, qword ptr [edi+DUMMYREFARRAY.Ref2.Gains]
-	sub ecx, dword ptr [edi+DUMMYREFARRAY.Ref3.Delay]
-	movq mm6, qword ptr [edi+DUMMYREFARRAY.Ref3.Gains]
-	sub edx, dword ptr [edi+DUMMYREFARRAY.Ref4.Delay]
-	movq mm7, qword ptr [edi+DUMMYREFARRAY.Ref4.Gains]
-	pop edi
-	and eax, SNDMIX_REFLECTIONS_DELAY_MASK
-	and ebx, SNDMIX_REFLECTIONS_DELAY_MASK
-	and ecx, SNDMIX_REFLECTIONS_DELAY_MASK
-	and edx, SNDMIX_REFLECTIONS_DELAY_MASK
-refloop1:
-	movd mm3, dword ptr [esi+edx*4]
-	movd mm2, dword ptr [esi+ecx*4]
-	inc edx
-	inc ecx
-	movd mm1, dword ptr [esi+ebx*4]
-	movd mm0, dword ptr [esi+eax*4]
-	punpckldq mm3, mm3
-	punpckldq mm2, mm2
-	pmaddwd mm3, mm7
-	inc ebx
-	inc eax
-	pmaddwd mm2, mm6
-	punpckldq mm1, mm1
-	punpckldq mm0, mm0
-	pmaddwd mm1, mm5
-	and eax, SNDMIX_REFLECTIONS_DELAY_MASK
-	and ebx, SNDMIX_REFLECTIONS_DELAY_MASK
-	pmaddwd mm0, mm4
-	and ecx, SNDMIX_REFLECTIONS_DELAY_MASK
-	paddd mm2, mm3
-	paddd mm0, mm1
-	paddd mm0, mm2
-	and edx, SNDMIX_REFLECTIONS_DELAY_MASK
-	psrad mm0, 15
-	add edi, 4
-	packssdw mm0, mm0
-	dec ebp
-	movd dword ptr [edi-4], mm0
-	jnz refloop1
-	pop ebp
-	// Second stage
-	push ebp
-	mov edi, pPreDelay
-	mov eax, pRefOut
-	mov edx, pOut
-	mov ebp, nSamples
-	movd mm7, dword ptr [edi+SWRVBREFDELAY.ReflectionsGain]
-	pxor mm0, mm0
-	push eax
-	punpcklwd mm7, mm0	// mm7 = [ 0 |g_r| 0 |g_l]
-	mov eax, dword ptr [edi+SWRVBREFDELAY.nDelayPos]
-	lea edi, [edi+SWRVBREFDELAY.Reflections]
-	mov ebx, eax
-	mov ecx, eax
-	sub eax, dword ptr [edi+DUMMYREFARRAY.Ref5.Delay]
-	movq mm4, qword ptr [edi+DUMMYREFARRAY.Ref5.Gains]
-	sub ebx, dword ptr [edi+DUMMYREFARRAY.Ref6.Delay]
-	movq mm5, qword ptr [edi+DUMMYREFARRAY.Ref6.Gains]
-	sub ecx, dword ptr [edi+DUMMYREFARRAY.Ref7.Delay]
-	movq mm6, qword ptr [edi+DUMMYREFARRAY.Ref7.Gains]
-	pop edi
-	and ecx, SNDMIX_REFLECTIONS_DELAY_MASK
-	and ebx, SNDMIX_REFLECTIONS_DELAY_MASK
-	and eax, SNDMIX_REFLECTIONS_DELAY_MASK
-	psrad mm7, 3	// For 28-bit final output: 16+15-3 = 28
-refloop2:
-	movd mm2, dword ptr [esi+ecx*4]
-	movd mm1, dword ptr [esi+ebx*4]
-	movd mm0, dword ptr [esi+eax*4]
-	movd mm3, dword ptr [edi]			// mm3 = output of previous reflections
-	punpckldq mm2, mm2
-	inc ecx
-	pmaddwd mm2, mm6
-	punpckldq mm1, mm1
-	inc ebx
-	pmaddwd mm1, mm5
-	punpckldq mm0, mm0
-	inc eax
-	pmaddwd mm0, mm4
-	and ecx, SNDMIX_REFLECTIONS_DELAY_MASK
-	and ebx, SNDMIX_REFLECTIONS_DELAY_MASK
-	paddd mm0, mm2
-	paddd mm0, mm1
-	add edi, 4
-	psrad mm0, 15
-	and eax, SNDMIX_REFLECTIONS_DELAY_MASK
-	packssdw mm0, mm0
-	paddsw mm0, mm3
-	add edx, 8
-	movd dword ptr [edi-4], mm0		// late reverb stereo input
-	punpcklwd mm0, mm0
-	pmaddwd mm0, mm7				// Apply reflections gain
-	dec ebp
-	movq qword ptr [edx-8], mm0		// At this, point, this is the only output of the reverb
-	jnz refloop2
-	pop ebp
-	emms
+#if defined(MPT_INTRINSICS_X86)
+	if(GetProcSupport() & PROCSUPPORT_SSE2)
+	{
+		SSE2_ProcessReflections(pPreDelay, pRefOut, pOut, nSamples);
+		return;
+	}
+#endif // MPT_INTRINSICS_X86
+
+	const int16 *pDelay = pPreDelay->RefDelayBuffer;
+	uint32 pos[7];
+	for(int r = 0; r < 7; r++)
+	{
+		pos[r] = (pPreDelay->nDelayPos - pPreDelay->Reflections[r].Delay) & SNDMIX_REFLECTIONS_DELAY_MASK;
+	}
+
+	// First stage: reflections 1-4
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		uint32 sumL = 0, sumR = 0;
+		for(int r = 0; r < 4; r++)
+		{
+			const int16 *in = pDelay + pos[r] * 2;
+			const int16 *gains = pPreDelay->Reflections[r].Gains;
+			sumL += MulAdd16(in[0], gains[0], in[1], gains[1]);
+			sumR += MulAdd16(in[0], gains[2], in[1], gains[3]);
+			pos[r] = (pos[r] + 1) & SNDMIX_REFLECTIONS_DELAY_MASK;
+		}
+		pRefOut[i * 2] = Sat16(static_cast<int32>(sumL) >> 15);
+		pRefOut[i * 2 + 1] = Sat16(static_cast<int32>(sumR) >> 15);
+	}
+
+	// Second stage: reflections 5-7
+	// For 28-bit final output: 16+15-3 = 28
+	const int16 masterGainL = static_cast<int16>(static_cast<uint16>(pPreDelay->ReflectionsGain[0]) >> 3);
+	const int16 masterGainR = static_cast<int16>(static_cast<uint16>(pPreDelay->ReflectionsGain[1]) >> 3);
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		uint32 sumL = 0, sumR = 0;
+		for(int r = 4; r < 7; r++)
+		{
+			const int16 *in = pDelay + pos[r] * 2;
+			const int16 *gains = pPreDelay->Reflections[r].Gains;
+			sumL += MulAdd16(in[0], gains[0], in[1], gains[1]);
+			sumR += MulAdd16(in[0], gains[2], in[1], gains[3]);
+			pos[r] = (pos[r] + 1) & SNDMIX_REFLECTIONS_DELAY_MASK;
+		}
+		// Add output of previous reflections; this is the late reverb stereo input
+		const int16 outL = AddSat16(Sat16(static_cast<int32>(sumL) >> 15), pRefOut[i * 2]);
+		const int16 outR = AddSat16(Sat16(static_cast<int32>(sumR) >> 15), pRefOut[i * 2 + 1]);
+		pRefOut[i * 2] = outL;
+		pRefOut[i * 2 + 1] = outR;
+		// Apply reflections gain. At this point, this is the only output of the reverb
+		pOut[i * 2] = outL * masterGainL;
+		pOut[i * 2 + 1] = outR * masterGainR;
 	}
 }
 
@@ -906,112 +1025,98 @@ refloop2:
 // Late reverberation (with SW reflections)
 //
 
-void CReverb::MMX_ProcessLateReverb(PSWLATEREVERB pReverb, short int *pRefOut, int *pMixOut, uint32 nSamples)
-//-----------------------------------------------------------------------------------------------------------
+void CReverb::ProcessLateReverb(PSWLATEREVERB pReverb, const int16 *pRefOut, int *pMixOut, uint32 nSamples)
+//---------------------------------------------------------------------------------------------------------
 {
-	_asm {
-	push ebp
-	mov ebx, pReverb
-	mov esi, pRefOut
-	mov edi, pMixOut
-	mov ebp, nSamples
-	mov ecx, dword ptr [ebx+SWLATEREVERB.nDelayPos]
-	movq mm3, qword ptr [ebx+SWLATEREVERB.RvbOutGains]
-	movq mm5, qword ptr [ebx+SWLATEREVERB.nDifCoeffs]
-	movq mm6, qword ptr [ebx+SWLATEREVERB.nDecayLP]
-	movq mm7, qword ptr [ebx+SWLATEREVERB.LPHistory]
-rvbloop:
-	sub ecx, RVBDLY2L_LEN
-	movd mm0, dword ptr [esi]
-	lea edx, [ecx+RVBDLY2L_LEN - RVBDLY2R_LEN]
-	and ecx, RVBDLY_MASK
-	and edx, RVBDLY_MASK
-	movd mm1, dword ptr [ebx+SWLATEREVERB.Delay2+ecx*4]
-	movd mm2, dword ptr [ebx+SWLATEREVERB.Delay2+edx*4]
-	add ecx, RVBDLY2L_LEN - RVBDIF1R_LEN
-	punpckldq mm0, mm0
-	and ecx, RVBDLY_MASK
-	punpckldq mm1, mm2
-	psraw mm0, 2			// mm0 = stereo input
-	psubsw mm7, mm1
-	movzx eax, word ptr [ebx+SWLATEREVERB.Diffusion1+ecx*4+2]
-	pmulhw mm7, mm6
-	add ecx, RVBDIF1R_LEN - RVBDIF1L_LEN
-	add esi, 4
-	paddsw mm7, mm7
-	paddsw mm7, mm1		// mm7 = low-passed decay
-	movq mm1, qword ptr [ebx+SWLATEREVERB.nDecayDC]
-	and ecx, RVBDLY_MASK
-	shl eax, 16
-	pmaddwd mm1, mm7	// apply decay gain
-	movzx edx, word ptr [ebx+SWLATEREVERB.Diffusion1+ecx*4]
-	add ecx, RVBDIF1L_LEN
-	psrad mm1, 15		// mm1 = decay [  r  |  l  ]
-	and ecx, RVBDLY_MASK
-	packssdw mm1, mm1
-	or eax, edx
-	paddsw mm1, mm0		// mm1 = input + decay		[ r | l | r | l ]
-	movd mm2, eax		// mm2 = diffusion1 history	[ 0 | 0 | rd| ld] Xd(n-D)
-	pmulhw mm2, mm5		// mm2 = k.Xd(n-D)
-	movq mm4, mm1		// mm4 = reverb output
-	movq mm0, mm5
-	psubsw mm1, mm2		// mm1 = X(n) - k.Xd(n-D) = Xd(n)
-	movd mm2, eax
-	pmulhw mm0, mm1		// mm0 = k.Xd(n)
-	movd dword ptr [ebx+SWLATEREVERB.Diffusion1+ecx*4], mm1
-	paddsw mm0, mm2		// mm0 = Xd(n-D) + k.Xd(n)
-	mov eax, ecx
-	// Insert the diffusion output in the reverb delay line
-	movd dword ptr [ebx+SWLATEREVERB.Delay1+ecx*4], mm0
-	sub ecx, RVBDLY1R_LEN
-	sub eax, RVBDLY1L_LEN
-	punpckldq mm0, mm0
-	and ecx, RVBDLY_MASK
-	and eax, RVBDLY_MASK
-	paddsw mm4, mm0		// accumulate with reverb output
-	// Input to second diffuser
-	movd mm0, dword ptr [ebx+SWLATEREVERB.Delay1+ecx*4]
-	movd mm1, dword ptr [ebx+SWLATEREVERB.Delay1+eax*4]
-	add ecx, RVBDLY1R_LEN - RVBDIF2R_LEN
-	and ecx, RVBDLY_MASK
-	punpckldq mm1, mm0
-	movzx eax, word ptr [ebx+SWLATEREVERB.Diffusion2+ecx*4+2]
-	paddsw mm4, mm1
-	pmaddwd mm1, qword ptr [ebx+SWLATEREVERB.Dif2InGains]
-	add ecx, RVBDIF2R_LEN - RVBDIF2L_LEN
-	and ecx, RVBDLY_MASK
-	psrad mm1, 15
-	movzx edx, word ptr [ebx+SWLATEREVERB.Diffusion2+ecx*4]
-	packssdw mm1, mm1	// mm1 = 2nd diffuser input [ r | l | r | l ]
-	shl eax, 16
-	psubsw mm4, mm1		// accumulate with reverb output
-	or eax, edx
-	add ecx, RVBDIF2L_LEN
-	movd mm2, eax		// mm2 = diffusion2 history
-	and ecx, RVBDLY_MASK
-	pmulhw mm2, mm5		// mm2 = k.Xd(n-D)
-	movq mm0, mm5
-	psubsw mm1, mm2		// mm1 = X(n) - k.Xd(n-D) = Xd(n)
-	movd mm2, eax
-	pmulhw mm0, mm1		// mm0 = k.Xd(n)
-	movd dword ptr [ebx+SWLATEREVERB.Diffusion2+ecx*4], mm1
-	movq mm1, qword ptr [edi]
-	paddsw mm0, mm2		// mm0 = Xd(n-D) + k.Xd(n)
-	paddsw mm4, mm0		// accumulate with reverb output
-	movd dword ptr [ebx+SWLATEREVERB.Delay2+ecx*4], mm0
-	pmaddwd mm4, mm3	// mm4 = [   r   |   l   ]
-	inc ecx
-	add edi, 8
-	and ecx, RVBDLY_MASK
-	paddd mm4, mm1
-	dec ebp
-	movq qword ptr [edi-8], mm4
-	jnz rvbloop
-	pop ebp
-	movq qword ptr [ebx+SWLATEREVERB.LPHistory], mm7
-	mov dword ptr [ebx+SWLATEREVERB.nDelayPos], ecx
-	emms
+#if defined(MPT_INTRINSICS_X86)
+	if(GetProcSupport() & PROCSUPPORT_SSE2)
+	{
+		SSE2_ProcessLateReverb(pReverb, pRefOut, pMixOut, nSamples);
+		return;
 	}
+#endif // MPT_INTRINSICS_X86
+
+	const int16 *k = pReverb->nDifCoeffs;
+	int16 *history = pReverb->LPHistory;
+	uint32 pos = pReverb->nDelayPos;
+	for(uint32 i = 0; i < nSamples; i++)
+	{
+		// Stereo input
+		const int16 in[2] = { static_cast<int16>(pRefOut[i * 2] >> 2), static_cast<int16>(pRefOut[i * 2 + 1] >> 2) };
+		// Low-passed decay
+		const int16 *dly2L = &pReverb->Delay2[((pos - RVBDLY2L_LEN) & RVBDLY_MASK) * 2];
+		const int16 *dly2R = &pReverb->Delay2[((pos - RVBDLY2R_LEN) & RVBDLY_MASK) * 2];
+		const int16 tank[4] = { dly2L[0], dly2L[1], dly2R[0], dly2R[1] };
+		for(int c = 0; c < 4; c++)
+		{
+			const int16 lp = MulHigh16(SubSat16(history[c], tank[c]), pReverb->nDecayLP[c]);
+			history[c] = AddSat16(AddSat16(lp, lp), tank[c]);
+		}
+		// Apply decay gain
+		const int16 *dc = pReverb->nDecayDC;
+		const int16 decay[2] =
+		{
+			AddSat16(Sat16(static_cast<int32>(MulAdd16(dc[0], history[0], dc[1], history[1])) >> 15), in[0]),
+			AddSat16(Sat16(static_cast<int32>(MulAdd16(dc[2], history[2], dc[3], history[3])) >> 15), in[1]),
+		};
+		int16 out[4] = { decay[0], decay[1], decay[0], decay[1] };
+		// First diffuser
+		const int16 dif1[2] =
+		{
+			pReverb->Diffusion1[((pos - RVBDIF1L_LEN) & RVBDLY_MASK) * 2],
+			pReverb->Diffusion1[((pos - RVBDIF1R_LEN) & RVBDLY_MASK) * 2 + 1],
+		};
+		int16 dif[2];
+		for(int c = 0; c < 2; c++)
+		{
+			const int16 diffused = SubSat16(decay[c], MulHigh16(dif1[c], k[c]));
+			pReverb->Diffusion1[pos * 2 + c] = diffused;
+			dif[c] = AddSat16(MulHigh16(k[c], diffused), dif1[c]);
+			// Insert the diffusion output in the reverb delay line
+			pReverb->Delay1[pos * 2 + c] = dif[c];
+		}
+		for(int c = 0; c < 4; c++)
+		{
+			out[c] = AddSat16(out[c], dif[c & 1]);
+		}
+		// Input to second diffuser
+		const int16 *dly1L = &pReverb->Delay1[((pos - RVBDLY1L_LEN) & RVBDLY_MASK) * 2];
+		const int16 *dly1R = &pReverb->Delay1[((pos - RVBDLY1R_LEN) & RVBDLY_MASK) * 2];
+		const int16 dly1[4] = { dly1L[0], dly1L[1], dly1R[0], dly1R[1] };
+		const int16 *g = pReverb->Dif2InGains;
+		const int16 dif2In[2] =
+		{
+			Sat16(static_cast<int32>(MulAdd16(dly1[0], g[0], dly1[1], g[1])) >> 15),
+			Sat16(static_cast<int32>(MulAdd16(dly1[2], g[2], dly1[3], g[3])) >> 15),
+		};
+		for(int c = 0; c < 4; c++)
+		{
+			out[c] = SubSat16(AddSat16(out[c], dly1[c]), dif2In[c & 1]);
+		}
+		// Second diffuser
+		const int16 dif2[2] =
+		{
+			pReverb->Diffusion2[((pos - RVBDIF2L_LEN) & RVBDLY_MASK) * 2],
+			pReverb->Diffusion2[((pos - RVBDIF2R_LEN) & RVBDLY_MASK) * 2 + 1],
+		};
+		for(int c = 0; c < 2; c++)
+		{
+			const int16 diffused = SubSat16(dif2In[c], MulHigh16(dif2[c], k[c]));
+			pReverb->Diffusion2[pos * 2 + c] = diffused;
+			dif[c] = AddSat16(MulHigh16(k[c], diffused), dif2[c]);
+			pReverb->Delay2[pos * 2 + c] = dif[c];
+			out[c] = AddSat16(out[c], dif[c]);
+		}
+		// The upper half only gets the gain applied to the diffuser input (there is no history in these lanes)
+		out[2] = AddSat16(out[2], MulHigh16(k[2], dif2In[0]));
+		out[3] = AddSat16(out[3], MulHigh16(k[3], dif2In[1]));
+		// Apply output gains and mix
+		const int16 *outGains = pReverb->RvbOutGains;
+		pMixOut[i * 2] = static_cast<int32>(static_cast<uint32>(pMixOut[i * 2]) + MulAdd16(out[0], outGains[0], out[1], outGains[1]));
+		pMixOut[i * 2 + 1] = static_cast<int32>(static_cast<uint32>(pMixOut[i * 2 + 1]) + MulAdd16(out[2], outGains[2], out[3], outGains[3]));
+		pos = (pos + 1) & RVBDLY_MASK;
+	}
+	pReverb->nDelayPos = pos;
 }
 
 
@@ -1019,109 +1124,30 @@ rvbloop:
 static int32 OnePoleLowPassCoef(int32 scale, float g, float F_c, float F_s)
 //-------------------------------------------------------------------------
 {
-	float cosw; // cos(2*PI*Fc/Fs)
-	float scale_over_1mg; // scale / (1.0f - g);
-	int32 result;
-
 	if (g > 0.999999f) return 0;
-	_asm {
-	fild scale
-	fld1
-	fld g
-	fld ST(0)
-	fmulp ST(1), ST(0)
-	fst g
-	fsubp ST(1), ST(0)
-	fdivp ST(1), ST(0)
-	fstp scale_over_1mg
-	fld F_c
-	fld F_s
-	fdivp ST(1), ST(0)
-	fldpi
-	fadd ST(0), ST(0)
-	fmulp ST(1), ST(0)
-	fcos
-	fstp cosw
-	fld g
-	fadd ST(0), ST(0)
-	fld1
-	fld cosw
-	fsubp ST(1), ST(0)
-	fmulp ST(1), ST(0)	// 2g*(1 cos(w))
-	fld g
-	fmul ST(0), ST(0)
-	fld1
-	fld cosw
-	fmul ST(0), ST(0)
-	fsubp ST(1), ST(0)
-	fmulp ST(1), ST(0)	// g*g*((1-cos w)^2)
-	fsubp ST(1), ST(0)
-	fsqrt
-	fld g
-	fmul cosw
-	faddp ST(1), ST(0)
-	fld1
-	fsubrp ST(1), ST(0)	// (1-gcos(w)-sqrt(2g(1-cos w) - g2(1-(cos w)^2)))
-	fld scale_over_1mg
-	fmulp ST(1), ST(0)
-	fistp result
-	}
-	return result;
+
+	g *= g;
+	double scale_over_1mg = scale / (1.0 - g);
+	double cosw = std::cos(2.0 * M_PI * F_c / F_s);
+	return Util::Round<int32>((1.0 - (std::sqrt((g + g) * (1.0 - cosw) - g * g * (1.0 - cosw * cosw)) + g * cosw)) * scale_over_1mg);
 }
 
 
 static int32 mBToLinear(int32 scale, int32 value_mB)
+//--------------------------------------------------
 {
-	// factor = log2(10)/(100*20)
-	const float _factor = 3.321928094887362304f / (100.0f * 20.0f);
-	long result;
-
 	if (!value_mB) return scale;
 	if (value_mB <= -10000) return 0;
-	_asm {
-	fild value_mB		// Load dB value
-	fld _factor			// Load the log2(10)/(20*65536) factor
-	fmulp ST(1), ST(0)	// ST(0) = value_dB/(20*65536)
-	fist result			// Store integer exponent
-	fisub result		// ST(0) = -1 <= (value_dB*log2(10)/(65536*20)) <= 1
-	f2xm1				// ST(0) = 2^(value_dB*log2(10)/(65536*20))-1
-	fild result			// load integer exponent
-	fild scale			// Load scale factor
-	fscale				// ST(0) = scale * 2^ST(1)
-	fstp ST(1)			// Remove the integer from the stack
-	fmul ST(1), ST(0)	// multiply with fractional part
-	faddp ST(1), ST(0)	// add 1*scale*integer_part
-	fistp result		// Convert to integer
-	}
-	return result;
+	return Util::Round<int32>(scale * std::pow(10.0, value_mB / 2000.0));
 }
 
 
 static float mBToLinear(int32 value_mB)
+//-------------------------------------
 {
-	// factor = log2(10)/(100*20)
-	const float _factor = 3.321928094887362304f / (100.0f * 20.0f);
-	long result;
-	float fresult;
-
 	if (!value_mB) return 1;
 	if (value_mB <= -100000) return 0;
-	_asm {
-	fild value_mB		// Load dB value
-	fld _factor			// Load the log2(10)/(20*65536) factor
-	fmulp ST(1), ST(0)	// ST(0) = value_dB/(20*65536)
-	fist result			// Store integer exponent
-	fisub result		// ST(0) = -1 <= (value_dB*log2(10)/(65536*20)) <= 1
-	f2xm1				// ST(0) = 2^(value_dB*log2(10)/(65536*20))-1
-	fild result			// load integer exponent
-	fld1				// Load scale factor
-	fscale				// ST(0) = scale * 2^ST(1)
-	fstp ST(1)			// Remove the integer from the stack
-	fmul ST(1), ST(0)	// multiply with fractional part
-	faddp ST(1), ST(0)	// add 1*scale*integer_part
-	fstp fresult		// Convert to integer
-	}
-	return fresult;
+	return static_cast<float>(std::pow(10.0, value_mB / 2000.0));
 }
 
 #endif // NO_REVERB
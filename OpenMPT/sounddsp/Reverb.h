@@ -149,6 +149,14 @@ private:
 	uint32 gnReverbSamples;
 	uint32 gnReverbDecaySamples;
 
+	// Preset and mixing frequency the reverb parameters were last calculated for
+	uint32 m_nCurrentPreset;
+	uint32 m_nCurrentMixingFreq;
+
+	// Processing time statistics
+	uint64 m_nProcessedFrames;
+	uint64 m_nProcessingTime;
+
 	// Internal reverb state
 	bool g_bLastInPresent;
 	bool g_bLastOutPresent;
@@ -158,8 +166,8 @@ private:
 	int g_nLastRvbIn_yr;
 	int g_nLastRvbOut_xl;
 	int g_nLastRvbOut_xr;
-	int64 gnDCRRvb_Y1;
-	int64 gnDCRRvb_X1;
+	int32 gnDCRRvb_Y1[2];
+	int32 gnDCRRvb_X1[2];
 
 	// Reverb mix buffers
 	SWRVBREFDELAY g_RefDelay;
@@ -178,21 +186,26 @@ public:
 
 	// [Reverb level 0(quiet)-100(loud)], [REVERBTYPE_XXXX]
 	bool SetReverbParameters(uint32 nDepth, uint32 nType);
+
+	// Number of frames that have been passed to Process() and the time that has been spent in Process() (in nanoseconds)
+	// since the reverb was last reset. Only frames that are processed while the reverb is enabled are counted.
+	uint64 GetProcessedFrames() const { return m_nProcessedFrames; }
+	uint64 GetProcessingTime() const { return m_nProcessingTime; }
 private:
 	void Shutdown();
 	// Pre/Post resampling and filtering
 	uint32 X86_ReverbProcessPreFiltering1x(int *pWet, uint32 nSamples);
 	uint32 X86_ReverbProcessPreFiltering2x(int *pWet, uint32 nSamples);
-	void MMX_ReverbProcessPostFiltering1x(const int *pRvb, int *pDry, uint32 nSamples);
+	void ReverbProcessPostFiltering1x(const int *pRvb, int *pDry, uint32 nSamples);
 	void X86_ReverbProcessPostFiltering2x(const int *pRvb, int *pDry, uint32 nSamples);
-	void MMX_ReverbDCRemoval(int *pBuffer, uint32 nSamples);
 	void X86_ReverbDryMix(int *pDry, int *pWet, int lDryVol, uint32 nSamples);
+	// The following functions use SSE2 if the CPU supports it and portable code otherwise. Both produce identical results.
 	// Process pre-diffusion and pre-delay
-	void MMX_ProcessPreDelay(PSWRVBREFDELAY pPreDelay, const int *pIn, uint32 nSamples);
+	void ProcessPreDelay(PSWRVBREFDELAY pPreDelay, const int *pIn, uint32 nSamples);
 	// Process reflections
-	void MMX_ProcessReflections(PSWRVBREFDELAY pPreDelay, short int *pRefOut, int *pMixOut, uint32 nSamples);
+	void ProcessReflections(PSWRVBREFDELAY pPreDelay, int16 *pRefOut, int *pMixOut, uint32 nSamples);
 	// Process Late Reverb (SW Reflections): stereo reflections output, 32-bit reverb output, SW reverb gain
-	void MMX_ProcessLateReverb(PSWLATEREVERB pReverb, short int *pRefOut, int *pMixOut, uint32 nSamples);
+	void ProcessLateReverb(PSWLATEREVERB pReverb, const int16 *pRefOut, int *pMixOut, uint32 nSamples);
 };
 
 
@@ -13,12 +13,54 @@
 #include "SampleFormatConverters.h"
 #include "SampleFormat.h"
 #include "MixerLoops.h"
+#include "MixerOutput.h"
 #include "Mixer.h"
 
 
 OPENMPT_NAMESPACE_BEGIN
 
 
+// Convert to output sample format and optionally perform dithering and clipping if needed.
+// 16-bit and floating point output use the fused output stage from MixerOutput.h,
+// the other sample formats are converted in separate passes.
+template<bool clipOutput, typename Tsample>
+void ConvertMixBufferToOutput(Tsample *buffer, Tsample * const *buffers, int *MixSoundBuffer, std::size_t channels, std::size_t countChunk, Dither &dither, float gainFactor)
+{
+	const SampleFormat sampleFormat = SampleFormatTraits<Tsample>::sampleFormat;
+	STATIC_ASSERT(SampleFormatTraits<Tsample>::sampleFormat != SampleFormatFloat32);
+
+#ifndef MODPLUG_TRACKER
+	ApplyGain(MixSoundBuffer, channels, countChunk, Util::Round<int32>(gainFactor * (1<<16)));
+#else
+	MPT_UNREFERENCED_PARAMETER(gainFactor);
+#endif // !MODPLUG_TRACKER
+
+	dither.Process(MixSoundBuffer, countChunk, channels, sampleFormat.GetBitsPerSample());
+
+	if(buffer)
+	{
+		ConvertInterleavedFixedPointToInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(buffer, MixSoundBuffer, channels, countChunk);
+	}
+	if(buffers)
+	{
+		ConvertInterleavedFixedPointToNonInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(buffers, MixSoundBuffer, channels, countChunk);
+	}
+}
+
+template<bool clipOutput>
+void ConvertMixBufferToOutput(int16 *buffer, int16 * const *buffers, int *MixSoundBuffer, std::size_t channels, std::size_t countChunk, Dither &dither, float gainFactor)
+{
+	ConvertMixBufferToOutput(buffer, buffers, MixSoundBuffer, channels, countChunk, dither, Util::Round<int32>(gainFactor * (1<<16)));
+}
+
+template<bool clipOutput>
+void ConvertMixBufferToOutput(float *buffer, float * const *buffers, int *MixSoundBuffer, std::size_t channels, std::size_t countChunk, Dither & /*dither*/, float gainFactor)
+{
+	// Apply final output gain for floating point output after conversion so we do not suffer underflow or clipping
+	ConvertMixBufferToOutput(buffer, buffers, MixSoundBuffer, channels, countChunk, clipOutput, gainFactor);
+}
+
+
 template<typename Tsample, bool clipOutput = false>
 class AudioReadTargetBuffer
 	: public IAudioReadTarget
@@ -43,28 +85,20 @@ public:
 public:
 	virtual void DataCallback(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk)
 	{
-		// Convert to output sample format and optionally perform dithering and clipping if needed
-
-		const SampleFormat sampleFormat = SampleFormatTraits<Tsample>::sampleFormat;
-
-		if(sampleFormat.IsInt())
-		{
-			dither.Process(MixSoundBuffer, countChunk, channels, sampleFormat.GetBitsPerSample());
-		}
-
-		if(outputBuffer)
-		{
-			ConvertInterleavedFixedPointToInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(outputBuffer + (channels * countRendered), MixSoundBuffer, channels, countChunk);
-		}
+		Process(MixSoundBuffer, channels, countChunk, 1.0f);
+	}
+protected:
+	void Process(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk, float gainFactor)
+	{
+		Tsample *buffers[4] = { nullptr, nullptr, nullptr, nullptr };
 		if(outputBuffers)
 		{
-			Tsample *buffers[4] = { nullptr, nullptr, nullptr, nullptr };
 			for(std::size_t channel = 0; channel < channels; ++channel)
 			{
 				buffers[channel] = outputBuffers[channel] + countRendered;
 			}
-			ConvertInterleavedFixedPointToNonInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(buffers, MixSoundBuffer, channels, countChunk);
 		}
+		ConvertMixBufferToOutput<clipOutput>(outputBuffer ? outputBuffer + (channels * countRendered) : nullptr, outputBuffers ? buffers : nullptr, MixSoundBuffer, channels, countChunk, dither, gainFactor);
 
 		countRendered += countChunk;
 	}
@@ -148,30 +182,6 @@ public:
 #else // !MODPLUG_TRACKER
 
 
-template<typename Tsample>
-void ApplyGainBeforeConversionIfAppropriate(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk, float gainFactor)
-{
-	// Apply final output gain for non floating point output
-	ApplyGain(MixSoundBuffer, channels, countChunk, Util::Round<int32>(gainFactor * (1<<16)));
-}
-template<>
-void ApplyGainBeforeConversionIfAppropriate<float>(int * /*MixSoundBuffer*/, std::size_t /*channels*/, std::size_t /*countChunk*/, float /*gainFactor*/)
-{
-	// nothing
-}
-
-template<typename Tsample>
-void ApplyGainAfterConversionIfAppropriate(Tsample * /*buffer*/, Tsample * const * /*buffers*/, std::size_t /*countRendered*/, std::size_t /*channels*/, std::size_t /*countChunk*/, float /*gainFactor*/)
-{
-	// nothing
-}
-template<>
-void ApplyGainAfterConversionIfAppropriate<float>(float *buffer, float * const *buffers, std::size_t countRendered, std::size_t channels, std::size_t countChunk, float gainFactor)
-{
-	// Apply final output gain for floating point output after conversion so we do not suffer underflow or clipping
-	ApplyGain(buffer, buffers, countRendered, channels, countChunk, gainFactor);
-}
-
 template<typename Tsample>
 class AudioReadTargetGainBuffer
 	: public AudioReadTargetBuffer<Tsample>
@@ -191,14 +201,7 @@ public:
 public:
 	virtual void DataCallback(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk)
 	{
-		const std::size_t countRendered = Tbase::GetRenderedCount();
-
-		ApplyGainBeforeConversionIfAppropriate<Tsample>(MixSoundBuffer, channels, countChunk, gainFactor);
-
-		Tbase::DataCallback(MixSoundBuffer, channels, countChunk);
-
-		ApplyGainAfterConversionIfAppropriate<Tsample>(Tbase::outputBuffer, Tbase::outputBuffers, countRendered, channels, countChunk, gainFactor);
-
+		Tbase::Process(MixSoundBuffer, channels, countChunk, gainFactor);
 	}
 };
 
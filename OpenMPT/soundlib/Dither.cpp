@@ -130,6 +130,27 @@ static void C_Dither(int *pBuffer, std::size_t count, uint32 nBits, DitherModPlu
 
 }
 
+static void C_DitherNoise(int *noise, std::size_t count, uint32 nBits, DitherModPlugState &state)
+//-----------------------------------------------------------------------------------------------
+{
+	if(nBits + MIXING_ATTENUATION + 1 >= 32) //if(nBits>16)
+	{
+		std::fill(noise, noise + count, 0);
+		return;
+	}
+
+	uint32 a = state.rng_a;
+	uint32 b = state.rng_b;
+
+	while(count--)
+	{
+		*noise++ = dither_rand(a, b) >> (nBits + MIXING_ATTENUATION + 1);
+	}
+
+	state.rng_a = a;
+	state.rng_b = b;
+}
+
 static void Dither_ModPlug(int *pBuffer, std::size_t count, std::size_t channels, uint32 nBits, DitherModPlugState &state)
 //------------------------------------------------------------------------------------------------------------------------
 {
@@ -310,4 +331,33 @@ void Dither::Process(int *mixbuffer, std::size_t count, std::size_t channels, in
 }
 
 
+bool Dither::IsSignalIndependent() const
+//--------------------------------------
+{
+	return mode != DitherSimple;
+}
+
+
+void Dither::GenerateNoise(int *noise, std::size_t count, int bits)
+//-----------------------------------------------------------------
+{
+	switch(mode)
+	{
+		case DitherNone:
+			std::fill(noise, noise + count, 0);
+			break;
+		case DitherSimple:
+			// noise shaping depends on the signal
+			MPT_ASSERT(false);
+			std::fill(noise, noise + count, 0);
+			break;
+		case DitherModPlug:
+		case DitherDefault:
+		default:
+			C_DitherNoise(noise, count, bits, state.modplug);
+			break;
+	}
+}
+
+
 OPENMPT_NAMESPACE_END
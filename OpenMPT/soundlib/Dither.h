@@ -65,6 +65,11 @@ public:
 	DitherMode GetMode() const;
 	void Reset();
 	void Process(int *mixbuffer, std::size_t count, std::size_t channels, int bits);
+	// Returns true if the noise added by the current mode does not depend on the signal.
+	// In that case, GenerateNoise() can be used instead of Process() to add the noise later.
+	bool IsSignalIndependent() const;
+	// Generate the noise that Process() would add to the next count samples (count includes all channels).
+	void GenerateNoise(int *noise, std::size_t count, int bits);
 	static mpt::ustring GetModeName(DitherMode mode);
 };
 
@@ -23,9 +23,11 @@
 #include "stdafx.h"
 #include "Sndfile.h"
 #include "MixerLoops.h"
+#include "../common/Profiler.h"
 #include <cfloat>	// For FLT_EPSILON
 #ifdef MPT_INTMIXER
 #include "IntMixer.h"
+#include "IntMixerSIMD.h"
 #else
 #include "FloatMixer.h"
 #endif // MPT_INTMIXER
@@ -275,49 +277,48 @@ static forceinline int32 GetSampleCount(ModChannel &chn, int32 nSamples, bool IT
 void CSoundFile::CreateStereoMix(int count)
 //-----------------------------------------
 {
-	mixsample_t *pOfsL, *pOfsR;
-
 	if (!count) return;
 
+	OPENMPT_PROFILE_FUNCTION(Profiler::Mixer);
+
 	// Resetting sound buffer
 	StereoFill(MixSoundBuffer, count, gnDryROfsVol, gnDryLOfsVol);
 	if(m_MixerSettings.gnChannels > 2) InitMixBuffer(MixRearBuffer, count*2);
 
 	CHANNELINDEX nchmixed = 0;
+	CHANNELINDEX numMixed = 0, numCulled = 0;
 
 	const bool ITPingPongMode = IsITPingPongMode();
 	const bool realtimeMix = !IsRenderingToDisc();
 
+#if !defined(NO_THREADS) && defined(MPT_INTMIXER)
+	// Voices that are mixed into the front or rear buffer are mixed in parallel after all other voices (reverb, plugins) have been mixed.
+	// Which voices are dropped when hitting the voice limit depends on the mixing order, so we can only do this if the limit cannot be reached.
+	const bool parallelMix = m_ParallelMixer.IsEnabled() && (m_nMixChannels <= m_MixerSettings.m_nMaxMixChannels || !realtimeMix);
+	m_ParallelMixer.voices.clear();
+#endif // !NO_THREADS && MPT_INTMIXER
+
 	for(uint32 nChn = 0; nChn < m_nMixChannels; nChn++)
 	{
 		ModChannel &chn = m_PlayState.Chn[m_PlayState.ChnMix[nChn]];
-		uint32 functionNdx = 0;
 
 		if(!chn.pCurrentSample) continue;
-		pOfsR = &gnDryROfsVol;
-		pOfsL = &gnDryLOfsVol;
-		if(chn.dwFlags[CHN_16BIT]) functionNdx |= MixFuncTable::ndx16Bit;
-		if(chn.dwFlags[CHN_STEREO]) functionNdx |= MixFuncTable::ndxStereo;
-	#ifndef NO_FILTER
-		if(chn.dwFlags[CHN_FILTER]) functionNdx |= MixFuncTable::ndxFilter;
-	#endif
-
-		const MixFuncTable::ResamplingIndex resamplingMode = MixFuncTable::ResamplingModeToMixFlags(chn.resamplingMode);
-		functionNdx |= resamplingMode;
+		mixsample_t *pOfsR = &gnDryROfsVol;
+		mixsample_t *pOfsL = &gnDryLOfsVol;
 
 		mixsample_t *pbuffer = MixSoundBuffer;
 #ifndef NO_REVERB
-#ifdef ENABLE_MMX
-		if(GetProcSupport() & PROCSUPPORT_MMX)
+#ifdef MODPLUG_TRACKER
+		if(((m_MixerSettings.DSPMask & SNDDSP_REVERB) && !chn.dwFlags[CHN_NOREVERB]) || chn.dwFlags[CHN_REVERB])
+#else
+		// The reverb is opt-in for libopenmpt, so S99 (CHN_REVERB) must not enable it on its own.
+		if((m_MixerSettings.DSPMask & SNDDSP_REVERB) && (!chn.dwFlags[CHN_NOREVERB] || chn.dwFlags[CHN_REVERB]))
+#endif // MODPLUG_TRACKER
 		{
-			if(((m_MixerSettings.DSPMask & SNDDSP_REVERB) && !chn.dwFlags[CHN_NOREVERB]) || chn.dwFlags[CHN_REVERB])
-			{
-				pbuffer = m_Reverb.GetReverbSendBuffer(count);
-				pOfsR = &m_Reverb.gnRvbROfsVol;
-				pOfsL = &m_Reverb.gnRvbLOfsVol;
-			}
+			pbuffer = m_Reverb.GetReverbSendBuffer(count);
+			pOfsR = &m_Reverb.gnRvbROfsVol;
+			pOfsL = &m_Reverb.gnRvbLOfsVol;
 		}
-#endif
 #endif
 		if(chn.dwFlags[CHN_SURROUND] && m_MixerSettings.gnChannels > 2)
 			pbuffer = MixRearBuffer;
@@ -342,163 +343,310 @@ void CSoundFile::CreateStereoMix(int count)
 			}
 		}
 
-		// Calculate offset of loop wrap-around buffer for this sample.
-		const int8 * const samplePointer = static_cast<const int8 *>(chn.pCurrentSample);
-		const int8 * lookaheadPointer = nullptr;
-		const SmpLength lookaheadStart = chn.nLoopEnd - InterpolationMaxLookahead;
-		// We only need to apply the loop wrap-around logic if the sample is actually looping and if interpolation is applied.
-		// If there is no interpolation happening, there is no lookahead happening the sample read-out is exact.
-		if(chn.dwFlags[CHN_LOOP] && resamplingMode != MixFuncTable::ndxNoInterpolation)
+#if !defined(NO_THREADS) && defined(MPT_INTMIXER)
+		if(parallelMix && (pbuffer == MixSoundBuffer || pbuffer == MixRearBuffer))
 		{
-			const bool loopEndsAtSampleEnd = chn.pModSample->uFlags[CHN_LOOP] && chn.pModSample->nLoopEnd == chn.pModSample->nLength;
-			const bool inSustainLoop = chn.InSustainLoop();
-
-			// Do not enable wraparound magic if we're previewing a custom loop!
-			if(inSustainLoop || chn.nLoopEnd == chn.pModSample->nLoopEnd)
+			ParallelMixer::Voice voice;
+			voice.chn = &chn;
+			voice.ofsR = voice.ofsL = 0;
+			voice.rear = (pbuffer == MixRearBuffer);
+			voice.mixed = false;
+			voice.culled = false;
+			m_ParallelMixer.voices.push_back(voice);
+			continue;
+		}
+#endif // !NO_THREADS && MPT_INTMIXER
+
+		const bool mixingAllowed = (nchmixed < m_MixerSettings.m_nMaxMixChannels || !realtimeMix);
+		bool culled = false;
+		const bool mixed = MixChannel(chn, pbuffer, pOfsR, pOfsL, count, mixingAllowed, ITPingPongMode, culled);
+		if(culled)
+			numCulled++;
+		else if(mixed)
+			numMixed++;
+		if(mixed)
+		{
+			nchmixed++;
+			if(nMixPlugin > 0 && nMixPlugin <= MAX_MIXPLUGINS && m_MixPlugins[nMixPlugin - 1].pMixState)
 			{
-				SmpLength lookaheadOffset = (loopEndsAtSampleEnd ? 0 : (3 * InterpolationMaxLookahead)) + chn.pModSample->nLength - chn.nLoopEnd;
-				if(inSustainLoop)
-				{
-					lookaheadOffset += 4 * InterpolationMaxLookahead;
-				}
-				lookaheadPointer = samplePointer + lookaheadOffset * chn.pModSample->GetBytesPerSample();
+				m_MixPlugins[nMixPlugin - 1].pMixState->ResetSilence();
 			}
 		}
+	}
 
-		////////////////////////////////////////////////////
-		CHANNELINDEX naddmix = 0;
-		int nsamples = count;
-		// Keep mixing this sample until the buffer is filled.
-		do
+#if !defined(NO_THREADS) && defined(MPT_INTMIXER)
+	if(!m_ParallelMixer.voices.empty())
+	{
+		ParallelMixContext context = { this, count, ITPingPongMode };
+		m_ParallelMixer.Mix(count, ParallelMixVoices, &context);
+		m_ParallelMixer.Reduce(MixSoundBuffer, MixRearBuffer, count);
+		for(std::vector<ParallelMixer::Voice>::const_iterator voice = m_ParallelMixer.voices.begin(); voice != m_ParallelMixer.voices.end(); voice++)
 		{
-			uint32 nrampsamples = nsamples;
-			int32 nSmpCount;
-			if(chn.nRampLength > 0)
-			{
-				if (nrampsamples > chn.nRampLength) nrampsamples = chn.nRampLength;
-			}
+			gnDryROfsVol += voice->ofsR;
+			gnDryLOfsVol += voice->ofsL;
+			if(voice->mixed) nchmixed++;
+			if(voice->culled)
+				numCulled++;
+			else if(voice->mixed)
+				numMixed++;
+		}
+	}
+#endif // !NO_THREADS && MPT_INTMIXER
 
-			if((nSmpCount = GetSampleCount(chn, nrampsamples, ITPingPongMode)) <= 0)
-			{
-				// Stopping the channel
-				chn.pCurrentSample = nullptr;
-				chn.nLength = 0;
-				chn.nPos = 0;
-				chn.nPosLo = 0;
-				chn.nRampLength = 0;
-				EndChannelOfs(chn, pbuffer, nsamples);
-				*pOfsR += chn.nROfs;
-				*pOfsL += chn.nLOfs;
-				chn.nROfs = chn.nLOfs = 0;
-				chn.dwFlags.reset(CHN_PINGPONGFLAG);
-				break;
-			}
+	m_nMixStat = std::max<CHANNELINDEX>(m_nMixStat, nchmixed);
+	m_nMixedVoices = numMixed;
+	m_nCulledVoices = numCulled;
+}
 
-			// Should we mix this channel ?
-			if((nchmixed >= m_MixerSettings.m_nMaxMixChannels && realtimeMix)	// Too many channels
-				|| (!chn.nRampLength && !(chn.leftVol | chn.rightVol)))			// Channel is completely silent
-			{
-				int32 delta = BufferLengthToSamples(nSmpCount, chn);
-				chn.nPosLo = delta & 0xFFFF;
-				chn.nPos += (delta >> 16);
-				chn.nROfs = chn.nLOfs = 0;
-				pbuffer += nSmpCount * 2;
-				naddmix = 0;
-			} else
-			{
-				// Do mixing
 
-				// Loop wrap-around magic.
-				if(lookaheadPointer != nullptr)
-				{
-					const int32 readLength = BufferLengthToSamples(nSmpCount, chn) >> 16;
-					
-					chn.pCurrentSample = samplePointer;
-					if(chn.nPos >= lookaheadStart)
-					{
-						const int32 oldCount = nSmpCount;
-
-						// When going backwards - we can only go back up to lookaheadStart.
-						// When going forwards - read through the whole pre-computed wrap-around buffer if possible.
-						const int32 samplesToRead = chn.nInc < 0
-							? (chn.nPos - lookaheadStart)
-							: 2 * InterpolationMaxLookahead - (chn.nPos - lookaheadStart);
-						nSmpCount = SamplesToBufferLength(samplesToRead, chn);
-						Limit(nSmpCount, 1, oldCount);
-						chn.pCurrentSample = lookaheadPointer;
-					} else if(chn.nInc > 0 && chn.nPos + readLength >= lookaheadStart && nSmpCount > 1)
-					{
-						// We shouldn't read that far if we're not using the pre-computed wrap-around buffer.
-						const int32 oldCount = nSmpCount;
-						nSmpCount = SamplesToBufferLength(lookaheadStart - chn.nPos, chn);
-						Limit(nSmpCount, 1, oldCount - 1);
-					}
-				}
+#if !defined(NO_THREADS) && defined(MPT_INTMIXER)
+
+// Mix the voices assigned to a worker of the parallel mixer into its private buffers.
+void CSoundFile::ParallelMixVoices(void *context, ParallelMixer::Worker &worker)
+//------------------------------------------------------------------------------
+{
+	const ParallelMixContext &mixContext = *static_cast<const ParallelMixContext *>(context);
+	const CSoundFile &sndFile = *mixContext.sndFile;
+	std::vector<ParallelMixer::Voice> &voices = mixContext.sndFile->m_ParallelMixer.voices;
+	for(size_t v = worker.firstVoice; v < worker.endVoice; v++)
+	{
+		ParallelMixer::Voice &voice = voices[v];
+		voice.mixed = sndFile.MixChannel(*voice.chn, voice.rear ? worker.rearBuffer : worker.frontBuffer, &voice.ofsR, &voice.ofsL, mixContext.count, true, mixContext.ITPingPongMode, voice.culled);
+	}
+}
+
+#endif // !NO_THREADS && MPT_INTMIXER
+
+
+// Returns true if mixing the next count samples of a voice is not going to change the mix buffer because the voice only reads digital silence.
+// readLimit is the first sampling point that must not be read from the sample data.
+bool CSoundFile::IsVoiceSegmentSilent(const ModChannel &chn, int32 count, SmpLength readLimit) const
+//--------------------------------------------------------------------------------------------------
+{
+	if(chn.pModSample == nullptr || chn.pCurrentSample != chn.pModSample->pSample)
+	{
+		return false;
+	}
+	// A resonant filter keeps ringing after the input became silent
+	if(chn.dwFlags[CHN_FILTER] && (chn.nFilter_Y[0][0] | chn.nFilter_Y[0][1] | chn.nFilter_Y[1][0] | chn.nFilter_Y[1][1]) != 0)
+	{
+		return false;
+	}
+	// Range of sampling points that the interpolators might read
+	const int32 lastPos = static_cast<int32>(chn.nPos) + (((count - 1) * chn.nInc + static_cast<int32>(chn.nPosLo)) >> 16);
+	const int32 first = std::min(static_cast<int32>(chn.nPos), lastPos) - static_cast<int32>(InterpolationMaxLookahead);
+	const int32 last = std::max(static_cast<int32>(chn.nPos), lastPos) + static_cast<int32>(InterpolationMaxLookahead);
+	if(last >= static_cast<int32>(readLimit))
+	{
+		return false;
+	}
+	// The sampling points before the sample start repeat the first sampling point (see ctrlSmp::PrecomputeLoops)
+	return IsSampleRangeSilent(*chn.pModSample, std::max(first, int32(0)), last);
+}
+
 
+// Mix a single voice into the given buffer. If the voice stops playing, its click removal offset is added to *pOfsR and *pOfsL.
+// If mixingAllowed is false, the voice is advanced without being mixed. Returns true if the voice has been mixed.
+// Parts of the voice that are silent (zero volume or digital silence) are skipped while keeping the voice state exact.
+// culled is set to true if the whole voice has been skipped because of that.
+// Apart from the voice itself, this function does not modify any state, so different voices can be mixed concurrently.
+bool CSoundFile::MixChannel(ModChannel &chn, mixsample_t *pbuffer, mixsample_t *pOfsR, mixsample_t *pOfsL, int count, bool mixingAllowed, bool ITPingPongMode, bool &culled) const
+//----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	uint32 functionNdx = 0;
+	if(chn.dwFlags[CHN_16BIT]) functionNdx |= MixFuncTable::ndx16Bit;
+	if(chn.dwFlags[CHN_STEREO]) functionNdx |= MixFuncTable::ndxStereo;
+#ifndef NO_FILTER
+	if(chn.dwFlags[CHN_FILTER]) functionNdx |= MixFuncTable::ndxFilter;
+#endif
 
-				mixsample_t *pbufmax = pbuffer + (nSmpCount * 2);
-				chn.nROfs = - *(pbufmax-2);
-				chn.nLOfs = - *(pbufmax-1);
+	const MixFuncTable::ResamplingIndex resamplingMode = MixFuncTable::ResamplingModeToMixFlags(chn.resamplingMode);
+	const MixFuncInterface *mixFunctions = MixFuncTable::Functions + resamplingMode;
+#if defined(MPT_INTMIXER) && defined(ENABLE_SSE4)
+	// Use the vectorized interpolators if the CPU supports them
+	const MixFuncInterface *simdFunctions = MixFuncTable::GetSIMDFunctions(chn.resamplingMode);
+	if(simdFunctions != nullptr)
+	{
+		mixFunctions = simdFunctions;
+	}
+#endif // MPT_INTMIXER && ENABLE_SSE4
+
+	// Calculate offset of loop wrap-around buffer for this sample.
+	const int8 * const samplePointer = static_cast<const int8 *>(chn.pCurrentSample);
+	const int8 * lookaheadPointer = nullptr;
+	const SmpLength lookaheadStart = chn.nLoopEnd - InterpolationMaxLookahead;
+	// We only need to apply the loop wrap-around logic if the sample is actually looping and if interpolation is applied.
+	// If there is no interpolation happening, there is no lookahead happening the sample read-out is exact.
+	if(chn.dwFlags[CHN_LOOP] && resamplingMode != MixFuncTable::ndxNoInterpolation)
+	{
+		const bool loopEndsAtSampleEnd = chn.pModSample->uFlags[CHN_LOOP] && chn.pModSample->nLoopEnd == chn.pModSample->nLength;
+		const bool inSustainLoop = chn.InSustainLoop();
 
-				uint32 targetpos = chn.nPos + (BufferLengthToSamples(nSmpCount, chn) >> 16);
-				MixFuncTable::Functions[functionNdx | (chn.nRampLength ? MixFuncTable::ndxRamp : 0)](chn, m_Resampler, pbuffer, nSmpCount);
-				MPT_ASSERT(chn.nPos == targetpos);
+		// Do not enable wraparound magic if we're previewing a custom loop!
+		if(inSustainLoop || chn.nLoopEnd == chn.pModSample->nLoopEnd)
+		{
+			SmpLength lookaheadOffset = (loopEndsAtSampleEnd ? 0 : (3 * InterpolationMaxLookahead)) + chn.pModSample->nLength - chn.nLoopEnd;
+			if(inSustainLoop)
+			{
+				lookaheadOffset += 4 * InterpolationMaxLookahead;
+			}
+			lookaheadPointer = samplePointer + lookaheadOffset * chn.pModSample->GetBytesPerSample();
+		}
+	}
+
+	const bool cullSilentVoices = !(m_MixerSettings.MixerFlags & SNDMIX_NOVOICECULLING);
+	const SmpLength readLimit = (lookaheadPointer != nullptr) ? lookaheadStart : (chn.pModSample != nullptr ? chn.pModSample->nLength : 0);
+
+	////////////////////////////////////////////////////
+	bool naddmix = false;
+	bool mixedAny = false, culledAny = false;
+	int nsamples = count;
+	// Keep mixing this sample until the buffer is filled.
+	do
+	{
+		uint32 nrampsamples = nsamples;
+		int32 nSmpCount;
+		if(chn.nRampLength > 0)
+		{
+			if (nrampsamples > chn.nRampLength) nrampsamples = chn.nRampLength;
+		}
+
+		if((nSmpCount = GetSampleCount(chn, nrampsamples, ITPingPongMode)) <= 0)
+		{
+			// Stopping the channel
+			chn.pCurrentSample = nullptr;
+			chn.nLength = 0;
+			chn.nPos = 0;
+			chn.nPosLo = 0;
+			chn.nRampLength = 0;
+			EndChannelOfs(chn, pbuffer, nsamples);
+			*pOfsR += chn.nROfs;
+			*pOfsL += chn.nLOfs;
+			chn.nROfs = chn.nLOfs = 0;
+			chn.dwFlags.reset(CHN_PINGPONGFLAG);
+			break;
+		}
 
-				chn.nROfs += *(pbufmax-2);
-				chn.nLOfs += *(pbufmax-1);
-				pbuffer = pbufmax;
-				naddmix = 1;
+		// Should we mix this channel ?
+		if(!mixingAllowed	// Too many channels
+			|| (!chn.nRampLength && !(chn.leftVol | chn.rightVol)))			// Channel is completely silent
+		{
+			int32 delta = BufferLengthToSamples(nSmpCount, chn);
+			chn.nPosLo = delta & 0xFFFF;
+			chn.nPos += (delta >> 16);
+			chn.nROfs = chn.nLOfs = 0;
+			pbuffer += nSmpCount * 2;
+			naddmix = false;
+			culledAny |= mixingAllowed;
+		} else if(cullSilentVoices && IsVoiceSegmentSilent(chn, nSmpCount, readLimit))
+		{
+			// The voice only reads digital silence, so mixing it would not change the mix buffer.
+			// Advance it exactly like the mixer would, including the volume ramp.
+			int32 delta = BufferLengthToSamples(nSmpCount, chn);
+			chn.nPosLo = delta & 0xFFFF;
+			chn.nPos += (delta >> 16);
+			if(chn.nRampLength)
+			{
+				chn.rampLeftVol += chn.leftRamp * nSmpCount;
+				chn.rampRightVol += chn.rightRamp * nSmpCount;
+				chn.leftVol = chn.rampLeftVol >> VOLUMERAMPPRECISION;
+				chn.rightVol = chn.rampRightVol >> VOLUMERAMPPRECISION;
 			}
-			nsamples -= nSmpCount;
-			if (chn.nRampLength)
+			chn.nROfs = chn.nLOfs = 0;
+			pbuffer += nSmpCount * 2;
+			// Still counts as a mixed voice (e.g. for the song end detection)
+			naddmix = true;
+			culledAny = true;
+		} else
+		{
+			// Do mixing
+
+			// Loop wrap-around magic.
+			if(lookaheadPointer != nullptr)
 			{
-				if (chn.nRampLength <= static_cast<uint32>(nSmpCount))
+				const int32 readLength = BufferLengthToSamples(nSmpCount, chn) >> 16;
+				
+				chn.pCurrentSample = samplePointer;
+				if(chn.nPos >= lookaheadStart)
 				{
-					// Ramping is done
-					chn.nRampLength = 0;
-					chn.leftVol = chn.newLeftVol;
-					chn.rightVol = chn.newRightVol;
-					chn.rightRamp = chn.leftRamp = 0;
-					if(chn.dwFlags[CHN_NOTEFADE] && !chn.nFadeOutVol)
-					{
-						chn.nLength = 0;
-						chn.pCurrentSample = nullptr;
-					}
-				} else
+					const int32 oldCount = nSmpCount;
+
+					// When going backwards - we can only go back up to lookaheadStart.
+					// When going forwards - read through the whole pre-computed wrap-around buffer if possible.
+					const int32 samplesToRead = chn.nInc < 0
+						? (chn.nPos - lookaheadStart)
+						: 2 * InterpolationMaxLookahead - (chn.nPos - lookaheadStart);
+					nSmpCount = SamplesToBufferLength(samplesToRead, chn);
+					Limit(nSmpCount, 1, oldCount);
+					chn.pCurrentSample = lookaheadPointer;
+				} else if(chn.nInc > 0 && chn.nPos + readLength >= lookaheadStart && nSmpCount > 1)
 				{
-					chn.nRampLength -= nSmpCount;
+					// We shouldn't read that far if we're not using the pre-computed wrap-around buffer.
+					const int32 oldCount = nSmpCount;
+					nSmpCount = SamplesToBufferLength(lookaheadStart - chn.nPos, chn);
+					Limit(nSmpCount, 1, oldCount - 1);
 				}
 			}
 
-			// ProTracker compatibility: Instrument changes without a note do not happen instantly, but rather when the sample loop has finished playing.
-			// Test case: PTInstrSwap.mod
-			if(m_SongFlags[SONG_PT1XMODE] && chn.nPos >= chn.nLoopEnd && chn.dwFlags[CHN_LOOP] && chn.nNewIns && chn.nNewIns <= GetNumSamples() && chn.pModSample != &Samples[chn.nNewIns])
+
+			mixsample_t *pbufmax = pbuffer + (nSmpCount * 2);
+			chn.nROfs = - *(pbufmax-2);
+			chn.nLOfs = - *(pbufmax-1);
+
+			uint32 targetpos = chn.nPos + (BufferLengthToSamples(nSmpCount, chn) >> 16);
+			mixFunctions[functionNdx | (chn.nRampLength ? MixFuncTable::ndxRamp : 0)](chn, m_Resampler, pbuffer, nSmpCount);
+			MPT_ASSERT(chn.nPos == targetpos);
+
+			chn.nROfs += *(pbufmax-2);
+			chn.nLOfs += *(pbufmax-1);
+			pbuffer = pbufmax;
+			naddmix = true;
+			mixedAny = true;
+		}
+		nsamples -= nSmpCount;
+		if (chn.nRampLength)
+		{
+			if (chn.nRampLength <= static_cast<uint32>(nSmpCount))
 			{
-				const ModSample &smp = Samples[chn.nNewIns];
-				chn.pModSample = &smp;
-				chn.pCurrentSample = smp.pSample;
-				chn.dwFlags = (chn.dwFlags & CHN_CHANNELFLAGS) | smp.uFlags;
-				chn.nLoopStart = smp.nLoopStart;
-				chn.nLoopEnd = smp.nLoopEnd;
-				chn.nLength = smp.uFlags[CHN_LOOP] ? smp.nLoopEnd : smp.nLength;
-				chn.nPos = chn.nLoopStart;
-				if(!chn.pCurrentSample)
+				// Ramping is done
+				chn.nRampLength = 0;
+				chn.leftVol = chn.newLeftVol;
+				chn.rightVol = chn.newRightVol;
+				chn.rightRamp = chn.leftRamp = 0;
+				if(chn.dwFlags[CHN_NOTEFADE] && !chn.nFadeOutVol)
 				{
-					break;
+					chn.nLength = 0;
+					chn.pCurrentSample = nullptr;
 				}
+			} else
+			{
+				chn.nRampLength -= nSmpCount;
 			}
-		} while(nsamples > 0);
+		}
 
-		// Restore sample pointer in case it got changed through loop wrap-around
-		chn.pCurrentSample = samplePointer;
-		nchmixed += naddmix;
-	
-		if(naddmix && nMixPlugin > 0 && nMixPlugin <= MAX_MIXPLUGINS && m_MixPlugins[nMixPlugin - 1].pMixState)
+		// ProTracker compatibility: Instrument changes without a note do not happen instantly, but rather when the sample loop has finished playing.
+		// Test case: PTInstrSwap.mod
+		if(m_SongFlags[SONG_PT1XMODE] && chn.nPos >= chn.nLoopEnd && chn.dwFlags[CHN_LOOP] && chn.nNewIns && chn.nNewIns <= GetNumSamples() && chn.pModSample != &Samples[chn.nNewIns])
 		{
-			m_MixPlugins[nMixPlugin - 1].pMixState->ResetSilence();
+			const ModSample &smp = Samples[chn.nNewIns];
+			chn.pModSample = &smp;
+			chn.pCurrentSample = smp.pSample;
+			chn.dwFlags = (chn.dwFlags & CHN_CHANNELFLAGS) | smp.uFlags;
+			chn.nLoopStart = smp.nLoopStart;
+			chn.nLoopEnd = smp.nLoopEnd;
+			chn.nLength = smp.uFlags[CHN_LOOP] ? smp.nLoopEnd : smp.nLength;
+			chn.nPos = chn.nLoopStart;
+			if(!chn.pCurrentSample)
+			{
+				break;
+			}
 		}
-	}
-	m_nMixStat = std::max<CHANNELINDEX>(m_nMixStat, nchmixed);
+	} while(nsamples > 0);
+
+	// Restore sample pointer in case it got changed through loop wrap-around
+	chn.pCurrentSample = samplePointer;
+	culled = culledAny && !mixedAny;
+	return naddmix;
 }
 
 
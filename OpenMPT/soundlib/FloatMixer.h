@@ -40,14 +40,19 @@ typedef IntToFloatTraits<2, 2, mixsample_t, int16, -int16_min> Int16SToFloatS;
 template<class Traits>
 struct LinearInterpolation
 {
-	forceinline void Start(const ModChannel &, const CResampler &) { }
+	const typename Traits::output_t *linearTable;
+
+	forceinline void Start(const ModChannel &, const CResampler &resampler)
+	{
+		linearTable = resampler.LinearTablef;
+	}
 
 	forceinline void End(const ModChannel &) { }
 
 	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
 	{
 		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
-		const Traits::output_t fract = CResampler::LinearTablef[posLo >> 8];
+		const Traits::output_t fract = linearTable[posLo >> 8];
 
 		for(int i = 0; i < Traits::numChannelsIn; i++)
 		{
@@ -63,13 +68,18 @@ struct LinearInterpolation
 template<class Traits>
 struct FastSincInterpolation
 {
-	forceinline void Start(const ModChannel &, const CResampler &) { }
+	const typename Traits::output_t *sincTable;
+
+	forceinline void Start(const ModChannel &, const CResampler &resampler)
+	{
+		sincTable = resampler.FastSincTablef;
+	}
 	forceinline void End(const ModChannel &) { }
 
 	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
 	{
 		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
-		const Traits::output_t *lut = CResampler::FastSincTablef + ((posLo >> 6) & 0x3FC);
+		const Traits::output_t *lut = sincTable + ((posLo >> 6) & 0x3FC);
 
 		for(int i = 0; i < Traits::numChannelsIn; i++)
 		{
@@ -124,7 +134,7 @@ struct FIRFilterInterpolation
 
 	forceinline void Start(const ModChannel &, const CResampler &resampler)
 	{
-		WFIRlut = resampler.m_WindowedFIR.lut;
+		WFIRlut = resampler.m_WindowedFIR->lut;
 	}
 
 	forceinline void End(const ModChannel &) { }
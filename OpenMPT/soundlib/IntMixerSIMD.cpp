@@ -0,0 +1,417 @@
+/*
+ * IntMixerSIMD.cpp
+ * ----------------
+ * Purpose: SSE4.1 and AVX2 versions of the fixed point sinc and FIR interpolators.
+ * Notes  : The interpolators compute a whole block of sampling points at once (see BlockSampleLoop),
+ *          the filter and mix functors are the same as for the scalar mixer.
+ *          _mm_madd_epi16 computes the same 16x16 bit products and 32-bit sums as the scalar code in IntMixer.h,
+ *          so the output is bit-identical to the scalar interpolators.
+ *          The SIMD code is compiled using function-specific target attributes, so this file does not
+ *          require any special compiler flags and the CPU features are only used if GetProcSupport() reports them.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+#include "Sndfile.h"
+#include "IntMixerSIMD.h"
+
+#if defined(MPT_INTMIXER) && defined(ENABLE_SSE4)
+
+#include "IntMixer.h"
+#include "Resampler.h"
+#include "../common/misc_util.h"
+#include <cstring>
+#ifdef ENABLE_AVX2
+#include <immintrin.h>
+#else
+#include <smmintrin.h>
+#endif
+
+
+OPENMPT_NAMESPACE_BEGIN
+
+
+namespace MixFuncTable
+{
+
+
+//////////////////////////////////////////////////////////////////////////
+// Tap positions and lookup tables, see the scalar interpolators in IntMixer.h
+
+struct FastSincTaps
+{
+	enum { numTaps = 4, tapsBefore = 1, shift = 14, halfSums = false };
+	const int16 *table;
+
+	forceinline void Start(const ModChannel &, const CResampler &)
+	{
+		table = CResampler::FastSincTable;
+	}
+
+	forceinline const int16 *GetLUT(const int32 posLo) const { return table + ((posLo >> 6) & 0x3FC); }
+};
+
+
+struct PolyphaseTaps
+{
+	enum { numTaps = 8, tapsBefore = 3, shift = SINC_QUANTSHIFT, halfSums = false };
+	const SINC_TYPE *table;
+
+	forceinline void Start(const ModChannel &chn, const CResampler &resampler)
+	{
+		table = (((chn.nInc > 0x13000) || (chn.nInc < -0x13000)) ?
+			(((chn.nInc > 0x18000) || (chn.nInc < -0x18000)) ? resampler.gDownsample2x : resampler.gDownsample13x) : resampler.gKaiserSinc);
+	}
+
+	forceinline const int16 *GetLUT(const int32 posLo) const { return table + ((posLo >> (16 - SINC_PHASES_BITS)) & SINC_MASK) * SINC_WIDTH; }
+};
+
+
+// The FIR interpolator sums up both halves of the filter separately and halves them before adding them together
+struct FIRFilterTaps
+{
+	enum { numTaps = 8, tapsBefore = 3, shift = WFIR_16BITSHIFT, halfSums = true };
+	const WFIR_TYPE *table;
+
+	forceinline void Start(const ModChannel &, const CResampler &resampler)
+	{
+		table = resampler.m_WindowedFIR->lut;
+	}
+
+	forceinline const int16 *GetLUT(const int32 posLo) const { return table + (((posLo + WFIR_FRACHALVE) >> WFIR_FRACSHIFT) & WFIR_FRACMASK); }
+};
+
+STATIC_ASSERT(sizeof(SINC_TYPE) == sizeof(int16));
+STATIC_ASSERT(sizeof(WFIR_TYPE) == sizeof(int16));
+STATIC_ASSERT(SINC_WIDTH == 8 && WFIR_WIDTH == 8);
+
+
+//////////////////////////////////////////////////////////////////////////
+// SSE4.1
+
+// Load 4 or 8 consecutive sample values and convert them to 16-bit (the equivalent of Traits::Convert)
+static forceinline MPT_TARGET_SSE4 __m128i Load4SSE4(const int8 *p)
+{
+	int32 v;
+	std::memcpy(&v, p, sizeof(v));
+	return _mm_slli_epi16(_mm_cvtepi8_epi16(_mm_cvtsi32_si128(v)), 8);
+}
+
+static forceinline MPT_TARGET_SSE4 __m128i Load4SSE4(const int16 *p)
+{
+	return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+}
+
+static forceinline MPT_TARGET_SSE4 __m128i Load8SSE4(const int8 *p)
+{
+	return _mm_slli_epi16(_mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))), 8);
+}
+
+static forceinline MPT_TARGET_SSE4 __m128i Load8SSE4(const int16 *p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+
+// Sort interleaved stereo samples L0 R0 L1 R1 L2 R2 L3 R3 into L0 L1 R0 R1 L2 L3 R2 R3, so that _mm_madd_epi16 sums up samples of the same channel.
+static forceinline MPT_TARGET_SSE4 __m128i DeinterleaveSSE4(const __m128i x)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+
+// Multiply the sample values of one sampling point with the filter taps.
+// m0 receives the products of the first four taps and m1 those of the last four taps, summed up in pairs:
+// Mono: p01 p23 x x, Stereo: L01 R01 L23 R23
+template<int numChannels, int numTaps, typename T>
+static forceinline MPT_TARGET_SSE4 void MultiplyTapsSSE4(const T *in, const int16 *lut, __m128i &m0, __m128i &m1)
+{
+	if(numChannels == 1 && numTaps == 4)
+	{
+		m0 = _mm_madd_epi16(Load4SSE4(in), _mm_loadl_epi64(reinterpret_cast<const __m128i *>(lut)));
+		m1 = _mm_setzero_si128();
+	} else if(numChannels == 1)
+	{
+		m0 = _mm_madd_epi16(Load8SSE4(in), _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut)));
+		m1 = _mm_srli_si128(m0, 8);
+	} else if(numTaps == 4)
+	{
+		const __m128i taps = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(lut));
+		m0 = _mm_madd_epi16(DeinterleaveSSE4(Load8SSE4(in)), _mm_shuffle_epi32(taps, _MM_SHUFFLE(1, 1, 0, 0)));
+		m1 = _mm_setzero_si128();
+	} else
+	{
+		const __m128i taps = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut));
+		m0 = _mm_madd_epi16(DeinterleaveSSE4(Load8SSE4(in)), _mm_shuffle_epi32(taps, _MM_SHUFFLE(1, 1, 0, 0)));
+		m1 = _mm_madd_epi16(DeinterleaveSSE4(Load8SSE4(in + 8)), _mm_shuffle_epi32(taps, _MM_SHUFFLE(3, 3, 2, 2)));
+	}
+}
+
+
+// Add up the pairs computed by MultiplyTaps. The result is in element 0 (mono) or 0 and 1 (stereo).
+template<int numChannels>
+static forceinline MPT_TARGET_SSE4 __m128i PairSumSSE4(const __m128i m)
+{
+	return _mm_add_epi32(m, numChannels == 1 ? _mm_srli_si128(m, 4) : _mm_srli_si128(m, 8));
+}
+
+
+template<class Taps, int numChannels>
+static forceinline MPT_TARGET_SSE4 __m128i ReduceSSE4(const __m128i m0, const __m128i m1)
+{
+	if(Taps::halfSums)
+	{
+		return _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(PairSumSSE4<numChannels>(m0), 1), _mm_srai_epi32(PairSumSSE4<numChannels>(m1), 1)), Taps::shift - 1);
+	} else
+	{
+		return _mm_srai_epi32(PairSumSSE4<numChannels>(_mm_add_epi32(m0, m1)), Taps::shift);
+	}
+}
+
+
+template<int numChannels>
+static forceinline MPT_TARGET_SSE4 void StoreSSE4(mixsample_t *out, const __m128i v)
+{
+	if(numChannels == 1)
+	{
+		out[0] = _mm_cvtsi128_si32(v);
+	} else
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(out), v);
+	}
+}
+
+
+template<class Traits, class Taps>
+static forceinline MPT_TARGET_SSE4 void InterpolateOneSSE4(typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 smpPos, const Taps &taps)
+{
+	__m128i m0, m1;
+	MultiplyTapsSSE4<Traits::numChannelsIn, Taps::numTaps>(inBuffer + ((smpPos >> 16) - Taps::tapsBefore) * Traits::numChannelsIn, taps.GetLUT(smpPos & 0xFFFF), m0, m1);
+	StoreSSE4<Traits::numChannelsIn>(outSample, ReduceSSE4<Taps, Traits::numChannelsIn>(m0, m1));
+}
+
+
+template<class Traits, class Taps>
+static MPT_TARGET_SSE4 void InterpolateSSE4(typename Traits::outbuf_t *outSamples, const typename Traits::input_t * const inBuffer, int32 smpPos, const int32 increment, const int numSamples, const Taps &taps)
+{
+	for(int i = 0; i < numSamples; i++)
+	{
+		InterpolateOneSSE4<Traits>(outSamples[i], inBuffer, smpPos, taps);
+		smpPos += increment;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// AVX2: Two sampling points are computed at once, one in each 128-bit lane.
+
+#ifdef ENABLE_AVX2
+
+static forceinline MPT_TARGET_AVX2 __m256i CombineAVX2(const __m128i lo, const __m128i hi)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+
+static forceinline MPT_TARGET_AVX2 __m256i DeinterleaveAVX2(const __m256i x)
+{
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+
+// Same as MultiplyTapsSSE4, for two sampling points
+template<int numChannels, int numTaps, typename T>
+static forceinline MPT_TARGET_AVX2 void MultiplyTapsAVX2(const T *in0, const T *in1, const int16 *lut0, const int16 *lut1, __m256i &m0, __m256i &m1)
+{
+	if(numChannels == 1 && numTaps == 4)
+	{
+		m0 = _mm256_madd_epi16(CombineAVX2(Load4SSE4(in0), Load4SSE4(in1)),
+			CombineAVX2(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(lut0)), _mm_loadl_epi64(reinterpret_cast<const __m128i *>(lut1))));
+		m1 = _mm256_setzero_si256();
+	} else if(numChannels == 1)
+	{
+		m0 = _mm256_madd_epi16(CombineAVX2(Load8SSE4(in0), Load8SSE4(in1)),
+			CombineAVX2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lut0)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut1))));
+		m1 = _mm256_srli_si256(m0, 8);
+	} else if(numTaps == 4)
+	{
+		const __m256i taps = CombineAVX2(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(lut0)), _mm_loadl_epi64(reinterpret_cast<const __m128i *>(lut1)));
+		m0 = _mm256_madd_epi16(DeinterleaveAVX2(CombineAVX2(Load8SSE4(in0), Load8SSE4(in1))), _mm256_shuffle_epi32(taps, _MM_SHUFFLE(1, 1, 0, 0)));
+		m1 = _mm256_setzero_si256();
+	} else
+	{
+		const __m256i taps = CombineAVX2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lut0)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(lut1)));
+		m0 = _mm256_madd_epi16(DeinterleaveAVX2(CombineAVX2(Load8SSE4(in0), Load8SSE4(in1))), _mm256_shuffle_epi32(taps, _MM_SHUFFLE(1, 1, 0, 0)));
+		m1 = _mm256_madd_epi16(DeinterleaveAVX2(CombineAVX2(Load8SSE4(in0 + 8), Load8SSE4(in1 + 8))), _mm256_shuffle_epi32(taps, _MM_SHUFFLE(3, 3, 2, 2)));
+	}
+}
+
+
+template<int numChannels>
+static forceinline MPT_TARGET_AVX2 __m256i PairSumAVX2(const __m256i m)
+{
+	return _mm256_add_epi32(m, numChannels == 1 ? _mm256_srli_si256(m, 4) : _mm256_srli_si256(m, 8));
+}
+
+
+template<class Taps, int numChannels>
+static forceinline MPT_TARGET_AVX2 __m256i ReduceAVX2(const __m256i m0, const __m256i m1)
+{
+	if(Taps::halfSums)
+	{
+		return _mm256_srai_epi32(_mm256_add_epi32(_mm256_srai_epi32(PairSumAVX2<numChannels>(m0), 1), _mm256_srai_epi32(PairSumAVX2<numChannels>(m1), 1)), Taps::shift - 1);
+	} else
+	{
+		return _mm256_srai_epi32(PairSumAVX2<numChannels>(_mm256_add_epi32(m0, m1)), Taps::shift);
+	}
+}
+
+
+template<class Traits, class Taps>
+static MPT_TARGET_AVX2 void InterpolateAVX2(typename Traits::outbuf_t *outSamples, const typename Traits::input_t * const inBuffer, int32 smpPos, const int32 increment, const int numSamples, const Taps &taps)
+{
+	int i = 0;
+	for(; i + 1 < numSamples; i += 2)
+	{
+		const int32 smpPos1 = smpPos + increment;
+		__m256i m0, m1;
+		MultiplyTapsAVX2<Traits::numChannelsIn, Taps::numTaps>(
+			inBuffer + ((smpPos >> 16) - Taps::tapsBefore) * Traits::numChannelsIn,
+			inBuffer + ((smpPos1 >> 16) - Taps::tapsBefore) * Traits::numChannelsIn,
+			taps.GetLUT(smpPos & 0xFFFF), taps.GetLUT(smpPos1 & 0xFFFF), m0, m1);
+		const __m256i result = ReduceAVX2<Taps, Traits::numChannelsIn>(m0, m1);
+		StoreSSE4<Traits::numChannelsIn>(outSamples[i], _mm256_castsi256_si128(result));
+		StoreSSE4<Traits::numChannelsIn>(outSamples[i + 1], _mm256_extracti128_si256(result, 1));
+		smpPos = smpPos1 + increment;
+	}
+	if(i < numSamples)
+	{
+		InterpolateOneSSE4<Traits>(outSamples[i], inBuffer, smpPos, taps);
+	}
+	_mm256_zeroupper();
+}
+
+#endif // ENABLE_AVX2
+
+
+//////////////////////////////////////////////////////////////////////////
+// Interpolation functors for BlockSampleLoop
+
+template<class Traits, class Taps>
+struct SSE4Interpolation
+{
+	Taps taps;
+
+	forceinline void Start(const ModChannel &chn, const CResampler &resampler) { taps.Start(chn, resampler); }
+	forceinline void End(const ModChannel &) { }
+
+	forceinline void operator() (typename Traits::outbuf_t *outSamples, const typename Traits::input_t * const inBuffer, const int32 smpPos, const int32 increment, const int numSamples)
+	{
+		InterpolateSSE4<Traits>(outSamples, inBuffer, smpPos, increment, numSamples, taps);
+	}
+};
+
+template<class Traits> struct FastSincSSE4 : public SSE4Interpolation<Traits, FastSincTaps> { };
+template<class Traits> struct PolyphaseSSE4 : public SSE4Interpolation<Traits, PolyphaseTaps> { };
+template<class Traits> struct FIRFilterSSE4 : public SSE4Interpolation<Traits, FIRFilterTaps> { };
+
+#ifdef ENABLE_AVX2
+
+template<class Traits, class Taps>
+struct AVX2Interpolation
+{
+	Taps taps;
+
+	forceinline void Start(const ModChannel &chn, const CResampler &resampler) { taps.Start(chn, resampler); }
+	forceinline void End(const ModChannel &) { }
+
+	forceinline void operator() (typename Traits::outbuf_t *outSamples, const typename Traits::input_t * const inBuffer, const int32 smpPos, const int32 increment, const int numSamples)
+	{
+		InterpolateAVX2<Traits>(outSamples, inBuffer, smpPos, increment, numSamples, taps);
+	}
+};
+
+template<class Traits> struct FastSincAVX2 : public AVX2Interpolation<Traits, FastSincTaps> { };
+template<class Traits> struct PolyphaseAVX2 : public AVX2Interpolation<Traits, PolyphaseTaps> { };
+template<class Traits> struct FIRFilterAVX2 : public AVX2Interpolation<Traits, FIRFilterTaps> { };
+
+#endif // ENABLE_AVX2
+
+
+//////////////////////////////////////////////////////////////////////////
+// Mix function tables, same layout as in Fastmix.cpp
+
+typedef Int8MToIntS I8M;
+typedef Int16MToIntS I16M;
+typedef Int8SToIntS I8S;
+typedef Int16SToIntS I16S;
+
+#define BuildMixFuncTableRamp(resampling, filter, ramp) \
+	BlockSampleLoop<I8M, resampling<I8M>, filter<I8M>, MixMono ## ramp<I8M> >, \
+	BlockSampleLoop<I16M, resampling<I16M>, filter<I16M>, MixMono ## ramp<I16M> >, \
+	BlockSampleLoop<I8S, resampling<I8S>, filter<I8S>, MixStereo ## ramp<I8S> >, \
+	BlockSampleLoop<I16S, resampling<I16S>, filter<I16S>, MixStereo ## ramp<I16S> >
+
+#define BuildMixFuncTableFilter(resampling, filter) \
+	BuildMixFuncTableRamp(resampling, filter, NoRamp), \
+	BuildMixFuncTableRamp(resampling, filter, Ramp)
+
+#define BuildMixFuncTable(resampling) \
+	BuildMixFuncTableFilter(resampling, NoFilter), \
+	BuildMixFuncTableFilter(resampling, ResonantFilter)
+
+static const MixFuncInterface FunctionsSSE4[3 * 16] =
+{
+	BuildMixFuncTable(FastSincSSE4),	// Fast Sinc (Cubic Spline) SRC
+	BuildMixFuncTable(PolyphaseSSE4),	// Kaiser SRC
+	BuildMixFuncTable(FIRFilterSSE4),	// FIR SRC
+};
+
+#ifdef ENABLE_AVX2
+static const MixFuncInterface FunctionsAVX2[3 * 16] =
+{
+	BuildMixFuncTable(FastSincAVX2),	// Fast Sinc (Cubic Spline) SRC
+	BuildMixFuncTable(PolyphaseAVX2),	// Kaiser SRC
+	BuildMixFuncTable(FIRFilterAVX2),	// FIR SRC
+};
+#endif // ENABLE_AVX2
+
+#undef BuildMixFuncTableRamp
+#undef BuildMixFuncTableFilter
+#undef BuildMixFuncTable
+
+
+const MixFuncInterface *GetSIMDFunctions(uint8 resamplingMode)
+//-------------------------------------------------------------
+{
+	size_t offset;
+	switch(resamplingMode)
+	{
+	case SRCMODE_SPLINE:    offset = 0 * 16; break;
+	case SRCMODE_POLYPHASE: offset = 1 * 16; break;
+	case SRCMODE_FIRFILTER: offset = 2 * 16; break;
+	default: return nullptr;
+	}
+
+#ifdef ENABLE_AVX2
+	if(GetProcSupport() & PROCSUPPORT_AVX2)
+	{
+		return FunctionsAVX2 + offset;
+	}
+#endif // ENABLE_AVX2
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return FunctionsSSE4 + offset;
+	}
+	return nullptr;
+}
+
+
+} // namespace MixFuncTable
+
+
+OPENMPT_NAMESPACE_END
+
+#endif // MPT_INTMIXER && ENABLE_SSE4
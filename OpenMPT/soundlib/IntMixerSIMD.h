@@ -0,0 +1,31 @@
+/*
+ * IntMixerSIMD.h
+ * --------------
+ * Purpose: SSE4.1 and AVX2 versions of the fixed point sinc and FIR interpolators.
+ * Notes  : See implementation file.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#include "Mixer.h"
+#include "MixerInterface.h"
+
+OPENMPT_NAMESPACE_BEGIN
+
+#if defined(MPT_INTMIXER) && defined(ENABLE_SSE4)
+
+namespace MixFuncTable
+{
+
+// Returns the 16 vectorized mix functions (laid out like the table in Fastmix.cpp) for the given resampling mode,
+// or nullptr if there are no vectorized functions for this mode or the CPU does not support them.
+const MixFuncInterface *GetSIMDFunctions(uint8 resamplingMode);
+
+} // namespace MixFuncTable
+
+#endif // MPT_INTMIXER && ENABLE_SSE4
+
+OPENMPT_NAMESPACE_END
@@ -633,7 +633,12 @@ bool CSoundFile::ReadIT(FileReader &file, ModLoadingFlags loadFlags)
 				{
 					if(!sample.uFlags[SMP_KEEPONDISK])
 					{
-						sampleHeader.GetSampleFormat(fileHeader.cwtv).ReadSample(sample, file);
+						const SampleIO sampleIO = sampleHeader.GetSampleFormat(fileHeader.cwtv);
+						const bool compressed = (sampleIO.GetEncoding() == SampleIO::IT214 || sampleIO.GetEncoding() == SampleIO::IT215);
+						if(!(loadFlags & decodeSamplesLazily) || !compressed || !DeferSampleDecoding(i + 1, sampleIO, file))
+						{
+							sampleIO.ReadSample(sample, file);
+						}
 					} else
 					{
 						// External sample in MPTM file
@@ -666,6 +671,19 @@ bool CSoundFile::ReadIT(FileReader &file, ModLoadingFlags loadFlags)
 #endif // MPT_EXTERNAL_SAMPLES
 					}
 					lastSampleOffset = std::max(lastSampleOffset, file.GetPosition());
+				} else if(!(loadFlags & loadSampleData) && file.Seek(sampleOffset))
+				{
+					// Don't decode the sample, but we still need to know where its data ends to find the extensions following it.
+					if(!sample.uFlags[SMP_KEEPONDISK])
+					{
+						file.Skip(sampleHeader.GetSampleFormat(fileHeader.cwtv).CalculateEncodedSize(sample.nLength, file));
+					} else
+					{
+						size_t strLen;
+						file.ReadVarInt(strLen);
+						file.Skip(strLen);
+					}
+					lastSampleOffset = std::max(lastSampleOffset, file.GetPosition());
 				}
 			}
 		}
@@ -101,7 +101,54 @@ static void SampleLoop(ModChannel &chn, const CResampler &resampler, typename Tr
 	c.nPosLo = smpPos & 0xFFFF;
 }
 
-// Type of the SampleLoop function above
+// Variant of SampleLoop for interpolation functors that compute several sampling points at once (e.g. using SIMD instructions).
+// The interpolated samples are computed in blocks and then passed through the filter and mix functors one by one.
+// InterpolationFunc has to provide the following operator instead of the one used by SampleLoop:
+// void operator() (typename Traits::outbuf_t *outSamples, const typename Traits::input_t * const inBuffer, const int32 smpPos, const int32 increment, const int numSamples)
+template<class Traits, class InterpolationFunc, class FilterFunc, class MixFunc>
+static void BlockSampleLoop(ModChannel &chn, const CResampler &resampler, typename Traits::output_t * MPT_RESTRICT outBuffer, int numSamples)
+{
+	ModChannel &c = chn;
+	const typename Traits::input_t * MPT_RESTRICT inSample = static_cast<const typename Traits::input_t *>(c.pCurrentSample) + c.nPos * Traits::numChannelsIn;
+
+	int32 smpPos = c.nPosLo;	// 16.16 sample position relative to c.nPos
+
+	InterpolationFunc interpolate;
+	FilterFunc filter;
+	MixFunc mix;
+
+	// Do initialisation if necessary
+	interpolate.Start(c, resampler);
+	filter.Start(c);
+	mix.Start(c);
+
+	enum { blockSize = 64 };
+	typename Traits::outbuf_t outSamples[blockSize];
+
+	while(numSamples > 0)
+	{
+		const int blockSamples = numSamples < blockSize ? numSamples : blockSize;
+		interpolate(outSamples, inSample, smpPos, c.nInc, blockSamples);
+		for(int i = 0; i < blockSamples; i++)
+		{
+			filter(outSamples[i], c);
+			mix(outSamples[i], c, outBuffer);
+			outBuffer += Traits::numChannelsOut;
+		}
+
+		smpPos += c.nInc * blockSamples;
+		numSamples -= blockSamples;
+	}
+
+	mix.End(c);
+	filter.End(c);
+	interpolate.End(c);
+
+	c.nPos += smpPos >> 16;
+	c.nPosLo = smpPos & 0xFFFF;
+}
+
+// Type of the SampleLoop and BlockSampleLoop functions above
 typedef void (*MixFuncInterface)(ModChannel &, const CResampler &, mixsample_t *, int);
 
 OPENMPT_NAMESPACE_END
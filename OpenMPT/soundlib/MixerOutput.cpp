@@ -0,0 +1,417 @@
+/*
+ * MixerOutput.cpp
+ * ---------------
+ * Purpose: Final output stage which converts the mix buffer to 16-bit or floating point output.
+ * Notes  : Output gain, dithering, conversion and clipping used to be separate passes over the mix buffer
+ *          and the output buffer. Here, they are done in a single pass that writes directly to the
+ *          caller's interleaved or planar buffers.
+ *          The SSE4.1 and AVX2 versions produce exactly the same output as the scalar code, which in turn
+ *          matches ApplyGain(), Dither::Process() and the converters in SampleFormatConverters.h.
+ *          Dither noise is generated up-front for the whole chunk because the random number generator
+ *          is inherently serial. Noise-shaped dither depends on the output signal, so it is still applied
+ *          in a separate pass.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+#include "MixerOutput.h"
+#include "../common/Endianness.h"
+#include "Mixer.h"
+#include "Dither.h"
+#include "Snd_defs.h"
+#include "ModSample.h"
+#include "SampleFormatConverters.h"
+#include "../common/misc_util.h"
+
+#if defined(ENABLE_AVX2)
+#include <immintrin.h>
+#elif defined(ENABLE_SSE4)
+#include <smmintrin.h>
+#endif
+
+
+OPENMPT_NAMESPACE_BEGIN
+
+
+// Right shift for converting a mix buffer sample to 16-bit
+enum { int16Shift = MIXING_FRACTIONAL_BITS + 1 - 16 };
+
+typedef void (*ConvertInt16Func)(int16 *interleaved, int16 * const *planar, const int32 *mix, const int32 *noise, std::size_t channels, std::size_t start, std::size_t end, int32 gain);
+typedef void (*ConvertFloatFunc)(float *interleaved, float * const *planar, const int32 *mix, std::size_t channels, std::size_t start, std::size_t end, bool clip, float gain);
+
+
+//////////////////////////////////////////////////////////////////////////
+// Scalar versions
+// start and end are sample indices into the interleaved mix buffer and must be a multiple of the channel count.
+
+static void C_ConvertToInt16(int16 *interleaved, int16 * const *planar, const int32 *mix, const int32 *noise, std::size_t channels, std::size_t start, std::size_t end, int32 gain)
+//---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	SC::ConvertFixedPoint<int16, int32, MIXING_FRACTIONAL_BITS, false> conv;
+	const bool applyGain = (gain != (1 << 16));
+	for(std::size_t i = start; i < end; i += channels)
+	{
+		for(std::size_t channel = 0; channel < channels; channel++)
+		{
+			int32 val = mix[i + channel];
+			if(applyGain)
+			{
+				val = Util::muldiv(val, gain, 1 << 16);
+			}
+			if(noise)
+			{
+				val += noise[i + channel];
+			}
+			const int16 out = conv(val);
+			if(interleaved)
+			{
+				interleaved[i + channel] = out;
+			}
+			if(planar)
+			{
+				planar[channel][i / channels] = out;
+			}
+		}
+	}
+}
+
+
+static void C_ConvertToFloat(float *interleaved, float * const *planar, const int32 *mix, std::size_t channels, std::size_t start, std::size_t end, bool clip, float gain)
+//----------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	const float factor = 1.0f / static_cast<float>(1 << MIXING_FRACTIONAL_BITS);
+	for(std::size_t i = start; i < end; i += channels)
+	{
+		for(std::size_t channel = 0; channel < channels; channel++)
+		{
+			float out = mix[i + channel] * factor;
+			if(clip)
+			{
+				if(out < -1.0f) out = -1.0f;
+				if(out > 1.0f) out = 1.0f;
+			}
+			out *= gain;
+			if(interleaved)
+			{
+				interleaved[i + channel] = out;
+			}
+			if(planar)
+			{
+				planar[channel][i / channels] = out;
+			}
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// SSE4.1 versions
+// Only interleaved, mono and stereo planar output is vectorized. The remaining samples are passed on to the scalar versions.
+
+#ifdef ENABLE_SSE4
+
+// Same as Util::muldiv(val, gain, 1 << 16) for non-negative gain, i.e. the 64-bit product is truncated towards zero.
+MPT_TARGET_SSE4 static forceinline __m128i SSE4_ApplyGain(__m128i val, __m128i gain)
+{
+	const __m128i absVal = _mm_abs_epi32(val);
+	const __m128i even = _mm_srli_epi64(_mm_mul_epu32(absVal, gain), 16);
+	const __m128i odd = _mm_slli_epi64(_mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(absVal, 32), gain), 16), 32);
+	return _mm_sign_epi32(_mm_blend_epi16(even, odd, 0xCC), val);
+}
+
+
+MPT_TARGET_SSE4 static void SSE4_ConvertToInt16(int16 *interleaved, int16 * const *planar, const int32 *mix, const int32 *noise, std::size_t channels, std::size_t start, std::size_t end, int32 gain)
+//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	const __m128i gainVec = _mm_set1_epi32(gain);
+	const __m128i rounding = _mm_set1_epi32(1 << (int16Shift - 1));
+	const __m128i deinterleave = _mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+	const bool applyGain = (gain != (1 << 16));
+	std::size_t i = start;
+	if(!planar || channels <= 2)
+	{
+		for(; i + 8 <= end; i += 8)
+		{
+			__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mix + i));
+			__m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mix + i + 4));
+			if(applyGain)
+			{
+				v1 = SSE4_ApplyGain(v1, gainVec);
+				v2 = SSE4_ApplyGain(v2, gainVec);
+			}
+			if(noise)
+			{
+				v1 = _mm_add_epi32(v1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(noise + i)));
+				v2 = _mm_add_epi32(v2, _mm_loadu_si128(reinterpret_cast<const __m128i *>(noise + i + 4)));
+			}
+			v1 = _mm_srai_epi32(_mm_add_epi32(v1, rounding), int16Shift);
+			v2 = _mm_srai_epi32(_mm_add_epi32(v2, rounding), int16Shift);
+			const __m128i out = _mm_packs_epi32(v1, v2);	// Saturates to int16
+			if(interleaved)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(interleaved + i), out);
+			}
+			if(planar && channels == 1)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(planar[0] + i), out);
+			} else if(planar)
+			{
+				const __m128i lr = _mm_shuffle_epi8(out, deinterleave);	// LRLRLRLR => LLLLRRRR
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(planar[0] + i / 2), lr);
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(planar[1] + i / 2), _mm_unpackhi_epi64(lr, lr));
+			}
+		}
+	}
+	C_ConvertToInt16(interleaved, planar, mix, noise, channels, i, end, gain);
+}
+
+
+MPT_TARGET_SSE4 static void SSE4_ConvertToFloat(float *interleaved, float * const *planar, const int32 *mix, std::size_t channels, std::size_t start, std::size_t end, bool clip, float gain)
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	const __m128 factor = _mm_set1_ps(1.0f / static_cast<float>(1 << MIXING_FRACTIONAL_BITS));
+	const __m128 gainVec = _mm_set1_ps(gain);
+	const __m128 clipMin = _mm_set1_ps(-1.0f), clipMax = _mm_set1_ps(1.0f);
+	std::size_t i = start;
+	if(!planar || channels <= 2)
+	{
+		for(; i + 8 <= end; i += 8)
+		{
+			__m128 f1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(mix + i))), factor);
+			__m128 f2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(mix + i + 4))), factor);
+			if(clip)
+			{
+				f1 = _mm_min_ps(_mm_max_ps(f1, clipMin), clipMax);
+				f2 = _mm_min_ps(_mm_max_ps(f2, clipMin), clipMax);
+			}
+			f1 = _mm_mul_ps(f1, gainVec);
+			f2 = _mm_mul_ps(f2, gainVec);
+			if(interleaved)
+			{
+				_mm_storeu_ps(interleaved + i, f1);
+				_mm_storeu_ps(interleaved + i + 4, f2);
+			}
+			if(planar && channels == 1)
+			{
+				_mm_storeu_ps(planar[0] + i, f1);
+				_mm_storeu_ps(planar[0] + i + 4, f2);
+			} else if(planar)
+			{
+				_mm_storeu_ps(planar[0] + i / 2, _mm_shuffle_ps(f1, f2, _MM_SHUFFLE(2, 0, 2, 0)));	// LRLR+LRLR => LLLL
+				_mm_storeu_ps(planar[1] + i / 2, _mm_shuffle_ps(f1, f2, _MM_SHUFFLE(3, 1, 3, 1)));	// LRLR+LRLR => RRRR
+			}
+		}
+	}
+	C_ConvertToFloat(interleaved, planar, mix, channels, i, end, clip, gain);
+}
+
+#endif // ENABLE_SSE4
+
+
+//////////////////////////////////////////////////////////////////////////
+// AVX2 versions, same as the SSE4.1 versions but with twice the width
+
+#ifdef ENABLE_AVX2
+
+MPT_TARGET_AVX2 static forceinline __m256i AVX2_ApplyGain(__m256i val, __m256i gain)
+{
+	const __m256i absVal = _mm256_abs_epi32(val);
+	const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(absVal, gain), 16);
+	const __m256i odd = _mm256_slli_epi64(_mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(absVal, 32), gain), 16), 32);
+	return _mm256_sign_epi32(_mm256_blend_epi32(even, odd, 0xAA), val);
+}
+
+
+MPT_TARGET_AVX2 static void AVX2_ConvertToInt16(int16 *interleaved, int16 * const *planar, const int32 *mix, const int32 *noise, std::size_t channels, std::size_t start, std::size_t end, int32 gain)
+//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	const __m256i gainVec = _mm256_set1_epi32(gain);
+	const __m256i rounding = _mm256_set1_epi32(1 << (int16Shift - 1));
+	const __m256i deinterleave = _mm256_setr_epi8(
+		0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+		0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+	const bool applyGain = (gain != (1 << 16));
+	std::size_t i = start;
+	if(!planar || channels <= 2)
+	{
+		for(; i + 16 <= end; i += 16)
+		{
+			__m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mix + i));
+			__m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mix + i + 8));
+			if(applyGain)
+			{
+				v1 = AVX2_ApplyGain(v1, gainVec);
+				v2 = AVX2_ApplyGain(v2, gainVec);
+			}
+			if(noise)
+			{
+				v1 = _mm256_add_epi32(v1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(noise + i)));
+				v2 = _mm256_add_epi32(v2, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(noise + i + 8)));
+			}
+			v1 = _mm256_srai_epi32(_mm256_add_epi32(v1, rounding), int16Shift);
+			v2 = _mm256_srai_epi32(_mm256_add_epi32(v2, rounding), int16Shift);
+			// Packing works on 128-bit lanes, so restore the sample order afterwards
+			const __m256i out = _mm256_permute4x64_epi64(_mm256_packs_epi32(v1, v2), _MM_SHUFFLE(3, 1, 2, 0));
+			if(interleaved)
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(interleaved + i), out);
+			}
+			if(planar && channels == 1)
+			{
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(planar[0] + i), out);
+			} else if(planar)
+			{
+				// LRLRLRLR|LRLRLRLR => LLLLRRRR|LLLLRRRR => LLLLLLLL|RRRRRRRR
+				const __m256i lr = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(out, deinterleave), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(planar[0] + i / 2), _mm256_castsi256_si128(lr));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(planar[1] + i / 2), _mm256_extracti128_si256(lr, 1));
+			}
+		}
+	}
+	C_ConvertToInt16(interleaved, planar, mix, noise, channels, i, end, gain);
+}
+
+
+MPT_TARGET_AVX2 static void AVX2_ConvertToFloat(float *interleaved, float * const *planar, const int32 *mix, std::size_t channels, std::size_t start, std::size_t end, bool clip, float gain)
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	const __m256 factor = _mm256_set1_ps(1.0f / static_cast<float>(1 << MIXING_FRACTIONAL_BITS));
+	const __m256 gainVec = _mm256_set1_ps(gain);
+	const __m256 clipMin = _mm256_set1_ps(-1.0f), clipMax = _mm256_set1_ps(1.0f);
+	std::size_t i = start;
+	if(!planar || channels <= 2)
+	{
+		for(; i + 16 <= end; i += 16)
+		{
+			__m256 f1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(mix + i))), factor);
+			__m256 f2 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(mix + i + 8))), factor);
+			if(clip)
+			{
+				f1 = _mm256_min_ps(_mm256_max_ps(f1, clipMin), clipMax);
+				f2 = _mm256_min_ps(_mm256_max_ps(f2, clipMin), clipMax);
+			}
+			f1 = _mm256_mul_ps(f1, gainVec);
+			f2 = _mm256_mul_ps(f2, gainVec);
+			if(interleaved)
+			{
+				_mm256_storeu_ps(interleaved + i, f1);
+				_mm256_storeu_ps(interleaved + i + 8, f2);
+			}
+			if(planar && channels == 1)
+			{
+				_mm256_storeu_ps(planar[0] + i, f1);
+				_mm256_storeu_ps(planar[0] + i + 8, f2);
+			} else if(planar)
+			{
+				// Shuffling works on 128-bit lanes, so restore the sample order afterwards
+				const __m256 l = _mm256_shuffle_ps(f1, f2, _MM_SHUFFLE(2, 0, 2, 0));
+				const __m256 r = _mm256_shuffle_ps(f1, f2, _MM_SHUFFLE(3, 1, 3, 1));
+				_mm256_storeu_ps(planar[0] + i / 2, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))));
+				_mm256_storeu_ps(planar[1] + i / 2, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))));
+			}
+		}
+	}
+	C_ConvertToFloat(interleaved, planar, mix, channels, i, end, clip, gain);
+}
+
+#endif // ENABLE_AVX2
+
+
+//////////////////////////////////////////////////////////////////////////
+
+static ConvertInt16Func GetConvertToInt16()
+//-----------------------------------------
+{
+#ifdef ENABLE_AVX2
+	if(GetProcSupport() & PROCSUPPORT_AVX2)
+	{
+		return &AVX2_ConvertToInt16;
+	}
+#endif // ENABLE_AVX2
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return &SSE4_ConvertToInt16;
+	}
+#endif // ENABLE_SSE4
+	return &C_ConvertToInt16;
+}
+
+
+static ConvertFloatFunc GetConvertToFloat()
+//-----------------------------------------
+{
+#ifdef ENABLE_AVX2
+	if(GetProcSupport() & PROCSUPPORT_AVX2)
+	{
+		return &AVX2_ConvertToFloat;
+	}
+#endif // ENABLE_AVX2
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return &SSE4_ConvertToFloat;
+	}
+#endif // ENABLE_SSE4
+	return &C_ConvertToFloat;
+}
+
+
+void ConvertMixBufferToOutput(int16 *interleavedOutput, int16 * const *planarOutput, int32 *mixBuffer, std::size_t channels, std::size_t count, Dither &dither, int32 gainFactor16_16)
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	MPT_ASSERT(channels >= 1 && channels <= 4);
+	MPT_ASSERT(gainFactor16_16 >= 0);
+	const ConvertInt16Func convert = GetConvertToInt16();
+
+	if(!dither.IsSignalIndependent())
+	{
+		// Noise shaping depends on the previously rounded samples, so the gain and dither cannot be fused.
+		if(gainFactor16_16 != (1 << 16))
+		{
+			for(std::size_t i = 0; i < count * channels; i++)
+			{
+				mixBuffer[i] = Util::muldiv(mixBuffer[i], gainFactor16_16, 1 << 16);
+			}
+		}
+		dither.Process(mixBuffer, count, channels, 16);
+		convert(interleavedOutput, planarOutput, mixBuffer, nullptr, channels, 0, count * channels, 1 << 16);
+		return;
+	}
+
+	if(dither.GetMode() == DitherNone)
+	{
+		convert(interleavedOutput, planarOutput, mixBuffer, nullptr, channels, 0, count * channels, gainFactor16_16);
+		return;
+	}
+
+	// Generate the noise for one mix buffer at a time
+	int32 noise[MIXBUFFERSIZE * 4];
+	int16 *planar[4] = { nullptr, nullptr, nullptr, nullptr };
+	for(std::size_t offset = 0; offset < count; offset += MIXBUFFERSIZE)
+	{
+		const std::size_t frames = std::min<std::size_t>(MIXBUFFERSIZE, count - offset);
+		if(planarOutput)
+		{
+			for(std::size_t channel = 0; channel < channels; channel++)
+			{
+				planar[channel] = planarOutput[channel] + offset;
+			}
+		}
+		dither.GenerateNoise(noise, frames * channels, 16);
+		convert(interleavedOutput ? interleavedOutput + offset * channels : nullptr, planarOutput ? planar : nullptr, mixBuffer + offset * channels, noise, channels, 0, frames * channels, gainFactor16_16);
+	}
+}
+
+
+void ConvertMixBufferToOutput(float *interleavedOutput, float * const *planarOutput, const int32 *mixBuffer, std::size_t channels, std::size_t count, bool clipOutput, float gainFactor)
+//----------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	MPT_ASSERT(channels >= 1 && channels <= 4);
+	GetConvertToFloat()(interleavedOutput, planarOutput, mixBuffer, channels, 0, count * channels, clipOutput, gainFactor);
+}
+
+
+OPENMPT_NAMESPACE_END
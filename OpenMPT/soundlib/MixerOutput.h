@@ -0,0 +1,25 @@
+/*
+ * MixerOutput.h
+ * -------------
+ * Purpose: Final output stage which converts the mix buffer to 16-bit or floating point output.
+ * Notes  : See implementation file.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+OPENMPT_NAMESPACE_BEGIN
+
+class Dither;
+
+
+// Apply the output gain, dithering, conversion and clipping to count frames of the interleaved mix buffer in a single pass.
+// The result is written to interleavedOutput and / or the per-channel buffers in planarOutput (either of them may be nullptr).
+// mixBuffer is only modified if the dither mode requires it.
+void ConvertMixBufferToOutput(int16 *interleavedOutput, int16 * const *planarOutput, int32 *mixBuffer, std::size_t channels, std::size_t count, Dither &dither, int32 gainFactor16_16);
+void ConvertMixBufferToOutput(float *interleavedOutput, float * const *planarOutput, const int32 *mixBuffer, std::size_t channels, std::size_t count, bool clipOutput, float gainFactor);
+
+
+OPENMPT_NAMESPACE_END
@@ -22,6 +22,128 @@ OPENMPT_NAMESPACE_BEGIN
 //#define MMCMP_LOG
 
 
+namespace
+{
+
+// Unpacked contents of a packed file. The packed data is only decompressed as far as the unpacked data is actually accessed,
+// so e.g. probing a packed file only has to decompress its first few blocks.
+// With MPT_FILEREADER_STD_ISTREAM, this can be used directly as the data container of a FileReader.
+class UnpackedFileContainer
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+	: public IFileDataContainer
+#endif
+{
+
+#if !defined(MPT_FILEREADER_STD_ISTREAM)
+public:
+	typedef std::size_t off_t;
+#endif
+
+protected:
+
+	FileReader packedFile;
+	const off_t unpackedLength;
+	mutable std::vector<char> unpackedData;	// Allocated on first access
+	mutable bool unpackError;
+
+	UnpackedFileContainer(const FileReader &file, off_t length) : packedFile(file), unpackedLength(length), unpackError(false) { }
+
+	// Decompress at least everything that is needed for accessing unpackedData[pos, pos + length[.
+	// Each part of the packed data must only be decompressed once. Returns false if the packed data is invalid.
+	virtual bool Unpack(off_t pos, off_t length) const = 0;
+
+	// Returns false if the packed data turned out to be invalid, now or on an earlier access.
+	// In that case, the partially unpacked data is cleared and the file cannot be read anymore.
+	bool Prepare(off_t pos, off_t length) const
+	{
+		if(unpackedData.empty())
+		{
+			unpackedData.resize(unpackedLength);
+		}
+		if(!unpackError && length != 0 && !Unpack(pos, length))
+		{
+			unpackError = true;
+			std::fill(unpackedData.begin(), unpackedData.end(), char(0));
+		}
+		return !unpackError;
+	}
+
+public:
+
+	virtual ~UnpackedFileContainer() { }
+
+	// Decompress the whole file and move the unpacked data to dest. The object cannot be used anymore afterwards.
+	// Returns false if the packed data is invalid.
+	bool UnpackAll(std::vector<char> &dest)
+	{
+		bool result = Prepare(0, unpackedLength);
+		dest.swap(unpackedData);
+		return result;
+	}
+
+	// Decompress the whole file now. Returns false if the packed data is invalid.
+	bool UnpackNow() const
+	{
+		return Prepare(0, unpackedLength);
+	}
+
+	// Becomes false as soon as invalid packed data has been encountered.
+	bool IsValid() const
+	{
+		return !unpackError;
+	}
+
+	// Callers may have obtained the length before, so even after an error, this still points to unpackedLength (zeroed) bytes.
+	const char *GetRawData() const
+	{
+		Prepare(0, unpackedLength);
+		return &unpackedData[0];
+	}
+
+	off_t GetLength() const
+	{
+		return unpackError ? 0 : unpackedLength;
+	}
+
+	off_t Read(char *dst, off_t pos, off_t count) const
+	{
+		count = GetReadableLength(pos, count);
+		if(count == 0 || !Prepare(pos, count))
+		{
+			return 0;
+		}
+		std::copy(unpackedData.begin() + pos, unpackedData.begin() + pos + count, dst);
+		return count;
+	}
+
+	const char *GetPartialRawData(off_t pos, off_t length) const
+	{
+		if(pos + length > GetLength() || !Prepare(pos, length))
+		{
+			return nullptr;
+		}
+		return &unpackedData[0] + pos;
+	}
+
+	bool CanRead(off_t pos, off_t length) const
+	{
+		return pos + length <= GetLength();
+	}
+
+	off_t GetReadableLength(off_t pos, off_t length) const
+	{
+		if(pos >= GetLength())
+		{
+			return 0;
+		}
+		return std::min<off_t>(length, GetLength() - pos);
+	}
+
+};
+
+} // namespace
+
+
 #ifdef NEEDS_PRAGMA_PACK
 #pragma pack(push, 1)
 #endif
@@ -186,214 +308,309 @@ static bool MMCMP_IsDstBlockValid(const std::vector<char> &unpackedData, const M
 }
 
 
-bool UnpackMMCMP(std::vector<char> &unpackedData, FileReader &file)
-//-----------------------------------------------------------------
+// Location of a block in the packed file and its sub-blocks in the unpacked file
+struct MMCMPBlockInfo
 {
-	file.Rewind();
-	unpackedData.clear();
+	MMCMPBLOCK blk;
+	std::vector<MMCMPSUBBLOCK> subblks;
+	uint32 memPos;		// Position of the packed block data
+	uint32 unpkStart;	// All sub-blocks are located within [unpkStart, unpkEnd[ of the unpacked file
+	uint32 unpkEnd;
+};
 
-	MMCMPFILEHEADER mfh;
-	if(!file.ReadConvertEndianness(mfh)) return false;
-	if(std::memcmp(mfh.id, "ziRCONia", 8) != 0) return false;
-	if(mfh.hdrsize != sizeof(MMCMPHEADER)) return false;
-	MMCMPHEADER mmh;
-	if(!file.ReadConvertEndianness(mmh)) return false;
-	if(mmh.nblocks == 0) return false;
-	if(mmh.filesize == 0) return false;
-	if(mmh.filesize > 0x80000000) return false;
-	if(mmh.blktable > file.GetLength()) return false;
-	if(mmh.blktable + 4 * mmh.nblocks > file.GetLength()) return false;
 
-	unpackedData.resize(mmh.filesize);
+static bool MMCMP_UnpackBlock(std::vector<char> &unpackedData, FileReader &file, const MMCMPBlockInfo &block)
+//----------------------------------------------------------------------------------------------------------
+{
+	const MMCMPBLOCK &blk = block.blk;
+	const uint32 memPos = block.memPos;
+	if(block.subblks.empty()) return true;
+	const MMCMPSUBBLOCK *psubblk = &(block.subblks[0]);
 
-	for (uint32 nBlock=0; nBlock<mmh.nblocks; nBlock++)
+	// Data is not packed
+	if (!(blk.flags & MMCMP_COMP))
 	{
-		if(!file.Seek(mmh.blktable + 4*nBlock)) return false;
-		if(!file.CanRead(4)) return false;
-		uint32 blkPos = file.ReadUint32LE();
-		if(!file.Seek(blkPos)) return false;
-		MMCMPBLOCK blk;
-		if(!file.ReadConvertEndianness(blk)) return false;
-		std::vector<MMCMPSUBBLOCK> subblks(blk.sub_blk);
-		for(uint32 i=0; i<blk.sub_blk; ++i)
+		for (uint32 i=0; i<blk.sub_blk; i++)
 		{
-			if(!file.ReadConvertEndianness(subblks[i])) return false;
-		}
-		MMCMPSUBBLOCK *psubblk = blk.sub_blk > 0 ? &(subblks[0]) : nullptr;
-
-		if(blkPos + sizeof(MMCMPBLOCK) + blk.sub_blk * sizeof(MMCMPSUBBLOCK) >= file.GetLength()) return false;
-		uint32 memPos = blkPos + sizeof(MMCMPBLOCK) + blk.sub_blk * sizeof(MMCMPSUBBLOCK);
-
+			if(!MMCMP_IsDstBlockValid(unpackedData, *psubblk)) return false;
 #ifdef MMCMP_LOG
-		Log("block %d: flags=%04X sub_blocks=%d", nBlock, (uint32)pblk->flags, (uint32)pblk->sub_blk);
-		Log(" pksize=%d unpksize=%d", pblk->pk_size, pblk->unpk_size);
-		Log(" tt_entries=%d num_bits=%d\n", pblk->tt_entries, pblk->num_bits);
+			Log("  Unpacked sub-block %d: offset %d, size=%d\n", i, psubblk->unpk_pos, psubblk->unpk_size);
 #endif
-		// Data is not packed
-		if (!(blk.flags & MMCMP_COMP))
-		{
-			for (uint32 i=0; i<blk.sub_blk; i++)
-			{
-				if(!MMCMP_IsDstBlockValid(unpackedData, *psubblk)) return false;
+			if(!file.Seek(memPos)) return false;
+			if(file.ReadRaw(&(unpackedData[psubblk->unpk_pos]), psubblk->unpk_size) != psubblk->unpk_size) return false;
+			psubblk++;
+		}
+	} else
+	// Data is 16-bit packed
+	if (blk.flags & MMCMP_16BIT)
+	{
+		MMCMPBITBUFFER bb;
+		uint32 subblk = 0;
+		if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
+		char *pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
+		uint32 dwSize = psubblk[subblk].unpk_size >> 1;
+		uint32 dwPos = 0;
+		uint32 numbits = blk.num_bits;
+		uint32 oldval = 0;
+
 #ifdef MMCMP_LOG
-				Log("  Unpacked sub-block %d: offset %d, size=%d\n", i, psubblk->unpk_pos, psubblk->unpk_size);
+		Log("  16-bit block: pos=%d size=%d ", psubblk->unpk_pos, psubblk->unpk_size);
+		if (pblk->flags & MMCMP_DELTA) Log("DELTA ");
+		if (pblk->flags & MMCMP_ABS16) Log("ABS16 ");
+		Log("\n");
 #endif
-				if(!file.Seek(memPos)) return false;
-				if(file.ReadRaw(&(unpackedData[psubblk->unpk_pos]), psubblk->unpk_size) != psubblk->unpk_size) return false;
-				psubblk++;
-			}
-		} else
-		// Data is 16-bit packed
-		if (blk.flags & MMCMP_16BIT)
+		bb.bitcount = 0;
+		bb.bitbuffer = 0;
+		if(!file.Seek(memPos + blk.tt_entries)) return false;
+		if(!file.CanRead(blk.pk_size - blk.tt_entries)) return false;
+		bb.pSrc = reinterpret_cast<const uint8 *>(file.GetRawData());
+		bb.pEnd = reinterpret_cast<const uint8 *>(file.GetRawData() - blk.tt_entries + blk.pk_size);
+		while (subblk < blk.sub_blk)
 		{
-			MMCMPBITBUFFER bb;
-			uint32 subblk = 0;
-			if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
-			char *pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
-			uint32 dwSize = psubblk[subblk].unpk_size >> 1;
-			uint32 dwPos = 0;
-			uint32 numbits = blk.num_bits;
-			uint32 oldval = 0;
+			uint32 newval = 0x10000;
+			uint32 d = bb.GetBits(numbits+1);
 
-#ifdef MMCMP_LOG
-			Log("  16-bit block: pos=%d size=%d ", psubblk->unpk_pos, psubblk->unpk_size);
-			if (pblk->flags & MMCMP_DELTA) Log("DELTA ");
-			if (pblk->flags & MMCMP_ABS16) Log("ABS16 ");
-			Log("\n");
-#endif
-			bb.bitcount = 0;
-			bb.bitbuffer = 0;
-			if(!file.Seek(memPos + blk.tt_entries)) return false;
-			if(!file.CanRead(blk.pk_size - blk.tt_entries)) return false;
-			bb.pSrc = reinterpret_cast<const uint8 *>(file.GetRawData());
-			bb.pEnd = reinterpret_cast<const uint8 *>(file.GetRawData() - blk.tt_entries + blk.pk_size);
-			while (subblk < blk.sub_blk)
+			if (d >= MMCMP16BitCommands[numbits])
 			{
-				uint32 newval = 0x10000;
-				uint32 d = bb.GetBits(numbits+1);
-
-				if (d >= MMCMP16BitCommands[numbits])
+				uint32 nFetch = MMCMP16BitFetch[numbits];
+				uint32 newbits = bb.GetBits(nFetch) + ((d - MMCMP16BitCommands[numbits]) << nFetch);
+				if (newbits != numbits)
 				{
-					uint32 nFetch = MMCMP16BitFetch[numbits];
-					uint32 newbits = bb.GetBits(nFetch) + ((d - MMCMP16BitCommands[numbits]) << nFetch);
-					if (newbits != numbits)
-					{
-						numbits = newbits & 0x0F;
-					} else
-					{
-						if ((d = bb.GetBits(4)) == 0x0F)
-						{
-							if (bb.GetBits(1)) break;
-							newval = 0xFFFF;
-						} else
-						{
-							newval = 0xFFF0 + d;
-						}
-					}
+					numbits = newbits & 0x0F;
 				} else
 				{
-					newval = d;
-				}
-				if (newval < 0x10000)
-				{
-					newval = (newval & 1) ? (uint32)(-(int32)((newval+1) >> 1)) : (uint32)(newval >> 1);
-					if (blk.flags & MMCMP_DELTA)
+					if ((d = bb.GetBits(4)) == 0x0F)
 					{
-						newval += oldval;
-						oldval = newval;
+						if (bb.GetBits(1)) break;
+						newval = 0xFFFF;
 					} else
-					if (!(blk.flags & MMCMP_ABS16))
 					{
-						newval ^= 0x8000;
+						newval = 0xFFF0 + d;
 					}
-					pDest[dwPos*2 + 0] = (uint8)(((uint16)newval) & 0xff);
-					pDest[dwPos*2 + 1] = (uint8)(((uint16)newval) >> 8);
-					dwPos++;
 				}
-				if (dwPos >= dwSize)
+			} else
+			{
+				newval = d;
+			}
+			if (newval < 0x10000)
+			{
+				newval = (newval & 1) ? (uint32)(-(int32)((newval+1) >> 1)) : (uint32)(newval >> 1);
+				if (blk.flags & MMCMP_DELTA)
+				{
+					newval += oldval;
+					oldval = newval;
+				} else
+				if (!(blk.flags & MMCMP_ABS16))
 				{
-					subblk++;
-					dwPos = 0;
-					if(!(subblk < blk.sub_blk)) break;
-					if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
-					dwSize = psubblk[subblk].unpk_size >> 1;
-					pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
+					newval ^= 0x8000;
 				}
+				pDest[dwPos*2 + 0] = (uint8)(((uint16)newval) & 0xff);
+				pDest[dwPos*2 + 1] = (uint8)(((uint16)newval) >> 8);
+				dwPos++;
 			}
-		} else
-		// Data is 8-bit packed
-		{
-			MMCMPBITBUFFER bb;
-			uint32 subblk = 0;
-			if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
-			char *pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
-			uint32 dwSize = psubblk[subblk].unpk_size;
-			uint32 dwPos = 0;
-			uint32 numbits = blk.num_bits;
-			uint32 oldval = 0;
-			if(!file.Seek(memPos)) return false;
-			const uint8 *ptable = reinterpret_cast<const uint8 *>(file.GetRawData());
-
-			bb.bitcount = 0;
-			bb.bitbuffer = 0;
-			if(!file.Seek(memPos + blk.tt_entries)) return false;
-			if(!file.CanRead(blk.pk_size - blk.tt_entries)) return false;
-			bb.pSrc = reinterpret_cast<const uint8 *>(file.GetRawData());
-			bb.pEnd = reinterpret_cast<const uint8 *>(file.GetRawData() - blk.tt_entries + blk.pk_size);
-			while (subblk < blk.sub_blk)
+			if (dwPos >= dwSize)
 			{
-				uint32 newval = 0x100;
-				uint32 d = bb.GetBits(numbits+1);
+				subblk++;
+				dwPos = 0;
+				if(!(subblk < blk.sub_blk)) break;
+				if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
+				dwSize = psubblk[subblk].unpk_size >> 1;
+				pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
+			}
+		}
+	} else
+	// Data is 8-bit packed
+	{
+		MMCMPBITBUFFER bb;
+		uint32 subblk = 0;
+		if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
+		char *pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
+		uint32 dwSize = psubblk[subblk].unpk_size;
+		uint32 dwPos = 0;
+		uint32 numbits = blk.num_bits;
+		uint32 oldval = 0;
+		if(!file.Seek(memPos)) return false;
+		const uint8 *ptable = reinterpret_cast<const uint8 *>(file.GetRawData());
+
+		bb.bitcount = 0;
+		bb.bitbuffer = 0;
+		if(!file.Seek(memPos + blk.tt_entries)) return false;
+		if(!file.CanRead(blk.pk_size - blk.tt_entries)) return false;
+		bb.pSrc = reinterpret_cast<const uint8 *>(file.GetRawData());
+		bb.pEnd = reinterpret_cast<const uint8 *>(file.GetRawData() - blk.tt_entries + blk.pk_size);
+		while (subblk < blk.sub_blk)
+		{
+			uint32 newval = 0x100;
+			uint32 d = bb.GetBits(numbits+1);
 
-				if (d >= MMCMP8BitCommands[numbits])
+			if (d >= MMCMP8BitCommands[numbits])
+			{
+				uint32 nFetch = MMCMP8BitFetch[numbits];
+				uint32 newbits = bb.GetBits(nFetch) + ((d - MMCMP8BitCommands[numbits]) << nFetch);
+				if (newbits != numbits)
 				{
-					uint32 nFetch = MMCMP8BitFetch[numbits];
-					uint32 newbits = bb.GetBits(nFetch) + ((d - MMCMP8BitCommands[numbits]) << nFetch);
-					if (newbits != numbits)
-					{
-						numbits = newbits & 0x07;
-					} else
-					{
-						if ((d = bb.GetBits(3)) == 7)
-						{
-							if (bb.GetBits(1)) break;
-							newval = 0xFF;
-						} else
-						{
-							newval = 0xF8 + d;
-						}
-					}
+					numbits = newbits & 0x07;
 				} else
 				{
-					newval = d;
-				}
-				if (newval < 0x100)
-				{
-					int n = ptable[newval];
-					if (blk.flags & MMCMP_DELTA)
+					if ((d = bb.GetBits(3)) == 7)
+					{
+						if (bb.GetBits(1)) break;
+						newval = 0xFF;
+					} else
 					{
-						n += oldval;
-						oldval = n;
+						newval = 0xF8 + d;
 					}
-					pDest[dwPos++] = (uint8)n;
 				}
-				if (dwPos >= dwSize)
+			} else
+			{
+				newval = d;
+			}
+			if (newval < 0x100)
+			{
+				int n = ptable[newval];
+				if (blk.flags & MMCMP_DELTA)
 				{
-					subblk++;
-					dwPos = 0;
-					if(!(subblk < blk.sub_blk)) break;
-					if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
-					dwSize = psubblk[subblk].unpk_size;
-					pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
+					n += oldval;
+					oldval = n;
 				}
+				pDest[dwPos++] = (uint8)n;
+			}
+			if (dwPos >= dwSize)
+			{
+				subblk++;
+				dwPos = 0;
+				if(!(subblk < blk.sub_blk)) break;
+				if(!MMCMP_IsDstBlockValid(unpackedData, psubblk[subblk])) return false;
+				dwSize = psubblk[subblk].unpk_size;
+				pDest = &(unpackedData[psubblk[subblk].unpk_pos]);
 			}
 		}
 	}
-
 	return true;
 }
 
 
+namespace
+{
+
+// Unpacks the blocks of an MMCMP file as they are accessed.
+class MMCMPFileContainer : public UnpackedFileContainer
+{
+protected:
+	std::vector<MMCMPBlockInfo> blocks;
+	mutable std::vector<bool> blockUnpacked;
+	bool blocksOverlap;	// If blocks write to overlapping ranges, they must all be unpacked at once and in order to get the same result
+
+	bool Unpack(off_t pos, off_t length) const
+	{
+		bool result = true;
+		for(std::size_t i = 0; i < blocks.size(); i++)
+		{
+			if(blockUnpacked[i]) continue;
+			if(!blocksOverlap && (blocks[i].unpkEnd <= pos || blocks[i].unpkStart >= pos + length)) continue;
+			blockUnpacked[i] = true;
+			FileReader file(packedFile);
+			if(!MMCMP_UnpackBlock(unpackedData, file, blocks[i])) result = false;
+		}
+		return result;
+	}
+
+public:
+	MMCMPFileContainer(const FileReader &file, uint32 filesize, std::vector<MMCMPBlockInfo> &blockInfo)
+		: UnpackedFileContainer(file, filesize)
+		, blockUnpacked(blockInfo.size(), false)
+		, blocksOverlap(false)
+	{
+		blocks.swap(blockInfo);
+		std::vector<std::pair<uint32, uint32> > ranges;
+		for(std::size_t i = 0; i < blocks.size(); i++)
+		{
+			if(blocks[i].unpkStart < blocks[i].unpkEnd) ranges.push_back(std::make_pair(blocks[i].unpkStart, blocks[i].unpkEnd));
+		}
+		std::sort(ranges.begin(), ranges.end());
+		for(std::size_t i = 1; i < ranges.size(); i++)
+		{
+			if(ranges[i].first < ranges[i - 1].second) blocksOverlap = true;
+		}
+	}
+};
+
+} // namespace
+
+
+// Read the header and block table of an MMCMP file. No data is unpacked yet.
+static MPT_SHARED_PTR<UnpackedFileContainer> OpenMMCMP(FileReader &file)
+//----------------------------------------------------------------------
+{
+	file.Rewind();
+
+	MMCMPFILEHEADER mfh;
+	if(!file.ReadConvertEndianness(mfh)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(std::memcmp(mfh.id, "ziRCONia", 8) != 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(mfh.hdrsize != sizeof(MMCMPHEADER)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	MMCMPHEADER mmh;
+	if(!file.ReadConvertEndianness(mmh)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(mmh.nblocks == 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(mmh.filesize == 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(mmh.filesize > 0x80000000) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(mmh.blktable > file.GetLength()) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(mmh.blktable + 4 * mmh.nblocks > file.GetLength()) return MPT_SHARED_PTR<UnpackedFileContainer>();
+
+	std::vector<MMCMPBlockInfo> blocks(mmh.nblocks);
+	for (uint32 nBlock=0; nBlock<mmh.nblocks; nBlock++)
+	{
+		MMCMPBlockInfo &block = blocks[nBlock];
+		if(!file.Seek(mmh.blktable + 4*nBlock)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+		if(!file.CanRead(4)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+		uint32 blkPos = file.ReadUint32LE();
+		if(!file.Seek(blkPos)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+		MMCMPBLOCK &blk = block.blk;
+		if(!file.ReadConvertEndianness(blk)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+		block.subblks.resize(blk.sub_blk);
+		block.unpkStart = mmh.filesize;
+		block.unpkEnd = 0;
+		for(uint32 i=0; i<blk.sub_blk; ++i)
+		{
+			MMCMPSUBBLOCK &subblk = block.subblks[i];
+			if(!file.ReadConvertEndianness(subblk)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+			if(subblk.unpk_pos >= mmh.filesize || subblk.unpk_size > mmh.filesize - subblk.unpk_pos) return MPT_SHARED_PTR<UnpackedFileContainer>();
+			block.unpkStart = std::min(block.unpkStart, subblk.unpk_pos);
+			block.unpkEnd = std::max(block.unpkEnd, subblk.unpk_pos + subblk.unpk_size);
+		}
+
+		if(blkPos + sizeof(MMCMPBLOCK) + blk.sub_blk * sizeof(MMCMPSUBBLOCK) >= file.GetLength()) return MPT_SHARED_PTR<UnpackedFileContainer>();
+		block.memPos = blkPos + sizeof(MMCMPBLOCK) + blk.sub_blk * sizeof(MMCMPSUBBLOCK);
+
+#ifdef MMCMP_LOG
+		Log("block %d: flags=%04X sub_blocks=%d", nBlock, (uint32)blk.flags, (uint32)blk.sub_blk);
+		Log(" pksize=%d unpksize=%d", blk.pk_size, blk.unpk_size);
+		Log(" tt_entries=%d num_bits=%d\n", blk.tt_entries, blk.num_bits);
+#endif
+	}
+
+	return MPT_SHARED_PTR<UnpackedFileContainer>(new MMCMPFileContainer(file, mmh.filesize, blocks));
+}
+
+
+bool UnpackMMCMP(std::vector<char> &unpackedData, FileReader &file)
+//-----------------------------------------------------------------
+{
+	unpackedData.clear();
+	MPT_SHARED_PTR<UnpackedFileContainer> container = OpenMMCMP(file);
+	return container && container->UnpackAll(unpackedData);
+}
+
+
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+FileReader UnpackMMCMP(FileReader &file)
+//--------------------------------------
+{
+	MPT_SHARED_PTR<UnpackedFileContainer> container = OpenMMCMP(file);
+	return container ? FileReader(container) : FileReader();
+}
+#endif
+
+
 /////////////////////////////////////////////////////////////////////////////
 //
 // XPK unpacker
@@ -483,8 +700,10 @@ static int32 bfexts(const uint8 *p, int32 bo, int32 bc, XPK_BufferBounds &bufs)
 }
 
 
-static bool XPK_DoUnpack(const uint8 *src, uint32 srcLen, uint8 *dst, int32 len)
-//------------------------------------------------------------------------------
+// Unpack the chunks starting at srcPos / dstPos until at least stopPos bytes of unpacked data are available.
+// srcPos and dstPos are updated to the start of the next chunk, so that unpacking can be resumed from there.
+static bool XPK_DoUnpack(const uint8 *src, uint32 srcLen, uint8 *dst, int32 len, uint32 &srcPos, int32 &dstPos, int32 stopPos)
+//---------------------------------------------------------------------------------------------------------------------------
 {
 	if(len <= 0) return false;
 	static const uint8 xpk_table[] = {
@@ -502,9 +721,15 @@ static bool XPK_DoUnpack(const uint8 *src, uint32 srcLen, uint8 *dst, int32 len)
 	bufs.pDstBeg = dst;
 	bufs.pDstEnd = dst + len;
 
-	c = src;
+	c = src + srcPos;
+	dst += dstPos;
+	len -= dstPos;
 	while (len > 0)
 	{
+		srcPos = static_cast<uint32>(c - bufs.pSrcBeg);
+		dstPos = static_cast<int32>(dst - bufs.pDstBeg);
+		if(dstPos >= stopPos) return true;
+
 		if(&(c[0]) < bufs.pSrcBeg || &(c[0]) >= bufs.pSrcEnd) throw XPK_error();
 		if(&(c[7]) < bufs.pSrcBeg || &(c[7]) >= bufs.pSrcEnd) throw XPK_error();
 		type = c[0];
@@ -615,6 +840,8 @@ static bool XPK_DoUnpack(const uint8 *src, uint32 srcLen, uint8 *dst, int32 len)
 			d2 -= d6;
 		}
 	}
+	// Nothing left to unpack
+	dstPos = static_cast<int32>(bufs.pDstEnd - bufs.pDstBeg);
 	return true;
 
 l75a:
@@ -701,37 +928,86 @@ l7ca:
 }
 
 
-bool UnpackXPK(std::vector<char> &unpackedData, FileReader &file)
-//---------------------------------------------------------------
+namespace
+{
+
+// Unpacks the chunks of an XPK file as they are accessed. Chunks can refer to data of previous chunks, so they are always unpacked in order.
+class XPKFileContainer : public UnpackedFileContainer
+{
+protected:
+	mutable uint32 srcPos;
+	mutable int32 dstPos;
+
+	bool Unpack(off_t pos, off_t length) const
+	{
+		const int32 stopPos = static_cast<int32>(pos + length);
+		if(dstPos >= stopPos) return true;
+		FileReader file(packedFile);
+		file.Seek(sizeof(XPKFILEHEADER));
+		bool result = false;
+		try
+		{
+			result = XPK_DoUnpack(reinterpret_cast<const uint8 *>(file.GetRawData()), static_cast<uint32>(file.BytesLeft()), reinterpret_cast<uint8 *>(&(unpackedData[0])), static_cast<int32>(unpackedLength), srcPos, dstPos, stopPos);
+		} catch(XPK_error&)
+		{
+			result = false;
+		}
+		if(!result)
+		{
+			// Don't try again
+			dstPos = static_cast<int32>(unpackedLength);
+		}
+		return result;
+	}
+
+public:
+	XPKFileContainer(const FileReader &file, uint32 dstLen) : UnpackedFileContainer(file, dstLen), srcPos(0), dstPos(0) { }
+};
+
+} // namespace
+
+
+// Read the header of an XPK file. No data is unpacked yet.
+static MPT_SHARED_PTR<UnpackedFileContainer> OpenXPK(FileReader &file)
+//--------------------------------------------------------------------
 {
 	file.Rewind();
-	unpackedData.clear();
 
 	XPKFILEHEADER header;
-	if(!file.ReadConvertEndianness(header)) return false;
-	if(std::memcmp(header.XPKF, "XPKF", 4) != 0) return false;
-	if(std::memcmp(header.SQSH, "SQSH", 4) != 0) return false;
-	if(header.SrcLen == 0) return false;
-	if(header.DstLen == 0) return false;
-	if(!file.CanRead(header.SrcLen + 8 - sizeof(XPKFILEHEADER))) return false;
+	if(!file.ReadConvertEndianness(header)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(std::memcmp(header.XPKF, "XPKF", 4) != 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(std::memcmp(header.SQSH, "SQSH", 4) != 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(header.SrcLen == 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(header.DstLen == 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(header.DstLen > 0x7FFFFFFF) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(!file.CanRead(header.SrcLen + 8 - sizeof(XPKFILEHEADER))) return MPT_SHARED_PTR<UnpackedFileContainer>();
 
 #ifdef MMCMP_LOG
 	Log("XPK detected (SrcLen=%d DstLen=%d) filesize=%d\n", header.SrcLen, header.DstLen, file.GetLength());
 #endif
-	unpackedData.resize(header.DstLen);
-	bool result = false;
-	try
-	{
-		result = XPK_DoUnpack(reinterpret_cast<const uint8 *>(file.GetRawData()), header.SrcLen + 8 - sizeof(XPKFILEHEADER), reinterpret_cast<uint8 *>(&(unpackedData[0])), header.DstLen);
-	} catch(XPK_error&)
-	{
-		return false;
-	}
+	return mpt::make_shared<XPKFileContainer>(file.GetChunk(0, header.SrcLen + 8), header.DstLen);
+}
 
-	return result;
+
+bool UnpackXPK(std::vector<char> &unpackedData, FileReader &file)
+//---------------------------------------------------------------
+{
+	unpackedData.clear();
+	MPT_SHARED_PTR<UnpackedFileContainer> container = OpenXPK(file);
+	return container && container->UnpackAll(unpackedData);
 }
 
 
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+FileReader UnpackXPK(FileReader &file)
+//------------------------------------
+{
+	MPT_SHARED_PTR<UnpackedFileContainer> container = OpenXPK(file);
+	return container ? FileReader(container) : FileReader();
+}
+#endif
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // PowerPack PP20 Unpacker
@@ -796,6 +1072,7 @@ static bool PP20_DoUnpack(const uint8 *pSrc, uint32 nSrcLen, uint8 *pDst, uint32
 				n += code;
 				if (code != 3) break;
 			}
+			if(n > nBytesLeft) return false;
 			for (uint32 i=0; i<n; i++)
 			{
 				pDst[--nBytesLeft] = (uint8)BitBuffer.GetBits(8);
@@ -831,26 +1108,69 @@ static bool PP20_DoUnpack(const uint8 *pSrc, uint32 nSrcLen, uint8 *pDst, uint32
 }
 
 
-bool UnpackPP20(std::vector<char> &unpackedData, FileReader &file)
-//----------------------------------------------------------------
+namespace
+{
+
+// PP20 data is unpacked backwards, starting at the end of the file, so the whole file has to be unpacked on first access.
+class PP20FileContainer : public UnpackedFileContainer
+{
+protected:
+	mutable bool unpacked;
+
+	bool Unpack(off_t, off_t) const
+	{
+		if(unpacked) return true;
+		unpacked = true;
+		FileReader file(packedFile);
+		file.Seek(4);
+		return PP20_DoUnpack(reinterpret_cast<const uint8 *>(file.GetRawData()), file.GetLength() - 4, reinterpret_cast<uint8 *>(&(unpackedData[0])), static_cast<uint32>(unpackedLength));
+	}
+
+public:
+	PP20FileContainer(const FileReader &file, uint32 dstLen) : UnpackedFileContainer(file, dstLen), unpacked(false) { }
+};
+
+} // namespace
+
+
+// Read and unpack a PP20 file.
+static MPT_SHARED_PTR<UnpackedFileContainer> OpenPP20(FileReader &file)
+//---------------------------------------------------------------------
 {
 	file.Rewind();
-	unpackedData.clear();
 
-	if(!file.CanRead(PP20_PACKED_SIZE_MIN)) return false;
-	if(!file.ReadMagic("PP20")) return false;
+	if(!file.CanRead(PP20_PACKED_SIZE_MIN)) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	if(!file.ReadMagic("PP20")) return MPT_SHARED_PTR<UnpackedFileContainer>();
 	file.Seek(file.GetLength() - 4);
 	uint32 dstLen = 0;
 	dstLen |= file.ReadUint8() << 16;
 	dstLen |= file.ReadUint8() << 8;
 	dstLen |= file.ReadUint8() << 0;
-	if(dstLen == 0) return false;
-	unpackedData.resize(dstLen);
-	file.Seek(4);
-	bool result = PP20_DoUnpack(reinterpret_cast<const uint8 *>(file.GetRawData()), file.GetLength() - 4, reinterpret_cast<uint8 *>(&(unpackedData[0])), dstLen);
+	if(dstLen == 0) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	// There is no way to validate PP20 data other than unpacking it, and it has to be unpacked as a whole anyway.
+	MPT_SHARED_PTR<UnpackedFileContainer> container = mpt::make_shared<PP20FileContainer>(file, dstLen);
+	if(!container->UnpackNow()) return MPT_SHARED_PTR<UnpackedFileContainer>();
+	return container;
+}
 
-	return result;
+
+bool UnpackPP20(std::vector<char> &unpackedData, FileReader &file)
+//----------------------------------------------------------------
+{
+	unpackedData.clear();
+	MPT_SHARED_PTR<UnpackedFileContainer> container = OpenPP20(file);
+	return container && container->UnpackAll(unpackedData);
 }
 
 
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+FileReader UnpackPP20(FileReader &file)
+//-------------------------------------
+{
+	MPT_SHARED_PTR<UnpackedFileContainer> container = OpenPP20(file);
+	return container ? FileReader(container) : FileReader();
+}
+#endif
+
+
 OPENMPT_NAMESPACE_END
@@ -94,4 +94,143 @@ void ModChannel::Reset(ResetFlags resetMask, const CSoundFile &sndFile, CHANNELI
 }
 
 
+
+bool VoicePool::StealKey::operator< (const StealKey &other) const
+//---------------------------------------------------------------
+{
+	if(hasFadeOut != other.hasFadeOut) return hasFadeOut < other.hasFadeOut;
+	if(hasFadeOut && volume != other.volume) return volume < other.volume;
+	if(hasFadeOut && envPosition != other.envPosition) return envPosition < other.envPosition;
+	return voice < other.voice;
+}
+
+
+VoicePool::StealKey VoicePool::GetStealKey(const ModChannel &chn, CHANNELINDEX voice)
+//----------------------------------------------------------------------------------
+{
+	StealKey key;
+	key.hasFadeOut = (chn.nFadeOutVol != 0) ? 1 : 0;
+	uint32 v = chn.nVolume;
+	if(chn.dwFlags[CHN_NOTEFADE])
+		v = v * chn.nFadeOutVol;
+	else
+		v <<= 16;
+	if(chn.dwFlags[CHN_LOOP]) v >>= 1;
+	key.volume = v;
+	key.envPosition = ~chn.VolEnv.nEnvPosition;
+	key.voice = voice;
+	key.version = 0;
+	return key;
+}
+
+
+// Collect the free and used voices in [first, end).
+void VoicePool::Rebuild(const ModChannel *voices, CHANNELINDEX first, CHANNELINDEX end)
+//-------------------------------------------------------------------------------------
+{
+	firstVoice = first;
+	endVoice = std::max(first, end);
+	freeVoices.clear();
+	stealVoices.clear();
+	versions.assign(endVoice - firstVoice, 0);
+	for(CHANNELINDEX i = firstVoice; i < endVoice; i++)
+	{
+		if(!voices[i].nLength)
+			freeVoices.push_back(i);	// Ascending indices already form a min-heap
+		else
+			stealVoices.push_back(GetStealKey(voices[i], i));
+	}
+	std::make_heap(stealVoices.begin(), stealVoices.end(), StealKey::Greater());
+	valid = true;
+}
+
+
+// A voice has been started, stopped or changed in volume.
+void VoicePool::Update(const ModChannel *voices, CHANNELINDEX voice)
+//------------------------------------------------------------------
+{
+	if(!valid || voice < firstVoice || voice >= endVoice)
+	{
+		return;
+	}
+	const uint32 version = ++versions[voice - firstVoice];
+	if(!voices[voice].nLength)
+	{
+		freeVoices.push_back(voice);
+		std::push_heap(freeVoices.begin(), freeVoices.end(), std::greater<CHANNELINDEX>());
+	} else
+	{
+		StealKey key = GetStealKey(voices[voice], voice);
+		key.version = version;
+		stealVoices.push_back(key);
+		std::push_heap(stealVoices.begin(), stealVoices.end(), StealKey::Greater());
+	}
+}
+
+
+// Returns the free voice with the lowest index, or 0 if there is none.
+CHANNELINDEX VoicePool::GetFreeVoice(const ModChannel *voices)
+//------------------------------------------------------------
+{
+	while(!freeVoices.empty())
+	{
+		const CHANNELINDEX voice = freeVoices.front();
+		std::pop_heap(freeVoices.begin(), freeVoices.end(), std::greater<CHANNELINDEX>());
+		freeVoices.pop_back();
+		if(!voices[voice].nLength)
+		{
+			return voice;
+		}
+		// The voice has been started without telling us, so it has to become stealable.
+		Update(voices, voice);
+	}
+	return 0;
+}
+
+
+// Returns the voice that is stolen best: the first voice without fade-out volume,
+// or else the quietest voice below 25% volume. Returns 0 if no voice should be stolen.
+CHANNELINDEX VoicePool::GetVoiceToSteal(const ModChannel *voices)
+//---------------------------------------------------------------
+{
+	while(!stealVoices.empty())
+	{
+		const StealKey top = stealVoices.front();
+		if(top.version != versions[top.voice - firstVoice])
+		{
+			// Outdated entry
+			std::pop_heap(stealVoices.begin(), stealVoices.end(), StealKey::Greater());
+			stealVoices.pop_back();
+			continue;
+		}
+		const StealKey current = GetStealKey(voices[top.voice], top.voice);
+		if(!voices[top.voice].nLength || current != top)
+		{
+			// The voice has been changed without telling us
+			std::pop_heap(stealVoices.begin(), stealVoices.end(), StealKey::Greater());
+			stealVoices.pop_back();
+			if(!voices[top.voice].nLength)
+			{
+				return top.voice;
+			}
+			Update(voices, top.voice);
+			continue;
+		}
+
+		if(!top.hasFadeOut)
+		{
+			return top.voice;
+		}
+		// Only steal voices below 25% volume
+		const uint32 threshold = 64 * 65536;
+		if(top.volume < threshold || (top.volume == threshold && ~top.envPosition > 0xFFFFFF))
+		{
+			return top.voice;
+		}
+		return 0;
+	}
+	return 0;
+}
+
+
 OPENMPT_NAMESPACE_END
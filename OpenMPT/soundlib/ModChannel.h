@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <vector>
+
 OPENMPT_NAMESPACE_BEGIN
 
 class CSoundFile;
@@ -189,6 +191,63 @@ struct ModChannel
 };
 
 
+// Free and stealable NNA voices, so that not all voices have to be scanned for every new note.
+// The pool is filled from the voice states by Rebuild() and then has to be told about every voice that
+// is changed through Update(), until it is invalidated again.
+//=============
+class VoicePool
+//=============
+{
+protected:
+
+	// Voices are stolen in ascending key order.
+	struct StealKey
+	{
+		uint32 hasFadeOut;	// Voices without fade-out volume are stolen first
+		uint32 volume;
+		uint32 envPosition;	// Inverted, so that voices with advanced volume envelopes are stolen first
+		CHANNELINDEX voice;
+		uint32 version;
+
+		bool operator< (const StealKey &other) const;
+		bool operator!= (const StealKey &other) const { return hasFadeOut != other.hasFadeOut || volume != other.volume || envPosition != other.envPosition; }
+
+		// The std heap functions create max-heaps, so the comparison has to be reversed.
+		struct Greater
+		{
+			bool operator() (const StealKey &a, const StealKey &b) const { return b < a; }
+		};
+	};
+
+	std::vector<CHANNELINDEX> freeVoices;	// Min-heap
+	std::vector<StealKey> stealVoices;		// Min-heap
+	std::vector<uint32> versions;			// Entries of a voice with an older version have been replaced by Update()
+	CHANNELINDEX firstVoice, endVoice;
+	bool valid;
+
+public:
+
+	VoicePool() : firstVoice(0), endVoice(0), valid(false) { }
+
+	bool IsValid() const { return valid; }
+	void Invalidate() { valid = false; }
+
+	// Collect the free and used voices in [first, end).
+	void Rebuild(const ModChannel *voices, CHANNELINDEX first, CHANNELINDEX end);
+	// A voice has been started, stopped or changed in volume.
+	void Update(const ModChannel *voices, CHANNELINDEX voice);
+
+	// Returns the free voice with the lowest index, or 0 if there is none.
+	CHANNELINDEX GetFreeVoice(const ModChannel *voices);
+	// Returns the voice that is stolen best: the first voice without fade-out volume,
+	// or else the quietest voice below 25% volume. Returns 0 if no voice should be stolen.
+	CHANNELINDEX GetVoiceToSteal(const ModChannel *voices);
+
+protected:
+	static StealKey GetStealKey(const ModChannel &chn, CHANNELINDEX voice);
+};
+
+
 // Default pattern channel settings
 struct ModChannelSettings
 {
@@ -12,6 +12,7 @@
 #include "Sndfile.h"
 #include "ModSample.h"
 #include "modsmp_ctrl.h"
+#include "SampleDataStore.h"
 
 #include <cmath>
 
@@ -219,7 +220,8 @@ void ModSample::FreeSample()
 void ModSample::FreeSample(void *samplePtr)
 //-----------------------------------------
 {
-	if(samplePtr)
+	// Shared sample data is only freed by the store once its last user has released it.
+	if(samplePtr && !SampleDataStore::Release(samplePtr))
 	{
 		delete[] (((char *)samplePtr) - (InterpolationMaxLookahead * MaxSamplingPointSize));
 	}
@@ -339,4 +341,120 @@ void ModSample::FrequencyToTranspose()
 }
 
 
+namespace
+{
+	// Peak absolute amplitude of count elementary samples, scaled to 16 bits
+	template<typename T>
+	uint16 GetPeak(const T *p, size_t count)
+	//--------------------------------------
+	{
+		int peak = 0;
+		for(size_t i = 0; i < count; i++)
+		{
+			const int v = p[i] < 0 ? -p[i] : p[i];
+			if(v > peak) peak = v;
+		}
+		return static_cast<uint16>(peak << (16 - sizeof(T) * 8));
+	}
+}
+
+
+void SampleIndex::Build(const ModSample &smp)
+//-------------------------------------------
+{
+	Clear();
+	if(!smp.HasSampleData())
+	{
+		return;
+	}
+	sampleData = smp.pSample;
+	length = smp.nLength;
+	bytesPerSample = smp.GetBytesPerSample();
+	const SmpLength numBlocks = (length + BlockSize - 1) / BlockSize;
+	peaks.resize(numBlocks);
+	nextAudibleBlock.resize(numBlocks + 1);
+	ScanBlocks(smp, 0, numBlocks - 1);
+	UpdateSilentBlocks();
+}
+
+
+void SampleIndex::Update(const ModSample &smp, SmpLength first, SmpLength last)
+//-----------------------------------------------------------------------------
+{
+	if(!IsValid(smp))
+	{
+		Build(smp);
+		return;
+	}
+	LimitMax(last, length - 1);
+	if(first > last)
+	{
+		return;
+	}
+	ScanBlocks(smp, first / BlockSize, last / BlockSize);
+	UpdateSilentBlocks();
+}
+
+
+void SampleIndex::Clear()
+//-----------------------
+{
+	sampleData = nullptr;
+	length = 0;
+	bytesPerSample = 0;
+	peaks.clear();
+	nextAudibleBlock.clear();
+}
+
+
+uint16 SampleIndex::GetRangePeak(SmpLength first, SmpLength last) const
+//---------------------------------------------------------------------
+{
+	LimitMax(last, length - 1);
+	if(first > last || length == 0)
+	{
+		return 0;
+	}
+	uint16 peak = 0;
+	for(SmpLength block = first / BlockSize; block <= last / BlockSize; block++)
+	{
+		// Skip silent stretches
+		block = nextAudibleBlock[block];
+		if(block > last / BlockSize)
+		{
+			break;
+		}
+		peak = std::max(peak, peaks[block]);
+	}
+	return peak;
+}
+
+
+void SampleIndex::ScanBlocks(const ModSample &smp, SmpLength firstBlock, SmpLength lastBlock)
+//-------------------------------------------------------------------------------------------
+{
+	const size_t numChannels = smp.GetNumChannels();
+	for(SmpLength block = firstBlock; block <= lastBlock; block++)
+	{
+		const size_t offset = block * BlockSize * numChannels;
+		const size_t count = std::min(SmpLength(BlockSize), length - block * BlockSize) * numChannels;
+		peaks[block] = (smp.GetElementarySampleSize() == 2)
+			? GetPeak(smp.pSample16 + offset, count)
+			: GetPeak(smp.pSample8 + offset, count);
+	}
+}
+
+
+void SampleIndex::UpdateSilentBlocks()
+//------------------------------------
+{
+	const SmpLength numBlocks = GetNumBlocks();
+	nextAudibleBlock[numBlocks] = numBlocks;
+	for(SmpLength block = numBlocks; block-- > 0; )
+	{
+		nextAudibleBlock[block] = (peaks[block] == 0) ? nextAudibleBlock[block + 1] : block;
+	}
+}
+
+
 OPENMPT_NAMESPACE_END
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <vector>
+
 OPENMPT_NAMESPACE_BEGIN
 
 class CSoundFile;
@@ -98,4 +100,47 @@ struct ModSample
 	void FrequencyToTranspose();
 };
 
+
+// Coarse index of a sample's data: the peak amplitude of every block of BlockSize sampling points, and which blocks are digital silence.
+// Sample headers are freely copied around, so the index is not stored in ModSample itself. CSoundFile keeps one for every sample slot (see CSoundFile::GetSampleIndex).
+class SampleIndex
+{
+public:
+	static const SmpLength BlockSize = 256;
+
+	SampleIndex() : sampleData(nullptr), length(0), bytesPerSample(0) { }
+
+	// Build the index from scratch.
+	void Build(const ModSample &smp);
+	// Rescan the blocks containing the sampling points first to last (inclusive) after they have been modified in-place.
+	// If the sample data has been replaced since the index was built, the whole index is rebuilt.
+	void Update(const ModSample &smp, SmpLength first, SmpLength last);
+	void Clear();
+
+	// Returns true if the index has been built for the current sample data of smp.
+	bool IsValid(const ModSample &smp) const { return sampleData == smp.pSample && length == smp.nLength && bytesPerSample == smp.GetBytesPerSample() && smp.HasSampleData(); }
+
+	SmpLength GetNumBlocks() const { return static_cast<SmpLength>(peaks.size()); }
+	// Peak absolute amplitude of a block, scaled to 16 bits (i.e. 0...32768)
+	uint16 GetBlockPeak(SmpLength block) const { return peaks[block]; }
+	// Peak absolute amplitude of all blocks touching the sampling points first to last (inclusive), scaled to 16 bits.
+	// This is exact if the range is aligned to block boundaries and an upper bound otherwise.
+	uint16 GetRangePeak(SmpLength first, SmpLength last) const;
+	// Returns true if all sampling points from first to last (inclusive) are digital silence.
+	bool IsRangeSilent(SmpLength first, SmpLength last) const
+	{
+		return first <= last && last < length && nextAudibleBlock[first / BlockSize] > last / BlockSize;
+	}
+
+protected:
+	void ScanBlocks(const ModSample &smp, SmpLength firstBlock, SmpLength lastBlock);
+	void UpdateSilentBlocks();
+
+	const void *sampleData;	// Sample data, length and format the index has been built for
+	SmpLength length;
+	uint8 bytesPerSample;
+	std::vector<uint16> peaks;				// Peak amplitude of every block
+	std::vector<uint32> nextAudibleBlock;	// For every block, the index of the first block at or after it that is not silent (one more entry than there are blocks)
+};
+
 OPENMPT_NAMESPACE_END
@@ -0,0 +1,226 @@
+/*
+ * ParallelMixer.cpp
+ * -----------------
+ * Purpose: Worker threads for mixing the voices of a module in parallel.
+ * Notes  : Every worker mixes a contiguous range of voices into its own private accumulation buffers,
+ *          which are added to the real mix buffers in worker order once all workers are done.
+ *          As the mix buffers are integer buffers, the sum does not depend on how the voices were
+ *          distributed, so the output is bit-identical to mixing all voices on a single thread.
+ *          The calling thread acts as the first worker, so N workers only require N-1 extra threads.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+
+#ifndef NO_THREADS
+
+#include "ParallelMixer.h"
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+
+OPENMPT_NAMESPACE_BEGIN
+
+
+ParallelMixer::ParallelMixer()
+//----------------------------
+	: mixFunc(nullptr)
+	, mixContext(nullptr)
+	, mixCount(0)
+	, generation(0)
+	, pendingWorkers(0)
+	, shutdown(false)
+	, lastNumVoices(0)
+{
+}
+
+
+ParallelMixer::~ParallelMixer()
+//-----------------------------
+{
+	StopThreads();
+}
+
+
+// Set the number of workers, including the thread that calls Mix(). 0 and 1 disable parallel mixing.
+void ParallelMixer::SetNumWorkers(uint32 numWorkers)
+//--------------------------------------------------
+{
+	if(numWorkers == workers.size() || (numWorkers <= 1 && workers.size() <= 1))
+	{
+		return;
+	}
+	StopThreads();
+	workers.clear();
+	if(numWorkers <= 1)
+	{
+		return;
+	}
+
+	workers.resize(numWorkers);
+	for(size_t i = 1; i < numWorkers; i++)
+	{
+		try
+		{
+			threads.push_back(std::thread(&ParallelMixer::WorkerThread, this, i, generation));
+		} catch(const std::system_error &)
+		{
+			// Continue with the threads we already have.
+			workers.resize(i);
+			break;
+		}
+	}
+	if(workers.size() <= 1)
+	{
+		workers.clear();
+	}
+}
+
+
+void ParallelMixer::StopThreads()
+//-------------------------------
+{
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		shutdown = true;
+	}
+	startCondition.notify_all();
+	for(std::vector<std::thread>::iterator thread = threads.begin(); thread != threads.end(); thread++)
+	{
+		thread->join();
+	}
+	threads.clear();
+	shutdown = false;
+}
+
+
+void ParallelMixer::WorkerThread(size_t worker, uint32 startGeneration)
+//---------------------------------------------------------------------
+{
+	uint32 seenGeneration = startGeneration;
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!shutdown && generation == seenGeneration)
+			{
+				startCondition.wait(lock);
+			}
+			if(shutdown)
+			{
+				return;
+			}
+			seenGeneration = generation;
+		}
+
+		RunWorker(workers[worker]);
+
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			pendingWorkers--;
+			if(pendingWorkers == 0)
+			{
+				doneCondition.notify_one();
+			}
+		}
+	}
+}
+
+
+void ParallelMixer::RunWorker(Worker &worker)
+//-------------------------------------------
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::fill(worker.frontBuffer, worker.frontBuffer + mixCount * 2, 0);
+	if(worker.hasRearVoices)
+	{
+		std::fill(worker.rearBuffer, worker.rearBuffer + mixCount * 2, 0);
+	}
+	if(worker.firstVoice != worker.endVoice)
+	{
+		mixFunc(mixContext, worker);
+	}
+	worker.mixTime = static_cast<uint32>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+
+// Distribute the voices among the workers and mix them. Returns when all workers are done.
+void ParallelMixer::Mix(int count, MixFunc func, void *context)
+//-------------------------------------------------------------
+{
+	MPT_ASSERT(IsEnabled());
+	MPT_ASSERT(count <= MIXBUFFERSIZE);
+
+	const size_t numVoices = voices.size(), numWorkers = workers.size();
+	for(size_t i = 0; i < numWorkers; i++)
+	{
+		Worker &worker = workers[i];
+		worker.firstVoice = numVoices * i / numWorkers;
+		worker.endVoice = numVoices * (i + 1) / numWorkers;
+		worker.hasRearVoices = false;
+		for(size_t v = worker.firstVoice; v < worker.endVoice; v++)
+		{
+			worker.hasRearVoices |= voices[v].rear;
+		}
+	}
+	lastNumVoices = static_cast<uint32>(numVoices);
+	mixFunc = func;
+	mixContext = context;
+	mixCount = count;
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		generation++;
+		pendingWorkers = static_cast<uint32>(numWorkers - 1);
+	}
+	startCondition.notify_all();
+
+	RunWorker(workers[0]);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while(pendingWorkers != 0)
+	{
+		doneCondition.wait(lock);
+	}
+}
+
+
+// Add the private worker buffers to the front and rear mix buffers.
+void ParallelMixer::Reduce(mixsample_t *frontBuffer, mixsample_t *rearBuffer, int count) const
+//---------------------------------------------------------------------------------------------
+{
+	for(std::vector<Worker>::const_iterator worker = workers.begin(); worker != workers.end(); worker++)
+	{
+		for(int i = 0; i < count * 2; i++)
+		{
+			frontBuffer[i] += worker->frontBuffer[i];
+		}
+		if(worker->hasRearVoices)
+		{
+			for(int i = 0; i < count * 2; i++)
+			{
+				rearBuffer[i] += worker->rearBuffer[i];
+			}
+		}
+	}
+}
+
+
+// Per-worker mixing time of the last chunk in microseconds
+std::vector<uint32> ParallelMixer::GetLastMixTimes() const
+//--------------------------------------------------------
+{
+	std::vector<uint32> times;
+	for(std::vector<Worker>::const_iterator worker = workers.begin(); worker != workers.end(); worker++)
+	{
+		times.push_back(worker->mixTime);
+	}
+	return times;
+}
+
+
+OPENMPT_NAMESPACE_END
+
+#endif // NO_THREADS
@@ -0,0 +1,107 @@
+/*
+ * ParallelMixer.h
+ * ---------------
+ * Purpose: Worker threads for mixing the voices of a module in parallel.
+ * Notes  : See implementation file.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#ifndef NO_THREADS
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Mixer.h"
+
+OPENMPT_NAMESPACE_BEGIN
+
+struct ModChannel;
+
+
+//=================
+class ParallelMixer
+//=================
+{
+public:
+
+	// A voice that is mixed into the front or rear mix buffer by one of the workers
+	struct Voice
+	{
+		ModChannel *chn;
+		// Click removal offsets of voices that stopped playing in this chunk, added to the dry offsets after mixing
+		mixsample_t ofsR, ofsL;
+		bool rear;
+		bool mixed;
+		bool culled;
+	};
+
+	// Private accumulation buffers of one worker
+	struct Worker
+	{
+		mixsample_t frontBuffer[MIXBUFFERSIZE * 2];
+		mixsample_t rearBuffer[MIXBUFFERSIZE * 2];
+		size_t firstVoice, endVoice;
+		bool hasRearVoices;
+		// Time spent mixing the last chunk, in microseconds
+		uint32 mixTime;
+	};
+
+	// Mixes voices [worker.firstVoice, worker.endVoice) into the worker's buffers
+	typedef void (*MixFunc)(void *context, Worker &worker);
+
+	std::vector<Voice> voices;
+
+protected:
+
+	std::vector<Worker> workers;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable startCondition, doneCondition;
+	MixFunc mixFunc;
+	void *mixContext;
+	int mixCount;
+	uint32 generation;
+	uint32 pendingWorkers;
+	bool shutdown;
+
+	// Statistics of the last chunk that was mixed in parallel
+	uint32 lastNumVoices;
+
+public:
+
+	ParallelMixer();
+	~ParallelMixer();
+
+	// Set the number of workers, including the thread that calls Mix(). 0 and 1 disable parallel mixing.
+	void SetNumWorkers(uint32 numWorkers);
+	uint32 GetNumWorkers() const { return static_cast<uint32>(workers.size()); }
+	bool IsEnabled() const { return workers.size() > 1; }
+
+	// Distribute the voices among the workers and mix them. Returns when all workers are done.
+	// Voices are split into contiguous ranges, so the reduction in worker order is deterministic.
+	void Mix(int count, MixFunc func, void *context);
+
+	// Add the private worker buffers to the front and rear mix buffers. With integer mix buffers, the result does not depend on the number of workers.
+	void Reduce(mixsample_t *frontBuffer, mixsample_t *rearBuffer, int count) const;
+
+	// Number of voices that were mixed in parallel in the last chunk
+	uint32 GetLastNumVoices() const { return lastNumVoices; }
+	// Per-worker mixing time of the last chunk in microseconds
+	std::vector<uint32> GetLastMixTimes() const;
+
+protected:
+
+	void StopThreads();
+	void WorkerThread(size_t worker, uint32 startGeneration);
+	void RunWorker(Worker &worker);
+};
+
+
+OPENMPT_NAMESPACE_END
+
+#endif // NO_THREADS
@@ -2,7 +2,7 @@
  * Resampler.h
  * -----------
  * Purpose: Holds the tables for all available resamplers.
- * Notes  : (currently none)
+ * Notes  : The tables are immutable once computed and shared between all CResampler instances, see Tables.cpp.
  * Authors: OpenMPT Devs
  * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
  */
@@ -57,41 +57,55 @@ public:
 };
 
 
+// Tables which do not depend on the resampler settings
+struct CResamplerStaticTables
+{
+	SINC_TYPE gDownsample13x[SINC_PHASES * 8];	// Downsample 1.333x
+	SINC_TYPE gDownsample2x[SINC_PHASES * 8];	// Downsample 2x
+
+#ifndef MPT_INTMIXER
+	mixsample_t FastSincTablef[256 * 4];	// Cubic spline LUT
+	mixsample_t LinearTablef[256];			// Linear interpolation LUT
+#endif // !defined(MPT_INTMIXER)
+};
+
+// Tables which depend on the cutoff and window type of the resampler settings
+struct CResamplerSettingsTables
+{
+	CWindowedFIR m_WindowedFIR;
+	SINC_TYPE gKaiserSinc[SINC_PHASES * 8];	// Upsampling
+};
+
+
 //==============
 class CResampler
 //==============
 {
 public:
 	CResamplerSettings m_Settings;
-	CWindowedFIR m_WindowedFIR;
 	static const int16 FastSincTable[256 * 4];
 
-	SINC_TYPE gKaiserSinc[SINC_PHASES * 8];				// Upsampling
-
-#ifdef MODPLUG_TRACKER
-	static bool StaticTablesInitialized;
-	#define RESAMPLER_TABLE static
-#else
-	// no global data which has to be initialized by hand in the library
-	#define RESAMPLER_TABLE 
-#endif // MODPLUG_TRACKER
-
-	RESAMPLER_TABLE SINC_TYPE gDownsample13x[SINC_PHASES * 8];	// Downsample 1.333x
-	RESAMPLER_TABLE SINC_TYPE gDownsample2x[SINC_PHASES * 8];	// Downsample 2x
+	// These point into the shared tables below and are only valid as long as this object is.
+	const CWindowedFIR *m_WindowedFIR;
+	const SINC_TYPE *gKaiserSinc;		// Upsampling
+	const SINC_TYPE *gDownsample13x;	// Downsample 1.333x
+	const SINC_TYPE *gDownsample2x;		// Downsample 2x
 
 #ifndef MPT_INTMIXER
-	RESAMPLER_TABLE mixsample_t FastSincTablef[256 * 4];	// Cubic spline LUT
-	RESAMPLER_TABLE mixsample_t LinearTablef[256];		// Linear interpolation LUT
+	const mixsample_t *FastSincTablef;	// Cubic spline LUT
+	const mixsample_t *LinearTablef;	// Linear interpolation LUT
 #endif // !defined(MPT_INTMIXER)
 
-#undef RESAMPLER_TABLE
-
 private:
+	MPT_SHARED_PTR<const CResamplerStaticTables> m_StaticTables;
+	MPT_SHARED_PTR<const CResamplerSettingsTables> m_SettingsTables;
 	CResamplerSettings m_OldSettings;
 public:
 	CResampler() { InitializeTables(true); }
 	~CResampler() {}
 	void InitializeTables(bool force=false);
+	// Returns true if both resamplers use the same table instances.
+	bool SharesTablesWith(const CResampler &other) const { return m_StaticTables == other.m_StaticTables && m_SettingsTables == other.m_SettingsTables; }
 	bool IsHQ() const { return m_Settings.SrcMode >= SRCMODE_SPLINE && m_Settings.SrcMode < SRCMODE_DEFAULT; }
 };
 
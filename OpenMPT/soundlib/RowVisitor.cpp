@@ -26,6 +26,41 @@
 
 OPENMPT_NAMESPACE_BEGIN
 
+void RowVisitor::Memory::swap(Memory &other)
+//-------------------------------------------
+{
+	orderStart.swap(other.orderStart);
+	bits.swap(other.bits);
+	wordGeneration.swap(other.wordGeneration);
+	std::swap(generation, other.generation);
+}
+
+
+RowVisitor::RowVisitor(const CSoundFile &sf, SEQUENCEINDEX sequence, MemoryCache &memoryCache) : sndFile(sf), cache(&memoryCache), currentOrder(0)
+//----------------------------------------------------------------------------------------------------------------------------------------------
+{
+	{
+		Util::lock_guard<Util::mutex> guard(cache->cacheMutex);
+		memory.swap(cache->memory);
+	}
+	Initialize(true, sequence);
+}
+
+
+RowVisitor::~RowVisitor()
+//-----------------------
+{
+	if(cache != nullptr)
+	{
+		Util::lock_guard<Util::mutex> guard(cache->cacheMutex);
+		if(cache->memory.bits.capacity() < memory.bits.capacity())
+		{
+			memory.swap(cache->memory);
+		}
+	}
+}
+
+
 // Resize / Clear the row vector.
 // If reset is true, the vector is not only resized to the required dimensions, but also completely cleared (i.e. all visited rows are unset).
 void RowVisitor::Initialize(bool reset, SEQUENCEINDEX sequence)
@@ -36,25 +71,62 @@ void RowVisitor::Initialize(bool reset, SEQUENCEINDEX sequence)
 	else
 		Order = &sndFile.Order;
 
-	const ORDERINDEX endOrder = Order->GetLengthTailTrimmed();
-	visitedRows.resize(endOrder);
 	if(reset)
 	{
 		visitOrder.clear();
 	}
 
-	for(ORDERINDEX order = 0; order < endOrder; order++)
+	const ORDERINDEX endOrder = Order->GetLengthTailTrimmed();
+	bool sameLayout = (memory.orderStart.size() == endOrder + 1u);
+	for(ORDERINDEX order = 0; order < endOrder && sameLayout; order++)
+	{
+		sameLayout = (GetNumRows(order) == GetVisitedRowsVectorSize(Order->At(order)));
+	}
+	if(sameLayout)
 	{
-		VisitedRowsBaseType &row = visitedRows[order];
-		const size_t size = GetVisitedRowsVectorSize(Order->At(order));
 		if(reset)
 		{
-			// If we want to reset the vectors completely, we overwrite existing items with false.
-			row.assign(size, false);
-		} else
-		{
-			row.resize(size, false);
+			NextGeneration();
 		}
+		return;
+	}
+
+	// The rows are stored at different positions now, so previously visited rows have to be moved.
+	VisitedRowsType oldRows;
+	if(!reset)
+	{
+		oldRows = GetVisitedRows();
+	}
+
+	memory.orderStart.resize(endOrder + 1);
+	uint32 numRows = 0;
+	for(ORDERINDEX order = 0; order < endOrder; order++)
+	{
+		memory.orderStart[order] = numRows;
+		numRows += static_cast<uint32>(GetVisitedRowsVectorSize(Order->At(order)));
+	}
+	memory.orderStart[endOrder] = numRows;
+	const size_t numWords = (numRows + 63u) / 64u;
+	memory.bits.resize(numWords);
+	memory.wordGeneration.resize(numWords, 0);
+	NextGeneration();
+
+	if(!reset)
+	{
+		SetVisitedRows(oldRows);
+	}
+}
+
+
+// Unset all rows.
+void RowVisitor::NextGeneration()
+//-------------------------------
+{
+	if(++memory.generation == 0)
+	{
+		// Words of the very first generation could be mistaken as valid again
+		std::fill(memory.wordGeneration.begin(), memory.wordGeneration.end(), 0);
+		memory.generation = 1;
 	}
 }
 
@@ -72,12 +144,12 @@ void RowVisitor::SetVisited(ORDERINDEX order, ROWINDEX row, bool visited)
 	}
 
 	// The module might have been edited in the meantime - so we have to extend this a bit.
-	if(order >= visitedRows.size() || row >= visitedRows[order].size())
+	if(row >= GetNumRows(order))
 	{
 		Initialize(false);
 	}
 
-	visitedRows[order][row] = visited;
+	SetBit(memory.orderStart[order] + row, visited);
 	if(visited)
 	{
 		AddVisitedRow(order, row);
@@ -91,29 +163,24 @@ void RowVisitor::SetVisited(ORDERINDEX order, ROWINDEX row, bool visited)
 bool RowVisitor::IsVisited(ORDERINDEX order, ROWINDEX row, bool autoSet)
 //----------------------------------------------------------------------
 {
-	const ORDERINDEX endOrder = Order->GetLengthTailTrimmed();
-	if(order >= endOrder)
-	{
-		return false;
-	}
-
 	// The row slot for this row has not been assigned yet - Just return false, as this means that the program has not played the row yet.
-	if(order >= visitedRows.size() || row >= visitedRows[order].size())
+	if(row >= GetNumRows(order))
 	{
-		if(autoSet)
+		if(autoSet && order < Order->GetLengthTailTrimmed())
 		{
 			SetVisited(order, row, true);
 		}
 		return false;
 	}
 
-	if(visitedRows[order][row])
+	const uint32 pos = memory.orderStart[order] + row;
+	if(GetBit(pos))
 	{
 		// We visited this row already - this module must be looping.
 		return true;
 	} else if(autoSet)
 	{
-		visitedRows[order][row] = true;
+		SetBit(pos, true);
 		AddVisitedRow(order, row);
 	}
 
@@ -152,7 +219,7 @@ bool RowVisitor::GetFirstUnvisitedRow(ORDERINDEX &order, ROWINDEX &row, bool fas
 			continue;
 		}
 
-		if(order >= visitedRows.size())
+		if(order + 1u >= memory.orderStart.size())
 		{
 			// Not yet initialized => unvisited
 			return true;
@@ -161,7 +228,7 @@ bool RowVisitor::GetFirstUnvisitedRow(ORDERINDEX &order, ROWINDEX &row, bool fas
 		const ROWINDEX endRow = (fastSearch ? 1 : sndFile.Patterns[pattern].GetNumRows());
 		for(row = 0; row < endRow; row++)
 		{
-			if(row >= visitedRows[order].size() || visitedRows[order][row] == false)
+			if(row >= GetNumRows(order) || !GetBit(memory.orderStart[order] + row))
 			{
 				// Not yet initialized, or unvisited
 				return true;
@@ -176,6 +243,142 @@ bool RowVisitor::GetFirstUnvisitedRow(ORDERINDEX &order, ROWINDEX &row, bool fas
 }
 
 
+// Retrieve a compact copy of all rows that have been visited.
+RowVisitor::VisitedRowsType RowVisitor::GetVisitedRows() const
+//------------------------------------------------------------
+{
+	VisitedRowsType rows;
+	rows.orderStart = memory.orderStart;
+	rows.bits.resize(memory.bits.size(), 0);
+	for(size_t word = 0; word < memory.bits.size(); word++)
+	{
+		if(memory.wordGeneration[word] == memory.generation)
+		{
+			rows.bits[word] = memory.bits[word];
+		}
+	}
+	return rows;
+}
+
+
+// Retrieve all rows that have been visited, except for those that have also been visited in another RowVisitor object.
+RowVisitor::VisitedRowsType RowVisitor::GetVisitedRowsExcept(const RowVisitor &other) const
+//-----------------------------------------------------------------------------------------
+{
+	VisitedRowsType rows = GetVisitedRows();
+	if(other.memory.orderStart == memory.orderStart)
+	{
+		for(size_t word = 0; word < rows.bits.size(); word++)
+		{
+			if(other.memory.wordGeneration[word] == other.memory.generation)
+			{
+				rows.bits[word] &= ~other.memory.bits[word];
+			}
+		}
+		return rows;
+	}
+
+	// Different layout (the module has been edited in the meantime)
+	const size_t numOrders = std::min(memory.orderStart.size(), other.memory.orderStart.size());
+	for(ORDERINDEX order = 0; order + 1u < numOrders; order++)
+	{
+		const ROWINDEX numRows = std::min(GetNumRows(order), other.GetNumRows(order));
+		for(ROWINDEX row = 0; row < numRows; row++)
+		{
+			if(other.GetBit(other.memory.orderStart[order] + row))
+			{
+				const uint32 pos = memory.orderStart[order] + row;
+				rows.bits[pos / 64u] &= ~(uint64(1) << (pos % 64u));
+			}
+		}
+	}
+	return rows;
+}
+
+
+// Append the bit set words that contain the rows of an order.
+void RowVisitor::GetOrderWords(ORDERINDEX order, VisitedRowsType::WordList &words) const
+//--------------------------------------------------------------------------------------
+{
+	const ROWINDEX numRows = GetNumRows(order);
+	if(numRows == 0)
+	{
+		return;
+	}
+	const uint32 lastWord = (memory.orderStart[order] + numRows - 1) / 64u;
+	for(uint32 word = memory.orderStart[order] / 64u; word <= lastWord; word++)
+	{
+		// Neighbouring orders can share a word
+		if(!words.empty() && words.back().first == word)
+		{
+			continue;
+		}
+		words.push_back(std::make_pair(word, (memory.wordGeneration[word] == memory.generation) ? memory.bits[word] : uint64(0)));
+	}
+}
+
+
+// Replace the visited rows vector, e.g. with a copy obtained from GetVisitedRowsExcept().
+void RowVisitor::SetVisitedRows(const VisitedRowsType &rows)
+//----------------------------------------------------------
+{
+	NextGeneration();
+	if(rows.orderStart == memory.orderStart)
+	{
+		memory.bits = rows.bits;
+		std::fill(memory.wordGeneration.begin(), memory.wordGeneration.end(), memory.generation);
+		return;
+	}
+
+	// Different layout (the module has been edited in the meantime)
+	const size_t numOrders = std::min(memory.orderStart.size(), rows.orderStart.size());
+	for(ORDERINDEX order = 0; order + 1u < numOrders; order++)
+	{
+		const ROWINDEX numRows = std::min<ROWINDEX>(GetNumRows(order), rows.orderStart[order + 1] - rows.orderStart[order]);
+		for(ROWINDEX row = 0; row < numRows; row++)
+		{
+			if(rows.IsVisited(order, row))
+			{
+				SetBit(memory.orderStart[order] + row, true);
+			}
+		}
+	}
+}
+
+
+bool RowVisitor::VisitedRowsType::IsVisited(ORDERINDEX order, ROWINDEX row) const
+//-------------------------------------------------------------------------------
+{
+	if(order + 1u >= orderStart.size() || row >= orderStart[order + 1] - orderStart[order])
+	{
+		return false;
+	}
+	const uint32 pos = orderStart[order] + row;
+	return ((bits[pos / 64u] >> (pos % 64u)) & 1) != 0;
+}
+
+
+size_t RowVisitor::VisitedRowsType::GetMemoryUsage() const
+//--------------------------------------------------------
+{
+	return orderStart.capacity() * sizeof(uint32) + bits.capacity() * sizeof(uint64);
+}
+
+
+// Overwrite the given bit set words.
+void RowVisitor::VisitedRowsType::SetWords(const WordList &words)
+//---------------------------------------------------------------
+{
+	for(WordList::const_iterator word = words.begin(); word != words.end(); word++)
+	{
+		if(word->first < bits.size())
+		{
+			bits[word->first] = word->second;
+		}
+	}
+}
+
+
 // Set all rows of a previous pattern loop as unvisited.
 void RowVisitor::ResetPatternLoop(ORDERINDEX order, ROWINDEX startRow)
 //--------------------------------------------------------------------
@@ -10,8 +10,10 @@
 
 #pragma once
 
+#include <utility>
 #include <vector>
 #include "Snd_defs.h"
+#include "../common/mutex.h"
 
 OPENMPT_NAMESPACE_BEGIN
 
@@ -22,29 +24,69 @@ class ModSequence;
 class RowVisitor
 //==============
 {
+public:
+
+	// Compact copy of the visited rows, e.g. for seek index checkpoints.
+	struct VisitedRowsType
+	{
+		// Position of the first row of each order in the bit set. The last element is the total number of rows.
+		std::vector<uint32> orderStart;
+		// One bit per row
+		std::vector<uint64> bits;
+
+		// Bit set words together with their position, e.g. to store only the words that have changed since an earlier copy.
+		typedef std::vector<std::pair<uint32, uint64> > WordList;
+
+		bool IsVisited(ORDERINDEX order, ROWINDEX row) const;
+		size_t GetMemoryUsage() const;
+		// Overwrite the given bit set words.
+		void SetWords(const WordList &words);
+
+		bool operator== (const VisitedRowsType &other) const { return orderStart == other.orderStart && bits == other.bits; }
+	};
+
+	// Visited row memory that is handed from one RowVisitor to the next, so that it doesn't have to be allocated and cleared again.
+	// Only one RowVisitor can use it at a time; others allocate their own memory in the meantime.
+	class MemoryCache;
+
 protected:
 
-	// Data type for the visited rows.
-	typedef std::vector<bool> VisitedRowsBaseType;
-	typedef std::vector<VisitedRowsBaseType> VisitedRowsType;
+	struct Memory
+	{
+		// Same layout as in VisitedRowsType
+		std::vector<uint32> orderStart;
+		std::vector<uint64> bits;
+		// A bit set word is only valid if its generation matches the current generation, so all rows can be unset in constant time.
+		std::vector<uint32> wordGeneration;
+		uint32 generation;
+
+		Memory() : generation(1) { }
+		void swap(Memory &other);
+	};
 
 	const CSoundFile &sndFile;
 	const ModSequence *Order;
+	MemoryCache *cache;
 
 	// Memory for every row in the module if it has been visited or not.
-	VisitedRowsType visitedRows;
+	Memory memory;
 	// Memory of visited rows (including their order) to reset pattern loops.
 	std::vector<ROWINDEX> visitOrder;
 	ORDERINDEX currentOrder;
 
 public:
 
-	RowVisitor(const CSoundFile &sf, SEQUENCEINDEX sequence = SEQUENCEINDEX_INVALID) : sndFile(sf), currentOrder(0)
+	RowVisitor(const CSoundFile &sf, SEQUENCEINDEX sequence = SEQUENCEINDEX_INVALID) : sndFile(sf), cache(nullptr), currentOrder(0)
 	{
 		Initialize(true, sequence);
 	};
 
-	RowVisitor(const RowVisitor &other) : sndFile(other.sndFile), Order(other.Order), visitedRows(other.visitedRows), visitOrder(other.visitOrder), currentOrder(other.currentOrder) { };
+	// Use the memory of a previous RowVisitor, and give it back when done.
+	RowVisitor(const CSoundFile &sf, SEQUENCEINDEX sequence, MemoryCache &memoryCache);
+
+	RowVisitor(const RowVisitor &other) : sndFile(other.sndFile), Order(other.Order), cache(nullptr), memory(other.memory), visitOrder(other.visitOrder), currentOrder(other.currentOrder) { };
+
+	~RowVisitor();
 
 	// Resize / Clear the row vector.
 	// If reset is true, the vector is not only resized to the required dimensions, but also completely cleared (i.e. all visited rows are unset).
@@ -79,9 +121,24 @@ public:
 	// Retrieve visited rows vector from another RowVisitor object.
 	void Set(const RowVisitor &other)
 	{
-		visitedRows = other.visitedRows;
+		memory.orderStart = other.memory.orderStart;
+		memory.bits = other.memory.bits;
+		memory.wordGeneration = other.memory.wordGeneration;
+		memory.generation = other.memory.generation;
 	}
 
+	// Retrieve all rows that have been visited, except for those that have also been visited in another RowVisitor object.
+	VisitedRowsType GetVisitedRowsExcept(const RowVisitor &other) const;
+
+	// Retrieve a compact copy of all rows that have been visited.
+	VisitedRowsType GetVisitedRows() const;
+
+	// Append the bit set words that contain the rows of an order.
+	void GetOrderWords(ORDERINDEX order, VisitedRowsType::WordList &words) const;
+
+	// Replace the visited rows vector, e.g. with a copy obtained from GetVisitedRowsExcept().
+	void SetVisitedRows(const VisitedRowsType &rows);
+
 	// Set all rows of a previous pattern loop as unvisited.
 	void ResetPatternLoop(ORDERINDEX order, ROWINDEX startRow);
 
@@ -95,6 +152,45 @@ protected:
 	// Add a row to the visited row memory for this pattern.
 	void AddVisitedRow(ORDERINDEX order, ROWINDEX row);
 
+	// Unset all rows.
+	void NextGeneration();
+
+	// Number of rows of an order in the current layout, or 0 if the order is not part of it.
+	ROWINDEX GetNumRows(ORDERINDEX order) const
+	{
+		return (order + 1u < memory.orderStart.size()) ? (memory.orderStart[order + 1] - memory.orderStart[order]) : 0;
+	}
+
+	bool GetBit(uint32 pos) const
+	{
+		const uint32 word = pos / 64u;
+		return memory.wordGeneration[word] == memory.generation && ((memory.bits[word] >> (pos % 64u)) & 1) != 0;
+	}
+
+	void SetBit(uint32 pos, bool visited)
+	{
+		const uint32 word = pos / 64u;
+		if(memory.wordGeneration[word] != memory.generation)
+		{
+			memory.bits[word] = 0;
+			memory.wordGeneration[word] = memory.generation;
+		}
+		const uint64 mask = uint64(1) << (pos % 64u);
+		if(visited)
+			memory.bits[word] |= mask;
+		else
+			memory.bits[word] &= ~mask;
+	}
+
+};
+
+
+class RowVisitor::MemoryCache
+{
+	friend class RowVisitor;
+protected:
+	Memory memory;
+	Util::mutex cacheMutex;
 };
 
 OPENMPT_NAMESPACE_END
@@ -0,0 +1,210 @@
+/*
+ * SampleDataStore.cpp
+ * -------------------
+ * Purpose: Process-wide store of read-only sample data that is shared between modules.
+ * Notes  : Buffers are identified by a hash of their complete contents, including the pre-computed loop wrap-around
+ *          buffers, and are only shared if they are actually identical, so hash collisions are harmless.
+ *          When the same module (or a module containing the same samples) is opened many times, the sample memory
+ *          only grows with the number of distinct samples.
+ *          A shared buffer is reference-counted and freed by ModSample::FreeSample() when its last user releases it.
+ *          Code that modifies sample data has to call MakeUnique() first (copy-on-write).
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+#include "Sndfile.h"
+#include "SampleDataStore.h"
+#include "../common/mutex.h"
+#include <map>
+
+OPENMPT_NAMESPACE_BEGIN
+
+
+namespace SampleDataStore
+{
+
+namespace
+{
+
+struct Buffer
+{
+	uint64 hash;
+	size_t size;		// Real buffer size in bytes, including the lookahead buffers
+	uint32 refCount;
+};
+
+struct Store
+{
+	Util::mutex mutex;
+	std::map<const void *, Buffer> buffers;			// Keyed by sample pointer (ModSample::pSample)
+	std::multimap<uint64, const void *> hashes;
+	size_t memoryUsage;
+
+	Store() : memoryUsage(0) { }
+};
+
+Store &GetStore()
+{
+	static Store store;
+	return store;
+}
+
+// The actual allocation starts before the sample pointer, see ModSample::AllocateSample()
+const char *GetBufferStart(const void *samplePtr)
+{
+	return static_cast<const char *>(samplePtr) - (InterpolationMaxLookahead * MaxSamplingPointSize);
+}
+
+// 64-bit FNV-1a, processing eight bytes at a time
+uint64 HashBuffer(const char *data, size_t size)
+{
+	const uint64 prime = 1099511628211ull;
+	uint64 hash = 14695981039346656037ull ^ size;
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8)
+	{
+		uint64 v;
+		std::memcpy(&v, data + i, 8);
+		hash = (hash ^ v) * prime;
+	}
+	for(; i < size; i++)
+	{
+		hash = (hash ^ static_cast<uint8>(data[i])) * prime;
+	}
+	return hash;
+}
+
+} // unnamed namespace
+
+
+void Share(ModSample &sample)
+//---------------------------
+{
+	if(!sample.HasSampleData() || IsShared(sample.pSample))
+	{
+		return;
+	}
+	const size_t size = ModSample::GetRealSampleBufferSize(sample.nLength, sample.GetBytesPerSample());
+	if(size == 0)
+	{
+		return;
+	}
+	const char *data = GetBufferStart(sample.pSample);
+	const uint64 hash = HashBuffer(data, size);
+
+	void *ownSample = nullptr;
+	{
+		Store &store = GetStore();
+		Util::lock_guard<Util::mutex> guard(store.mutex);
+		typedef std::multimap<uint64, const void *>::const_iterator HashIterator;
+		const std::pair<HashIterator, HashIterator> candidates = store.hashes.equal_range(hash);
+		for(HashIterator candidate = candidates.first; candidate != candidates.second; candidate++)
+		{
+			Buffer &buffer = store.buffers[candidate->second];
+			if(buffer.size == size && !std::memcmp(GetBufferStart(candidate->second), data, size))
+			{
+				buffer.refCount++;
+				ownSample = sample.pSample;
+				sample.pSample = const_cast<void *>(candidate->second);
+				break;
+			}
+		}
+		if(ownSample == nullptr)
+		{
+			const Buffer buffer = { hash, size, 1 };
+			store.buffers[sample.pSample] = buffer;
+			store.hashes.insert(std::make_pair(hash, sample.pSample));
+			store.memoryUsage += size;
+		}
+	}
+	// Not in the store, so this really frees the buffer.
+	ModSample::FreeSample(ownSample);
+}
+
+
+bool MakeUnique(ModSample &sample)
+//--------------------------------
+{
+	if(!IsShared(sample.pSample))
+	{
+		return false;
+	}
+	void *newSample = ModSample::AllocateSample(sample.nLength, sample.GetBytesPerSample());
+	if(newSample == nullptr)
+	{
+		return false;
+	}
+	const size_t size = ModSample::GetRealSampleBufferSize(sample.nLength, sample.GetBytesPerSample());
+	std::memcpy(const_cast<char *>(GetBufferStart(newSample)), GetBufferStart(sample.pSample), size);
+	Release(sample.pSample);
+	sample.pSample = newSample;
+	return true;
+}
+
+
+bool Release(void *samplePtr)
+//---------------------------
+{
+	Store &store = GetStore();
+	Util::lock_guard<Util::mutex> guard(store.mutex);
+	std::map<const void *, Buffer>::iterator buffer = store.buffers.find(samplePtr);
+	if(buffer == store.buffers.end())
+	{
+		return false;
+	}
+	if(--buffer->second.refCount == 0)
+	{
+		typedef std::multimap<uint64, const void *>::iterator HashIterator;
+		const std::pair<HashIterator, HashIterator> range = store.hashes.equal_range(buffer->second.hash);
+		for(HashIterator entry = range.first; entry != range.second; entry++)
+		{
+			if(entry->second == samplePtr)
+			{
+				store.hashes.erase(entry);
+				break;
+			}
+		}
+		store.memoryUsage -= buffer->second.size;
+		store.buffers.erase(buffer);
+		delete[] GetBufferStart(samplePtr);
+	}
+	return true;
+}
+
+
+bool IsShared(const void *samplePtr)
+//----------------------------------
+{
+	if(samplePtr == nullptr)
+	{
+		return false;
+	}
+	Store &store = GetStore();
+	Util::lock_guard<Util::mutex> guard(store.mutex);
+	return store.buffers.find(samplePtr) != store.buffers.end();
+}
+
+
+size_t GetNumBuffers()
+//--------------------
+{
+	Store &store = GetStore();
+	Util::lock_guard<Util::mutex> guard(store.mutex);
+	return store.buffers.size();
+}
+
+
+size_t GetMemoryUsage()
+//---------------------
+{
+	Store &store = GetStore();
+	Util::lock_guard<Util::mutex> guard(store.mutex);
+	return store.memoryUsage;
+}
+
+} // namespace SampleDataStore
+
+
+OPENMPT_NAMESPACE_END
@@ -0,0 +1,42 @@
+/*
+ * SampleDataStore.h
+ * -----------------
+ * Purpose: Process-wide store of read-only sample data that is shared between modules.
+ * Notes  : See implementation file.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+OPENMPT_NAMESPACE_BEGIN
+
+struct ModSample;
+
+
+namespace SampleDataStore
+{
+
+// Replace the sample's buffer by an identical buffer from the store if there is one, or add the sample's buffer to the store otherwise.
+// From then on, the buffer must be treated as read-only; call MakeUnique() before modifying it.
+// Only use this for samples that are not edited afterwards, i.e. not in the tracker.
+void Share(ModSample &sample);
+
+// Give the sample a private copy of its buffer if it is shared. Returns true if the buffer has been replaced.
+bool MakeUnique(ModSample &sample);
+
+// Drop one reference to a shared buffer. Returns false if samplePtr is not a shared buffer, i.e. the caller still owns it.
+bool Release(void *samplePtr);
+
+// Returns true if samplePtr is a shared buffer.
+bool IsShared(const void *samplePtr);
+
+// Number of distinct buffers and total number of bytes in the store
+size_t GetNumBuffers();
+size_t GetMemoryUsage();
+
+} // namespace SampleDataStore
+
+
+OPENMPT_NAMESPACE_END
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include "SampleFormatConvertersSIMD.h"
+
 
 OPENMPT_NAMESPACE_BEGIN
 
@@ -603,6 +605,134 @@ struct ConversionChain
 
 
 
+// Decode as many samples as possible at once using the bulk decoders from SampleFormatConvertersSIMD.h.
+// Returns the number of decoded samples, the remaining samples have to be decoded one by one using the functor.
+// If the functor is not stateless, each channel has to be decoded separately.
+template <typename SampleConversion>
+struct BulkDecode
+{
+	static const bool stateless = false;
+	forceinline size_t operator() (typename SampleConversion::output_t *, const char *, size_t, SampleConversion &)
+	{
+		return 0;
+	}
+};
+
+template <>
+struct BulkDecode<DecodeInt8>
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int8 *outBuf, const char *inBuf, size_t count, DecodeInt8 &)
+	{
+		return DecodeInt8Bulk(outBuf, inBuf, count, 0);
+	}
+};
+
+template <>
+struct BulkDecode<DecodeUint8>
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int8 *outBuf, const char *inBuf, size_t count, DecodeUint8 &)
+	{
+		return DecodeInt8Bulk(outBuf, inBuf, count, 0x80);
+	}
+};
+
+template <>
+struct BulkDecode<DecodeInt8Delta>
+{
+	static const bool stateless = false;
+	forceinline size_t operator() (int8 *outBuf, const char *inBuf, size_t count, DecodeInt8Delta &conv)
+	{
+		return DecodeInt8DeltaBulk(outBuf, inBuf, count, conv.delta);
+	}
+};
+
+template <uint16 offset>
+struct BulkDecode<DecodeInt16<offset, littleEndian16> >
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, DecodeInt16<offset, littleEndian16> &)
+	{
+		STATIC_ASSERT(offset == 0 || offset == 0x8000u);
+		return DecodeInt16Bulk(outBuf, inBuf, count, false, offset);
+	}
+};
+
+template <uint16 offset>
+struct BulkDecode<DecodeInt16<offset, bigEndian16> >
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, DecodeInt16<offset, bigEndian16> &)
+	{
+		STATIC_ASSERT(offset == 0 || offset == 0x8000u);
+		return DecodeInt16Bulk(outBuf, inBuf, count, true, offset);
+	}
+};
+
+template <>
+struct BulkDecode<DecodeInt16Delta<littleEndian16> >
+{
+	static const bool stateless = false;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, DecodeInt16Delta<littleEndian16> &conv)
+	{
+		return DecodeInt16DeltaBulk(outBuf, inBuf, count, false, conv.delta);
+	}
+};
+
+template <>
+struct BulkDecode<DecodeInt16Delta<bigEndian16> >
+{
+	static const bool stateless = false;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, DecodeInt16Delta<bigEndian16> &conv)
+	{
+		return DecodeInt16DeltaBulk(outBuf, inBuf, count, true, conv.delta);
+	}
+};
+
+template <>
+struct BulkDecode<ConversionChain<Convert<int16, int32>, DecodeInt24<0, littleEndian24> > >
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, ConversionChain<Convert<int16, int32>, DecodeInt24<0, littleEndian24> > &)
+	{
+		return DecodeInt24ToInt16Bulk(outBuf, inBuf, count, false);
+	}
+};
+
+template <>
+struct BulkDecode<ConversionChain<Convert<int16, int32>, DecodeInt24<0, bigEndian24> > >
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, ConversionChain<Convert<int16, int32>, DecodeInt24<0, bigEndian24> > &)
+	{
+		return DecodeInt24ToInt16Bulk(outBuf, inBuf, count, true);
+	}
+};
+
+template <>
+struct BulkDecode<ConversionChain<Convert<int16, float32>, DecodeFloat32<littleEndian32> > >
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, ConversionChain<Convert<int16, float32>, DecodeFloat32<littleEndian32> > &)
+	{
+		return DecodeFloat32ToInt16Bulk(outBuf, inBuf, count, false);
+	}
+};
+
+template <>
+struct BulkDecode<ConversionChain<Convert<int16, float32>, DecodeFloat32<bigEndian32> > >
+{
+	static const bool stateless = true;
+	forceinline size_t operator() (int16 *outBuf, const char *inBuf, size_t count, ConversionChain<Convert<int16, float32>, DecodeFloat32<bigEndian32> > &)
+	{
+		return DecodeFloat32ToInt16Bulk(outBuf, inBuf, count, true);
+	}
+};
+
+
+
+
 template <typename Tsample>
 struct Normalize;
 
@@ -804,6 +934,10 @@ size_t CopyMonoSample(ModSample &sample, const char *sourceBuffer, size_t source
 	SampleConversion sampleConv(conv);
 	const char * MPT_RESTRICT inBuf = sourceBuffer;
 	typename SampleConversion::output_t * MPT_RESTRICT outBuf = static_cast<typename SampleConversion::output_t *>(sample.pSample);
+	const size_t bulkFrames = SC::BulkDecode<SampleConversion>()(outBuf, inBuf, numFrames, sampleConv);
+	inBuf += bulkFrames * SampleConversion::input_inc;
+	outBuf += bulkFrames;
+	numFrames -= bulkFrames;
 	while(numFrames--)
 	{
 		*outBuf = sampleConv(inBuf);
@@ -829,6 +963,14 @@ size_t CopyStereoInterleavedSample(ModSample &sample, const char *sourceBuffer,
 	SampleConversion sampleConvRight(conv);
 	const char * MPT_RESTRICT inBuf = sourceBuffer;
 	typename SampleConversion::output_t * MPT_RESTRICT outBuf = static_cast<typename SampleConversion::output_t *>(sample.pSample);
+	if(SC::BulkDecode<SampleConversion>::stateless)
+	{
+		// Both channels can be decoded at once
+		const size_t bulkFrames = SC::BulkDecode<SampleConversion>()(outBuf, inBuf, numFrames * 2, sampleConvLeft) / 2;
+		inBuf += bulkFrames * frameSize;
+		outBuf += bulkFrames * 2;
+		numFrames -= bulkFrames;
+	}
 	while(numFrames--)
 	{
 		*outBuf = sampleConvLeft(inBuf);
@@ -842,6 +984,34 @@ size_t CopyStereoInterleavedSample(ModSample &sample, const char *sourceBuffer,
 }
 
 
+// Copy one channel of a stereo split sample data buffer to every other sample of outBuf.
+template <typename SampleConversion>
+void CopyStereoSplitChannel(typename SampleConversion::output_t * MPT_RESTRICT outBuf, const char * MPT_RESTRICT inBuf, size_t numSamples, SampleConversion &sampleConv)
+//-----------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	// The bulk decoders only write contiguous output, so decode blocks of samples and spread them out from there.
+	typename SampleConversion::output_t block[256];
+	while(numSamples > 0)
+	{
+		const size_t blockSize = std::min<size_t>(numSamples, CountOf(block));
+		const size_t bulkSamples = SC::BulkDecode<SampleConversion>()(block, inBuf, blockSize, sampleConv);
+		for(size_t i = 0; i < bulkSamples; i++)
+		{
+			*outBuf = block[i];
+			outBuf += 2;
+		}
+		inBuf += bulkSamples * SampleConversion::input_inc;
+		for(size_t i = bulkSamples; i < blockSize; i++)
+		{
+			*outBuf = sampleConv(inBuf);
+			inBuf += SampleConversion::input_inc;
+			outBuf += 2;
+		}
+		numSamples -= blockSize;
+	}
+}
+
+
 // Copy a stereo split sample data buffer.
 template <typename SampleConversion>
 size_t CopyStereoSplitSample(ModSample &sample, const char *sourceBuffer, size_t sourceSize, SampleConversion conv = SampleConversion())
@@ -856,27 +1026,13 @@ size_t CopyStereoSplitSample(ModSample &sample, const char *sourceBuffer, size_t
 	const size_t countSamplesLeft = sourceSizeLeft / sampleSize;
 	const size_t countSamplesRight = sourceSizeRight / sampleSize;
 
-	size_t numSamplesLeft = countSamplesLeft;
 	SampleConversion sampleConvLeft(conv);
-	const char * MPT_RESTRICT inBufLeft = sourceBuffer;
-	typename SampleConversion::output_t * MPT_RESTRICT outBufLeft = static_cast<typename SampleConversion::output_t *>(sample.pSample);
-	while(numSamplesLeft--)
-	{
-		*outBufLeft = sampleConvLeft(inBufLeft);
-		inBufLeft += SampleConversion::input_inc;
-		outBufLeft += 2;
-	}
+	typename SampleConversion::output_t *outBufLeft = static_cast<typename SampleConversion::output_t *>(sample.pSample);
+	CopyStereoSplitChannel(outBufLeft, sourceBuffer, countSamplesLeft, sampleConvLeft);
 
-	size_t numSamplesRight = countSamplesRight;
 	SampleConversion sampleConvRight(conv);
-	const char * MPT_RESTRICT inBufRight = sourceBuffer + sample.nLength * SampleConversion::input_inc;
-	typename SampleConversion::output_t * MPT_RESTRICT outBufRight = static_cast<typename SampleConversion::output_t *>(sample.pSample) + 1;
-	while(numSamplesRight--)
-	{
-		*outBufRight = sampleConvRight(inBufRight);
-		inBufRight += SampleConversion::input_inc;
-		outBufRight += 2;
-	}
+	typename SampleConversion::output_t *outBufRight = static_cast<typename SampleConversion::output_t *>(sample.pSample) + 1;
+	CopyStereoSplitChannel(outBufRight, sourceBuffer + sample.nLength * SampleConversion::input_inc, countSamplesRight, sampleConvRight);
 
 	return (countSamplesLeft + countSamplesRight) * sampleSize;
 }
@@ -0,0 +1,282 @@
+/*
+ * SampleFormatConvertersSIMD.cpp
+ * ------------------------------
+ * Purpose: Bulk versions of the most common sample decoding functors from SampleFormatConverters.h.
+ * Notes  : Decoding uncompressed sample data one sample at a time through the functors is the bottleneck when
+ *          loading modules or instruments with large samples. These functions decode whole blocks of samples
+ *          using SSE4.1 (byte swapping, sign conversion, 24-bit and float to 16-bit conversion, delta decoding
+ *          using a prefix sum), and the copy functions in SampleFormatConverters.h use them through SC::BulkDecode.
+ *          Like in IntMixerSIMD.cpp, the SIMD code is compiled using function-specific target attributes and only
+ *          used if GetProcSupport() reports the required CPU features.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+#include "SampleFormatConvertersSIMD.h"
+#include "../common/misc_util.h"
+#include <cstring>
+#ifdef ENABLE_SSE4
+#include <smmintrin.h>
+#endif
+
+
+OPENMPT_NAMESPACE_BEGIN
+
+
+namespace SC
+{
+
+
+#ifdef ENABLE_SSE4
+
+MPT_TARGET_SSE4 static std::size_t SSE4_DecodeInt8(int8 *outBuf, const char *inBuf, std::size_t count, uint8 xorMask)
+//-------------------------------------------------------------------------------------------------------------------
+{
+	const __m128i mask = _mm_set1_epi8(static_cast<char>(xorMask));
+	std::size_t i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuf + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuf + i), _mm_xor_si128(v, mask));
+	}
+	return i;
+}
+
+
+MPT_TARGET_SSE4 static std::size_t SSE4_DecodeInt8Delta(int8 *outBuf, const char *inBuf, std::size_t count, uint8 &delta)
+//-----------------------------------------------------------------------------------------------------------------------
+{
+	const __m128i broadcastLast = _mm_set1_epi8(15);
+	__m128i carry = _mm_set1_epi8(static_cast<char>(delta));
+	std::size_t i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuf + i));
+		// Prefix sum
+		v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+		v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+		v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+		v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+		v = _mm_add_epi8(v, carry);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuf + i), v);
+		carry = _mm_shuffle_epi8(v, broadcastLast);
+	}
+	delta = static_cast<uint8>(_mm_cvtsi128_si32(carry));
+	return i;
+}
+
+
+MPT_TARGET_SSE4 static std::size_t SSE4_DecodeInt16(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian, uint16 xorMask)
+//-------------------------------------------------------------------------------------------------------------------------------------
+{
+	const __m128i mask = _mm_set1_epi16(static_cast<int16>(xorMask));
+	const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	std::size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuf + i * 2));
+		if(bigEndian)
+		{
+			v = _mm_shuffle_epi8(v, swap);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuf + i), _mm_xor_si128(v, mask));
+	}
+	return i;
+}
+
+
+MPT_TARGET_SSE4 static std::size_t SSE4_DecodeInt16Delta(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian, uint16 &delta)
+//-----------------------------------------------------------------------------------------------------------------------------------------
+{
+	const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	const __m128i broadcastLast = _mm_setr_epi8(14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15);
+	__m128i carry = _mm_set1_epi16(static_cast<int16>(delta));
+	std::size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuf + i * 2));
+		if(bigEndian)
+		{
+			v = _mm_shuffle_epi8(v, swap);
+		}
+		// Prefix sum
+		v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+		v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+		v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+		v = _mm_add_epi16(v, carry);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuf + i), v);
+		carry = _mm_shuffle_epi8(v, broadcastLast);
+	}
+	delta = static_cast<uint16>(_mm_cvtsi128_si32(carry));
+	return i;
+}
+
+
+MPT_TARGET_SSE4 static std::size_t SSE4_DecodeInt24ToInt16(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian)
+//----------------------------------------------------------------------------------------------------------------------------
+{
+	// Keep the two most significant bytes of four samples
+	const __m128i select = bigEndian
+		? _mm_setr_epi8(1, 0, 4, 3, 7, 6, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1)
+		: _mm_setr_epi8(1, 2, 4, 5, 7, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1);
+	std::size_t i = 0;
+	// The second load reads four bytes beyond the eighth sample.
+	for(; i + 10 <= count; i += 8)
+	{
+		const char *src = inBuf + i * 3;
+		const __m128i lo = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)), select);
+		const __m128i hi = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12)), select);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuf + i), _mm_unpacklo_epi64(lo, hi));
+	}
+	return i;
+}
+
+
+MPT_TARGET_SSE4 static std::size_t SSE4_DecodeFloat32ToInt16(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian)
+//------------------------------------------------------------------------------------------------------------------------------
+{
+	const __m128i swap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const __m128 minVal = _mm_set1_ps(-1.0f), maxVal = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(65536.0f), one = _mm_set1_ps(1.0f);
+	std::size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuf + i * 4));
+		__m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuf + i * 4 + 16));
+		if(bigEndian)
+		{
+			v1 = _mm_shuffle_epi8(v1, swap);
+			v2 = _mm_shuffle_epi8(v2, swap);
+		}
+		// Same as Convert<int16, float32>: Clamp, then round by computing (val * 65536 + 1) / 2.
+		// NaN becomes -1 here (the scalar code leaves it to the compiler's float-to-int conversion).
+		__m128 f1 = _mm_min_ps(_mm_max_ps(_mm_castsi128_ps(v1), minVal), maxVal);
+		__m128 f2 = _mm_min_ps(_mm_max_ps(_mm_castsi128_ps(v2), minVal), maxVal);
+		f1 = _mm_add_ps(_mm_mul_ps(f1, scale), one);
+		f2 = _mm_add_ps(_mm_mul_ps(f2, scale), one);
+		const __m128i i1 = _mm_srai_epi32(_mm_cvttps_epi32(f1), 1);
+		const __m128i i2 = _mm_srai_epi32(_mm_cvttps_epi32(f2), 1);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuf + i), _mm_packs_epi32(i1, i2));
+	}
+	return i;
+}
+
+#endif // ENABLE_SSE4
+
+
+std::size_t DecodeInt8Bulk(int8 *outBuf, const char *inBuf, std::size_t count, uint8 xorMask)
+//-------------------------------------------------------------------------------------------
+{
+	if(xorMask == 0)
+	{
+		std::memcpy(outBuf, inBuf, count);
+		return count;
+	}
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return SSE4_DecodeInt8(outBuf, inBuf, count, xorMask);
+	}
+#endif // ENABLE_SSE4
+	return 0;
+}
+
+
+std::size_t DecodeInt8DeltaBulk(int8 *outBuf, const char *inBuf, std::size_t count, uint8 &delta)
+//-----------------------------------------------------------------------------------------------
+{
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return SSE4_DecodeInt8Delta(outBuf, inBuf, count, delta);
+	}
+#else
+	MPT_UNREFERENCED_PARAMETER(outBuf);
+	MPT_UNREFERENCED_PARAMETER(inBuf);
+	MPT_UNREFERENCED_PARAMETER(count);
+	MPT_UNREFERENCED_PARAMETER(delta);
+#endif // ENABLE_SSE4
+	return 0;
+}
+
+
+std::size_t DecodeInt16Bulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian, uint16 xorMask)
+//--------------------------------------------------------------------------------------------------------------
+{
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return SSE4_DecodeInt16(outBuf, inBuf, count, bigEndian, xorMask);
+	}
+#else
+	MPT_UNREFERENCED_PARAMETER(outBuf);
+	MPT_UNREFERENCED_PARAMETER(inBuf);
+	MPT_UNREFERENCED_PARAMETER(count);
+	MPT_UNREFERENCED_PARAMETER(bigEndian);
+	MPT_UNREFERENCED_PARAMETER(xorMask);
+#endif // ENABLE_SSE4
+	return 0;
+}
+
+
+std::size_t DecodeInt16DeltaBulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian, uint16 &delta)
+//------------------------------------------------------------------------------------------------------------------
+{
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return SSE4_DecodeInt16Delta(outBuf, inBuf, count, bigEndian, delta);
+	}
+#else
+	MPT_UNREFERENCED_PARAMETER(outBuf);
+	MPT_UNREFERENCED_PARAMETER(inBuf);
+	MPT_UNREFERENCED_PARAMETER(count);
+	MPT_UNREFERENCED_PARAMETER(bigEndian);
+	MPT_UNREFERENCED_PARAMETER(delta);
+#endif // ENABLE_SSE4
+	return 0;
+}
+
+
+std::size_t DecodeInt24ToInt16Bulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian)
+//-----------------------------------------------------------------------------------------------------
+{
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return SSE4_DecodeInt24ToInt16(outBuf, inBuf, count, bigEndian);
+	}
+#else
+	MPT_UNREFERENCED_PARAMETER(outBuf);
+	MPT_UNREFERENCED_PARAMETER(inBuf);
+	MPT_UNREFERENCED_PARAMETER(count);
+	MPT_UNREFERENCED_PARAMETER(bigEndian);
+#endif // ENABLE_SSE4
+	return 0;
+}
+
+
+std::size_t DecodeFloat32ToInt16Bulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian)
+//-------------------------------------------------------------------------------------------------------
+{
+#ifdef ENABLE_SSE4
+	if(GetProcSupport() & PROCSUPPORT_SSE4_1)
+	{
+		return SSE4_DecodeFloat32ToInt16(outBuf, inBuf, count, bigEndian);
+	}
+#else
+	MPT_UNREFERENCED_PARAMETER(outBuf);
+	MPT_UNREFERENCED_PARAMETER(inBuf);
+	MPT_UNREFERENCED_PARAMETER(count);
+	MPT_UNREFERENCED_PARAMETER(bigEndian);
+#endif // ENABLE_SSE4
+	return 0;
+}
+
+
+} // namespace SC
+
+
+OPENMPT_NAMESPACE_END
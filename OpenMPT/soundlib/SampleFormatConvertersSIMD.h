@@ -0,0 +1,41 @@
+/*
+ * SampleFormatConvertersSIMD.h
+ * ----------------------------
+ * Purpose: Bulk versions of the most common sample decoding functors from SampleFormatConverters.h.
+ * Notes  : See implementation file.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+OPENMPT_NAMESPACE_BEGIN
+
+
+namespace SC { // SC = _S_ample_C_onversion
+
+
+// Each function decodes up to count samples from inBuf to outBuf and returns the number of samples that have been decoded.
+// This may be less than count (or even 0 if the CPU does not support the required instructions),
+// in which case the caller has to decode the remaining samples with the corresponding functor.
+// The results are identical to those of the functors.
+
+// DecodeInt8 (xorMask = 0) and DecodeUint8 (xorMask = 0x80)
+std::size_t DecodeInt8Bulk(int8 *outBuf, const char *inBuf, std::size_t count, uint8 xorMask);
+// DecodeInt8Delta, continuing from and updating delta
+std::size_t DecodeInt8DeltaBulk(int8 *outBuf, const char *inBuf, std::size_t count, uint8 &delta);
+// DecodeInt16 with offset 0 (xorMask = 0) or 0x8000 (xorMask = 0x8000)
+std::size_t DecodeInt16Bulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian, uint16 xorMask);
+// DecodeInt16Delta, continuing from and updating delta
+std::size_t DecodeInt16DeltaBulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian, uint16 &delta);
+// DecodeInt24 followed by Convert<int16, int32>
+std::size_t DecodeInt24ToInt16Bulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian);
+// DecodeFloat32 followed by Convert<int16, float32>
+std::size_t DecodeFloat32ToInt16Bulk(int16 *outBuf, const char *inBuf, std::size_t count, bool bigEndian);
+
+
+} // namespace SC
+
+
+OPENMPT_NAMESPACE_END
@@ -578,6 +578,86 @@ size_t SampleIO::ReadSample(ModSample &sample, FileReader &file) const
 	return bytesRead;
 }
 
+
+// Calculate the size of the encoded sample data without decoding it.
+// Returns 0 if the size cannot be determined for this encoding without decoding the whole sample.
+size_t SampleIO::CalculateEncodedSize(SmpLength length, FileReader file) const
+//----------------------------------------------------------------------------
+{
+	LimitMax(length, MAX_SAMPLE_LENGTH);
+
+	switch(GetEncoding())
+	{
+	case signedPCM:
+	case unsignedPCM:
+	case deltaPCM:
+	case floatPCM:
+	case PCM7to8:
+	case floatPCM15:
+	case floatPCM23:
+	case floatPCMnormalize:
+	case signedPCMnormalize:
+		return static_cast<size_t>(std::min<FileReader::off_t>(static_cast<FileReader::off_t>(length) * (GetBitDepth() / 8) * GetNumChannels(), file.BytesLeft()));
+
+	case IT214:
+	case IT215:
+		{
+			// Every channel is stored in blocks that are prefixed with their compressed size
+			// and (except for the last block) decompress to ITCompression::blockSize bytes.
+			const FileReader::off_t filePosition = file.GetPosition();
+			const SmpLength blockLength = static_cast<SmpLength>(ITCompression::blockSize / (GetBitDepth() / 8));
+			for(uint8 chn = 0; chn < GetNumChannels(); chn++)
+			{
+				for(SmpLength remaining = length; remaining > 0 && file.AreBytesLeft(); remaining -= std::min(remaining, blockLength))
+				{
+					file.Skip(file.ReadUint16LE());
+				}
+			}
+			return static_cast<size_t>(file.GetPosition() - filePosition);
+		}
+
+	case ADPCM:
+		// 16-byte compression table followed by two samples per byte
+		if(*this != SampleIO(_8bit, mono, littleEndian, ADPCM) || !file.CanRead(16))
+		{
+			return 0;
+		}
+		return static_cast<size_t>(16 + std::min<FileReader::off_t>((length + 1) / 2, file.BytesLeft() - 16));
+
+	case PTM8Dto16:
+		// One 8-bit delta value for each byte of the 16-bit sample
+		if(GetChannelFormat() != mono || GetBitDepth() != 16)
+		{
+			return 0;
+		}
+		return static_cast<size_t>(std::min<FileReader::off_t>(static_cast<FileReader::off_t>(length) * 2, file.BytesLeft()));
+
+	case AMS:
+		// The packed size is stored in the header
+		if(GetChannelFormat() != mono || !file.CanRead(10))
+		{
+			return 0;
+		}
+		{
+			file.Skip(4);
+			const uint32 packedSize = file.ReadUint32LE();
+			return static_cast<size_t>(9 + std::min<FileReader::off_t>(packedSize, file.BytesLeft() - 1));
+		}
+
+	case MDL:
+		// The bit stream is not terminated, so the decoder is given all remaining data
+		if(GetChannelFormat() != mono || GetBitDepth() > 16 || !file.CanRead(5))
+		{
+			return 0;
+		}
+		return static_cast<size_t>(file.BytesLeft());
+
+	default:
+		// DMF Huffman streams have to be decoded to find their end, MT2 only post-processes data that has already been read.
+		return 0;
+	}
+}
+
 #if MPT_COMPILER_GCC
 #if MPT_GCC_AT_LEAST(4,6,0)
 #pragma GCC diagnostic pop
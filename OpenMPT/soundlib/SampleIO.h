@@ -95,6 +95,7 @@ public:
 	}
 
 	SampleIO(const SampleIO &other) : format(other.format) { }
+	SampleIO &operator= (const SampleIO &other) { format = other.format; return *this; }
 
 	bool operator== (const SampleIO &other) const
 	{
@@ -168,6 +169,10 @@ public:
 	// Read a sample from memory
 	size_t ReadSample(ModSample &sample, FileReader &file) const;
 
+	// Calculate the size of the encoded sample data without decoding it (e.g. to find data following it in the file).
+	// Returns 0 if the size cannot be determined for this encoding without decoding the whole sample.
+	size_t CalculateEncodedSize(SmpLength length, FileReader file) const;
+
 #ifndef MODPLUG_NO_FILESAVE
 	// Write a sample to file
 	size_t WriteSample(FILE *f, const ModSample &sample, SmpLength maxSamples = 0) const;
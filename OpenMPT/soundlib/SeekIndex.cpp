@@ -0,0 +1,741 @@
+/*
+ * SeekIndex.cpp
+ * -------------
+ * Purpose: Checkpoints of the song length calculation state, used for speeding up seeking and incremental song length calculation.
+ * Notes  : When calculating the length of all sub songs, GetLength() can store its complete state every few seconds.
+ *          Later seeks within the same sub song can then resume from the latest checkpoint before the seek target
+ *          instead of parsing the whole song from the start again, which makes seeking in long modules much faster.
+ *
+ *          A checkpoint is only used if the seek run from the start of the sub song would have passed through exactly
+ *          the same state, i.e. the rows visited since the start of the sub song are stored along with the checkpoint
+ *          (this way, loop detection works as if the song was parsed from the start), and checkpoints are only valid
+ *          for the mixing frequency and tempo settings they were recorded with.
+ *
+ *          The song length cache works similarly: When calculating the length of a single song, GetLength() stores its
+ *          state whenever it enters another order, along with the orders it looked at until it entered the next one.
+ *          After the song has been modified, the calculation resumes from the first order entry that was followed by a
+ *          modified order. As soon as it enters an order with exactly the same state as in the previous calculation
+ *          (apart from the elapsed time), and no modified order was played after that point, the rest of the song is
+ *          known to play exactly as before, so the previous result can be taken over.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+#include "Sndfile.h"
+#include "SeekIndex.h"
+
+OPENMPT_NAMESPACE_BEGIN
+
+
+// Initial minimum distance between two checkpoints in seconds
+static const double SeekIndexMinInterval = 1.0;
+
+
+static uint32 GetTempoFactor(const CSoundFile &sndFile)
+//-----------------------------------------------------
+{
+#ifndef MODPLUG_TRACKER
+	return sndFile.m_nTempoFactor;
+#else
+	MPT_UNREFERENCED_PARAMETER(sndFile);
+	return 65536;
+#endif // MODPLUG_TRACKER
+}
+
+
+void SeekIndex::ChnMemory::Save(const ModChannel &chn)
+//----------------------------------------------------
+{
+	nOldGlobalVolSlide = chn.nOldGlobalVolSlide;
+	nGlobalVol = chn.nGlobalVol;
+	nPortamentoSlide = chn.nPortamentoSlide;
+	nPatternLoop = chn.nPatternLoop;
+	nPatternLoopCount = chn.nPatternLoopCount;
+	nNewIns = chn.nNewIns;
+	nLastNote = chn.nLastNote;
+	nOldTempo = chn.nOldTempo;
+	nOldHiOffset = chn.nOldHiOffset;
+	nOldOffset = chn.nOldOffset;
+	nOldPortaUpDown = chn.nOldPortaUpDown;
+	nOldVolumeSlide = chn.nOldVolumeSlide;
+	nOldChnVolSlide = chn.nOldChnVolSlide;
+}
+
+
+void SeekIndex::ChnMemory::Restore(ModChannel &chn) const
+//-------------------------------------------------------
+{
+	chn.nOldGlobalVolSlide = nOldGlobalVolSlide;
+	chn.nGlobalVol = nGlobalVol;
+	chn.nPortamentoSlide = nPortamentoSlide;
+	chn.nPatternLoop = nPatternLoop;
+	chn.nPatternLoopCount = nPatternLoopCount;
+	chn.nNewIns = nNewIns;
+	chn.nLastNote = nLastNote;
+	chn.nOldTempo = nOldTempo;
+	chn.nOldHiOffset = nOldHiOffset;
+	chn.nOldOffset = nOldOffset;
+	chn.nOldPortaUpDown = nOldPortaUpDown;
+	chn.nOldVolumeSlide = nOldVolumeSlide;
+	chn.nOldChnVolSlide = nOldChnVolSlide;
+}
+
+
+bool SeekIndex::ChnMemory::operator== (const ChnMemory &other) const
+//------------------------------------------------------------------
+{
+	return nOldGlobalVolSlide == other.nOldGlobalVolSlide
+		&& nGlobalVol == other.nGlobalVol
+		&& nPortamentoSlide == other.nPortamentoSlide
+		&& nPatternLoop == other.nPatternLoop
+		&& nPatternLoopCount == other.nPatternLoopCount
+		&& nNewIns == other.nNewIns
+		&& nLastNote == other.nLastNote
+		&& nOldTempo == other.nOldTempo
+		&& nOldHiOffset == other.nOldHiOffset
+		&& nOldOffset == other.nOldOffset
+		&& nOldPortaUpDown == other.nOldPortaUpDown
+		&& nOldVolumeSlide == other.nOldVolumeSlide
+		&& nOldChnVolSlide == other.nOldChnVolSlide;
+}
+
+
+size_t SeekIndex::Checkpoint::GetMemoryUsage() const
+//--------------------------------------------------
+{
+	return sizeof(Checkpoint)
+		+ chnMemory.capacity() * sizeof(ChnMemory)
+		+ chnSettings.capacity() * sizeof(GetLengthChnSettings)
+		+ visitedRows.GetMemoryUsage();
+}
+
+
+SeekIndex::SeekIndex(const CSoundFile &sf)
+//----------------------------------------
+	: sndFile(sf)
+	, memoryLimit(0)
+	, memoryUsage(0)
+	, interval(SeekIndexMinInterval)
+	, mixingFreq(0)
+	, tempoFactor(0)
+	, recordedWithAdjust(false)
+{
+}
+
+
+// Set maximum memory consumption in bytes. 0 disables the index.
+void SeekIndex::SetMemoryLimit(size_t limit)
+//------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(indexMutex);
+	memoryLimit = limit;
+	if(memoryUsage > memoryLimit)
+	{
+		ClearLocked();
+	}
+}
+
+
+// Remove all checkpoints.
+void SeekIndex::Clear()
+//---------------------
+{
+	Util::lock_guard<Util::mutex> guard(indexMutex);
+	ClearLocked();
+}
+
+
+void SeekIndex::ClearLocked()
+//---------------------------
+{
+	subsongs.clear();
+	memoryUsage = 0;
+	interval = SeekIndexMinInterval;
+}
+
+
+// Returns true if checkpoints can be recorded or used with the current playback settings.
+bool SeekIndex::CanBeUsed(bool adjustSamplePositions) const
+//---------------------------------------------------------
+{
+	// Sample positions are not part of the checkpoints.
+	return IsEnabled() && !adjustSamplePositions;
+}
+
+
+// Start a new recording pass for the given sequence, replacing previously recorded checkpoints of this sequence.
+void SeekIndex::BeginRecording(Recorder &recorder, SEQUENCEINDEX sequence, bool adjust)
+//-------------------------------------------------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(indexMutex);
+	if(mixingFreq != sndFile.m_MixerSettings.gdwMixingFreq || tempoFactor != GetTempoFactor(sndFile) || recordedWithAdjust != adjust)
+	{
+		// Old checkpoints are useless with the new settings.
+		ClearLocked();
+		mixingFreq = sndFile.m_MixerSettings.gdwMixingFreq;
+		tempoFactor = GetTempoFactor(sndFile);
+		recordedWithAdjust = adjust;
+	}
+
+	std::vector<SubsongIndex>::iterator subsong = subsongs.begin();
+	while(subsong != subsongs.end())
+	{
+		if(subsong->sequence == sequence)
+		{
+			for(std::vector<Checkpoint>::const_iterator checkpoint = subsong->checkpoints.begin(); checkpoint != subsong->checkpoints.end(); checkpoint++)
+			{
+				memoryUsage -= checkpoint->GetMemoryUsage();
+			}
+			subsong = subsongs.erase(subsong);
+		} else
+		{
+			subsong++;
+		}
+	}
+	recorder.sequence = sequence;
+	recorder.active = false;
+}
+
+
+// Start recording checkpoints for a new sub song.
+void SeekIndex::BeginSubsong(Recorder &recorder, ORDERINDEX startOrder, ROWINDEX startRow)
+//----------------------------------------------------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(indexMutex);
+	SubsongIndex subsong;
+	subsong.sequence = recorder.sequence;
+	subsong.startOrder = startOrder;
+	subsong.startRow = startRow;
+	subsongs.push_back(subsong);
+	recorder.startOrder = startOrder;
+	recorder.startRow = startRow;
+	recorder.lastCheckpointTime = 0.0;
+	recorder.interval = interval;
+	recorder.active = true;
+}
+
+
+// Add a checkpoint to the recorder's current sub song.
+void SeekIndex::AddCheckpoint(Recorder &recorder, const Checkpoint &checkpoint)
+//-----------------------------------------------------------------------------
+{
+	if(!recorder.active)
+	{
+		return;
+	}
+	recorder.lastCheckpointTime = checkpoint.elapsedTime;
+
+	Util::lock_guard<Util::mutex> guard(indexMutex);
+	recorder.interval = interval;
+	if(checkpoint.GetMemoryUsage() > memoryLimit)
+	{
+		return;
+	}
+	// Other recorders may have added sub songs in the meantime, so look up the current one by its start position.
+	std::vector<SubsongIndex>::reverse_iterator subsong = subsongs.rbegin();
+	while(subsong != subsongs.rend() && (subsong->sequence != recorder.sequence || subsong->startOrder != recorder.startOrder || subsong->startRow != recorder.startRow))
+	{
+		subsong++;
+	}
+	if(subsong == subsongs.rend())
+	{
+		// The index has been cleared while recording.
+		recorder.active = false;
+		return;
+	}
+	std::vector<Checkpoint> &checkpoints = subsong->checkpoints;
+	checkpoints.push_back(checkpoint);
+	memoryUsage += checkpoints.back().GetMemoryUsage();
+	while(memoryUsage > memoryLimit)
+	{
+		Thin();
+	}
+	recorder.interval = interval;
+}
+
+
+// Drop every second checkpoint until the memory limit is satisfied.
+// If there is only one checkpoint per sub song left, the checkpoints of the last sub songs are dropped instead.
+void SeekIndex::Thin()
+//--------------------
+{
+	bool thinned = false;
+	for(std::vector<SubsongIndex>::iterator subsong = subsongs.begin(); subsong != subsongs.end(); subsong++)
+	{
+		std::vector<Checkpoint> &checkpoints = subsong->checkpoints;
+		if(checkpoints.size() < 2)
+		{
+			continue;
+		}
+		// Keep checkpoints 1, 3, 5, ... so that the remaining ones are spaced at twice the interval
+		size_t kept = 0;
+		for(size_t i = 0; i < checkpoints.size(); i++)
+		{
+			if(i % 2u)
+			{
+				std::swap(checkpoints[kept++], checkpoints[i]);
+			} else
+			{
+				memoryUsage -= checkpoints[i].GetMemoryUsage();
+			}
+		}
+		checkpoints.resize(kept);
+		thinned = true;
+	}
+
+	if(thinned)
+	{
+		interval *= 2.0;
+		return;
+	}
+
+	for(std::vector<SubsongIndex>::reverse_iterator subsong = subsongs.rbegin(); subsong != subsongs.rend(); subsong++)
+	{
+		if(!subsong->checkpoints.empty())
+		{
+			memoryUsage -= subsong->checkpoints.back().GetMemoryUsage();
+			subsong->checkpoints.clear();
+			return;
+		}
+	}
+	memoryUsage = 0;
+}
+
+
+// Find the latest checkpoint that lies before the target of a GetLength() call and copy it.
+bool SeekIndex::FindCheckpoint(SEQUENCEINDEX sequence, const GetLengthTarget &target, bool adjust, Checkpoint &checkpoint) const
+//----------------------------------------------------------------------------------------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(indexMutex);
+	if(mixingFreq != sndFile.m_MixerSettings.gdwMixingFreq || tempoFactor != GetTempoFactor(sndFile))
+	{
+		return false;
+	}
+
+	if(target.mode == GetLengthTarget::SeekPosition)
+	{
+		// Only targets that are marked as visited once they have been passed can be looked up.
+		const ModSequence &orderList = sndFile.Order.GetSequence(sequence);
+		if(target.pos.order >= orderList.GetLength()
+			|| !sndFile.Patterns.IsValidPat(orderList[target.pos.order])
+			|| !sndFile.Patterns[orderList[target.pos.order]].IsValidRow(target.pos.row))
+		{
+			return false;
+		}
+	} else if(target.mode != GetLengthTarget::SeekSeconds)
+	{
+		return false;
+	}
+
+	for(std::vector<SubsongIndex>::const_iterator subsong = subsongs.begin(); subsong != subsongs.end(); subsong++)
+	{
+		if(subsong->sequence != sequence || subsong->startOrder != target.startOrder || subsong->startRow != target.startRow)
+		{
+			continue;
+		}
+
+		// Checkpoints are sorted by time, the set of visited rows only grows, and once a checkpoint depends on the adjust mode,
+		// all following checkpoints do so as well - so the usable checkpoints form a prefix of the list and we can use a binary search.
+		const std::vector<Checkpoint> &checkpoints = subsong->checkpoints;
+		size_t first = 0, last = checkpoints.size();
+		while(first < last)
+		{
+			const size_t mid = first + (last - first) / 2;
+			const Checkpoint &candidate = checkpoints[mid];
+			bool usable = (adjust == recordedWithAdjust || candidate.adjustIndependent);
+			if(target.mode == GetLengthTarget::SeekSeconds)
+			{
+				usable = usable && candidate.elapsedTime < target.time;
+			} else
+			{
+				usable = usable && !candidate.visitedRows.IsVisited(target.pos.order, target.pos.row);
+			}
+			if(usable)
+			{
+				first = mid + 1;
+			} else
+			{
+				last = mid;
+			}
+		}
+		if(first == 0)
+		{
+			return false;
+		}
+		checkpoint = checkpoints[first - 1];
+		return true;
+	}
+	return false;
+}
+
+
+SongLengthCache::SongLengthCache(const CSoundFile &sf)
+//----------------------------------------------------
+	: sndFile(sf)
+	, sequence(0)
+	, startOrder(0)
+	, startRow(0)
+	, mixingFreq(0)
+	, tempoFactor(0)
+	, defaultSpeed(0)
+	, defaultTempo(0)
+	, defaultGlobalVolume(0)
+	, defaultRowsPerBeat(0)
+	, tempoMode(0)
+	, restartPos(0)
+	, numChannels(0)
+	, modType(MOD_TYPE_NONE)
+	, modFlags(0)
+	, lastSimulatedEntries(0)
+	, enabled(false)
+{
+}
+
+
+void SongLengthCache::SetEnabled(bool enable)
+//-------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(cacheMutex);
+	enabled = enable;
+	if(!enabled)
+	{
+		ClearLocked();
+	}
+}
+
+
+// Forget all cached state.
+void SongLengthCache::Clear()
+//---------------------------
+{
+	Util::lock_guard<Util::mutex> guard(cacheMutex);
+	ClearLocked();
+}
+
+
+void SongLengthCache::ClearLocked()
+//---------------------------------
+{
+	entries.clear();
+	orderList.clear();
+	patterns.clear();
+	modifiedPatterns.clear();
+	modifiedOrders.clear();
+	result = Result();
+}
+
+
+// Report that the pattern data of a pattern has been modified.
+void SongLengthCache::InvalidatePattern(PATTERNINDEX pattern)
+//-----------------------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(cacheMutex);
+	if(entries.empty() || pattern >= patterns.size())
+	{
+		// Patterns that did not exist are detected automatically.
+		return;
+	}
+	if(modifiedPatterns.size() <= pattern)
+	{
+		modifiedPatterns.resize(pattern + 1, false);
+	}
+	modifiedPatterns[pattern] = true;
+}
+
+
+// Report that the orders first to last (inclusive) have to be played again, e.g. because the sequence has been modified.
+void SongLengthCache::InvalidateOrders(ORDERINDEX first, ORDERINDEX last)
+//-----------------------------------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(cacheMutex);
+	// Orders beyond the end of the cached order list are only played if the order list has changed, which is detected automatically.
+	LimitMax(last, static_cast<ORDERINDEX>(orderList.size() - 1));
+	if(entries.empty() || orderList.empty() || first > last)
+	{
+		return;
+	}
+	if(modifiedOrders.size() <= last)
+	{
+		modifiedOrders.resize(last + 1, false);
+	}
+	std::fill(modifiedOrders.begin() + first, modifiedOrders.begin() + last + 1, true);
+}
+
+
+bool SongLengthCache::SettingsMatch(SEQUENCEINDEX seq, ORDERINDEX order, ROWINDEX row) const
+//------------------------------------------------------------------------------------------
+{
+	return sequence == seq && startOrder == order && startRow == row
+		&& mixingFreq == sndFile.m_MixerSettings.gdwMixingFreq
+		&& tempoFactor == GetTempoFactor(sndFile)
+		&& defaultSpeed == sndFile.m_nDefaultSpeed
+		&& defaultTempo == sndFile.m_nDefaultTempo
+		&& defaultGlobalVolume == sndFile.m_nDefaultGlobalVolume
+		&& defaultRowsPerBeat == sndFile.m_nDefaultRowsPerBeat
+		&& tempoMode == sndFile.m_nTempoMode
+		&& restartPos == sndFile.m_nRestartPos
+		&& numChannels == sndFile.GetNumChannels()
+		&& modType == sndFile.GetType()
+		&& modFlags == sndFile.GetModFlags();
+}
+
+
+// Start a song length calculation.
+SongLengthCache::UpdateMode SongLengthCache::BeginUpdate(Recorder &recorder, SEQUENCEINDEX seq, ORDERINDEX order, ROWINDEX row, SeekIndex::Checkpoint &resumeState, Result &cachedResult)
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+{
+	Util::lock_guard<Util::mutex> guard(cacheMutex);
+	recorder = Recorder();
+	recorder.active = enabled;
+	if(!enabled || entries.empty() || !SettingsMatch(seq, order, row))
+	{
+		return calculateAll;
+	}
+
+	// Find the order list positions that might play differently now
+	const ModSequence &newOrderList = sndFile.Order.GetSequence(seq);
+	const size_t numOrders = std::max<size_t>(orderList.size(), newOrderList.size());
+	std::vector<bool> modified(numOrders + 1, false);
+	// Anything beyond the end of the order list
+	modified[numOrders] = (orderList.size() != newOrderList.size());
+	for(ORDERINDEX ord = 0; ord < numOrders; ord++)
+	{
+		if(ord >= orderList.size() || ord >= newOrderList.size() || orderList[ord] != newOrderList[ord]
+			|| (ord < modifiedOrders.size() && modifiedOrders[ord]))
+		{
+			modified[ord] = true;
+			continue;
+		}
+		const PATTERNINDEX pat = newOrderList[ord];
+		PatternInfo info = { 0, 0 };
+		if(sndFile.Patterns.IsValidPat(pat))
+		{
+			info.numRows = sndFile.Patterns[pat].GetNumRows();
+			info.rowsPerBeat = sndFile.Patterns[pat].GetOverrideSignature() ? sndFile.Patterns[pat].GetRowsPerBeat() : 0;
+		}
+		if(pat < patterns.size())
+		{
+			modified[ord] = (info != patterns[pat]) || (pat < modifiedPatterns.size() && modifiedPatterns[pat]);
+		} else
+		{
+			modified[ord] = (info.numRows != 0);
+		}
+	}
+
+	// Find the first and last order entries that were followed by a modified order
+	size_t firstModified = entries.size(), lastModified = 0;
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		const std::vector<ORDERINDEX> &touched = entries[i].touchedOrders;
+		for(std::vector<ORDERINDEX>::const_iterator ord = touched.begin(); ord != touched.end(); ord++)
+		{
+			if(modified[std::min<size_t>(*ord, numOrders)])
+			{
+				firstModified = std::min(firstModified, i);
+				lastModified = i;
+				break;
+			}
+		}
+	}
+
+	if(firstModified == entries.size())
+	{
+		cachedResult = result;
+		lastSimulatedEntries = 0;
+		orderList.resize(newOrderList.size());
+		for(ORDERINDEX ord = 0; ord < newOrderList.size(); ord++)
+		{
+			orderList[ord] = newOrderList[ord];
+		}
+		modifiedPatterns.clear();
+		modifiedOrders.clear();
+		return upToDate;
+	}
+
+	// All entries up to the first modified one stay the same. Only entries after the last modified one can be taken over later.
+	resumeState = entries[firstModified].state;
+	resumeState.visitedRows = GetVisitedRows(entries, firstModified);
+	recorder.entries.assign(entries.begin(), entries.begin() + firstModified);
+	recorder.oldEntries.swap(entries);
+	recorder.firstConvergenceEntry = lastModified + 1;
+	recorder.oldResult = result;
+	ClearLocked();
+	return resume;
+}
+
+
+// Add an order entry and check if the state has converged with the previous calculation.
+bool SongLengthCache::AddEntry(Recorder &recorder, const SeekIndex::Checkpoint &state, const RowVisitor &visitedRows, Result &convergedResult)
+//------------------------------------------------------------------------------------------------------------------------------------------
+{
+	if(!recorder.active)
+	{
+		return false;
+	}
+	recorder.currentOrder = state.nextOrder;
+
+	OrderEntry entry;
+	entry.state = state;
+	entry.state.visitedRows = RowVisitor::VisitedRowsType();
+	entry.allVisitedRows = (recorder.simulatedEntries == 0 || recorder.entries.empty());
+	if(entry.allVisitedRows)
+	{
+		entry.state.visitedRows = visitedRows.GetVisitedRows();
+	} else
+	{
+		// Rows can only have been visited in the orders that were played since the previous entry.
+		const std::vector<ORDERINDEX> &touched = recorder.entries.back().touchedOrders;
+		for(std::vector<ORDERINDEX>::const_iterator ord = touched.begin(); ord != touched.end(); ord++)
+		{
+			visitedRows.GetOrderWords(*ord, entry.visitedWords);
+		}
+	}
+	recorder.simulatedEntries++;
+
+	RowVisitor::VisitedRowsType currentRows;
+	for(size_t i = recorder.firstConvergenceEntry; i < recorder.oldEntries.size(); i++)
+	{
+		if(!StatesConverge(state, recorder.oldEntries[i].state))
+		{
+			continue;
+		}
+		// The visited rows are only rebuilt if everything else matches.
+		if(currentRows.orderStart.empty())
+		{
+			currentRows = visitedRows.GetVisitedRows();
+		}
+		if(!(GetVisitedRows(recorder.oldEntries, i) == currentRows))
+		{
+			continue;
+		}
+		// Take over the rest of the previous calculation, shifted to the new timing.
+		// The following entries only store the rows that changed since this entry, which is the same in both calculations.
+		const double timeOffset = state.elapsedTime - recorder.oldEntries[i].state.elapsedTime;
+		const uint32 sampleOffset = state.totalSampleCount - recorder.oldEntries[i].state.totalSampleCount;
+		entry.touchedOrders = recorder.oldEntries[i].touchedOrders;
+		recorder.entries.push_back(entry);
+		for(size_t j = i + 1; j < recorder.oldEntries.size(); j++)
+		{
+			recorder.entries.push_back(recorder.oldEntries[j]);
+			SeekIndex::Checkpoint &entryState = recorder.entries.back().state;
+			entryState.elapsedTime += timeOffset;
+			entryState.totalSampleCount += sampleOffset;
+			for(std::vector<GetLengthChnSettings>::iterator chn = entryState.chnSettings.begin(); chn != entryState.chnSettings.end(); chn++)
+			{
+				chn->patLoop += timeOffset;
+			}
+		}
+		convergedResult = recorder.oldResult;
+		convergedResult.duration += timeOffset;
+		recorder.oldEntries.clear();
+		return true;
+	}
+
+	recorder.entries.push_back(entry);
+	return false;
+}
+
+
+// Returns true if GetLength() continues exactly like in the old state when it is in the new state and the same rows have been visited.
+// The visited rows are not compared here.
+bool SongLengthCache::StatesConverge(const SeekIndex::Checkpoint &newState, const SeekIndex::Checkpoint &oldState)
+//---------------------------------------------------------------------------------------------------------------
+{
+	if(newState.nextOrder != oldState.nextOrder
+		|| newState.nextRow != oldState.nextRow
+		|| newState.nextPatStartRow != oldState.nextPatStartRow
+		|| newState.musicSpeed != oldState.musicSpeed
+		|| newState.musicTempo != oldState.musicTempo
+		|| newState.globalVolume != oldState.globalVolume
+		|| newState.bufferDiff != oldState.bufferDiff
+		|| newState.chnMemory != oldState.chnMemory
+		|| newState.chnSettings.size() != oldState.chnSettings.size())
+	{
+		return false;
+	}
+	for(size_t chn = 0; chn < newState.chnSettings.size(); chn++)
+	{
+		const GetLengthChnSettings &newChn = newState.chnSettings[chn], &oldChn = oldState.chnSettings[chn];
+		if(newChn.patLoopStart != oldChn.patLoopStart || newChn.vol != oldChn.vol)
+		{
+			return false;
+		}
+		// Pattern loop start times are reset at the start of every pattern, otherwise they must be the same relative to the current time.
+		if(newState.nextRow != 0 && newChn.patLoop - newState.elapsedTime != oldChn.patLoop - oldState.elapsedTime)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Rebuild the visited rows of an entry from the previous entries.
+RowVisitor::VisitedRowsType SongLengthCache::GetVisitedRows(const std::vector<OrderEntry> &entries, size_t index)
+//-------------------------------------------------------------------------------------------------------------
+{
+	size_t first = index;
+	while(first > 0 && !entries[first].allVisitedRows)
+	{
+		first--;
+	}
+	RowVisitor::VisitedRowsType rows = entries[first].state.visitedRows;
+	for(size_t i = first + 1; i <= index; i++)
+	{
+		rows.SetWords(entries[i].visitedWords);
+	}
+	return rows;
+}
+
+
+// Store the order entries of a completed calculation.
+void SongLengthCache::EndUpdate(Recorder &recorder, SEQUENCEINDEX seq, ORDERINDEX order, ROWINDEX row, const Result &newResult)
+//----------------------------------------------------------------------------------------------------------------------------
+{
+	if(!recorder.active)
+	{
+		return;
+	}
+	Util::lock_guard<Util::mutex> guard(cacheMutex);
+	if(!enabled)
+	{
+		return;
+	}
+	ClearLocked();
+	entries.swap(recorder.entries);
+	result = newResult;
+	lastSimulatedEntries = recorder.simulatedEntries;
+
+	sequence = seq;
+	startOrder = order;
+	startRow = row;
+	mixingFreq = sndFile.m_MixerSettings.gdwMixingFreq;
+	tempoFactor = GetTempoFactor(sndFile);
+	defaultSpeed = sndFile.m_nDefaultSpeed;
+	defaultTempo = sndFile.m_nDefaultTempo;
+	defaultGlobalVolume = sndFile.m_nDefaultGlobalVolume;
+	defaultRowsPerBeat = sndFile.m_nDefaultRowsPerBeat;
+	tempoMode = sndFile.m_nTempoMode;
+	restartPos = sndFile.m_nRestartPos;
+	numChannels = sndFile.GetNumChannels();
+	modType = sndFile.GetType();
+	modFlags = sndFile.GetModFlags();
+
+	const ModSequence &newOrderList = sndFile.Order.GetSequence(seq);
+	orderList.resize(newOrderList.size());
+	for(ORDERINDEX ord = 0; ord < newOrderList.size(); ord++)
+	{
+		orderList[ord] = newOrderList[ord];
+	}
+	patterns.resize(sndFile.Patterns.Size());
+	for(PATTERNINDEX pat = 0; pat < sndFile.Patterns.Size(); pat++)
+	{
+		patterns[pat].numRows = sndFile.Patterns.IsValidPat(pat) ? sndFile.Patterns[pat].GetNumRows() : 0;
+		patterns[pat].rowsPerBeat = (sndFile.Patterns.IsValidPat(pat) && sndFile.Patterns[pat].GetOverrideSignature()) ? sndFile.Patterns[pat].GetRowsPerBeat() : 0;
+	}
+}
+
+
+OPENMPT_NAMESPACE_END
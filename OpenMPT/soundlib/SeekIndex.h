@@ -0,0 +1,301 @@
+/*
+ * SeekIndex.h
+ * -----------
+ * Purpose: Checkpoints of the song length calculation state, used for speeding up seeking.
+ * Notes  : See implementation file.
+ * Authors: OpenMPT Devs
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#include <vector>
+#include "Snd_defs.h"
+#include "RowVisitor.h"
+#include "../common/mutex.h"
+
+OPENMPT_NAMESPACE_BEGIN
+
+class CSoundFile;
+struct ModChannel;
+struct GetLengthTarget;
+
+
+// Per-channel pattern loop and volume memory of the GetLength() code
+struct GetLengthChnSettings
+{
+	double patLoop;
+	ROWINDEX patLoopStart;
+	BYTE vol;
+
+	GetLengthChnSettings()
+	{
+		patLoop = 0.0;
+		patLoopStart = 0;
+		vol = 0xFF;
+	}
+};
+
+
+//=============
+class SeekIndex
+//=============
+{
+public:
+
+	// Channel effect memory that is updated by GetLength(). All other channel members are reset at the start of a sub song and are not touched while seeking.
+	struct ChnMemory
+	{
+		uint32 nOldGlobalVolSlide;
+		int32 nGlobalVol;
+		int32 nPortamentoSlide;
+		ROWINDEX nPatternLoop;
+		uint8 nPatternLoopCount;
+		uint8 nNewIns, nLastNote;
+		uint8 nOldTempo, nOldHiOffset, nOldOffset;
+		uint8 nOldPortaUpDown, nOldVolumeSlide, nOldChnVolSlide;
+
+		void Save(const ModChannel &chn);
+		void Restore(ModChannel &chn) const;
+		bool operator== (const ChnMemory &other) const;
+	};
+
+	// Complete GetLength() state at the start of a row
+	struct Checkpoint
+	{
+		double elapsedTime;
+		double bufferDiff;
+		uint32 totalSampleCount;
+		uint32 musicSpeed, musicTempo;
+		int32 globalVolume;
+		ROWINDEX row, nextRow, nextPatStartRow, endRow;
+		ORDERINDEX order, nextOrder, endOrder;
+		// False if the state up to this point depends on whether GetLength() was called with eAdjust or not (e.g. because of T00 in IT files)
+		bool adjustIndependent;
+		std::vector<ChnMemory> chnMemory;
+		std::vector<GetLengthChnSettings> chnSettings;
+		// Rows visited since the start of the sub song
+		RowVisitor::VisitedRowsType visitedRows;
+
+		size_t GetMemoryUsage() const;
+	};
+
+	// State of a single recording pass. Every GetLength() call has its own recorder,
+	// so that several sequences can be recorded into the same index at the same time.
+	class Recorder
+	{
+		friend class SeekIndex;
+	protected:
+		SEQUENCEINDEX sequence;
+		ORDERINDEX startOrder;
+		ROWINDEX startRow;
+		double lastCheckpointTime;
+		// Copy of the index' checkpoint interval, so that it can be read without locking
+		double interval;
+		bool active;
+
+	public:
+		Recorder() : sequence(0), startOrder(0), startRow(0), lastCheckpointTime(0.0), interval(0.0), active(false) { }
+
+		// Returns true if a checkpoint should be recorded at the given time of the current sub song.
+		bool WantCheckpoint(double elapsedTime) const { return active && elapsedTime >= lastCheckpointTime + interval; }
+		// Stop recording checkpoints for the current sub song.
+		void EndSubsong() { active = false; }
+	};
+
+protected:
+
+	struct SubsongIndex
+	{
+		SEQUENCEINDEX sequence;
+		ORDERINDEX startOrder;
+		ROWINDEX startRow;
+		std::vector<Checkpoint> checkpoints;
+	};
+
+	const CSoundFile &sndFile;
+
+	std::vector<SubsongIndex> subsongs;
+	// Maximum and current memory consumption of all checkpoints in bytes
+	size_t memoryLimit, memoryUsage;
+	// Minimum time between two checkpoints in seconds. Grows if the memory limit is reached.
+	double interval;
+	// Mixer settings that were in use while recording, as they influence the elapsed time.
+	uint32 mixingFreq, tempoFactor;
+	// Whether the index was recorded with eAdjust
+	bool recordedWithAdjust;
+	// Protects all of the above, as sequences may be recorded from several threads at once
+	mutable Util::mutex indexMutex;
+
+public:
+
+	SeekIndex(const CSoundFile &sf);
+
+	// Set maximum memory consumption in bytes. 0 disables the index.
+	void SetMemoryLimit(size_t limit);
+	size_t GetMemoryLimit() const { return memoryLimit; }
+	size_t GetMemoryUsage() const { Util::lock_guard<Util::mutex> guard(indexMutex); return memoryUsage; }
+	bool IsEnabled() const { return memoryLimit != 0; }
+
+	// Remove all checkpoints, e.g. because the module has been modified.
+	// Note: The index is not invalidated automatically if patterns or orders are edited.
+	void Clear();
+
+	// Returns true if checkpoints can be recorded or used with the current playback settings.
+	bool CanBeUsed(bool adjustSamplePositions) const;
+
+	// Start a new recording pass for the given sequence, replacing previously recorded checkpoints of this sequence.
+	void BeginRecording(Recorder &recorder, SEQUENCEINDEX sequence, bool adjust);
+	// Start recording checkpoints for a new sub song. Must be called after BeginRecording().
+	void BeginSubsong(Recorder &recorder, ORDERINDEX startOrder, ROWINDEX startRow);
+	// Add a checkpoint to the recorder's current sub song.
+	void AddCheckpoint(Recorder &recorder, const Checkpoint &checkpoint);
+
+	// Find the latest checkpoint that lies before the target of a GetLength() call and copy it.
+	// Returns false if there is no suitable checkpoint.
+	bool FindCheckpoint(SEQUENCEINDEX sequence, const GetLengthTarget &target, bool adjust, Checkpoint &checkpoint) const;
+
+protected:
+
+	// Drop every second checkpoint until the memory limit is satisfied. Must be called with the index locked.
+	void Thin();
+	void ClearLocked();
+};
+
+
+//===================
+class SongLengthCache
+//===================
+{
+public:
+
+	// GetLength() state when entering an order, and the orders that were looked at until the next order was entered
+	struct OrderEntry
+	{
+		SeekIndex::Checkpoint state;
+		std::vector<ORDERINDEX> touchedOrders;
+		// Copying all visited rows for every order would take quadratic time and memory, so only the first entry of every calculation
+		// has them in state.visitedRows. The others store the words of the orders that were played since the previous entry.
+		RowVisitor::VisitedRowsType::WordList visitedWords;
+		bool allVisitedRows;
+
+		OrderEntry() : allVisitedRows(false) { }
+	};
+
+	// The parts of GetLengthType that are cached
+	struct Result
+	{
+		double duration;
+		ROWINDEX lastRow, endRow;
+		ORDERINDEX lastOrder, endOrder;
+
+		Result() : duration(0.0), lastRow(ROWINDEX_INVALID), endRow(ROWINDEX_INVALID), lastOrder(ORDERINDEX_INVALID), endOrder(ORDERINDEX_INVALID) { }
+	};
+
+	// State of a single song length calculation
+	class Recorder
+	{
+		friend class SongLengthCache;
+	protected:
+		std::vector<OrderEntry> entries;		// Order entries of the current calculation
+		std::vector<OrderEntry> oldEntries;		// Order entries of the previous calculation, which are taken over once the state converges
+		size_t firstConvergenceEntry;			// Only old entries from here on may be taken over, as all earlier ones are followed by modified orders
+		size_t simulatedEntries;
+		Result oldResult;
+		ORDERINDEX currentOrder;
+		bool active;
+
+	public:
+		Recorder() : firstConvergenceEntry(0), simulatedEntries(0), currentOrder(ORDERINDEX_INVALID), active(false) { }
+
+		// Returns true if GetLength() is about to enter another order, i.e. an order entry should be added.
+		bool WantEntry(ORDERINDEX nextOrder) const { return active && nextOrder != currentOrder; }
+		// Remember that GetLength() looked at an order since the last order entry.
+		void Touch(ORDERINDEX order)
+		{
+			if(active && !entries.empty() && (entries.back().touchedOrders.empty() || entries.back().touchedOrders.back() != order))
+			{
+				entries.back().touchedOrders.push_back(order);
+			}
+		}
+	};
+
+	enum UpdateMode
+	{
+		calculateAll,	// Calculate the song length from the start
+		resume,			// Resume the calculation from the returned state
+		upToDate,		// Nothing has changed, the returned result can be used as it is
+	};
+
+protected:
+
+	// Pattern properties that influence the song length, other than the pattern data
+	struct PatternInfo
+	{
+		ROWINDEX numRows;
+		ROWINDEX rowsPerBeat;	// 0 = no signature override
+		bool operator!= (const PatternInfo &other) const { return numRows != other.numRows || rowsPerBeat != other.rowsPerBeat; }
+	};
+
+	const CSoundFile &sndFile;
+
+	std::vector<OrderEntry> entries;
+	Result result;
+	// Song properties the cached entries have been calculated with
+	SEQUENCEINDEX sequence;
+	ORDERINDEX startOrder;
+	ROWINDEX startRow;
+	uint32 mixingFreq, tempoFactor;
+	uint32 defaultSpeed, defaultTempo, defaultGlobalVolume;
+	ROWINDEX defaultRowsPerBeat;
+	int tempoMode;
+	ORDERINDEX restartPos;
+	CHANNELINDEX numChannels;
+	MODTYPE modType;
+	uint16 modFlags;
+	std::vector<PATTERNINDEX> orderList;
+	std::vector<PatternInfo> patterns;
+	// Patterns and orders that have been modified since the entries were recorded
+	std::vector<bool> modifiedPatterns, modifiedOrders;
+	size_t lastSimulatedEntries;
+	bool enabled;
+	mutable Util::mutex cacheMutex;
+
+public:
+
+	SongLengthCache(const CSoundFile &sf);
+
+	// The cache is disabled by default.
+	void SetEnabled(bool enable);
+	bool IsEnabled() const { return enabled; }
+
+	// Forget all cached state.
+	void Clear();
+	// Changes to the order list, pattern sizes, global song properties and mixer settings are detected automatically,
+	// but pattern data edits have to be reported.
+	void InvalidatePattern(PATTERNINDEX pattern);
+	void InvalidateOrders(ORDERINDEX first, ORDERINDEX last);
+
+	// Number of order entries that had to be simulated by the last calculation
+	size_t GetLastSimulatedEntries() const { Util::lock_guard<Util::mutex> guard(cacheMutex); return lastSimulatedEntries; }
+
+	// Start a song length calculation. If resume is returned, the calculation has to continue from resumeState.
+	// If upToDate is returned, cachedResult is the song length.
+	UpdateMode BeginUpdate(Recorder &recorder, SEQUENCEINDEX seq, ORDERINDEX order, ROWINDEX row, SeekIndex::Checkpoint &resumeState, Result &cachedResult);
+	// Add an order entry. Returns true if the state has converged with the previous calculation, in which case the
+	// calculation can be stopped and convergedResult is the song length.
+	bool AddEntry(Recorder &recorder, const SeekIndex::Checkpoint &state, const RowVisitor &visitedRows, Result &convergedResult);
+	// Store the order entries of a completed calculation.
+	void EndUpdate(Recorder &recorder, SEQUENCEINDEX seq, ORDERINDEX order, ROWINDEX row, const Result &newResult);
+
+protected:
+
+	bool SettingsMatch(SEQUENCEINDEX seq, ORDERINDEX order, ROWINDEX row) const;
+	static bool StatesConverge(const SeekIndex::Checkpoint &newState, const SeekIndex::Checkpoint &oldState);
+	// Rebuild the visited rows of an entry from the previous entries.
+	static RowVisitor::VisitedRowsType GetVisitedRows(const std::vector<OrderEntry> &entries, size_t index);
+	void ClearLocked();
+};
+
+OPENMPT_NAMESPACE_END
@@ -304,6 +304,7 @@ DECLARE_FLAGSET(SongFlags)
 // Misc Flags (can safely be turned on or off)
 #define SNDMIX_MAXDEFAULTPAN	0x80000		// Used by the MOD loader (currently unused)
 #define SNDMIX_MUTECHNMODE		0x100000	// Notes are not played on muted channels
+#define SNDMIX_NOVOICECULLING	0x200000	// Mix voices that only play digital silence instead of skipping them (the output is the same)
 
 
 #define MAX_GLOBAL_VOLUME 256u
@@ -49,19 +49,7 @@ class GetLengthMemory
 public:
 
 	CSoundFile::PlayState state;
-	struct ChnSettings
-	{
-		double patLoop;
-		ROWINDEX patLoopStart;
-		BYTE vol;
-
-		ChnSettings()
-		{
-			patLoop = 0.0;
-			patLoopStart = 0;
-			vol = 0xFF;
-		}
-	};
+	typedef GetLengthChnSettings ChnSettings;
 
 	std::vector<ChnSettings> chnSettings;
 	double elapsedTime;
@@ -81,6 +69,7 @@ public:
 	{
 		elapsedTime = 0.0;
 		state.m_lTotalSampleCount = 0;
+		state.m_dBufferDiff = 0;
 		state.m_nMusicSpeed = sndFile.m_nDefaultSpeed;
 		state.m_nMusicTempo = sndFile.m_nDefaultTempo;
 		state.m_nGlobalVolume = sndFile.m_nDefaultGlobalVolume;
@@ -93,6 +82,65 @@ public:
 			state.Chn[chn].nNote = state.Chn[chn].nNewNote = state.Chn[chn].nLastNote = NOTE_NONE;
 		}
 	}
+
+	// Store everything except for the play position in a seek index checkpoint
+	void SaveCheckpoint(SeekIndex::Checkpoint &checkpoint) const
+	{
+		checkpoint.elapsedTime = elapsedTime;
+		checkpoint.totalSampleCount = state.m_lTotalSampleCount;
+		checkpoint.bufferDiff = state.m_dBufferDiff;
+		checkpoint.musicSpeed = state.m_nMusicSpeed;
+		checkpoint.musicTempo = state.m_nMusicTempo;
+		checkpoint.globalVolume = state.m_nGlobalVolume;
+		checkpoint.chnSettings = chnSettings;
+		checkpoint.chnMemory.resize(sndFile.GetNumChannels());
+		for(CHANNELINDEX chn = 0; chn < sndFile.GetNumChannels(); chn++)
+		{
+			checkpoint.chnMemory[chn].Save(state.Chn[chn]);
+		}
+	}
+
+	// Counterpart of SaveCheckpoint(), to be called after Reset()
+	void RestoreCheckpoint(const SeekIndex::Checkpoint &checkpoint)
+	{
+		elapsedTime = checkpoint.elapsedTime;
+		state.m_lTotalSampleCount = checkpoint.totalSampleCount;
+		state.m_dBufferDiff = checkpoint.bufferDiff;
+		state.m_nMusicSpeed = checkpoint.musicSpeed;
+		state.m_nMusicTempo = checkpoint.musicTempo;
+		state.m_nGlobalVolume = checkpoint.globalVolume;
+		chnSettings = checkpoint.chnSettings;
+		for(CHANNELINDEX chn = 0; chn < sndFile.GetNumChannels(); chn++)
+		{
+			checkpoint.chnMemory[chn].Restore(state.Chn[chn]);
+		}
+	}
+};
+
+
+// Seek index recording state of the sub song that GetLength() is currently going through
+struct SeekIndexSubsongRecorder
+{
+	SeekIndex &seekIndex;
+	SeekIndex::Recorder recorder;
+	// Rows visited before the current sub song started
+	RowVisitor startRows;
+	// Set if the timing of the current sub song depends on the adjust mode (T00 is only evaluated with eAdjust)
+	bool adjustDependentTiming;
+
+	SeekIndexSubsongRecorder(SeekIndex &index, const RowVisitor &visitedRows) : seekIndex(index), startRows(visitedRows), adjustDependentTiming(false) { }
+
+	// GetLength() continues with the next sub song, which starts at the given position.
+	void NextSubsong(const RowVisitor &visitedRows, ORDERINDEX startOrder, ROWINDEX startRow, ROWINDEX nextPatStartRow)
+	{
+		startRows.Set(visitedRows);
+		adjustDependentTiming = false;
+		// A new sub song can only be indexed if seeking from its start would result in the same state (FT2 E60 bug)
+		if(nextPatStartRow == 0)
+			seekIndex.BeginSubsong(recorder, startOrder, startRow);
+		else
+			recorder.EndSubsong();
+	}
 };
 
 
@@ -105,6 +153,7 @@ public:
 // [out] lastRow: last parsed row (dito)
 // [out] endOrder: last order before module loops (UNDEFINED if a target is specified)
 // [out] endRow: last row before module loops (dito)
+// Without eAdjust, the module is not modified, so the lengths of different sequences can be calculated concurrently.
 std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthTarget target)
 //--------------------------------------------------------------------------------------------------------
 {
@@ -127,7 +176,7 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 
 	GetLengthMemory memory(*this);
 	// Temporary visited rows vector (so that GetLength() won't interfere with the player code if the module is playing at the same time)
-	RowVisitor visitedRows(*this, sequence);
+	RowVisitor visitedRows(*this, sequence, m_visitedRowsCache);
 
 	// Optimize away channels for which it's pointless to adjust sample positions
 	std::vector<bool> adjustSampleChn(GetNumChannels(), true);
@@ -156,6 +205,61 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 		}
 	}
 
+	// Seek index: Checkpoints are recorded while calculating the length of all sub songs, and seeks can resume from them.
+	const bool useSeekIndex = m_SeekIndex.CanBeUsed(adjustSamplePos);
+	const bool recordSeekIndex = useSeekIndex && target.mode == GetLengthTarget::GetAllSubsongs;
+	// Effect memory is only needed for adjusting the play state, but it is also tracked while recording checkpoints so that they can be used for both kinds of seeks.
+	const bool updateEffectMemory = (adjustMode & eAdjust) || recordSeekIndex;
+	SeekIndexSubsongRecorder seekRecorder(m_SeekIndex, visitedRows);
+
+	// Song length cache: The plain length of a song (e.g. GetSongTime()) is only recalculated from the first modified order on.
+	const bool useLengthCache = m_SongLengthCache.IsEnabled() && adjustMode == eNoAdjust && target.mode == GetLengthTarget::NoTarget;
+	SongLengthCache::Recorder lengthCacheRecorder;
+
+	SeekIndex::Checkpoint resumeCheckpoint;
+	bool resume = false;
+	if(recordSeekIndex)
+	{
+		m_SeekIndex.BeginRecording(seekRecorder.recorder, sequence, (adjustMode & eAdjust) != 0);
+		m_SeekIndex.BeginSubsong(seekRecorder.recorder, nCurrentOrder, nRow);
+	} else if(useSeekIndex)
+	{
+		resume = m_SeekIndex.FindCheckpoint(sequence, target, (adjustMode & eAdjust) != 0, resumeCheckpoint);
+	}
+	if(useLengthCache)
+	{
+		SongLengthCache::Result cachedResult;
+		switch(m_SongLengthCache.BeginUpdate(lengthCacheRecorder, sequence, nCurrentOrder, nRow, resumeCheckpoint, cachedResult))
+		{
+		case SongLengthCache::upToDate:
+			retval.duration = cachedResult.duration;
+			retval.lastOrder = cachedResult.lastOrder;
+			retval.lastRow = cachedResult.lastRow;
+			retval.endOrder = cachedResult.endOrder;
+			retval.endRow = cachedResult.endRow;
+			results.push_back(retval);
+			return results;
+		case SongLengthCache::resume:
+			resume = true;
+			break;
+		case SongLengthCache::calculateAll:
+			break;
+		}
+	}
+	if(resume && resumeCheckpoint.chnMemory.size() == GetNumChannels())
+	{
+		// Skip everything up to the checkpoint
+		memory.RestoreCheckpoint(resumeCheckpoint);
+		visitedRows.SetVisitedRows(resumeCheckpoint.visitedRows);
+		nRow = resumeCheckpoint.row;
+		nNextRow = resumeCheckpoint.nextRow;
+		nNextPatStartRow = resumeCheckpoint.nextPatStartRow;
+		nCurrentOrder = resumeCheckpoint.order;
+		nNextOrder = resumeCheckpoint.nextOrder;
+		retval.endOrder = resumeCheckpoint.endOrder;
+		retval.endRow = resumeCheckpoint.endRow;
+	}
+
 	for (;;)
 	{
 		// Time target reached.
@@ -165,9 +269,42 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 			break;
 		}
 
+		const bool wantSeekCheckpoint = recordSeekIndex && seekRecorder.recorder.WantCheckpoint(memory.elapsedTime);
+		const bool wantOrderEntry = lengthCacheRecorder.WantEntry(nNextOrder);
+		if(wantSeekCheckpoint || wantOrderEntry)
+		{
+			SeekIndex::Checkpoint checkpoint;
+			memory.SaveCheckpoint(checkpoint);
+			checkpoint.row = nRow;
+			checkpoint.nextRow = nNextRow;
+			checkpoint.nextPatStartRow = nNextPatStartRow;
+			checkpoint.order = nCurrentOrder;
+			checkpoint.nextOrder = nNextOrder;
+			checkpoint.endOrder = retval.endOrder;
+			checkpoint.endRow = retval.endRow;
+			checkpoint.adjustIndependent = !seekRecorder.adjustDependentTiming;
+			if(wantSeekCheckpoint)
+			{
+				checkpoint.visitedRows = visitedRows.GetVisitedRowsExcept(seekRecorder.startRows);
+				m_SeekIndex.AddCheckpoint(seekRecorder.recorder, checkpoint);
+			}
+			SongLengthCache::Result convergedResult;
+			if(wantOrderEntry && m_SongLengthCache.AddEntry(lengthCacheRecorder, checkpoint, visitedRows, convergedResult))
+			{
+				// The rest of the song plays exactly like in the previous calculation
+				memory.elapsedTime = convergedResult.duration;
+				nCurrentOrder = convergedResult.lastOrder;
+				nRow = convergedResult.lastRow;
+				retval.endOrder = convergedResult.endOrder;
+				retval.endRow = convergedResult.endRow;
+				break;
+			}
+		}
+
 		uint32 rowDelay = 0, tickDelay = 0;
 		nRow = nNextRow;
 		nCurrentOrder = nNextOrder;
+		lengthCacheRecorder.Touch(nCurrentOrder);
 
 		if(nCurrentOrder >= orderList.size())
 			break;
@@ -200,6 +337,7 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 			}
 			nPattern = (nCurrentOrder < orderList.size()) ? orderList[nCurrentOrder] : orderList.GetInvalidPatIndex();
 			nNextOrder = nCurrentOrder;
+			lengthCacheRecorder.Touch(nCurrentOrder);
 			if((!Patterns.IsValidPat(nPattern)) && visitedRows.IsVisited(nCurrentOrder, 0, true))
 			{
 				if(!hasSearchTarget || !visitedRows.GetFirstUnvisitedRow(nNextOrder, nNextRow, true))
@@ -214,6 +352,10 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 					retval.startRow = nNextRow;
 					retval.startOrder = nNextOrder;
 					memory.Reset();
+					if(recordSeekIndex)
+					{
+						seekRecorder.NextSubsong(visitedRows, retval.startOrder, retval.startRow, nNextPatStartRow);
+					}
 
 					nRow = nNextRow;
 					nCurrentOrder = nNextOrder;
@@ -240,6 +382,10 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 					retval.startRow = nNextRow;
 					retval.startOrder = nNextOrder;
 					memory.Reset();
+					if(recordSeekIndex)
+					{
+						seekRecorder.NextSubsong(visitedRows, retval.startOrder, retval.startRow, nNextPatStartRow);
+					}
 					continue;
 				}
 			}
@@ -271,6 +417,10 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 				retval.startRow = nNextRow;
 				retval.startOrder = nNextOrder;
 				memory.Reset();
+				if(recordSeekIndex)
+				{
+					seekRecorder.NextSubsong(visitedRows, retval.startOrder, retval.startRow, nNextPatStartRow);
+				}
 				continue;
 			}
 		}
@@ -317,7 +467,7 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 				if(!patternBreakOnThisRow || (GetType() & (MOD_TYPE_MOD | MOD_TYPE_XM)))
 					nNextRow = 0;
 
-				if ((adjustMode & eAdjust))
+				if(updateEffectMemory)
 				{
 					pChn->nPatternLoopCount = 0;
 					pChn->nPatternLoop = 0;
@@ -350,7 +500,7 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 				{
 					nNextOrder = nCurrentOrder + 1;
 				}
-				if ((adjustMode & eAdjust))
+				if(updateEffectMemory)
 				{
 					pChn->nPatternLoopCount = 0;
 					pChn->nPatternLoop = 0;
@@ -375,9 +525,14 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 				break;
 			// Set Tempo
 			case CMD_TEMPO:
-				if ((adjustMode & eAdjust) && (GetType() & (MOD_TYPE_S3M | MOD_TYPE_IT | MOD_TYPE_MPT)))
+				if(updateEffectMemory && (GetType() & (MOD_TYPE_S3M | MOD_TYPE_IT | MOD_TYPE_MPT)))
 				{
-					if (param) pChn->nOldTempo = param; else param = pChn->nOldTempo;
+					if (param) pChn->nOldTempo = param;
+					else
+					{
+						seekRecorder.adjustDependentTiming = true;
+						if(adjustMode & eAdjust) param = pChn->nOldTempo;
+					}
 				}
 				if (param >= 0x20) memory.state.m_nMusicTempo = param; else
 				{
@@ -472,7 +627,7 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 				if(((param & 0xF0) == 0xA0) && !IsCompatibleMode(TRK_FASTTRACKER2)) pChn->nOldHiOffset = param & 0x0F;
 				break;
 			}
-			if ((adjustMode & eAdjust) == 0) continue;
+			if(!updateEffectMemory) continue;
 			switch(command)
 			{
 			// Portamento Up/Down
@@ -588,13 +743,13 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 			break;
 		}
 
-		ROWINDEX rowsPerBeat = m_nDefaultRowsPerBeat;
+		memory.state.m_nCurrentRowsPerBeat = m_nDefaultRowsPerBeat;
 		if(Patterns[nPattern].GetOverrideSignature())
 		{
-			rowsPerBeat = Patterns[nPattern].GetRowsPerBeat();
+			memory.state.m_nCurrentRowsPerBeat = Patterns[nPattern].GetRowsPerBeat();
 		}
 
-		const uint32 tickDuration = GetTickDuration(memory.state.m_nMusicTempo, memory.state.m_nMusicSpeed, rowsPerBeat);
+		const uint32 tickDuration = GetTickDuration(memory.state);
 		const uint32 numTicks = (memory.state.m_nMusicSpeed + tickDelay) * MAX(rowDelay, 1);
 		const uint32 rowDuration = tickDuration * numTicks;
 		memory.elapsedTime += static_cast<double>(rowDuration) / static_cast<double>(m_MixerSettings.gdwMixingFreq);
@@ -838,6 +993,17 @@ std::vector<GetLengthType> CSoundFile::GetLength(enmGetLengthResetMode adjustMod
 	retval.duration = memory.elapsedTime;
 	results.push_back(retval);
 
+	if(useLengthCache)
+	{
+		SongLengthCache::Result lengthResult;
+		lengthResult.duration = retval.duration;
+		lengthResult.lastOrder = retval.lastOrder;
+		lengthResult.lastRow = retval.lastRow;
+		lengthResult.endOrder = retval.endOrder;
+		lengthResult.endRow = retval.endRow;
+		m_SongLengthCache.EndUpdate(lengthCacheRecorder, sequence, retval.startOrder, retval.startRow, lengthResult);
+	}
+
 	// Store final variables
 	if((adjustMode & eAdjust))
 	{
@@ -1567,36 +1733,21 @@ void CSoundFile::NoteChange(ModChannel *pChn, int note, bool bPorta, bool bReset
 }
 
 
-CHANNELINDEX CSoundFile::GetNNAChannel(CHANNELINDEX nChn) const
-//-------------------------------------------------------------
+// Find a voice for moving a note to. Every voice that is changed afterwards has to be reported to m_VoicePool.
+CHANNELINDEX CSoundFile::GetNNAChannel(CHANNELINDEX nChn)
+//-------------------------------------------------------
 {
 	const ModChannel *pChn = &m_PlayState.Chn[nChn];
+	if(!m_VoicePool.IsValid())
+	{
+		m_VoicePool.Rebuild(m_PlayState.Chn, m_nChannels, std::max(m_nChannels, m_nMaxVoices));
+	}
 	// Check for empty channel
-	const ModChannel *pi = &m_PlayState.Chn[m_nChannels];
-	for (CHANNELINDEX i=m_nChannels; i<MAX_CHANNELS; i++, pi++) if (!pi->nLength) return i;
+	const CHANNELINDEX freeVoice = m_VoicePool.GetFreeVoice(m_PlayState.Chn);
+	if(freeVoice) return freeVoice;
 	if (!pChn->nFadeOutVol) return 0;
 	// All channels are used: check for lowest volume
-	CHANNELINDEX result = 0;
-	DWORD vol = 64*65536;	// 25%
-	DWORD envpos = 0xFFFFFF;
-	const ModChannel *pj = &m_PlayState.Chn[m_nChannels];
-	for (CHANNELINDEX j=m_nChannels; j<MAX_CHANNELS; j++, pj++)
-	{
-		if (!pj->nFadeOutVol) return j;
-		DWORD v = pj->nVolume;
-		if(pj->dwFlags[CHN_NOTEFADE])
-			v = v * pj->nFadeOutVol;
-		else
-			v <<= 16;
-		if(pj->dwFlags[CHN_LOOP]) v >>= 1;
-		if ((v < vol) || ((v == vol) && (pj->VolEnv.nEnvPosition > envpos)))
-		{
-			envpos = pj->VolEnv.nEnvPosition;
-			vol = v;
-			result = j;
-		}
-	}
-	return result;
+	return m_VoicePool.GetVoiceToSteal(m_PlayState.Chn);
 }
 
 
@@ -1629,6 +1780,7 @@ void CSoundFile::CheckNNA(CHANNELINDEX nChn, UINT instr, int note, bool forceCut
 		// Cut the note
 		chn.nFadeOutVol = 0;
 		chn.dwFlags.set(CHN_NOTEFADE | CHN_FASTVOLRAMP);
+		m_VoicePool.Update(m_PlayState.Chn, n);
 		// Stop this channel
 		pChn->nLength = pChn->nPos = pChn->nPosLo = 0;
 		pChn->nROfs = pChn->nLOfs = 0;
@@ -1746,6 +1898,7 @@ void CSoundFile::CheckNNA(CHANNELINDEX nChn, UINT instr, int note, bool forceCut
 					p->nFadeOutVol = 0;
 					p->dwFlags.set(CHN_NOTEFADE | CHN_FASTVOLRAMP);
 				}
+				m_VoicePool.Update(m_PlayState.Chn, i);
 			}
 		}
 	}
@@ -1830,6 +1983,7 @@ void CSoundFile::CheckNNA(CHANNELINDEX nChn, UINT instr, int note, bool forceCut
 				p->nFadeOutVol = 0;
 				p->dwFlags.set(CHN_NOTEFADE | CHN_FASTVOLRAMP);
 			}
+			m_VoicePool.Update(m_PlayState.Chn, n);
 			// Stop this channel
 			pChn->nLength = pChn->nPos = pChn->nPosLo = 0;
 			pChn->nROfs = pChn->nLOfs = 0;
@@ -3895,6 +4049,7 @@ void CSoundFile::ExtendedS3MCommands(CHANNELINDEX nChn, UINT param)
 									bkp->dwFlags.set(CHN_NOTEFADE);
 									bkp->nFadeOutVol = 0;
 								}
+								m_VoicePool.Update(m_PlayState.Chn, i);
 								const ModInstrument *pIns = bkp->pModInstrument;
 								IMixPlugin *pPlugin;
 								if(pIns != nullptr && pIns->nMixPlug && (pPlugin = m_MixPlugins[pIns->nMixPlug - 1].pMixPlugin) != nullptr)
@@ -4061,6 +4216,9 @@ void CSoundFile::InvertLoop(ModChannel *pChn)
 	if (++pChn->nEFxOffset >= pModSample->nLoopEnd - pModSample->nLoopStart)
 		pChn->nEFxOffset = 0;
 
+	// Samples shared with other modules must not be trashed.
+	if(!ctrlSmp::MakeSampleDataWritable(*pModSample, *this)) return;
+
 	// TRASH IT!!! (Yes, the sample!)
 	uint8 &sample = static_cast<uint8 *>(pModSample->pSample)[pModSample->nLoopStart + pChn->nEFxOffset];
 	sample = ~sample;
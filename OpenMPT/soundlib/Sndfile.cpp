@@ -580,6 +580,8 @@ CSoundFile::CSoundFile() :
 	m_MIDIMapper(*this),
 #endif
 	visitedSongRows(*this),
+	m_SeekIndex(*this),
+	m_SongLengthCache(*this),
 	m_pCustomLog(nullptr)
 #if MPT_COMPILER_MSVC
 #pragma warning(default : 4355) // "'this' : used in base member initializer list"
@@ -595,6 +597,8 @@ CSoundFile::CSoundFile() :
 	m_ContainerType = MOD_CONTAINERTYPE_NONE;
 	m_nChannels = 0;
 	m_nMixChannels = 0;
+	m_nMixedVoices = m_nCulledVoices = 0;
+	m_nMaxVoices = MAX_CHANNELS;
 	m_nSamples = 0;
 	m_nInstruments = 0;
 #ifndef MODPLUG_TRACKER
@@ -712,6 +716,204 @@ void CSoundFile::InitializeChannels()
 }
 
 
+// All module loaders, in the order in which they are tried if no format signature matches.
+typedef bool (CSoundFile::*FileLoaderFunc)(FileReader &file, CSoundFile::ModLoadingFlags loadFlags);
+typedef bool (CSoundFile::*MemoryLoaderFunc)(const uint8 *lpStream, DWORD dwMemLength, CSoundFile::ModLoadingFlags loadFlags);
+
+struct ModuleLoader
+{
+	const char *format;
+	FileLoaderFunc fileLoader;
+	MemoryLoaderFunc memoryLoader;	// For loaders that still work on raw memory
+};
+
+static const ModuleLoader moduleLoaders[] =
+{
+	{ "xm",   &CSoundFile::ReadXM,          nullptr },
+	{ "it",   &CSoundFile::ReadIT,          nullptr },
+	{ "s3m",  &CSoundFile::ReadS3M,         nullptr },
+	{ "itp",  &CSoundFile::ReadITProject,   nullptr },
+#ifdef MODPLUG_TRACKER
+	// this makes little sense for a module player library
+	{ "wav",  &CSoundFile::ReadWav,         nullptr },
+#endif // MODPLUG_TRACKER
+	{ "stm",  &CSoundFile::ReadSTM,         nullptr },
+	{ "med",  nullptr,                      &CSoundFile::ReadMed },
+	{ "mtm",  &CSoundFile::ReadMTM,         nullptr },
+	{ "mdl",  nullptr,                      &CSoundFile::ReadMDL },
+	{ "dbm",  &CSoundFile::ReadDBM,         nullptr },
+	{ "669",  &CSoundFile::Read669,         nullptr },
+	{ "far",  &CSoundFile::ReadFAR,         nullptr },
+	{ "ams",  &CSoundFile::ReadAMS,         nullptr },
+	{ "ams2", &CSoundFile::ReadAMS2,        nullptr },
+	{ "okt",  &CSoundFile::ReadOKT,         nullptr },
+	{ "ptm",  &CSoundFile::ReadPTM,         nullptr },
+	{ "ult",  &CSoundFile::ReadUlt,         nullptr },
+	{ "dmf",  &CSoundFile::ReadDMF,         nullptr },
+	{ "dsm",  &CSoundFile::ReadDSM,         nullptr },
+	{ "umx",  &CSoundFile::ReadUMX,         nullptr },
+	{ "amf0", &CSoundFile::ReadAMF_Asylum,  nullptr },
+	{ "amf",  &CSoundFile::ReadAMF_DSMI,    nullptr },
+	{ "psm",  &CSoundFile::ReadPSM,         nullptr },
+	{ "psm16",&CSoundFile::ReadPSM16,       nullptr },
+	{ "mt2",  &CSoundFile::ReadMT2,         nullptr },
+#ifdef MODPLUG_TRACKER
+	{ "mid",  nullptr,                      &CSoundFile::ReadMID },
+#endif // MODPLUG_TRACKER
+	{ "gdm",  &CSoundFile::ReadGDM,         nullptr },
+	{ "imf",  &CSoundFile::ReadIMF,         nullptr },
+	{ "digi", &CSoundFile::ReadDIGI,        nullptr },
+	{ "am",   &CSoundFile::ReadAM,          nullptr },
+	{ "j2b",  &CSoundFile::ReadJ2B,         nullptr },
+	{ "mo3",  &CSoundFile::ReadMO3,         nullptr },
+	{ "mod",  &CSoundFile::ReadMod,         nullptr },
+	{ "ice",  &CSoundFile::ReadICE,         nullptr },
+	{ "m15",  &CSoundFile::ReadM15,         nullptr },
+};
+
+
+// Cheap header signatures of the formats that have one.
+// The confidence reflects how unlikely it is that the signature is found in a file of another format by chance:
+// Long signatures at the start of the file score highest, short ones and signatures far into the file score lower.
+// The signatures are only used to find out which loaders should be tried first, the loaders still validate the header themselves.
+struct FormatSignature
+{
+	const char *format;
+	uint16 offset;
+	uint8 length;
+	uint8 confidence;
+	const char *magic;
+};
+
+static const FormatSignature formatSignatures[] =
+{
+	{ "xm",    0,    17, 100, "Extended Module: " },
+	{ "it",    0,     4,  80, "IMPM" },
+	{ "it",    0,     4,  80, "tpm." },
+	{ "s3m",   44,    4,  70, "SCRM" },
+	{ "itp",   0,     4,  80, "pti." },
+	{ "stm",   20,    8,  90, "!Scream!" },
+	{ "stm",   20,    8,  90, "!SCREAM!" },
+	{ "stm",   20,    8,  90, "BMOD2STM" },
+	{ "med",   0,     3,  50, "MMD" },
+	{ "mtm",   0,     3,  50, "MTM" },
+	{ "mdl",   0,     4,  80, "DMDL" },
+	{ "dbm",   0,     4,  80, "DBM0" },
+	{ "669",   0,     2,  20, "if" },
+	{ "669",   0,     2,  20, "JN" },
+	{ "far",   0,     4,  80, "FAR\xFE" },
+	{ "ams",   0,     7,  90, "Extreme" },
+	{ "ams2",  0,     7,  90, "AMShdr\x1A" },
+	{ "okt",   0,     8, 100, "OKTASONG" },
+	{ "ptm",   44,    4,  70, "PTMF" },
+	{ "ult",   0,    14, 100, "MAS_UTrack_V00" },
+	{ "dmf",   0,     4,  80, "DDMF" },
+	{ "dsm",   0,     4,  80, "DSMF" },
+	{ "dsm",   8,     4,  70, "DSMF" },
+	{ "umx",   0,     4,  80, "\xC1\x83\x2A\x9E" },
+	{ "amf0",  0,    24, 100, "ASYLUM Music Format V1.0" },
+	{ "amf",   0,     3,  50, "AMF" },
+	{ "psm",   0,     4,  80, "PSM " },
+	{ "psm16", 0,     4,  80, "PSM\xFE" },
+	{ "mt2",   0,     4,  80, "MT20" },
+	{ "gdm",   0,     4,  80, "GDM\xFE" },
+	{ "imf",   60,    4,  70, "IM10" },
+	{ "digi",  0,    20, 100, "DIGI Booster module\0" },
+	{ "am",    8,     4,  70, "AMFF" },
+	{ "am",    8,     4,  70, "AM  " },
+	{ "j2b",   0,     4,  80, "MUSE" },
+	{ "mo3",   0,     3,  50, "MO3" },
+	{ "mod",   1080,  4,  40, "M.K." },
+	{ "mod",   1080,  4,  40, "M!K!" },
+	{ "mod",   1080,  4,  40, "M&K!" },
+	{ "mod",   1080,  4,  40, "N.T." },
+	{ "mod",   1080,  4,  40, "CD81" },
+	{ "mod",   1080,  4,  40, "OKTA" },
+	{ "mod",   1080,  4,  40, "OCTA" },
+	{ "ice",   1464,  4,  40, "MTN\0" },
+	{ "ice",   1464,  4,  40, "IT10" },
+};
+
+
+static bool LoadWith(CSoundFile &sndFile, const ModuleLoader &loader, FileReader &file, CSoundFile::ModLoadingFlags loadFlags)
+//---------------------------------------------------------------------------------------------------------------------------
+{
+	if(loader.fileLoader != nullptr)
+	{
+		return (sndFile.*loader.fileLoader)(file, loadFlags);
+	} else
+	{
+		// Only request the raw data here, as this requires the whole file to be in memory (e.g. packed files have to be unpacked completely)
+		FileReader wholeFile = file;
+		wholeFile.Rewind();
+		return (sndFile.*loader.memoryLoader)(reinterpret_cast<const uint8 *>(wholeFile.GetRawData()), wholeFile.GetLength(), loadFlags);
+	}
+}
+
+
+struct SignatureMatch
+{
+	std::size_t loader;
+	uint8 confidence;
+	bool operator< (const SignatureMatch &other) const { return confidence > other.confidence; }
+};
+
+
+// Returns the indices of the loaders whose format signature is found in the file, most likely format first.
+static std::vector<SignatureMatch> MatchFormatSignatures(FileReader &file)
+//------------------------------------------------------------------------
+{
+	std::vector<SignatureMatch> matches;
+	for(std::size_t sig = 0; sig < CountOf(formatSignatures); sig++)
+	{
+		const FormatSignature &signature = formatSignatures[sig];
+		char magic[32];
+		MPT_ASSERT(signature.length <= sizeof(magic));
+		if(!file.Seek(signature.offset)
+			|| file.ReadRaw(magic, signature.length) != signature.length
+			|| memcmp(magic, signature.magic, signature.length))
+		{
+			continue;
+		}
+		for(std::size_t loader = 0; loader < CountOf(moduleLoaders); loader++)
+		{
+			if(!strcmp(moduleLoaders[loader].format, signature.format))
+			{
+				bool found = false;
+				for(std::vector<SignatureMatch>::const_iterator match = matches.begin(); match != matches.end(); match++)
+				{
+					found |= (match->loader == loader);
+				}
+				if(!found)
+				{
+					SignatureMatch match = { loader, signature.confidence };
+					matches.push_back(match);
+				}
+				break;
+			}
+		}
+	}
+	// Formats with the same confidence keep their loader chain order.
+	std::stable_sort(matches.begin(), matches.end());
+	file.Rewind();
+	return matches;
+}
+
+
+// Returns the formats whose signature is found in the file, in the order in which their loaders are tried.
+std::vector<const char *> CSoundFile::ProbeFormatSignatures(FileReader file)
+//--------------------------------------------------------------------------
+{
+	std::vector<SignatureMatch> matches = MatchFormatSignatures(file);
+	std::vector<const char *> formats;
+	for(std::vector<SignatureMatch>::const_iterator match = matches.begin(); match != matches.end(); match++)
+	{
+		formats.push_back(moduleLoaders[match->loader].format);
+	}
+	return formats;
+}
+
+
 #ifdef MODPLUG_TRACKER
 bool CSoundFile::Create(FileReader file, ModLoadingFlags loadFlags, CModDoc *pModDoc)
 //-----------------------------------------------------------------------------------
@@ -760,6 +962,17 @@ bool CSoundFile::Create(FileReader file, ModLoadingFlags loadFlags)
 #endif
 
 		MODCONTAINERTYPE packedContainerType = MOD_CONTAINERTYPE_NONE;
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+		// Packed files are only decompressed as far as the loaders actually read them.
+		FileReader unpackedFile;
+		if(packedContainerType == MOD_CONTAINERTYPE_NONE && (unpackedFile = UnpackXPK(file)).IsValid()) packedContainerType = MOD_CONTAINERTYPE_XPK;
+		if(packedContainerType == MOD_CONTAINERTYPE_NONE && (unpackedFile = UnpackPP20(file)).IsValid()) packedContainerType = MOD_CONTAINERTYPE_PP20;
+		if(packedContainerType == MOD_CONTAINERTYPE_NONE && (unpackedFile = UnpackMMCMP(file)).IsValid()) packedContainerType = MOD_CONTAINERTYPE_MMCMP;
+		if(packedContainerType != MOD_CONTAINERTYPE_NONE)
+		{
+			file = unpackedFile;
+		}
+#else
 		std::vector<char> unpackedData;
 		if(packedContainerType == MOD_CONTAINERTYPE_NONE && UnpackXPK(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_XPK;
 		if(packedContainerType == MOD_CONTAINERTYPE_NONE && UnpackPP20(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_PP20;
@@ -768,51 +981,39 @@ bool CSoundFile::Create(FileReader file, ModLoadingFlags loadFlags)
 		{
 			file = FileReader(&(unpackedData[0]), unpackedData.size());
 		}
+#endif
 
 		file.Rewind();
-		const uint8 *lpStream = reinterpret_cast<const unsigned char*>(file.GetRawData());
-		DWORD dwMemLength = file.GetLength();
 
-		if(!ReadXM(file, loadFlags)
-		 && !ReadIT(file, loadFlags)
-		 && !ReadS3M(file, loadFlags)
-		 && !ReadITProject(file, loadFlags)
-#ifdef MODPLUG_TRACKER
-		// this makes little sense for a module player library
-		 && !ReadWav(file, loadFlags)
-#endif // MODPLUG_TRACKER
-		 && !ReadSTM(file, loadFlags)
-		 && !ReadMed(lpStream, dwMemLength, loadFlags)
-		 && !ReadMTM(file, loadFlags)
-		 && !ReadMDL(lpStream, dwMemLength, loadFlags)
-		 && !ReadDBM(file, loadFlags)
-		 && !Read669(file, loadFlags)
-		 && !ReadFAR(file, loadFlags)
-		 && !ReadAMS(file, loadFlags)
-		 && !ReadAMS2(file, loadFlags)
-		 && !ReadOKT(file, loadFlags)
-		 && !ReadPTM(file, loadFlags)
-		 && !ReadUlt(file, loadFlags)
-		 && !ReadDMF(file, loadFlags)
-		 && !ReadDSM(file, loadFlags)
-		 && !ReadUMX(file, loadFlags)
-		 && !ReadAMF_Asylum(file, loadFlags)
-		 && !ReadAMF_DSMI(file, loadFlags)
-		 && !ReadPSM(file, loadFlags)
-		 && !ReadPSM16(file, loadFlags)
-		 && !ReadMT2(file, loadFlags)
-#ifdef MODPLUG_TRACKER
-		 && !ReadMID(lpStream, dwMemLength, loadFlags)
-#endif // MODPLUG_TRACKER
-		 && !ReadGDM(file, loadFlags)
-		 && !ReadIMF(file, loadFlags)
-		 && !ReadDIGI(file, loadFlags)
-		 && !ReadAM(file, loadFlags)
-		 && !ReadJ2B(file, loadFlags)
-		 && !ReadMO3(file, loadFlags)
-		 && !ReadMod(file, loadFlags)
-		 && !ReadICE(file, loadFlags)
-		 && !ReadM15(file, loadFlags))
+		// Try the loaders whose signature matches first, so that files of formats with weak signatures
+		// (e.g. MOD) don't have to go through the whole loader chain. Then try all remaining loaders.
+		std::vector<SignatureMatch> matches = MatchFormatSignatures(file);
+		std::vector<bool> triedLoaders(CountOf(moduleLoaders), false);
+		bool loaded = false;
+		for(std::vector<SignatureMatch>::const_iterator match = matches.begin(); match != matches.end() && !loaded; match++)
+		{
+			loaded = LoadWith(*this, moduleLoaders[match->loader], file, loadFlags);
+			triedLoaders[match->loader] = true;
+		}
+		for(std::size_t loader = 0; loader < CountOf(moduleLoaders) && !loaded; loader++)
+		{
+			if(!triedLoaders[loader])
+			{
+				loaded = LoadWith(*this, moduleLoaders[loader], file, loadFlags);
+			}
+		}
+
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+		// The packed data may have turned out to be invalid only while the loaders were reading it.
+		// As with the old eager decompression, such files are rejected rather than loaded from partially unpacked data.
+		if(packedContainerType != MOD_CONTAINERTYPE_NONE && !unpackedFile.IsValid())
+		{
+			loaded = false;
+			packedContainerType = MOD_CONTAINERTYPE_NONE;
+		}
+#endif
+
+		if(!loaded)
 		{
 			m_nType = MOD_TYPE_NONE;
 			m_ContainerType = MOD_CONTAINERTYPE_NONE;
@@ -860,7 +1061,7 @@ bool CSoundFile::Create(FileReader file, ModLoadingFlags loadFlags)
 		if(pSmp->pSample)
 		{
 			pSmp->PrecomputeLoops(*this, false);
-		} else
+		} else if(!IsSampleDecodingDeferred(nSmp))
 		{
 			pSmp->nLength = 0;
 			pSmp->nLoopStart = 0;
@@ -999,6 +1200,10 @@ bool CSoundFile::Destroy()
 	}
 
 	Patterns.DestroyPatterns();
+	m_SeekIndex.Clear();
+	m_SongLengthCache.Clear();
+	m_LazySamples.clear();
+	m_SampleIndex.clear();
 
 	songName.clear();
 	songArtist.clear();
@@ -1034,11 +1239,6 @@ bool CSoundFile::Destroy()
 void CSoundFile::SetDspEffects(DWORD DSPMask)
 //-------------------------------------------
 {
-#ifdef ENABLE_ASM
-#ifndef NO_REVERB
-	if(!(GetProcSupport() & PROCSUPPORT_MMX)) DSPMask &= ~SNDDSP_REVERB;
-#endif
-#endif
 	m_MixerSettings.DSPMask = DSPMask;
 	InitPlayer(false);
 }
@@ -1291,6 +1491,25 @@ void CSoundFile::RecalculateGainForAllPlugs()
 
 //end rewbs.VSTCompliance
 
+// Limit the number of voices (pattern channels plus NNA voices).
+// Voices above the limit are cut like a note cut NNA, i.e. they are ramped down to silence and stopped by ReadNote() afterwards.
+void CSoundFile::SetMaxVoices(CHANNELINDEX maxVoices)
+//---------------------------------------------------
+{
+	m_nMaxVoices = Clamp(maxVoices, CHANNELINDEX(1), MAX_CHANNELS);
+	for(CHANNELINDEX i = std::max(m_nChannels, m_nMaxVoices); i < MAX_CHANNELS; i++)
+	{
+		ModChannel &chn = m_PlayState.Chn[i];
+		if(chn.nLength)
+		{
+			chn.nFadeOutVol = 0;
+			chn.dwFlags.set(CHN_NOTEFADE | CHN_FASTVOLRAMP);
+		}
+	}
+	m_VoicePool.Invalidate();
+}
+
+
 void CSoundFile::ResetChannels()
 //------------------------------
 {
@@ -1611,6 +1830,7 @@ bool CSoundFile::DestroySample(SAMPLEINDEX nSample)
 	{
 		return false;
 	}
+	m_LazySamples.erase(nSample);
 	if(Samples[nSample].pSample == nullptr)
 	{
 		return true;
@@ -1884,39 +2104,40 @@ void CSoundFile::RecalculateSamplesPerTick()
 
 // Get length of a tick in sample, with tick-to-tick tempo correction in modern tempo mode.
 // This has to be called exactly once per tick because otherwise the error accumulation
-// goes wrong.
-UINT CSoundFile::GetTickDuration(UINT tempo, UINT speed, ROWINDEX rowsPerBeat)
-//----------------------------------------------------------------------------
+// goes wrong. The accumulated error is stored in the given play state, so that length
+// calculations can use their own state and do not interfere with the player.
+UINT CSoundFile::GetTickDuration(PlayState &playState) const
+//----------------------------------------------------------
 {
 	UINT retval = 0;
 	switch(m_nTempoMode)
 	{
 	case tempo_mode_classic:
 	default:
-		retval = (m_MixerSettings.gdwMixingFreq * 5) / (tempo << 1);
+		retval = (m_MixerSettings.gdwMixingFreq * 5) / (playState.m_nMusicTempo << 1);
 		break;
 
 	case tempo_mode_alternative:
-		retval = m_MixerSettings.gdwMixingFreq / tempo;
+		retval = m_MixerSettings.gdwMixingFreq / playState.m_nMusicTempo;
 		break;
 
 	case tempo_mode_modern:
 		{
-			double accurateBufferCount = static_cast<double>(m_MixerSettings.gdwMixingFreq) * (60.0 / static_cast<double>(tempo) / (static_cast<double>(speed * rowsPerBeat)));
+			double accurateBufferCount = static_cast<double>(m_MixerSettings.gdwMixingFreq) * (60.0 / static_cast<double>(playState.m_nMusicTempo) / (static_cast<double>(playState.m_nMusicSpeed * playState.m_nCurrentRowsPerBeat)));
 			UINT bufferCount = static_cast<int>(accurateBufferCount);
-			m_PlayState.m_dBufferDiff += accurateBufferCount - bufferCount;
+			playState.m_dBufferDiff += accurateBufferCount - bufferCount;
 
 			//tick-to-tick tempo correction:
-			if(m_PlayState.m_dBufferDiff >= 1)
+			if(playState.m_dBufferDiff >= 1)
 			{
 				bufferCount++;
-				m_PlayState.m_dBufferDiff--;
-			} else if(m_PlayState.m_dBufferDiff <= -1)
+				playState.m_dBufferDiff--;
+			} else if(playState.m_dBufferDiff <= -1)
 			{
 				bufferCount--;
-				m_PlayState.m_dBufferDiff++;
+				playState.m_dBufferDiff++;
 			}
-			MPT_ASSERT(fabs(m_PlayState.m_dBufferDiff) < 1);
+			MPT_ASSERT(fabs(playState.m_dBufferDiff) < 1);
 			retval = bufferCount;
 		}
 		break;
@@ -2077,6 +2298,142 @@ void CSoundFile::PrecomputeSampleLoops(bool updateChannels)
 }
 
 
+// Keep the encoded sample data at the current file position instead of decoding it.
+// Returns false if the sample has to be decoded right away.
+bool CSoundFile::DeferSampleDecoding(SAMPLEINDEX smp, const SampleIO &format, FileReader &file)
+//---------------------------------------------------------------------------------------------
+{
+	if(smp == 0 || smp >= MAX_SAMPLES)
+	{
+		return false;
+	}
+	ModSample &sample = Samples[smp];
+	LimitMax(sample.nLength, MAX_SAMPLE_LENGTH);
+	const size_t encodedSize = format.CalculateEncodedSize(sample.nLength, file);
+	if(sample.nLength == 0 || encodedSize == 0)
+	{
+		return false;
+	}
+
+	LazySample &lazySample = m_LazySamples[smp];
+	lazySample.format = format;
+	lazySample.data.resize(encodedSize);
+	file.ReadRaw(&lazySample.data[0], encodedSize);
+
+	// The player needs to know the sample format before the sample is decoded.
+	sample.FreeSample();
+	sample.uFlags.set(CHN_16BIT, format.GetBitDepth() >= 16);
+	sample.uFlags.set(CHN_STEREO, format.GetChannelFormat() != SampleIO::mono);
+	return true;
+}
+
+
+// Rebuild the index of a sample slot after its sample data has been replaced or modified.
+void CSoundFile::BuildSampleIndex(const ModSample &smp)
+//-----------------------------------------------------
+{
+	if(&smp < Samples || &smp >= Samples + MAX_SAMPLES)
+	{
+		return;
+	}
+	const SAMPLEINDEX slot = static_cast<SAMPLEINDEX>(&smp - Samples);
+	if(m_SampleIndex.size() <= slot)
+	{
+		m_SampleIndex.resize(slot + 1);
+	}
+	m_SampleIndex[slot].Build(smp);
+}
+
+
+// Update the index of a sample slot after the sampling points first to last (inclusive) have been modified in-place.
+void CSoundFile::UpdateSampleIndex(const ModSample &smp, SmpLength first, SmpLength last)
+//---------------------------------------------------------------------------------------
+{
+	if(&smp < Samples || &smp >= Samples + MAX_SAMPLES)
+	{
+		return;
+	}
+	const SAMPLEINDEX slot = static_cast<SAMPLEINDEX>(&smp - Samples);
+	if(m_SampleIndex.size() <= slot)
+	{
+		m_SampleIndex.resize(slot + 1);
+	}
+	m_SampleIndex[slot].Update(smp, first, last);
+}
+
+
+// Returns the index of a sample slot, or nullptr if there is no index for its current sample data.
+const SampleIndex *CSoundFile::GetSampleIndex(const ModSample &smp) const
+//-----------------------------------------------------------------------
+{
+	if(&smp < Samples || &smp >= Samples + MAX_SAMPLES)
+	{
+		return nullptr;
+	}
+	const SAMPLEINDEX slot = static_cast<SAMPLEINDEX>(&smp - Samples);
+	// The index is only valid if the sample data has not been replaced since it was built
+	if(slot >= m_SampleIndex.size() || !m_SampleIndex[slot].IsValid(smp))
+	{
+		return nullptr;
+	}
+	return &m_SampleIndex[slot];
+}
+
+
+// Returns true if all sampling points from first to last (inclusive) of a sample are known to be digital silence.
+bool CSoundFile::IsSampleRangeSilent(const ModSample &smp, SmpLength first, SmpLength last) const
+//----------------------------------------------------------------------------------------------
+{
+	const SampleIndex *index = GetSampleIndex(smp);
+	return index != nullptr && index->IsRangeSilent(first, last);
+}
+
+
+// Decode a sample whose decoding has been deferred by the loader.
+// Returns true if the sample has sample data afterwards.
+bool CSoundFile::DecodeLazySample(SAMPLEINDEX smp)
+//------------------------------------------------
+{
+	std::map<SAMPLEINDEX, LazySample>::iterator lazySample = m_LazySamples.find(smp);
+	if(lazySample == m_LazySamples.end())
+	{
+		return smp < MAX_SAMPLES && Samples[smp].HasSampleData();
+	}
+
+	ModSample &sample = Samples[smp];
+	FileReader file(&lazySample->second.data[0], lazySample->second.data.size());
+	lazySample->second.format.ReadSample(sample, file);
+	m_LazySamples.erase(lazySample);
+
+	if(sample.pSample != nullptr)
+	{
+		sample.PrecomputeLoops(*this, false);
+		return true;
+	}
+	// Decoding failed, so make sure that nobody tries to play the sample.
+	sample.nLength = 0;
+	for(CHANNELINDEX i = 0; i < MAX_CHANNELS; i++)
+	{
+		if(m_PlayState.Chn[i].pModSample == &sample)
+		{
+			m_PlayState.Chn[i].nLength = 0;
+		}
+	}
+	return false;
+}
+
+
+bool CSoundFile::DecodeLazySample(const ModSample *sample)
+//--------------------------------------------------------
+{
+	if(sample < Samples || sample >= Samples + MAX_SAMPLES)
+	{
+		return false;
+	}
+	return DecodeLazySample(static_cast<SAMPLEINDEX>(sample - Samples));
+}
+
+
 #ifdef MPT_EXTERNAL_SAMPLES
 // Load external waveform, but keep sample properties like frequency, panning, etc...
 // Returns true if the file could be loaded.
@@ -46,10 +46,14 @@
 #include "modcommand.h"
 #include "plugins/PlugInterface.h"
 #include "RowVisitor.h"
+#include "SeekIndex.h"
+#include "ParallelMixer.h"
 #include "Message.h"
 #include "pattern.h"
 #include "patternContainer.h"
 #include "ModSequence.h"
+#include "SampleIO.h"
+#include <map>
 
 
 OPENMPT_NAMESPACE_BEGIN
@@ -76,6 +80,13 @@ bool IMAADPCMUnpack16(int16 *target, SmpLength sampleLen, FileReader file, uint1
 bool UnpackXPK(std::vector<char> &unpackedData, FileReader &file);
 bool UnpackPP20(std::vector<char> &unpackedData, FileReader &file);
 bool UnpackMMCMP(std::vector<char> &unpackedData, FileReader &file);
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+// These return a FileReader for the unpacked file, which is decompressed on demand as it is read,
+// or an invalid FileReader if the file is not packed with the corresponding packer.
+FileReader UnpackXPK(FileReader &file);
+FileReader UnpackPP20(FileReader &file);
+FileReader UnpackMMCMP(FileReader &file);
+#endif
 
 typedef void (* LPSNDMIXHOOKPROC)(int *, unsigned long, unsigned long); // buffer, samples, channels
 
@@ -265,6 +276,108 @@ struct TimingInfo
 };
 
 
+// Where the time in CSoundFile::Read goes, and how much has been rendered.
+// The counters are plain integers, as a CSoundFile is never rendered by more than one thread at a time.
+// To keep the timing overhead low, only one run of one randomly chosen stage is timed in about every eighth tick,
+// and the time of every stage is extrapolated from its timed runs.
+struct RenderStats
+{
+	enum Stage
+	{
+		stageReadNote = 0,		// Tick processing, including stageProcessEffects
+		stageProcessEffects,	// Pattern effects (part of stageReadNote)
+		stageMix,				// Mixing the sample voices
+		stagePlugins,			// Plugin processing (part of stageDSP)
+		stageDSP,				// Reverb, plugins, DSP effects, global volume and stereo separation
+		stageOutput,			// Output gain, dithering and sample format conversion
+		numStages
+	};
+
+	uint64 renderedFrames;
+	uint64 ticks;
+	uint64 chunks;
+	uint64 mixedVoices;		// Sum over all chunks
+	uint64 culledVoices;	// Sum over all chunks
+	uint64 runs[numStages];			// How often each stage has been run
+	uint64 runFrames[numStages];	// Frames processed in all runs of the stages that work on chunks
+	uint64 timedRuns[numStages];	// How many of these runs have been timed
+	uint64 timedFrames[numStages];	// Frames processed in the timed runs
+	uint64 timedTime[numStages];	// Nanoseconds spent in the timed runs
+	bool timingEnabled;
+
+protected:
+	uint64 timingStart;
+	uint32 rngState;
+	Stage timedStage;	// Stage that is timed during the current tick
+	bool tickTimed;		// The current tick has already been timed
+
+public:
+	RenderStats() : timingEnabled(false) { Reset(); }
+
+	void Reset()
+	{
+		renderedFrames = ticks = chunks = mixedVoices = culledVoices = 0;
+		std::fill(runs, runs + numStages, uint64(0));
+		std::fill(runFrames, runFrames + numStages, uint64(0));
+		std::fill(timedRuns, timedRuns + numStages, uint64(0));
+		std::fill(timedFrames, timedFrames + numStages, uint64(0));
+		std::fill(timedTime, timedTime + numStages, uint64(0));
+		timingStart = 0;
+		rngState = 1;
+		timedStage = stageReadNote;
+		tickTimed = true;
+	}
+
+	// Choose whether and which stage is timed until the next tick. The choice is random, as a fixed rotation could line up with the song speed.
+	void BeginTick()
+	{
+		if(timingEnabled)
+		{
+			rngState = rngState * 1103515245 + 12345;
+			const uint32 r = rngState >> 16;
+			timedStage = static_cast<Stage>(r % numStages);
+			tickTimed = ((r / numStages) % 8) != 0;
+		}
+	}
+
+	void Start(Stage stage)
+	{
+		if(timingEnabled && stage == timedStage && !tickTimed)
+		{
+			timingStart = Util::GetTimestampNanoseconds();
+		}
+	}
+
+	// Stages that work on chunks pass the number of frames, so that their time can be extrapolated by frames instead of runs.
+	void Stop(Stage stage, uint64 frames = 0)
+	{
+		runs[stage]++;
+		runFrames[stage] += frames;
+		if(timingEnabled && stage == timedStage && !tickTimed)
+		{
+			timedTime[stage] += Util::GetTimestampNanoseconds() - timingStart;
+			timedRuns[stage]++;
+			timedFrames[stage] += frames;
+			tickTimed = true;
+		}
+	}
+
+	// Estimated nanoseconds spent in all runs of a stage.
+	// Only the first chunk of a tick is timed, which is usually longer than the remaining chunks, so chunk stages are extrapolated by frames.
+	uint64 GetTime(Stage stage) const
+	{
+		if(timedFrames[stage])
+		{
+			return static_cast<uint64>(static_cast<double>(timedTime[stage]) * static_cast<double>(runFrames[stage]) / static_cast<double>(timedFrames[stage]));
+		} else if(timedRuns[stage])
+		{
+			return static_cast<uint64>(static_cast<double>(timedTime[stage]) * static_cast<double>(runs[stage]) / static_cast<double>(timedRuns[stage]));
+		}
+		return 0;
+	}
+};
+
+
 class IAudioReadTarget
 {
 public:
@@ -373,6 +486,10 @@ private:
 public:
 	MixerSettings m_MixerSettings;
 	CResampler m_Resampler;
+#ifndef NO_THREADS
+	// Worker threads for mixing voices in parallel (disabled by default)
+	ParallelMixer m_ParallelMixer;
+#endif
 #ifndef NO_REVERB
 	CReverb m_Reverb;
 #endif
@@ -408,6 +525,11 @@ public:
 	CHANNELINDEX m_nMixChannels;
 private:
 	CHANNELINDEX m_nMixStat;
+	CHANNELINDEX m_nMixedVoices, m_nCulledVoices;	// Statistics of the last mixed chunk
+	CHANNELINDEX m_nMaxVoices;	// Pattern channels plus NNA voices that may be used
+	VoicePool m_VoicePool;		// Free and stealable NNA voices during ProcessRow()
+public:
+	RenderStats m_RenderStats;
 public:
 	ROWINDEX m_nDefaultRowsPerBeat, m_nDefaultRowsPerMeasure;	// default rows per beat and measure for this module // rewbs.betterBPM
 	tempoMode m_nTempoMode;
@@ -450,6 +572,7 @@ public:
 	struct PlayState
 	{
 		friend class CSoundFile;
+		friend class GetLengthMemory;
 	protected:
 		samplecount_t m_nBufferCount;
 		double m_dBufferDiff;
@@ -501,8 +624,15 @@ public:
 protected:
 	// For handling backwards jumps and stuff to prevent infinite loops when counting the mod length or rendering to wav.
 	RowVisitor visitedSongRows;
+	// Visited row memory of the previous GetLength() call
+	RowVisitor::MemoryCache m_visitedRowsCache;
 
 public:
+	// Checkpoints for speeding up GetLength() seeks (disabled by default)
+	SeekIndex m_SeekIndex;
+	// Order entries for recalculating the song length after edits (disabled by default)
+	SongLengthCache m_SongLengthCache;
+
 #ifdef MODPLUG_TRACKER
 	std::bitset<MAX_BASECHANNELS> m_bChannelMuteTogglePending;
 
@@ -538,6 +668,36 @@ public:
 	bool LoadExternalSample(SAMPLEINDEX smp, const mpt::PathString &filename);
 #endif // MPT_EXTERNAL_SAMPLES
 
+protected:
+	// Compressed sample data whose decoding has been deferred by the loader (see decodeSamplesLazily)
+	struct LazySample
+	{
+		std::vector<char> data;
+		SampleIO format;
+	};
+	std::map<SAMPLEINDEX, LazySample> m_LazySamples;
+
+public:
+	// Keep the encoded sample data at the current file position instead of decoding it. Returns false if the sample has to be decoded right away.
+	bool DeferSampleDecoding(SAMPLEINDEX smp, const SampleIO &format, FileReader &file);
+	bool IsSampleDecodingDeferred(SAMPLEINDEX smp) const { return m_LazySamples.count(smp) != 0; }
+	// Decode a deferred sample. Returns true if the sample has sample data afterwards.
+	bool DecodeLazySample(SAMPLEINDEX smp);
+	bool DecodeLazySample(const ModSample *sample);
+
+protected:
+	std::vector<SampleIndex> m_SampleIndex;	// Indexed by sample slot
+
+public:
+	// Rebuild the index of a sample slot after its sample data has been replaced or modified (called by ctrlSmp::PrecomputeLoops)
+	void BuildSampleIndex(const ModSample &smp);
+	// Update the index of a sample slot after the sampling points first to last (inclusive) have been modified in-place
+	void UpdateSampleIndex(const ModSample &smp, SmpLength first, SmpLength last);
+	// Returns the index of a sample slot, or nullptr if there is no index for its current sample data
+	const SampleIndex *GetSampleIndex(const ModSample &smp) const;
+	// Returns true if all sampling points from first to last (inclusive) of a sample are known to be digital silence
+	bool IsSampleRangeSilent(const ModSample &smp, SmpLength first, SmpLength last) const;
+
 	bool m_bIsRendering;
 	TimingInfo m_TimingInfo; // only valid if !m_bIsRendering
 
@@ -567,6 +727,7 @@ public:
 		loadPatternData		= 0x01,	// If unset, advise loaders to not process any pattern data (if possible)
 		loadSampleData		= 0x02,	// If unset, advise loaders to not process any sample data (if possible)
 		loadPluginData		= 0x04,	// If unset, plugins are not instanciated.
+		decodeSamplesLazily	= 0x08,	// If set, advise loaders to keep compressed sample data and only decode it when the sample is played for the first time
 		// Shortcuts
 		loadCompleteModule	= loadSampleData | loadPatternData | loadPluginData,
 		loadNoPatternOrPluginData	= loadSampleData,
@@ -619,6 +780,13 @@ public:
 	void DontLoopPattern(PATTERNINDEX nPat, ROWINDEX nRow = 0);		//rewbs.playSongFromCursor
 	CHANNELINDEX GetMixStat() const { return m_nMixStat; }
 	void ResetMixStat() { m_nMixStat = 0; }
+	// Number of voices that have been mixed in the last chunk
+	CHANNELINDEX GetNumMixedVoices() const { return m_nMixedVoices; }
+	// Number of voices that have been skipped in the last chunk because they were silent (zero volume or digital silence)
+	CHANNELINDEX GetNumCulledVoices() const { return m_nCulledVoices; }
+	// Limit the number of voices (pattern channels plus NNA voices) to a value up to MAX_CHANNELS. Voices above the limit are faded out quickly.
+	void SetMaxVoices(CHANNELINDEX maxVoices);
+	CHANNELINDEX GetMaxVoices() const { return m_nMaxVoices; }
 	void SetCurrentPos(UINT nPos);
 	void SetCurrentOrder(ORDERINDEX nOrder);
 	std::string GetTitle() const { return songName; }
@@ -641,7 +809,7 @@ public:
 
 	void RecalculateSamplesPerTick();
 	double GetRowDuration(UINT tempo, UINT speed) const;
-	UINT GetTickDuration(UINT tempo, UINT speed, ROWINDEX rowsPerBeat);
+	UINT GetTickDuration(PlayState &playState) const;
 
 	// A repeat count value of -1 means infinite loop
 	void SetRepeatCount(int n) { m_nRepeatCount = n; }
@@ -693,6 +861,8 @@ public:
 	bool ReadMID(const uint8 *lpStream, DWORD dwMemLength, ModLoadingFlags loadFlags = loadCompleteModule);
 
 	static std::vector<const char *> GetSupportedExtensions(bool otherFormats);
+	// Returns the formats whose header signature is found in the file, most likely format first. Create() tries their loaders first.
+	static std::vector<const char *> ProbeFormatSignatures(FileReader file);
 	static mpt::Charset GetCharsetFromModType(MODTYPE modtype);
 	static const char * ModTypeToString(MODTYPE modtype);
 	static std::string ModContainerTypeToString(MODCONTAINERTYPE containertype);
@@ -744,6 +914,17 @@ public:
 	samplecount_t Read(samplecount_t count, IAudioReadTarget &target);
 private:
 	void CreateStereoMix(int count);
+	bool MixChannel(ModChannel &chn, mixsample_t *pbuffer, mixsample_t *pOfsR, mixsample_t *pOfsL, int count, bool mixingAllowed, bool ITPingPongMode, bool &culled) const;
+	bool IsVoiceSegmentSilent(const ModChannel &chn, int32 count, SmpLength readLimit) const;
+#if !defined(NO_THREADS) && defined(MPT_INTMIXER)
+	struct ParallelMixContext
+	{
+		CSoundFile *sndFile;
+		int count;
+		bool ITPingPongMode;
+	};
+	static void ParallelMixVoices(void *context, ParallelMixer::Worker &worker);
+#endif
 public:
 	bool FadeSong(UINT msec);
 private:
@@ -770,7 +951,7 @@ public:
 	bool ReadNote();
 	bool ProcessRow();
 	bool ProcessEffects();
-	CHANNELINDEX GetNNAChannel(CHANNELINDEX nChn) const;
+	CHANNELINDEX GetNNAChannel(CHANNELINDEX nChn);
 	void CheckNNA(CHANNELINDEX nChn, UINT instr, int note, bool forceCut);
 	void NoteChange(ModChannel *pChn, int note, bool bPorta = false, bool bResetEnv = true, bool bManual = false) const;
 	void InstrumentChange(ModChannel *pChn, UINT instr, bool bPorta = false, bool bUpdVol = true, bool bResetEnv = true) const;
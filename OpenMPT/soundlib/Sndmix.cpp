@@ -205,6 +205,8 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 		// Update Channel Data
 		if(!m_PlayState.m_nBufferCount)
 		{ // last tick or fade completely processed, find out what to do next
+			m_RenderStats.BeginTick();
+			m_RenderStats.Start(RenderStats::stageReadNote);
 
 			if(m_SongFlags[SONG_FADINGSONG])
 			{ // song was faded out
@@ -212,6 +214,7 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 			} else if(ReadNote())
 			{ // render next tick (normal progress)
 				MPT_ASSERT(m_PlayState.m_nBufferCount > 0);
+				m_RenderStats.ticks++;
 				#ifdef MODPLUG_TRACKER
 					// Save pattern cue points for WAV rendering here (if we reached a new pattern, that is.)
 					if(IsRenderingToDisc() && (m_PatternCuePoints.empty() || m_PlayState.m_nCurrentOrder != m_PatternCuePoints.back().order))
@@ -247,6 +250,7 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 				}
 			}
 
+			m_RenderStats.Stop(RenderStats::stageReadNote);
 		}
 
 		if(m_SongFlags[SONG_ENDREACHED])
@@ -258,15 +262,26 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 
 		const samplecount_t countChunk = std::min<samplecount_t>(MIXBUFFERSIZE, std::min<samplecount_t>(m_PlayState.m_nBufferCount, countToRender));
 
+		m_RenderStats.Start(RenderStats::stageMix);
 		CreateStereoMix(countChunk);
+		m_RenderStats.Stop(RenderStats::stageMix, countChunk);
+
+		m_RenderStats.Start(RenderStats::stageDSP);
 
 		#ifndef NO_REVERB
-			m_Reverb.Process(MixSoundBuffer, countChunk);
+			#ifndef MODPLUG_TRACKER
+				if(m_MixerSettings.DSPMask & SNDDSP_REVERB)
+			#endif // !MODPLUG_TRACKER
+				{
+					m_Reverb.Process(MixSoundBuffer, countChunk);
+				}
 		#endif // NO_REVERB
 
 		if(mixPlugins)
 		{
+			m_RenderStats.Start(RenderStats::stagePlugins);
 			ProcessPlugins(countChunk);
+			m_RenderStats.Stop(RenderStats::stagePlugins, countChunk);
 		}
 
 		if(m_MixerSettings.gnChannels == 1)
@@ -294,7 +309,16 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 			InterleaveFrontRear(MixSoundBuffer, MixRearBuffer, countChunk);
 		}
 
+		m_RenderStats.Stop(RenderStats::stageDSP, countChunk);
+
+		m_RenderStats.Start(RenderStats::stageOutput);
 		target.DataCallback(MixSoundBuffer, m_MixerSettings.gnChannels, countChunk);
+		m_RenderStats.Stop(RenderStats::stageOutput, countChunk);
+
+		m_RenderStats.chunks++;
+		m_RenderStats.renderedFrames += countChunk;
+		m_RenderStats.mixedVoices += m_nMixedVoices;
+		m_RenderStats.culledVoices += m_nCulledVoices;
 
 		// Buffer ready
 		countRendered += countChunk;
@@ -302,7 +326,6 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 		m_PlayState.m_nBufferCount -= countChunk;
 		m_PlayState.m_lTotalSampleCount += countChunk;		// increase sample count for VSTTimeInfo.
 
-#ifdef MODPLUG_TRACKER
 		if(IsRenderingToDisc())
 		{
 			// Stop playback on F00 if no more voices are active.
@@ -316,7 +339,6 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 				m_SongFlags.set(SONG_ENDREACHED);
 			}
 		}
-#endif // MODPLUG_TRACKER
 	}
 
 	// mix done
@@ -647,7 +669,10 @@ bool CSoundFile::ProcessRow()
 	}
 
 	// Update Effects
-	return ProcessEffects();
+	m_RenderStats.Start(RenderStats::stageProcessEffects);
+	const bool result = ProcessEffects();
+	m_RenderStats.Stop(RenderStats::stageProcessEffects);
+	return result;
 }
 
 
@@ -1763,13 +1788,17 @@ bool CSoundFile::ReadNote()
 	} else
 #endif // MODPLUG_TRACKER
 	{
-		if(!ProcessRow())
+		// The voice pool is only kept up to date while the row is processed.
+		m_VoicePool.Invalidate();
+		const bool rowProcessed = ProcessRow();
+		m_VoicePool.Invalidate();
+		if(!rowProcessed)
 			return false;
 	}
 	////////////////////////////////////////////////////////////////////////////////////
 	if (!m_PlayState.m_nMusicTempo) return false;
 
-	m_PlayState.m_nSamplesPerTick = GetTickDuration(m_PlayState.m_nMusicTempo, m_PlayState.m_nMusicSpeed, m_PlayState.m_nCurrentRowsPerBeat);
+	m_PlayState.m_nSamplesPerTick = GetTickDuration(m_PlayState);
 	m_PlayState.m_nBufferCount = m_PlayState.m_nSamplesPerTick;
 
 	// Master Volume + Pre-Amplification / Attenuation setup
@@ -1812,13 +1841,15 @@ bool CSoundFile::ReadNote()
 	////////////////////////////////////////////////////////////////////////////////////
 	// Update channels data
 	m_nMixChannels = 0;
+	const CHANNELINDEX voiceLimit = std::max(m_nChannels, m_nMaxVoices);
 	ModChannel *pChn = m_PlayState.Chn;
 	for (CHANNELINDEX nChn = 0; nChn < MAX_CHANNELS; nChn++, pChn++)
 	{
 		// FT2 Compatibility: Prevent notes to be stopped after a fadeout. This way, a portamento effect can pick up a faded instrument which is long enough.
 		// This occours for example in the bassline (channel 11) of jt_burn.xm. I hope this won't break anything else...
 		// I also suppose this could decrease mixing performance a bit, but hey, which CPU can't handle 32 muted channels these days... :-)
-		if(pChn->dwFlags[CHN_NOTEFADE] && (!(pChn->nFadeOutVol|pChn->leftVol|pChn->rightVol)) && (!IsCompatibleMode(TRK_FASTTRACKER2)))
+		// Voices above the voice limit are always stopped once they have been faded out, see SetMaxVoices().
+		if(pChn->dwFlags[CHN_NOTEFADE] && (!(pChn->nFadeOutVol|pChn->leftVol|pChn->rightVol)) && (!IsCompatibleMode(TRK_FASTTRACKER2) || nChn >= voiceLimit))
 		{
 			pChn->nLength = 0;
 			pChn->nROfs = pChn->nLOfs = 0;
@@ -2047,6 +2078,11 @@ bool CSoundFile::ReadNote()
 		// Check for too big nInc
 		//if (((pChn->nInc >> 16) + 1) >= (int32)(pChn->nLoopEnd - pChn->nLoopStart)) pChn->dwFlags.reset(CHN_LOOP);
 		pChn->newLeftVol = pChn->newRightVol = 0;
+		// Samples whose decoding has been deferred by the loader are decoded the first time they are played.
+		if(pChn->pModSample != nullptr && pChn->pModSample->pSample == nullptr && pChn->nLength && pChn->nInc && !m_LazySamples.empty())
+		{
+			DecodeLazySample(pChn->pModSample);
+		}
 		pChn->pCurrentSample = (pChn->pModSample && pChn->pModSample->pSample && pChn->nLength && pChn->nInc) ? pChn->pModSample->pSample : nullptr;
 		if (pChn->pCurrentSample)
 		{
@@ -16,6 +16,7 @@
 
 #include "Resampler.h"
 #include "WindowedFIR.h"
+#include "../common/mutex.h"
 
 
 OPENMPT_NAMESPACE_BEGIN
@@ -908,54 +909,103 @@ static void getdownsample2x(short int *psinc)
 #endif
 
 
-#ifdef MODPLUG_TRACKER
-bool CResampler::StaticTablesInitialized = false;
-SINC_TYPE CResampler::gDownsample13x[SINC_PHASES*8];	// Downsample 1.333x
-SINC_TYPE CResampler::gDownsample2x[SINC_PHASES*8];		// Downsample 2x
-#ifndef MPT_INTMIXER
-mixsample_t CResampler::FastSincTablef[256 * 4];		// Cubic spline LUT
-mixsample_t CResampler::LinearTablef[256];				// Linear interpolation LUT
-#endif // !defined(MPT_INTMIXER)
-#endif // MODPLUG_TRACKER
+// Computing the tables takes a noticeable amount of time compared to loading a small module, so they are computed
+// only once per process and shared between all resamplers. The settings-independent tables are kept alive for the
+// lifetime of the process, the most recently used settings-dependent tables are cached as well.
+namespace
+{
+
+struct ResamplerTableCache
+{
+	struct Entry
+	{
+		double cutoff;
+		uint8 type;
+		MPT_SHARED_PTR<const CResamplerSettingsTables> tables;
+	};
+
+	// Number of settings-dependent tables that are kept alive when no resampler uses them anymore.
+	enum { maxEntries = 4 };
+
+	Util::mutex mutex;
+	MPT_SHARED_PTR<const CResamplerStaticTables> staticTables;
+	std::vector<Entry> entries;	// Most recently used first
+};
+
+ResamplerTableCache &GetTableCache()
+{
+	static ResamplerTableCache cache;
+	return cache;
+}
+
+} // unnamed namespace
 
 
 void CResampler::InitializeTables(bool force)
 {
-#ifdef MODPLUG_TRACKER
-	if((m_OldSettings == m_Settings) && !force && StaticTablesInitialized) return;
-	if(!StaticTablesInitialized)
-#else
-	if((m_OldSettings == m_Settings) && !force) return;
-#endif // MODPLUG_TRACKER
+	if((m_OldSettings == m_Settings) && !force && m_StaticTables && m_SettingsTables) return;
+
+	ResamplerTableCache &cache = GetTableCache();
+	Util::lock_guard<Util::mutex> guard(cache.mutex);
+
+	if(!cache.staticTables)
 	{
+		CResamplerStaticTables *tables = new CResamplerStaticTables();
 		//ericus' downsampling improvement.
 		//getsinc(gDownsample13x, 8.5, 3.0/4.0);
 		//getdownsample2x(gDownsample2x);
-		getsinc(gDownsample13x, 8.5, 0.5);
-		getsinc(gDownsample2x, 2.7625, 0.425);
+		getsinc(tables->gDownsample13x, 8.5, 0.5);
+		getsinc(tables->gDownsample2x, 2.7625, 0.425);
 		//end ericus' downsampling improvement.
 
 #ifndef MPT_INTMIXER
 		// Prepare fast sinc coefficients for floating point mixer
 		for(size_t i = 0; i < CountOf(FastSincTable); i++)
 		{
-			FastSincTablef[i] = static_cast<mixsample_t>(FastSincTable[i] * mixsample_t(1.0f / 16384.0f));
+			tables->FastSincTablef[i] = static_cast<mixsample_t>(FastSincTable[i] * mixsample_t(1.0f / 16384.0f));
 		}
 
 		// Prepare linear interpolation coefficients for floating point mixer
-		for(size_t i = 0; i < CountOf(LinearTablef); i++)
+		for(size_t i = 0; i < CountOf(tables->LinearTablef); i++)
 		{
-			LinearTablef[i] = static_cast<mixsample_t>(i * mixsample_t(1.0f / CountOf(LinearTablef)));
+			tables->LinearTablef[i] = static_cast<mixsample_t>(i * mixsample_t(1.0f / CountOf(tables->LinearTablef)));
 		}
 #endif // !defined(MPT_INTMIXER)
+		cache.staticTables = MPT_SHARED_PTR<const CResamplerStaticTables>(tables);
 	}
+	m_StaticTables = cache.staticTables;
 
-	m_WindowedFIR.InitTable(m_Settings.gdWFIRCutoff, m_Settings.gbWFIRType);
-	getsinc(gKaiserSinc, 9.6377, m_Settings.gdWFIRCutoff);
+	std::vector<ResamplerTableCache::Entry>::iterator entry = cache.entries.begin();
+	while(entry != cache.entries.end() && (entry->cutoff != m_Settings.gdWFIRCutoff || entry->type != m_Settings.gbWFIRType))
+	{
+		entry++;
+	}
+	if(entry != cache.entries.end())
+	{
+		m_SettingsTables = entry->tables;
+		cache.entries.erase(entry);
+	} else
+	{
+		CResamplerSettingsTables *tables = new CResamplerSettingsTables();
+		tables->m_WindowedFIR.InitTable(m_Settings.gdWFIRCutoff, m_Settings.gbWFIRType);
+		getsinc(tables->gKaiserSinc, 9.6377, m_Settings.gdWFIRCutoff);
+		m_SettingsTables = MPT_SHARED_PTR<const CResamplerSettingsTables>(tables);
+		if(cache.entries.size() >= ResamplerTableCache::maxEntries)
+		{
+			cache.entries.pop_back();
+		}
+	}
+	const ResamplerTableCache::Entry newEntry = { m_Settings.gdWFIRCutoff, m_Settings.gbWFIRType, m_SettingsTables };
+	cache.entries.insert(cache.entries.begin(), newEntry);
 
-#ifdef MODPLUG_TRACKER
-	StaticTablesInitialized = true;
-#endif // MODPLUG_TRACKER
+	m_WindowedFIR = &m_SettingsTables->m_WindowedFIR;
+	gKaiserSinc = m_SettingsTables->gKaiserSinc;
+	gDownsample13x = m_StaticTables->gDownsample13x;
+	gDownsample2x = m_StaticTables->gDownsample2x;
+#ifndef MPT_INTMIXER
+	FastSincTablef = m_StaticTables->FastSincTablef;
+	LinearTablef = m_StaticTables->LinearTablef;
+#endif // !defined(MPT_INTMIXER)
 
 	m_OldSettings = m_Settings;
 }
@@ -12,6 +12,7 @@
 #include "modsmp_ctrl.h"
 #include "../common/AudioCriticalSection.h"
 #include "Sndfile.h"
+#include "SampleDataStore.h"
 
 #define new DEBUG_NEW
 
@@ -254,15 +255,16 @@ void PrecomputeLoopsImpl(ModSample &smp, const CSoundFile &sndFile)
 	}
 }
 
-} // unnamed namespace.
-
 
-bool PrecomputeLoops(ModSample &smp, CSoundFile &sndFile, bool updateChannels)
-//----------------------------------------------------------------------------
+bool UpdateLoopBuffers(ModSample &smp, CSoundFile &sndFile, bool updateChannels)
+//------------------------------------------------------------------------------
 {
 	if(smp.nLength == 0 || smp.pSample == nullptr)
 		return false;
 
+	if(!MakeSampleDataWritable(smp, sndFile))
+		return false;
+
 	smp.SanitizeLoops();
 
 	// Update channels with possibly changed loop values
@@ -279,6 +281,49 @@ bool PrecomputeLoops(ModSample &smp, CSoundFile &sndFile, bool updateChannels)
 	return true;
 }
 
+} // unnamed namespace.
+
+
+bool PrecomputeLoops(ModSample &smp, CSoundFile &sndFile, bool updateChannels)
+//----------------------------------------------------------------------------
+{
+	if(!UpdateLoopBuffers(smp, sndFile, updateChannels))
+		return false;
+	sndFile.BuildSampleIndex(smp);
+	return true;
+}
+
+
+bool PrecomputeLoops(ModSample &smp, CSoundFile &sndFile, bool updateChannels, SmpLength first, SmpLength last)
+//-------------------------------------------------------------------------------------------------------------
+{
+	if(!UpdateLoopBuffers(smp, sndFile, updateChannels))
+		return false;
+	sndFile.UpdateSampleIndex(smp, first, last);
+	return true;
+}
+
+
+// Make sure that the sample data is not shared with other modules before modifying it.
+bool MakeSampleDataWritable(ModSample &smp, CSoundFile &sndFile)
+//--------------------------------------------------------------
+{
+	const void *oldSample = smp.pSample;
+	if(!SampleDataStore::IsShared(oldSample))
+		return true;
+	if(!SampleDataStore::MakeUnique(smp))
+		return false;
+
+	CriticalSection cs;
+
+	// Playing channels must read from the private copy from now on
+	for(CHANNELINDEX i = 0; i < MAX_CHANNELS; i++) if(sndFile.m_PlayState.Chn[i].pCurrentSample == oldSample)
+	{
+		sndFile.m_PlayState.Chn[i].pCurrentSample = smp.pSample;
+	}
+	return true;
+}
+
 
 // Propagate loop point changes to player
 bool UpdateLoopPoints(const ModSample &smp, CSoundFile &sndFile)
@@ -459,6 +504,11 @@ float RemoveDCOffset(ModSample &smp,
 		iEnd = smp.nLength;
 	}
 
+	// Silent parts have no offset, so there is no need to scan them
+	const SmpLength firstModified = iStart, lastModified = iEnd - 1;
+	if(sndFile.IsSampleRangeSilent(smp, firstModified, lastModified))
+		return 0;
+
 	iStart *= smp.GetNumChannels();
 	iEnd *= smp.GetNumChannels();
 
@@ -511,7 +561,7 @@ float RemoveDCOffset(ModSample &smp,
 		}
 	}
 
-	PrecomputeLoops(smp, sndFile, false);
+	PrecomputeLoops(smp, sndFile, false, firstModified, lastModified);
 
 	return fReportOffset;
 }
@@ -550,7 +600,7 @@ bool ReverseSample(ModSample &smp, SmpLength iStart, SmpLength iEnd, CSoundFile
 	else
 		return false;
 
-	PrecomputeLoops(smp, sndFile, false);
+	PrecomputeLoops(smp, sndFile, false, iStart, iEnd - 1);
 	return true;
 }
 
@@ -576,6 +626,7 @@ bool UnsignSample(ModSample &smp, SmpLength iStart, SmpLength iEnd, CSoundFile &
 		iStart = 0;
 		iEnd = smp.nLength;
 	}
+	const SmpLength firstModified = iStart, lastModified = iEnd - 1;
 	iStart *= smp.GetNumChannels();
 	iEnd *= smp.GetNumChannels();
 	if(smp.GetElementarySampleSize() == 2)
@@ -585,7 +636,7 @@ bool UnsignSample(ModSample &smp, SmpLength iStart, SmpLength iEnd, CSoundFile &
 	else
 		return false;
 
-	PrecomputeLoops(smp, sndFile, false);
+	PrecomputeLoops(smp, sndFile, false, firstModified, lastModified);
 	return true;
 }
 
@@ -610,6 +661,7 @@ bool InvertSample(ModSample &smp, SmpLength iStart, SmpLength iEnd, CSoundFile &
 		iStart = 0;
 		iEnd = smp.nLength;
 	}
+	const SmpLength firstModified = iStart, lastModified = iEnd - 1;
 	iStart *= smp.GetNumChannels();
 	iEnd *= smp.GetNumChannels();
 	if(smp.GetElementarySampleSize() == 2)
@@ -619,7 +671,7 @@ bool InvertSample(ModSample &smp, SmpLength iStart, SmpLength iEnd, CSoundFile &
 	else
 		return false;
 
-	PrecomputeLoops(smp, sndFile, false);
+	PrecomputeLoops(smp, sndFile, false, firstModified, lastModified);
 	return true;
 }
 
@@ -645,6 +697,7 @@ bool XFadeSample(ModSample &smp, SmpLength iFadeLength, CSoundFile &sndFile)
 
 	SmpLength iStart = smp.nLoopStart - iFadeLength;
 	SmpLength iEnd = smp.nLoopEnd - iFadeLength;
+	const SmpLength firstModified = iEnd, lastModified = smp.nLoopEnd - 1;
 	iStart *= smp.GetNumChannels();
 	iEnd *= smp.GetNumChannels();
 	iFadeLength *= smp.GetNumChannels();
@@ -656,7 +709,7 @@ bool XFadeSample(ModSample &smp, SmpLength iFadeLength, CSoundFile &sndFile)
 	else
 		return false;
 
-	PrecomputeLoops(smp, sndFile, true);
+	PrecomputeLoops(smp, sndFile, true, firstModified, lastModified);
 	return true;
 }
 
@@ -43,12 +43,18 @@ SmpLength ResizeSample(ModSample &smp, const SmpLength nNewLength, CSoundFile &s
 // Replaces sample in 'smp' with given sample and frees the old sample.
 void ReplaceSample(ModSample &smp, void *pNewSample,  const SmpLength nNewLength, CSoundFile &sndFile);
 
-// Update loop wrap-around buffers
+// Update loop wrap-around buffers and rebuild the sample index (see SampleIndex)
 bool PrecomputeLoops(ModSample &smp, CSoundFile &sndFile, bool updateChannels = true);
+// Update loop wrap-around buffers after the sampling points first to last (inclusive) have been modified in-place. Only the affected part of the sample index is updated.
+bool PrecomputeLoops(ModSample &smp, CSoundFile &sndFile, bool updateChannels, SmpLength first, SmpLength last);
 
 // Propagate loop point changes to player
 bool UpdateLoopPoints(const ModSample &smp, CSoundFile &sndFile);
 
+// Make sure that the sample data is not shared with other modules (see SampleDataStore) before modifying it.
+// Return: false if the sample data must not be modified because no private copy could be allocated.
+bool MakeSampleDataWritable(ModSample &smp, CSoundFile &sndFile);
+
 // Resets samples.
 void ResetSamples(CSoundFile &sndFile, ResetFlag resetflag, SAMPLEINDEX minSample = SAMPLEINDEX_INVALID, SAMPLEINDEX maxSample = SAMPLEINDEX_INVALID);
 
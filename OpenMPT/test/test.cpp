@@ -24,7 +24,11 @@
 #include "../soundlib/MIDIEvents.h"
 #include "../soundlib/MIDIMacros.h"
 #include "../soundlib/SampleFormatConverters.h"
+#include "../soundlib/Dither.h"
+#include "../soundlib/MixerOutput.h"
 #include "../soundlib/ITCompression.h"
+#include "../soundlib/SampleDataStore.h"
+#include "../soundlib/modsmp_ctrl.h"
 #ifdef MODPLUG_TRACKER
 #include "../mptrack/mptrack.h"
 #include "../mptrack/moddoc.h"
@@ -34,6 +38,13 @@
 #ifndef MODPLUG_TRACKER
 #include "../common/mptFileIO.h"
 #endif // !MODPLUG_TRACKER
+#ifdef LIBOPENMPT_BUILD
+#define LIBOPENMPT_EXT_IS_EXPERIMENTAL
+#include "../libopenmpt/libopenmpt.hpp"
+#include "../libopenmpt/libopenmpt_ext.hpp"
+#endif // LIBOPENMPT_BUILD
+#include <iomanip>
+#include <iostream>
 #include <limits>
 #include <istream>
 #include <ostream>
@@ -71,9 +82,17 @@ static noinline void TestStringIO();
 static noinline void TestMIDIEvents();
 static noinline void TestSampleConversion();
 static noinline void TestITCompression();
+static noinline void TestVoicePool();
+static noinline void TestSongLengthCacheEdits();
 static noinline void TestPCnoteSerialization();
 static noinline void TestLoadSaveFile();
 
+static noinline void BenchmarkFormatProbing();
+static noinline void BenchmarkSampleDecoding();
+static noinline void BenchmarkReverb();
+static noinline void BenchmarkSeeking();
+static noinline void BenchmarkVoices();
+
 
 
 static mpt::PathString *PathPrefix = nullptr;
@@ -91,8 +110,8 @@ static mpt::PathString GetPathPrefix()
 }
 
 
-void DoTests()
-//------------
+static void InitPathPrefix()
+//-------------------------
 {
 
 	#if MPT_OS_WINDOWS
@@ -124,6 +143,14 @@ void DoTests()
 
 	#endif
 
+}
+
+
+void DoTests()
+//------------
+{
+	InitPathPrefix();
+
 	DO_TEST(TestVersion);
 	DO_TEST(TestTypes);
 	DO_TEST(TestMisc);
@@ -134,6 +161,8 @@ void DoTests()
 	DO_TEST(TestMIDIEvents);
 	DO_TEST(TestSampleConversion);
 	DO_TEST(TestITCompression);
+	DO_TEST(TestVoicePool);
+	DO_TEST(TestSongLengthCacheEdits);
 
 	// slower tests, require opening a CModDoc
 	DO_TEST(TestPCnoteSerialization);
@@ -144,6 +173,22 @@ void DoTests()
 }
 
 
+void DoBenchmarks()
+//-----------------
+{
+	InitPathPrefix();
+
+	BenchmarkFormatProbing();
+	BenchmarkSampleDecoding();
+	BenchmarkReverb();
+	BenchmarkSeeking();
+	BenchmarkVoices();
+
+	delete PathPrefix;
+	PathPrefix = nullptr;
+}
+
+
 static void RemoveFile(const mpt::PathString &filename)
 //-----------------------------------------------------
 {
@@ -653,6 +698,21 @@ static noinline void TestMisc()
 	VERIFY_EQUAL(IsEqualUUID(uuid, Util::StringToCLSID(Util::CLSIDToString(uuid))), true);
 #endif
 
+	// Resampler tables are shared between all resamplers with the same settings
+	{
+		CResampler resampler1, resampler2;
+		VERIFY_EQUAL(resampler1.SharesTablesWith(resampler2), true);
+		VERIFY_EQUAL(resampler1.gKaiserSinc == resampler2.gKaiserSinc, true);
+		resampler2.m_Settings.gdWFIRCutoff = 0.9;
+		resampler2.InitializeTables();
+		VERIFY_EQUAL(resampler1.SharesTablesWith(resampler2), false);
+		VERIFY_EQUAL(resampler1.gDownsample2x == resampler2.gDownsample2x, true);
+		VERIFY_EQUAL(resampler1.gKaiserSinc[SINC_PHASES * 4] != resampler2.gKaiserSinc[SINC_PHASES * 4], true);
+		resampler2.m_Settings = resampler1.m_Settings;
+		resampler2.InitializeTables();
+		VERIFY_EQUAL(resampler1.SharesTablesWith(resampler2), true);
+	}
+
 }
 
 
@@ -1786,215 +1846,1581 @@ static void SaveS3M(const TSoundFileContainer &sndFile, const mpt::PathString &f
 
 
 
-// Test file loading and saving
-static noinline void TestLoadSaveFile()
-//-------------------------------------
+// Visited rows must be unset after a reset and survive a round trip through the compact copy, also when the memory is reused.
+static void TestRowVisitor(const CSoundFile &sndFile)
+//---------------------------------------------------
 {
-	if(!ShouldRunTests())
+	RowVisitor::MemoryCache cache;
+	for(int pass = 0; pass < 2; pass++)
 	{
-		return;
+		RowVisitor visitor(sndFile, SEQUENCEINDEX_INVALID, cache);
+		ORDERINDEX order = 0;
+		ROWINDEX row = 0;
+		VERIFY_EQUAL_NONCONT(visitor.GetFirstUnvisitedRow(order, row, false), true);
+		VERIFY_EQUAL_NONCONT(visitor.IsVisited(order, row, true), false);
+		VERIFY_EQUAL_NONCONT(visitor.IsVisited(order, row, false), true);
+		visitor.Visit(order, row + 1);
+
+		const RowVisitor startRows(visitor);
+		visitor.Visit(order, row + 2);
+		const RowVisitor::VisitedRowsType except = visitor.GetVisitedRowsExcept(startRows);
+		VERIFY_EQUAL_NONCONT(except.IsVisited(order, row), false);
+		VERIFY_EQUAL_NONCONT(except.IsVisited(order, row + 2), true);
+
+		visitor.Initialize(true);
+		VERIFY_EQUAL_NONCONT(visitor.IsVisited(order, row, false), false);
+		VERIFY_EQUAL_NONCONT(visitor.IsVisited(order, row + 1, false), false);
+		visitor.SetVisitedRows(except);
+		VERIFY_EQUAL_NONCONT(visitor.IsVisited(order, row, false), false);
+		VERIFY_EQUAL_NONCONT(visitor.IsVisited(order, row + 2, false), true);
 	}
-	mpt::PathString filenameBaseSrc = GetTestFilenameBase();
-	mpt::PathString filenameBase = GetTempFilenameBase();
-
-	// Test MPTM file loading
-	{
-		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBaseSrc + MPT_PATHSTRING("mptm"));
-
-		TestLoadMPTMFile(GetrSoundFile(sndFileContainer));
-
-		#ifndef MODPLUG_NO_FILESAVE
-			// Test file saving
-			SaveIT(sndFileContainer, filenameBase + MPT_PATHSTRING("saved.mptm"));
-		#endif
+}
 
-		DestroySoundFileContainer(sndFileContainer);
-	}
 
-	// Reload the saved file and test if everything is still working correctly.
-	#ifndef MODPLUG_NO_FILESAVE
+// Seeking with the help of the seek index must yield exactly the same results as seeking from the start of the song.
+static void TestSeekIndex(CSoundFile &sndFile)
+//--------------------------------------------
+{
+	sndFile.m_SeekIndex.SetMemoryLimit(0);
+	const std::vector<GetLengthType> lengths = sndFile.GetLength(eNoAdjust, GetLengthTarget(true));
+	VERIFY_EQUAL_NONCONT(sndFile.m_SeekIndex.GetMemoryUsage(), 0);
+
+	const int numSeeks = 13;
+	std::vector<GetLengthType> timeSeeks, posSeeks;
+	std::vector<uint32> tempos, speeds;
+	for(size_t subsong = 0; subsong < lengths.size(); subsong++)
 	{
-		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBase + MPT_PATHSTRING("saved.mptm"));
-
-		TestLoadMPTMFile(GetrSoundFile(sndFileContainer));
+		for(int i = 0; i < numSeeks; i++)
+		{
+			const double seconds = lengths[subsong].duration * i / (numSeeks - 1);
+			timeSeeks.push_back(sndFile.GetLength(eNoAdjust, GetLengthTarget(seconds).StartPos(SEQUENCEINDEX_INVALID, lengths[subsong].startOrder, lengths[subsong].startRow)).back());
+			posSeeks.push_back(sndFile.GetLength(eAdjust, GetLengthTarget(timeSeeks.back().lastOrder, timeSeeks.back().lastRow).StartPos(SEQUENCEINDEX_INVALID, lengths[subsong].startOrder, lengths[subsong].startRow)).back());
+			tempos.push_back(sndFile.m_PlayState.m_nMusicTempo);
+			speeds.push_back(sndFile.m_PlayState.m_nMusicSpeed);
+		}
+	}
 
-		DestroySoundFileContainer(sndFileContainer);
+	sndFile.m_SeekIndex.SetMemoryLimit(1 << 20);
+	const std::vector<GetLengthType> indexedLengths = sndFile.GetLength(eNoAdjust, GetLengthTarget(true));
+	VERIFY_EQUAL_NONCONT(indexedLengths.size(), lengths.size());
+	// Checkpoints are at least one second apart
+	VERIFY_EQUAL_NONCONT(sndFile.m_SeekIndex.GetMemoryUsage() > 0, lengths[0].duration > 1.0);
+	VERIFY_EQUAL_NONCONT(sndFile.m_SeekIndex.GetMemoryUsage() <= sndFile.m_SeekIndex.GetMemoryLimit(), true);
 
-		RemoveFile(filenameBase + MPT_PATHSTRING("saved.mptm"));
+	size_t seek = 0;
+	for(size_t subsong = 0; subsong < lengths.size(); subsong++)
+	{
+		VERIFY_EQUAL_NONCONT(indexedLengths[subsong].duration, lengths[subsong].duration);
+		for(int i = 0; i < numSeeks; i++, seek++)
+		{
+			const double seconds = lengths[subsong].duration * i / (numSeeks - 1);
+			const GetLengthType timeSeek = sndFile.GetLength(eNoAdjust, GetLengthTarget(seconds).StartPos(SEQUENCEINDEX_INVALID, lengths[subsong].startOrder, lengths[subsong].startRow)).back();
+			VERIFY_EQUAL_NONCONT(timeSeek.duration, timeSeeks[seek].duration);
+			VERIFY_EQUAL_NONCONT(timeSeek.targetReached, timeSeeks[seek].targetReached);
+			VERIFY_EQUAL_NONCONT(timeSeek.lastOrder, timeSeeks[seek].lastOrder);
+			VERIFY_EQUAL_NONCONT(timeSeek.lastRow, timeSeeks[seek].lastRow);
+
+			const GetLengthType posSeek = sndFile.GetLength(eAdjust, GetLengthTarget(timeSeek.lastOrder, timeSeek.lastRow).StartPos(SEQUENCEINDEX_INVALID, lengths[subsong].startOrder, lengths[subsong].startRow)).back();
+			VERIFY_EQUAL_NONCONT(posSeek.duration, posSeeks[seek].duration);
+			VERIFY_EQUAL_NONCONT(posSeek.targetReached, posSeeks[seek].targetReached);
+			VERIFY_EQUAL_NONCONT(sndFile.m_PlayState.m_nMusicTempo, tempos[seek]);
+			VERIFY_EQUAL_NONCONT(sndFile.m_PlayState.m_nMusicSpeed, speeds[seek]);
+		}
 	}
-	#endif
 
-	// Test XM file loading
-	{
-		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBaseSrc + MPT_PATHSTRING("xm"));
+	sndFile.m_SeekIndex.SetMemoryLimit(0);
+}
 
-		TestLoadXMFile(GetrSoundFile(sndFileContainer));
 
-		// In OpenMPT 1.20 (up to revision 1459), there was a bug in the XM saver
-		// that would create broken XMs if the sample map contained samples that
-		// were only referenced below C-1 or above B-8 (such samples should not
-		// be written). Let's insert a sample there and check if re-loading the
-		// file still works.
-		GetrSoundFile(sndFileContainer).m_nSamples++;
-		GetrSoundFile(sndFileContainer).Instruments[1]->Keyboard[110] = GetrSoundFile(sndFileContainer).GetNumSamples();
+// Disabling the cache discards all cached entries, so the cache has to be filled again afterwards.
+static double GetUncachedSongLength(CSoundFile &sndFile)
+//------------------------------------------------------
+{
+	sndFile.m_SongLengthCache.SetEnabled(false);
+	const double length = sndFile.GetLength(eNoAdjust).back().duration;
+	sndFile.m_SongLengthCache.SetEnabled(true);
+	sndFile.GetLength(eNoAdjust);
+	return length;
+}
 
-		#ifndef MODPLUG_NO_FILESAVE
-			// Test file saving
-			SaveXM(sndFileContainer, filenameBase + MPT_PATHSTRING("saved.xm"));
-		#endif
 
-		DestroySoundFileContainer(sndFileContainer);
+// After editing a pattern or the order list, the song length is only recalculated from the first modified order on
+// and must be the same as a complete recalculation. Any edits are reverted at the end.
+static void TestSongLengthCache(CSoundFile &sndFile)
+//--------------------------------------------------
+{
+	const GetLengthType reference = sndFile.GetLength(eNoAdjust).back();
+
+	sndFile.m_SongLengthCache.SetEnabled(true);
+	const GetLengthType cached = sndFile.GetLength(eNoAdjust).back();
+	VERIFY_EQUAL_NONCONT(cached.duration, reference.duration);
+	VERIFY_EQUAL_NONCONT(cached.lastOrder, reference.lastOrder);
+	VERIFY_EQUAL_NONCONT(cached.lastRow, reference.lastRow);
+	const size_t fullEntries = sndFile.m_SongLengthCache.GetLastSimulatedEntries();
+	VERIFY_EQUAL_NONCONT(fullEntries > 0, true);
+
+	// Nothing has changed
+	VERIFY_EQUAL_NONCONT(sndFile.GetLength(eNoAdjust).back().duration, reference.duration);
+	VERIFY_EQUAL_NONCONT(sndFile.m_SongLengthCache.GetLastSimulatedEntries(), 0);
+
+	// Change the speed in the last pattern that is played
+	const ORDERINDEX editOrder = reference.lastOrder;
+	const PATTERNINDEX editPat = sndFile.Order[editOrder];
+	if(!sndFile.Patterns.IsValidPat(editPat))
+	{
+		sndFile.m_SongLengthCache.SetEnabled(false);
+		return;
 	}
-
-	// Reload the saved file and test if everything is still working correctly.
-	#ifndef MODPLUG_NO_FILESAVE
+	// Only if another pattern is played before, there is something to take over from the previous calculation.
+	bool patternsBefore = false;
+	for(ORDERINDEX ord = 0; ord < editOrder; ord++)
 	{
-		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBase + MPT_PATHSTRING("saved.xm"));
-
-		TestLoadXMFile(GetrSoundFile(sndFileContainer));
+		if(sndFile.Patterns.IsValidPat(sndFile.Order[ord]) && sndFile.Order[ord] != editPat)
+		{
+			patternsBefore = true;
+		}
+	}
+	const bool firstOccurrence = (sndFile.Order.FindOrder(editPat) == editOrder);
+
+	ModCommand &m = *sndFile.Patterns[editPat].GetpModCommand(0, 0);
+	const ModCommand oldCommand = m;
+	m.command = CMD_SPEED;
+	m.param = (oldCommand.command == CMD_SPEED && oldCommand.param == 3) ? 4 : 3;
+	sndFile.m_SongLengthCache.InvalidatePattern(editPat);
+	const double editedLength = sndFile.GetLength(eNoAdjust).back().duration;
+	if(firstOccurrence && patternsBefore)
+	{
+		VERIFY_EQUAL_NONCONT(sndFile.m_SongLengthCache.GetLastSimulatedEntries() < fullEntries, true);
+	}
+	VERIFY_EQUAL_NONCONT(std::abs(editedLength - GetUncachedSongLength(sndFile)) < 1e-9, true);
 
-		DestroySoundFileContainer(sndFileContainer);
+	m = oldCommand;
+	sndFile.m_SongLengthCache.InvalidatePattern(editPat);
+	VERIFY_EQUAL_NONCONT(std::abs(sndFile.GetLength(eNoAdjust).back().duration - reference.duration) < 1e-9, true);
 
-		RemoveFile(filenameBase + MPT_PATHSTRING("saved.xm"));
+	// Changes to the order list are detected automatically
+	sndFile.Order[editOrder] = sndFile.Order.GetInvalidPatIndex();
+	const GetLengthType shortened = sndFile.GetLength(eNoAdjust).back();
+	if(patternsBefore)
+	{
+		VERIFY_EQUAL_NONCONT(sndFile.m_SongLengthCache.GetLastSimulatedEntries() < fullEntries, true);
 	}
-	#endif
+	VERIFY_EQUAL_NONCONT(std::abs(shortened.duration - GetUncachedSongLength(sndFile)) < 1e-9, true);
+	VERIFY_EQUAL_NONCONT(shortened.duration < reference.duration, true);
 
-	// Test S3M file loading
-	{
-		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBaseSrc + MPT_PATHSTRING("s3m"));
+	sndFile.Order[editOrder] = editPat;
+	VERIFY_EQUAL_NONCONT(std::abs(sndFile.GetLength(eNoAdjust).back().duration - reference.duration) < 1e-9, true);
 
-		TestLoadS3MFile(GetrSoundFile(sndFileContainer), false);
+	sndFile.m_SongLengthCache.SetEnabled(false);
+}
 
-		#ifndef MODPLUG_NO_FILESAVE
-			// Test file saving
-			SaveS3M(sndFileContainer, filenameBase + MPT_PATHSTRING("saved.s3m"));
-		#endif
 
-		DestroySoundFileContainer(sndFileContainer);
-	}
+#ifdef MPT_INTMIXER
 
-	// Reload the saved file and test if everything is still working correctly.
-	#ifndef MODPLUG_NO_FILESAVE
+// Collects the raw mix buffer contents
+class MixBufferCollector : public IAudioReadTarget
+{
+public:
+	std::vector<int> samples;
+	virtual void DataCallback(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk)
 	{
-		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBase + MPT_PATHSTRING("saved.s3m"));
+		samples.insert(samples.end(), MixSoundBuffer, MixSoundBuffer + channels * countChunk);
+	}
+};
 
-		TestLoadS3MFile(GetrSoundFile(sndFileContainer), true);
 
-		DestroySoundFileContainer(sndFileContainer);
 
-		RemoveFile(filenameBase + MPT_PATHSTRING("saved.s3m"));
+// Renders 64 chunks of the module, starting at the given order.
+static std::vector<int> RenderFromOrder(CSoundFile &sndFile, ORDERINDEX order)
+//----------------------------------------------------------------------------
+{
+	// Random instrument variations must be the same in every pass
+	srand(1);
+	sndFile.ResetChannels();
+	sndFile.InitPlayer(true);
+	sndFile.m_PlayState.m_nCurrentOrder = order;
+	sndFile.SetCurrentOrder(order);
+	sndFile.m_PlayState.m_nNextRow = 0;
+	sndFile.GetLength(eAdjust, GetLengthTarget(order, 0));
+
+	MixBufferCollector target;
+	for(int i = 0; i < 64; i++)
+	{
+		if(sndFile.Read(1024, target) == 0)
+		{
+			break;
+		}
 	}
-	#endif
+	return target.samples;
+}
 
-	// General file I/O tests
+
+// Returns the first order that plays a pattern, or the number of orders if there is none.
+static ORDERINDEX GetFirstPlayableOrder(const CSoundFile &sndFile)
+//----------------------------------------------------------------
+{
+	ORDERINDEX order = 0;
+	while(order < sndFile.Order.size() && !sndFile.Patterns.IsValidPat(sndFile.Order[order]))
 	{
-		std::ostringstream f;
-		size_t bytesWritten;
-		mpt::IO::WriteVarInt(f, uint16(0), &bytesWritten);		VERIFY_EQUAL_NONCONT(bytesWritten, 1);
-		mpt::IO::WriteVarInt(f, uint16(127), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 1);
-		mpt::IO::WriteVarInt(f, uint16(128), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 2);
-		mpt::IO::WriteVarInt(f, uint16(16383), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 2);
-		mpt::IO::WriteVarInt(f, uint16(16384), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 3);
-		mpt::IO::WriteVarInt(f, uint16(65535), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 3);
-		mpt::IO::WriteVarInt(f, uint64(0xFFFFFFFFFFFFFFFFull), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 10);
-		std::string data = f.str();
-		FileReader file(&data[0], data.size());
-		uint64 v;
-		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 0);
-		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 127);
-		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 128);
-		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 16383);
-		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 16384);
-		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 65535);
-		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 0xFFFFFFFFFFFFFFFFull);
+		order++;
 	}
+	return order;
 }
 
 
-static void RunITCompressionTest(const std::vector<int8> &sampleData, ChannelFlags smpFormat, bool it215)
-//-------------------------------------------------------------------------------------------------------
+#if defined(ENABLE_SSE4)
+
+// Renders 64 chunks of the module, only using the given instruction set extensions.
+static std::vector<int> RenderWithProcSupport(CSoundFile &sndFile, ORDERINDEX order, uint32 procSupport)
+//-----------------------------------------------------------------------------------------------------
 {
+	const uint32 oldProcSupport = ProcSupport;
+	ProcSupport = procSupport;
+	const std::vector<int> samples = RenderFromOrder(sndFile, order);
+	ProcSupport = oldProcSupport;
+	return samples;
+}
 
-	ModSample smp;
-	smp.uFlags = smpFormat;
-	smp.pSample = const_cast<int8 *>(&sampleData[0]);
-	smp.nLength = sampleData.size() / smp.GetBytesPerSample();
+#endif // ENABLE_SSE4
 
-	std::string data;
 
+// The vectorized interpolators must produce exactly the same output as the scalar interpolators.
+// This replaces the samples and the first pattern of the module, also on platforms without vectorized interpolators,
+// as the following mixer tests expect a module with audible samples.
+static void TestSIMDMixer(CSoundFile &sndFile)
+//--------------------------------------------
+{
+	// The samples of the test modules are mostly silent, so replace them by looped noise in all four sample formats.
+	while(sndFile.GetNumSamples() < 4)
 	{
-		std::ostringstream f;
-		ITCompression compression(smp, it215, &f);
-		data = f.str();
+		sndFile.m_nSamples++;
+	}
+	uint32 seed = 1;
+	for(SAMPLEINDEX smp = 1; smp <= sndFile.GetNumSamples(); smp++)
+	{
+		ModSample &sample = sndFile.GetSample(smp);
+		sample.FreeSample();
+		sample.Initialize(sndFile.GetType());
+		sample.uFlags.set(CHN_16BIT, (smp & 1) != 0);
+		sample.uFlags.set(CHN_STEREO, (smp & 2) != 0);
+		sample.nLength = 4000;
+		if(!sample.AllocateSample())
+		{
+			continue;
+		}
+		for(SmpLength i = 0; i < sample.GetSampleSizeInBytes(); i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			static_cast<uint8 *>(sample.pSample)[i] = static_cast<uint8>(seed >> 16);
+		}
+		sample.SetLoop(1000, sample.nLength, true, (smp % 3) == 0, sndFile);
 	}
 
+	// Use every sample and enable the filter on every other instrument
+	for(INSTRUMENTINDEX ins = 1; ins <= sndFile.GetNumInstruments(); ins++)
 	{
-		FileReader file(&data[0], data.length());
+		ModInstrument *pIns = sndFile.Instruments[ins];
+		if(pIns == nullptr)
+		{
+			continue;
+		}
+		for(size_t note = 0; note < CountOf(pIns->Keyboard); note++)
+		{
+			pIns->Keyboard[note] = static_cast<SAMPLEINDEX>(1 + note % sndFile.GetNumSamples());
+		}
+		pIns->SetCutoff(80, (ins & 1) != 0);
+		pIns->SetResonance(100, (ins & 1) != 0);
+	}
 
-		std::vector<int8> sampleDataNew(sampleData.size(), 0);
-		smp.pSample = &sampleDataNew[0];
+	// Play a note on every channel, at various pitches so that the downsampling tables are also used
+	const ORDERINDEX order = GetFirstPlayableOrder(sndFile);
+	if(order >= sndFile.Order.size())
+	{
+		return;
+	}
+	CPattern &pattern = sndFile.Patterns[sndFile.Order[order]];
+	for(ModCommand *m = pattern.Begin(); m != pattern.End(); m++)
+	{
+		m->Clear();
+	}
+	const CHANNELINDEX numInstrs = sndFile.GetNumInstruments() ? sndFile.GetNumInstruments() : sndFile.GetNumSamples();
+	for(CHANNELINDEX chn = 0; chn < sndFile.GetNumChannels(); chn++)
+	{
+		ModCommand &m = *pattern.GetpModCommand(0, chn);
+		m.note = static_cast<ModCommand::NOTE>(NOTE_MIDDLEC - 24 + (chn * 7) % 72);
+		m.instr = static_cast<ModCommand::INSTR>(1 + chn % numInstrs);
+	}
 
-		ITDecompression decompression(file, smp, it215);
-		VERIFY_EQUAL_NONCONT(memcmp(&sampleData[0], &sampleDataNew[0], sampleData.size()), 0);
+#if defined(ENABLE_SSE4)
+	const ResamplingMode modes[] = { SRCMODE_SPLINE, SRCMODE_POLYPHASE, SRCMODE_FIRFILTER };
+	const CResamplerSettings oldSettings = sndFile.m_Resampler.m_Settings;
+	for(size_t i = 0; i < CountOf(modes); i++)
+	{
+		CResamplerSettings settings = oldSettings;
+		settings.SrcMode = modes[i];
+		sndFile.SetResamplerSettings(settings);
+
+		const std::vector<int> scalar = RenderWithProcSupport(sndFile, order, ProcSupport & ~(PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2));
+		if(ProcSupport & PROCSUPPORT_SSE4_1)
+		{
+			VERIFY_EQUAL_NONCONT(RenderWithProcSupport(sndFile, order, ProcSupport & ~PROCSUPPORT_AVX2) == scalar, true);
+		}
+		if(ProcSupport & PROCSUPPORT_AVX2)
+		{
+			VERIFY_EQUAL_NONCONT(RenderWithProcSupport(sndFile, order, ProcSupport) == scalar, true);
+		}
 	}
+	sndFile.SetResamplerSettings(oldSettings);
+#endif // ENABLE_SSE4
 }
 
 
-static noinline void TestITCompression()
-//--------------------------------------
+// The DSP effects must produce the same output as the previous implementations, and the SSE2 kernels must match the portable code.
+// Expects the module to have been prepared by TestSIMDMixer.
+static void TestDSPEffects(CSoundFile &sndFile)
+//---------------------------------------------
 {
-	// Test loading / saving of IT-compressed samples
-	const int sampleDataSize = 65536;
-	std::vector<int8> sampleData(sampleDataSize, 0);
-	std::srand(0);
-	for(int i = 0; i < sampleDataSize; i++)
+#ifndef NO_DSP
+	// Bass expansion on a noisy signal with changing DC offset.
+	// The reference values were produced by a transliteration of the previous x86 assembly implementation.
 	{
-		sampleData[i] = (int8)std::rand();
+		std::vector<int> buffer(4096 * 2);
+		uint32 seed = 1;
+		for(std::size_t i = 0; i < buffer.size(); i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			buffer[i] = static_cast<int>((seed >> 8) % (1 << 25)) + (1 << 24) * static_cast<int>((i / 512) % 3 - 1);
+		}
+		CDSP dsp;
+		dsp.SetSettings(CDSPSettings());
+		dsp.Initialize(true, 44100, SNDDSP_MEGABASS);
+		for(std::size_t pos = 0; pos < buffer.size(); pos += 1024)
+		{
+			dsp.Process(&buffer[pos], nullptr, 512, 2, SNDDSP_MEGABASS);
+		}
+		const std::size_t offsets[] = { 0, 1, 2, 3, 511, 1024, 2047, 3000, 4095, 8191 };
+		const int expected[] = { -12530020, -6983264, -14370089, -4107518, -1406884, 37642488, -18160319, 29635048, -2124357, -17577804 };
+		for(std::size_t i = 0; i < CountOf(offsets); i++)
+		{
+			VERIFY_EQUAL_NONCONT(buffer[offsets[i]], expected[i]);
+		}
+		int64 sum = 0;
+		for(std::size_t i = 0; i < buffer.size(); i++)
+		{
+			sum += buffer[i];
+		}
+		VERIFY_EQUAL_NONCONT(sum, int64(10798044060));
 	}
+#endif // NO_DSP
 
-	// Run each compression test with IT215 compression and without.
-	for(int i = 0; i < 2; i++)
+#ifndef NO_REVERB
+	// Half a second of noise followed by the reverb tail, for two presets.
+	// The reference values were produced by a transliteration of the previous MMX implementation, which the current code matches exactly on x86.
+	// The tolerance (about 0.1% of the output peak) leaves room for the coefficients to be rounded differently by other math libraries.
 	{
-		RunITCompressionTest(sampleData, ChannelFlags(0), i == 0);
-		RunITCompressionTest(sampleData, CHN_16BIT, i == 0);
-		RunITCompressionTest(sampleData, CHN_STEREO, i == 0);
-		RunITCompressionTest(sampleData, CHN_16BIT | CHN_STEREO, i == 0);
+		const int reverbTypes[] = { 1, 28 };
+		const std::size_t offsets[] = { 0, 1, 1000, 4097, 10000, 20001, 22050, 30000, 40000, 44099 };
+		const int expected[][CountOf(offsets)] =
+		{
+			{ -10908254, -6050086, -7356915, -2566240, -8772355, -4867152, -11303375, 577751, 137288, 131018 },
+			{ -10908254, -6050086, -6427650, -4660495, -7954816, -3102373, -14173018, -1369510, 378557, -566413 },
+		};
+		const int tolerance = 1 << 14;
+		for(std::size_t t = 0; t < CountOf(reverbTypes); t++)
+		{
+			MPT_SHARED_PTR<CReverb> reverb = mpt::make_shared<CReverb>();
+			reverb->m_Settings.m_nReverbType = reverbTypes[t];
+			reverb->m_Settings.m_nReverbDepth = 8;
+			reverb->Initialize(true, 44100);
+			const uint32 frames = 22050, chunkSize = 512;
+			std::vector<int> output(frames * 2, 0);
+			uint32 seed = 1;
+			for(uint32 pos = 0; pos < frames; pos += chunkSize)
+			{
+				const uint32 count = std::min(chunkSize, frames - pos);
+				if(pos < frames / 2)
+				{
+					int *send = reverb->GetReverbSendBuffer(count);
+					for(uint32 i = 0; i < count * 2; i++)
+					{
+						seed = seed * 1103515245 + 12345;
+						send[i] += static_cast<int>((seed >> 8) % (1 << 25)) - (1 << 24);
+					}
+				}
+				reverb->Process(&output[pos * 2], count);
+			}
+			for(std::size_t i = 0; i < CountOf(offsets); i++)
+			{
+				VERIFY_EQUAL_NONCONT(std::abs(output[offsets[i]] - expected[t][i]) <= tolerance, true);
+			}
+		}
 	}
-}
-
-
-static double Rand01() {return rand() / double(RAND_MAX);}
-template <class T>
-T Rand(const T min, const T max) {return Util::Round<T>(min + Rand01() * (max - min));}
+#endif // NO_REVERB
 
+	const ORDERINDEX order = GetFirstPlayableOrder(sndFile);
+	if(order >= sndFile.Order.size())
+	{
+		return;
+	}
 
+	const DWORD oldMask = sndFile.m_MixerSettings.DSPMask;
+	const std::vector<int> dry = RenderFromOrder(sndFile, order);
 
-static void GenerateCommands(CPattern& pat, const double dProbPcs, const double dProbPc)
-//--------------------------------------------------------------------------------------
-{
-	const double dPcxProb = dProbPcs + dProbPc;
-	const CPattern::const_iterator end = pat.End();
-	for(CPattern::iterator i = pat.Begin(); i != end; i++)
+#if !defined(NO_REVERB) && !defined(MODPLUG_TRACKER)
+	// S99 must not send anything to the reverb while it is disabled
 	{
-		const double rand = Rand01();
-		if(rand < dPcxProb)
+		CPattern &pattern = sndFile.Patterns[sndFile.Order[order]];
+		std::vector<CHANNELINDEX> changed;
+		for(CHANNELINDEX chn = 0; chn < sndFile.GetNumChannels(); chn++)
 		{
-			if(rand < dProbPcs)
-				i->note = NOTE_PCS;
-			else
-				i->note = NOTE_PC;
+			ModCommand &m = *pattern.GetpModCommand(0, chn);
+			if(m.command == CMD_NONE)
+			{
+				m.command = CMD_S3MCMDEX;
+				m.param = 0x99;
+				changed.push_back(chn);
+			}
+		}
+		VERIFY_EQUAL_NONCONT(changed.empty(), false);
+		VERIFY_EQUAL_NONCONT(RenderFromOrder(sndFile, order) == dry, true);
+		for(std::size_t i = 0; i < changed.size(); i++)
+		{
+			ModCommand &m = *pattern.GetpModCommand(0, changed[i]);
+			m.command = CMD_NONE;
+			m.param = 0;
+		}
+	}
+#endif // !NO_REVERB && !MODPLUG_TRACKER
 
-			i->instr = Rand<ModCommand::INSTR>(0, MAX_MIXPLUGINS);
-			i->SetValueVolCol(Rand<uint16>(0, ModCommand::maxColumnValue));
-			i->SetValueEffectCol(Rand<uint16>(0, ModCommand::maxColumnValue));
+#ifndef NO_REVERB
+	sndFile.SetDspEffects(SNDDSP_REVERB | SNDDSP_MEGABASS | SNDDSP_SURROUND | SNDDSP_AGC);
+#if defined(MPT_INTRINSICS_X86)
+	const std::vector<int> portable = RenderWithProcSupport(sndFile, order, ProcSupport & ~(PROCSUPPORT_SSE2 | PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2));
+	if(ProcSupport & PROCSUPPORT_SSE2)
+	{
+		VERIFY_EQUAL_NONCONT(RenderWithProcSupport(sndFile, order, ProcSupport & ~(PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2)) == portable, true);
+	}
+#else
+	const std::vector<int> portable = RenderFromOrder(sndFile, order);
+#endif // MPT_INTRINSICS_X86
+	VERIFY_EQUAL_NONCONT(portable.size(), dry.size());
+	VERIFY_EQUAL_NONCONT(portable != dry, true);
+	VERIFY_EQUAL_NONCONT(sndFile.m_Reverb.GetProcessedFrames(), portable.size() / sndFile.m_MixerSettings.gnChannels);
+
+	// Other reverb presets must be picked up without a reset
+	const CReverbSettings oldReverbSettings = sndFile.m_Reverb.m_Settings;
+	sndFile.m_Reverb.m_Settings.m_nReverbType = 5;
+	sndFile.m_Reverb.Initialize(false, sndFile.m_MixerSettings.gdwMixingFreq);
+	VERIFY_EQUAL_NONCONT(RenderFromOrder(sndFile, order) != portable, true);
+	sndFile.m_Reverb.m_Settings = oldReverbSettings;
+	sndFile.m_Reverb.Initialize(false, sndFile.m_MixerSettings.gdwMixingFreq);
+#endif // NO_REVERB
+
+#ifndef NO_EQ
+	const UINT gains[] = { 32, 16, 0, 16, 32, 0 };
+	const UINT freqs[] = { 125, 300, 600, 1250, 4000, 8000 };
+	sndFile.SetDspEffects(SNDDSP_EQ);
+	sndFile.SetEQGains(gains, CountOf(gains), freqs, true);
+	const std::vector<int> equalized = RenderFromOrder(sndFile, order);
+	VERIFY_EQUAL_NONCONT(equalized.size(), dry.size());
+	VERIFY_EQUAL_NONCONT(equalized != dry, true);
+#if defined(MPT_INTRINSICS_X86)
+	// The SSE2 equalizer flushes denormals to zero and rounds towards zero,
+	// so it can only be expected to be very close to the previous (C) implementation.
+	if(ProcSupport & PROCSUPPORT_SSE2)
+	{
+		sndFile.SetEQGains(gains, CountOf(gains), freqs, true);
+		const std::vector<int> reference = RenderWithProcSupport(sndFile, order, ProcSupport & ~(PROCSUPPORT_SSE2 | PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2 | PROCSUPPORT_AMD_3DNOW));
+		VERIFY_EQUAL_NONCONT(reference.size(), equalized.size());
+		int maxDiff = 0, peak = 0;
+		for(std::size_t i = 0; i < reference.size() && i < equalized.size(); i++)
+		{
+			maxDiff = std::max(maxDiff, std::abs(reference[i] - equalized[i]));
+			peak = std::max(peak, std::abs(reference[i]));
 		}
-		else
-			i->Clear();
+		VERIFY_EQUAL_NONCONT(maxDiff <= peak / 4096, true);
 	}
+#endif // MPT_INTRINSICS_X86
+
+	const UINT flat[] = { 16, 16, 16, 16, 16, 16 };
+	sndFile.SetEQGains(flat, CountOf(flat), freqs, true);
+#endif // NO_EQ
+	sndFile.SetDspEffects(oldMask);
 }
 
 
-// Test PC note serialization
+// Skipping silent voices must not change the output.
+// Expects the module to have been prepared by TestSIMDMixer.
+static void TestVoiceCulling(CSoundFile &sndFile)
+//-----------------------------------------------
+{
+	const ORDERINDEX order = GetFirstPlayableOrder(sndFile);
+	if(order >= sndFile.Order.size() || sndFile.GetNumSamples() < 2)
+	{
+		return;
+	}
+
+	// The first sample becomes completely silent, the second one is silent up to the middle of its loop.
+	for(SAMPLEINDEX smp = 1; smp <= 2; smp++)
+	{
+		ModSample &sample = sndFile.GetSample(smp);
+		if(sample.pSample == nullptr)
+		{
+			continue;
+		}
+		const SmpLength silentLength = (smp == 1) ? sample.nLength : 8 * SampleIndex::BlockSize;
+		memset(sample.pSample, 0, silentLength * sample.GetBytesPerSample());
+		ctrlSmp::PrecomputeLoops(sample, sndFile, false);
+		VERIFY_EQUAL_NONCONT(sndFile.IsSampleRangeSilent(sample, 0, silentLength - 1), true);
+		VERIFY_EQUAL_NONCONT(sndFile.IsSampleRangeSilent(sample, 0, silentLength), false);
+		const SampleIndex *index = sndFile.GetSampleIndex(sample);
+		VERIFY_EQUAL_NONCONT(index != nullptr, true);
+		if(index != nullptr)
+		{
+			VERIFY_EQUAL_NONCONT(index->GetRangePeak(0, silentLength - 1), 0);
+			VERIFY_EQUAL_NONCONT(index->GetRangePeak(0, sample.nLength - 1) > 0, smp != 1);
+		}
+	}
+
+	// Editing a silent part of the sample in-place only updates that part of the index
+	{
+		ModSample &sample = sndFile.GetSample(2);
+		const SmpLength editStart = 3 * SampleIndex::BlockSize + 10, editEnd = editStart + 20;
+		ctrlSmp::InvertSample(sample, editStart, editEnd, sndFile);
+		VERIFY_EQUAL_NONCONT(sndFile.IsSampleRangeSilent(sample, 0, 3 * SampleIndex::BlockSize - 1), true);
+		VERIFY_EQUAL_NONCONT(sndFile.IsSampleRangeSilent(sample, editStart, editStart), false);
+		VERIFY_EQUAL_NONCONT(sndFile.IsSampleRangeSilent(sample, 4 * SampleIndex::BlockSize, 8 * SampleIndex::BlockSize - 1), true);
+		VERIFY_EQUAL_NONCONT(sndFile.GetSampleIndex(sample) != nullptr && sndFile.GetSampleIndex(sample)->GetBlockPeak(3) == (sample.uFlags[CHN_16BIT] ? 1 : 256), true);
+		ctrlSmp::InvertSample(sample, editStart, editEnd, sndFile);
+		VERIFY_EQUAL_NONCONT(sndFile.IsSampleRangeSilent(sample, 0, 8 * SampleIndex::BlockSize - 1), true);
+	}
+
+	const DWORD oldFlags = sndFile.m_MixerSettings.MixerFlags;
+	sndFile.m_MixerSettings.MixerFlags |= SNDMIX_NOVOICECULLING;
+	const std::vector<int> reference = RenderFromOrder(sndFile, order);
+	VERIFY_EQUAL_NONCONT(sndFile.GetNumCulledVoices(), 0);
+
+	sndFile.m_MixerSettings.MixerFlags &= ~SNDMIX_NOVOICECULLING;
+	VERIFY_EQUAL_NONCONT(RenderFromOrder(sndFile, order) == reference, true);
+	VERIFY_EQUAL_NONCONT(sndFile.GetNumCulledVoices() > 0, true);
+	VERIFY_EQUAL_NONCONT(sndFile.GetNumMixedVoices() > 0, true);
+	sndFile.m_MixerSettings.MixerFlags = oldFlags;
+}
+
+
+// The render statistics must cover everything that has been rendered, and measuring the time must not change the output.
+static void TestRenderStats(CSoundFile &sndFile)
+//----------------------------------------------
+{
+	const ORDERINDEX order = GetFirstPlayableOrder(sndFile);
+	if(order >= sndFile.Order.size())
+	{
+		return;
+	}
+
+	sndFile.m_RenderStats.timingEnabled = false;
+	sndFile.m_RenderStats.Reset();
+	const std::vector<int> reference = RenderFromOrder(sndFile, order);
+	const RenderStats &stats = sndFile.m_RenderStats;
+	VERIFY_EQUAL_NONCONT(stats.renderedFrames * sndFile.m_MixerSettings.gnChannels, reference.size());
+	VERIFY_EQUAL_NONCONT(stats.ticks > 0, true);
+	VERIFY_EQUAL_NONCONT(stats.chunks >= stats.ticks, true);
+	VERIFY_EQUAL_NONCONT(stats.mixedVoices + stats.culledVoices > 0, true);
+	VERIFY_EQUAL_NONCONT(stats.runs[RenderStats::stageMix], stats.chunks);
+	VERIFY_EQUAL_NONCONT(stats.runFrames[RenderStats::stageMix], stats.renderedFrames);
+	VERIFY_EQUAL_NONCONT(stats.runFrames[RenderStats::stageOutput], stats.renderedFrames);
+	VERIFY_EQUAL_NONCONT(stats.runFrames[RenderStats::stageReadNote], 0);
+	VERIFY_EQUAL_NONCONT(stats.GetTime(RenderStats::stageMix), 0);
+
+	sndFile.m_RenderStats.timingEnabled = true;
+	sndFile.m_RenderStats.Reset();
+	VERIFY_EQUAL_NONCONT(RenderFromOrder(sndFile, order) == reference, true);
+	VERIFY_EQUAL_NONCONT(stats.renderedFrames * sndFile.m_MixerSettings.gnChannels, reference.size());
+	// At most one stage is timed per tick; the last tick may have been started by the song end
+	uint64 timedRuns = 0;
+	for(int stage = 0; stage < RenderStats::numStages; stage++)
+	{
+		timedRuns += stats.timedRuns[stage];
+	}
+	VERIFY_EQUAL_NONCONT(timedRuns > 0, true);
+	VERIFY_EQUAL_NONCONT(timedRuns <= stats.ticks + 1, true);
+	VERIFY_EQUAL_NONCONT(stats.timedFrames[RenderStats::stageMix] <= stats.runFrames[RenderStats::stageMix], true);
+	VERIFY_EQUAL_NONCONT(stats.GetTime(RenderStats::stagePlugins), 0);
+	sndFile.m_RenderStats.timingEnabled = false;
+
+	// A timed chunk of 512 frames in a tick of 512 + 370 frames: Chunk stages are extrapolated by frames, tick stages by runs.
+	RenderStats extrapolated;
+	extrapolated.runs[RenderStats::stageMix] = 2;
+	extrapolated.runFrames[RenderStats::stageMix] = 882;
+	extrapolated.timedRuns[RenderStats::stageMix] = 1;
+	extrapolated.timedFrames[RenderStats::stageMix] = 512;
+	extrapolated.timedTime[RenderStats::stageMix] = 5120;
+	VERIFY_EQUAL_NONCONT(extrapolated.GetTime(RenderStats::stageMix), 8820);
+	extrapolated.runs[RenderStats::stageReadNote] = 4;
+	extrapolated.timedRuns[RenderStats::stageReadNote] = 1;
+	extrapolated.timedTime[RenderStats::stageReadNote] = 1000;
+	VERIFY_EQUAL_NONCONT(extrapolated.GetTime(RenderStats::stageReadNote), 4000);
+}
+
+#else
+
+static void TestSIMDMixer(CSoundFile &)
+//-------------------------------------
+{
+}
+
+static void TestDSPEffects(CSoundFile &)
+//--------------------------------------
+{
+}
+
+static void TestVoiceCulling(CSoundFile &)
+//----------------------------------------
+{
+}
+
+static void TestRenderStats(CSoundFile &)
+//---------------------------------------
+{
+}
+
+#endif // MPT_INTMIXER
+
+
+// The format signatures should make Create() try the right loader first.
+static void TestFormatSignature(const mpt::PathString &filename, const std::string &expectedFormat)
+//-------------------------------------------------------------------------------------------------
+{
+	mpt::ifstream stream(filename, std::ios::binary);
+	FileReader file(&stream);
+	const std::vector<const char *> formats = CSoundFile::ProbeFormatSignatures(file);
+	VERIFY_EQUAL_NONCONT(formats.empty(), false);
+	if(!formats.empty())
+	{
+		VERIFY_EQUAL_NONCONT(formats[0], expectedFormat);
+	}
+}
+
+
+#ifdef LIBOPENMPT_BUILD
+
+// Rendering a sub song with openmpt::ext::offline_render must give the same output as reading it in small chunks,
+// except that the song is not faded out at its end.
+static void TestOfflineRender(const mpt::PathString &filename)
+//------------------------------------------------------------
+{
+	const std::int32_t samplerate = 44100;
+	std::ostringstream log;
+
+	std::vector<std::int16_t> realtimeOutput;
+	{
+		mpt::ifstream stream(filename, std::ios::binary);
+		openmpt::module_ext mod(stream, log);
+		std::vector<std::int16_t> buffer(480 * 2);
+		std::size_t count;
+		while((count = mod.read_interleaved_stereo(samplerate, 480, &buffer[0])) != 0)
+		{
+			realtimeOutput.insert(realtimeOutput.end(), buffer.begin(), buffer.begin() + count * 2);
+		}
+	}
+
+	std::vector<std::int16_t> offlineOutput;
+	double duration = 0.0;
+	{
+		mpt::ifstream stream(filename, std::ios::binary);
+		openmpt::module_ext mod(stream, log);
+		duration = mod.get_duration_seconds();
+		openmpt::ext::offline_render *render = static_cast<openmpt::ext::offline_render *>(mod.get_interface(openmpt::ext::offline_render_id));
+		VERIFY_EQUAL_NONCONT(render != nullptr, true);
+		if(render == nullptr)
+		{
+			return;
+		}
+		std::vector<std::int16_t> buffer(65536 * 2);
+		std::size_t count;
+		while((count = render->render_interleaved_stereo(samplerate, 65536, &buffer[0])) != 0)
+		{
+			offlineOutput.insert(offlineOutput.end(), buffer.begin(), buffer.begin() + count * 2);
+		}
+		VERIFY_EQUAL_NONCONT(render->get_render_speed() > 0.0, true);
+	}
+
+	// The offline render stops at the song end, reading continues with the fade-out.
+	VERIFY_EQUAL_NONCONT(offlineOutput.empty(), false);
+	VERIFY_EQUAL_NONCONT(offlineOutput.size() <= realtimeOutput.size(), true);
+	VERIFY_EQUAL_NONCONT(std::abs(static_cast<double>(offlineOutput.size() / 2) / samplerate - duration) < 0.1, true);
+	if(offlineOutput.size() <= realtimeOutput.size())
+	{
+		VERIFY_EQUAL_NONCONT(std::equal(offlineOutput.begin(), offlineOutput.end(), realtimeOutput.begin()), true);
+	}
+}
+
+
+// openmpt::probe must report the same information as loading the complete module.
+static void TestProbe(const mpt::PathString &filename)
+//----------------------------------------------------
+{
+	std::ostringstream log;
+	mpt::ifstream moduleStream(filename, std::ios::binary);
+	openmpt::module mod(moduleStream, log);
+
+	for(int calculateDuration = 0; calculateDuration < 2; calculateDuration++)
+	{
+		mpt::ifstream stream(filename, std::ios::binary);
+		const openmpt::module_info info = openmpt::probe(stream, calculateDuration != 0, log);
+		VERIFY_EQUAL_NONCONT(info.type, mod.get_metadata("type"));
+		VERIFY_EQUAL_NONCONT(info.type_long, mod.get_metadata("type_long"));
+		VERIFY_EQUAL_NONCONT(info.title, mod.get_metadata("title"));
+		VERIFY_EQUAL_NONCONT(info.artist, mod.get_metadata("artist"));
+		VERIFY_EQUAL_NONCONT(info.message, mod.get_metadata("message"));
+		VERIFY_EQUAL_NONCONT(info.num_orders, mod.get_num_orders());
+		VERIFY_EQUAL_NONCONT(info.num_instruments, mod.get_num_instruments());
+		VERIFY_EQUAL_NONCONT(info.num_samples, mod.get_num_samples());
+		VERIFY_EQUAL_NONCONT(info.instrument_names == mod.get_instrument_names(), true);
+		VERIFY_EQUAL_NONCONT(info.sample_names == mod.get_sample_names(), true);
+		if(calculateDuration)
+		{
+			VERIFY_EQUAL_NONCONT(info.num_channels, mod.get_num_channels());
+			VERIFY_EQUAL_NONCONT(info.num_patterns, mod.get_num_patterns());
+			VERIFY_EQUAL_NONCONT(info.duration_seconds, mod.get_duration_seconds());
+		} else
+		{
+			VERIFY_EQUAL_NONCONT(info.duration_seconds, 0.0);
+		}
+	}
+}
+
+// test.zip contains a deflated test.xm, a stored Music/test.s3m, readme.txt, the directory Music/,
+// broken.it whose deflated data has been damaged and mod.huge whose uncompressed size has been changed to 2 GiB.
+static void TestArchive(const mpt::PathString &filenameBase)
+//----------------------------------------------------------
+{
+	std::vector<std::uint8_t> data;
+	{
+		mpt::ifstream stream(filenameBase + MPT_PATHSTRING("zip"), std::ios::binary);
+		FileReader file(&stream);
+		file.ReadVector(data, file.GetLength());
+	}
+	std::vector<std::uint8_t> xmData;
+	{
+		mpt::ifstream stream(filenameBase + MPT_PATHSTRING("xm"), std::ios::binary);
+		FileReader file(&stream);
+		file.ReadVector(xmData, file.GetLength());
+	}
+	VERIFY_EQUAL_NONCONT(data.empty(), false);
+	if(data.empty())
+	{
+		return;
+	}
+
+	std::ostringstream log;
+	openmpt::archive arc(data);
+	const std::vector<openmpt::archive_entry> entries = arc.get_entries();
+	VERIFY_EQUAL_NONCONT(entries.size(), 4u);
+	if(entries.size() != 4)
+	{
+		return;
+	}
+	VERIFY_EQUAL_NONCONT(entries[0].filename, "test.xm");
+	VERIFY_EQUAL_NONCONT(entries[0].size, xmData.size());
+	VERIFY_EQUAL_NONCONT(entries[1].filename, "Music/test.s3m");
+	VERIFY_EQUAL_NONCONT(entries[2].filename, "broken.it");
+	VERIFY_EQUAL_NONCONT(entries[3].filename, "mod.huge");
+
+	VERIFY_EQUAL_NONCONT(arc.extract(0) == xmData, true);
+	{
+		openmpt::module mod(arc, 0, log);
+		VERIFY_EQUAL_NONCONT(mod.get_metadata("type"), "xm");
+	}
+	{
+		openmpt::module mod(arc, 1, log);
+		VERIFY_EQUAL_NONCONT(mod.get_metadata("type"), "s3m");
+	}
+
+	// Corrupted entries and invalid indices must be reported through openmpt::exception, also if the declared size is implausible.
+	for(std::size_t i = 2; i <= 4; i++)
+	{
+		bool thrown = false;
+		try
+		{
+			arc.extract(i);
+		} catch(const openmpt::exception &)
+		{
+			thrown = true;
+		}
+		VERIFY_EQUAL_NONCONT(thrown, true);
+	}
+
+	const std::vector<openmpt::module_info> info = arc.probe_all(false, 2, log);
+	VERIFY_EQUAL_NONCONT(info.size(), entries.size());
+	if(info.size() == entries.size())
+	{
+		VERIFY_EQUAL_NONCONT(info[0].type, "xm");
+		VERIFY_EQUAL_NONCONT(info[1].type, "s3m");
+		VERIFY_EQUAL_NONCONT(info[2].type, "");
+		VERIFY_EQUAL_NONCONT(info[3].type, "");
+	}
+}
+
+
+#endif // LIBOPENMPT_BUILD
+
+
+// Packed modules are decompressed on demand and must load just like the unpacked file.
+static void TestPackedFile(const mpt::PathString &filename)
+//---------------------------------------------------------
+{
+	mpt::ifstream stream(filename, std::ios::binary);
+	FileReader file(&stream);
+	std::vector<char> data(file.GetLength());
+	file.ReadRaw(&data[0], data.size());
+	const uint32 length = static_cast<uint32>(data.size());
+	const uint32 blockSize = 4096;
+	const uint32 numBlocks = (length + blockSize - 1) / blockSize;
+
+	// MMCMP file with stored blocks
+	std::ostringstream mmcmp;
+	mmcmp.write("ziRCONia", 8);
+	mpt::IO::WriteIntLE<uint16>(mmcmp, 14);
+	mpt::IO::WriteIntLE<uint16>(mmcmp, 0x1310);
+	mpt::IO::WriteIntLE<uint16>(mmcmp, static_cast<uint16>(numBlocks));
+	mpt::IO::WriteIntLE<uint32>(mmcmp, length);
+	mpt::IO::WriteIntLE<uint32>(mmcmp, 24);
+	mpt::IO::WriteIntLE<uint16>(mmcmp, 0);
+	for(uint32 i = 0, blockPos = 24 + 4 * numBlocks; i < numBlocks; i++)
+	{
+		mpt::IO::WriteIntLE<uint32>(mmcmp, blockPos);
+		blockPos += 20 + 8 + std::min(blockSize, length - i * blockSize);
+	}
+	for(uint32 i = 0; i < numBlocks; i++)
+	{
+		const uint32 size = std::min(blockSize, length - i * blockSize);
+		mpt::IO::WriteIntLE<uint32>(mmcmp, size);
+		mpt::IO::WriteIntLE<uint32>(mmcmp, size);
+		mpt::IO::WriteIntLE<uint32>(mmcmp, 0);
+		mpt::IO::WriteIntLE<uint16>(mmcmp, 1);
+		mpt::IO::WriteIntLE<uint16>(mmcmp, 0);
+		mpt::IO::WriteIntLE<uint32>(mmcmp, 0);
+		mpt::IO::WriteIntLE<uint32>(mmcmp, i * blockSize);
+		mpt::IO::WriteIntLE<uint32>(mmcmp, size);
+		mmcmp.write(&data[i * blockSize], size);
+	}
+
+	// XPK file with raw chunks
+	std::ostringstream xpk;
+	xpk.write("XPKF", 4);
+	mpt::IO::WriteIntBE<uint32>(xpk, 36 - 8 + numBlocks * 8 + length);
+	xpk.write("SQSH", 4);
+	mpt::IO::WriteIntBE<uint32>(xpk, length);
+	for(int i = 0; i < 5; i++)
+	{
+		mpt::IO::WriteIntBE<uint32>(xpk, 0);
+	}
+	for(uint32 i = 0; i < numBlocks; i++)
+	{
+		const uint32 size = std::min(blockSize, length - i * blockSize);
+		mpt::IO::WriteIntBE<uint32>(xpk, 0);
+		mpt::IO::WriteIntBE<uint16>(xpk, static_cast<uint16>(size));
+		mpt::IO::WriteIntBE<uint16>(xpk, static_cast<uint16>(size));
+		xpk.write(&data[i * blockSize], size);
+	}
+
+	// PP20 file consisting of a single run of literal bytes, which are stored backwards in a backwards bit stream
+	std::vector<bool> bits;
+	bits.push_back(false);
+	uint32 runLength = 1;
+	while(runLength < length)
+	{
+		const uint32 code = std::min<uint32>(length - runLength, 3);
+		bits.push_back((code & 2) != 0);
+		bits.push_back((code & 1) != 0);
+		runLength += code;
+		if(code != 3) break;
+	}
+	for(uint32 i = length; i > 0; i--)
+	{
+		for(int bit = 7; bit >= 0; bit--)
+		{
+			bits.push_back(((static_cast<uint8>(data[i - 1]) >> bit) & 1) != 0);
+		}
+	}
+	std::string pp20Bits((bits.size() + 7) / 8, '\0');
+	for(std::size_t i = 0; i < bits.size(); i++)
+	{
+		if(bits[i]) pp20Bits[pp20Bits.size() - 1 - i / 8] |= static_cast<char>(1 << (i % 8));
+	}
+	std::ostringstream pp20;
+	pp20.write("PP20", 4);
+	pp20.write("\x09\x0A\x0B\x0B", 4);
+	pp20.write(pp20Bits.data(), pp20Bits.size());
+	mpt::IO::WriteIntBE<uint8>(pp20, static_cast<uint8>(length >> 16));
+	mpt::IO::WriteIntBE<uint16>(pp20, static_cast<uint16>(length));
+	mpt::IO::WriteIntBE<uint8>(pp20, 0);
+
+	typedef bool (*UnpackFunc)(std::vector<char> &, FileReader &);
+	const UnpackFunc unpackFuncs[] = { UnpackMMCMP, UnpackXPK, UnpackPP20 };
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+	typedef FileReader (*UnpackFileFunc)(FileReader &);
+	const UnpackFileFunc unpackFileFuncs[] = { UnpackMMCMP, UnpackXPK, UnpackPP20 };
+#endif
+	const std::string packed[] = { mmcmp.str(), xpk.str(), pp20.str() };
+	const MODCONTAINERTYPE containerTypes[] = { MOD_CONTAINERTYPE_MMCMP, MOD_CONTAINERTYPE_XPK, MOD_CONTAINERTYPE_PP20 };
+	for(std::size_t i = 0; i < CountOf(packed); i++)
+	{
+		FileReader packedFile(packed[i].data(), packed[i].size());
+		std::vector<char> unpackedData;
+		VERIFY_EQUAL_NONCONT(unpackFuncs[i](unpackedData, packedFile), true);
+		VERIFY_EQUAL_NONCONT(unpackedData == data, true);
+
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+		// Reading parts of the file in random order
+		FileReader unpackedFile = unpackFileFuncs[i](packedFile);
+		VERIFY_EQUAL_NONCONT(unpackedFile.IsValid(), true);
+		VERIFY_EQUAL_NONCONT(unpackedFile.GetLength(), length);
+		const uint32 offsets[] = { 5000, 0, length - 100, length / 2 };
+		for(std::size_t j = 0; j < CountOf(offsets); j++)
+		{
+			char buf[100];
+			unpackedFile.Seek(offsets[j]);
+			VERIFY_EQUAL_NONCONT(unpackedFile.ReadRaw(buf, sizeof(buf)), sizeof(buf));
+			VERIFY_EQUAL_NONCONT(std::memcmp(buf, &data[offsets[j]], sizeof(buf)), 0);
+		}
+		VERIFY_EQUAL_NONCONT(std::memcmp(unpackedFile.GetChunk(0, length).GetRawData(), &data[0], length), 0);
+#endif
+
+		MPT_SHARED_PTR<CSoundFile> sndFile = mpt::make_shared<CSoundFile>();
+		VERIFY_EQUAL_NONCONT(sndFile->Create(packedFile, CSoundFile::loadCompleteModule), true);
+		VERIFY_EQUAL_NONCONT(sndFile->GetContainerType(), containerTypes[i]);
+		TestLoadXMFile(*sndFile);
+		sndFile->Destroy();
+	}
+
+	// Truncated MMCMP file: The header and block table are intact, but the data of the last block is incomplete.
+	// Corrupt MMCMP file: The first block claims to be compressed, but its translation table exceeds the file.
+	std::string truncatedMMCMP = mmcmp.str();
+	truncatedMMCMP.resize(truncatedMMCMP.size() - 100);
+	std::string corruptMMCMP = mmcmp.str();
+	const std::size_t firstBlockPos = 24 + 4 * numBlocks;
+	corruptMMCMP[firstBlockPos + 14] = 1;	// flags = MMCMP_COMP
+	corruptMMCMP[firstBlockPos + 16] = '\xFF';	// tt_entries
+	corruptMMCMP[firstBlockPos + 17] = '\xFF';
+	const std::string invalid[] = { truncatedMMCMP, corruptMMCMP };
+	for(std::size_t i = 0; i < CountOf(invalid); i++)
+	{
+		FileReader packedFile(invalid[i].data(), invalid[i].size());
+		std::vector<char> unpackedData;
+		VERIFY_EQUAL_NONCONT(UnpackMMCMP(unpackedData, packedFile), false);
+
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+		// The error is only noticed when the broken block is accessed. From then on, the file cannot be read anymore.
+		FileReader unpackedFile = UnpackMMCMP(packedFile);
+		VERIFY_EQUAL_NONCONT(unpackedFile.IsValid(), true);
+		const uint32 brokenOffset = (i == 0) ? (length - 1) : 0;
+		const uint32 intactOffset = (i == 0) ? 0 : (length - 1);
+		char buf[1];
+		unpackedFile.Seek(intactOffset);
+		VERIFY_EQUAL_NONCONT(unpackedFile.ReadRaw(buf, 1), 1);
+		VERIFY_EQUAL_NONCONT(buf[0], data[intactOffset]);
+		unpackedFile.Seek(brokenOffset);
+		VERIFY_EQUAL_NONCONT(unpackedFile.ReadRaw(buf, 1), 0);
+		VERIFY_EQUAL_NONCONT(unpackedFile.IsValid(), false);
+		unpackedFile.Seek(intactOffset);
+		VERIFY_EQUAL_NONCONT(unpackedFile.ReadRaw(buf, 1), 0);
+		VERIFY_EQUAL_NONCONT(unpackedFile.GetLength(), 0);
+#endif
+
+		MPT_SHARED_PTR<CSoundFile> sndFile = mpt::make_shared<CSoundFile>();
+		VERIFY_EQUAL_NONCONT(sndFile->Create(packedFile, CSoundFile::loadCompleteModule), false);
+		sndFile->Destroy();
+	}
+
+	// PP20 file whose first literal run is longer than the unpacked length
+	std::string invalidPP20 = pp20.str();
+	invalidPP20[invalidPP20.size() - 4] = 0;
+	invalidPP20[invalidPP20.size() - 3] = 0;
+	invalidPP20[invalidPP20.size() - 2] = 2;
+	{
+		FileReader packedFile(invalidPP20.data(), invalidPP20.size());
+		std::vector<char> unpackedData;
+		VERIFY_EQUAL_NONCONT(UnpackPP20(unpackedData, packedFile), false);
+#if defined(MPT_FILEREADER_STD_ISTREAM)
+		VERIFY_EQUAL_NONCONT(UnpackPP20(packedFile).IsValid(), false);
+#endif
+	}
+}
+
+
+// Identical samples of separately loaded modules should share their memory, and modifying shared sample data must not affect other modules.
+static void TestSharedSampleData(const mpt::PathString &filename)
+//---------------------------------------------------------------
+{
+	const size_t numBuffers = SampleDataStore::GetNumBuffers();
+	MPT_SHARED_PTR<CSoundFile> sndFile[2];
+	for(int i = 0; i < 2; i++)
+	{
+		mpt::ifstream stream(filename, std::ios::binary);
+		FileReader file(&stream);
+		sndFile[i] = mpt::make_shared<CSoundFile>();
+		VERIFY_EQUAL_NONCONT(sndFile[i]->Create(file, CSoundFile::loadCompleteModule), true);
+		for(SAMPLEINDEX smp = 1; smp <= sndFile[i]->GetNumSamples(); smp++)
+		{
+			SampleDataStore::Share(sndFile[i]->GetSample(smp));
+		}
+	}
+	VERIFY_EQUAL_NONCONT(SampleDataStore::GetNumBuffers() > numBuffers, true);
+
+	ModSample &sample1 = sndFile[0]->GetSample(1), &sample2 = sndFile[1]->GetSample(1);
+	VERIFY_EQUAL_NONCONT(sample1.pSample == sample2.pSample, true);
+	VERIFY_EQUAL_NONCONT(SampleDataStore::IsShared(sample1.pSample), true);
+
+	// Copy on write
+	VERIFY_EQUAL_NONCONT(ctrlSmp::MakeSampleDataWritable(sample1, *sndFile[0]), true);
+	VERIFY_EQUAL_NONCONT(sample1.pSample != sample2.pSample, true);
+	VERIFY_EQUAL_NONCONT(SampleDataStore::IsShared(sample1.pSample), false);
+	VERIFY_EQUAL_NONCONT(SampleDataStore::IsShared(sample2.pSample), true);
+	VERIFY_EQUAL_NONCONT(std::memcmp(sample1.pSample, sample2.pSample, sample1.GetSampleSizeInBytes()), 0);
+
+	sndFile[0]->Destroy();
+	sndFile[1]->Destroy();
+	VERIFY_EQUAL_NONCONT(SampleDataStore::GetNumBuffers(), numBuffers);
+}
+
+
+// Test file loading and saving
+static noinline void TestLoadSaveFile()
+//-------------------------------------
+{
+	if(!ShouldRunTests())
+	{
+		return;
+	}
+	mpt::PathString filenameBaseSrc = GetTestFilenameBase();
+	mpt::PathString filenameBase = GetTempFilenameBase();
+
+	TestFormatSignature(filenameBaseSrc + MPT_PATHSTRING("mptm"), "it");
+	TestFormatSignature(filenameBaseSrc + MPT_PATHSTRING("xm"), "xm");
+	TestFormatSignature(filenameBaseSrc + MPT_PATHSTRING("s3m"), "s3m");
+
+	// Test MPTM file loading
+	{
+		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBaseSrc + MPT_PATHSTRING("mptm"));
+
+		TestLoadMPTMFile(GetrSoundFile(sndFileContainer));
+		TestRowVisitor(GetrSoundFile(sndFileContainer));
+		TestSeekIndex(GetrSoundFile(sndFileContainer));
+		TestSongLengthCache(GetrSoundFile(sndFileContainer));
+
+		#ifndef MODPLUG_NO_FILESAVE
+			// Test file saving
+			SaveIT(sndFileContainer, filenameBase + MPT_PATHSTRING("saved.mptm"));
+		#endif
+
+		TestSIMDMixer(GetrSoundFile(sndFileContainer));
+		TestDSPEffects(GetrSoundFile(sndFileContainer));
+		TestVoiceCulling(GetrSoundFile(sndFileContainer));
+		TestRenderStats(GetrSoundFile(sndFileContainer));
+
+		DestroySoundFileContainer(sndFileContainer);
+	}
+
+	// Reload the saved file and test if everything is still working correctly.
+	#ifndef MODPLUG_NO_FILESAVE
+	{
+		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBase + MPT_PATHSTRING("saved.mptm"));
+
+		TestLoadMPTMFile(GetrSoundFile(sndFileContainer));
+
+		DestroySoundFileContainer(sndFileContainer);
+
+		RemoveFile(filenameBase + MPT_PATHSTRING("saved.mptm"));
+	}
+	#endif
+
+	// When skipping the sample data, the song extensions following it must still be found.
+	{
+		mpt::ifstream stream(filenameBaseSrc + MPT_PATHSTRING("mptm"), std::ios::binary);
+		FileReader file(&stream);
+		MPT_SHARED_PTR<CSoundFile> pSndFile = mpt::make_shared<CSoundFile>();
+		VERIFY_EQUAL_NONCONT(pSndFile->Create(file, static_cast<CSoundFile::ModLoadingFlags>(CSoundFile::loadPatternData | CSoundFile::loadPluginData)), true);
+		VERIFY_EQUAL_NONCONT(pSndFile->GetSample(1).pSample == nullptr, true);
+		VERIFY_EQUAL_NONCONT(pSndFile->GetNumChannels(), 70);
+		VERIFY_EQUAL_NONCONT(pSndFile->m_nTempoMode, tempo_mode_modern);
+		VERIFY_EQUAL_NONCONT(pSndFile->m_nDefaultRowsPerBeat, 6);
+		VERIFY_EQUAL_NONCONT(pSndFile->m_dwCreatedWithVersion, MAKE_VERSION_NUMERIC(1, 19, 02, 05));
+		pSndFile->Destroy();
+	}
+
+	// Test XM file loading
+	{
+		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBaseSrc + MPT_PATHSTRING("xm"));
+
+		TestLoadXMFile(GetrSoundFile(sndFileContainer));
+		TestSeekIndex(GetrSoundFile(sndFileContainer));
+		TestSongLengthCache(GetrSoundFile(sndFileContainer));
+
+		// In OpenMPT 1.20 (up to revision 1459), there was a bug in the XM saver
+		// that would create broken XMs if the sample map contained samples that
+		// were only referenced below C-1 or above B-8 (such samples should not
+		// be written). Let's insert a sample there and check if re-loading the
+		// file still works.
+		GetrSoundFile(sndFileContainer).m_nSamples++;
+		GetrSoundFile(sndFileContainer).Instruments[1]->Keyboard[110] = GetrSoundFile(sndFileContainer).GetNumSamples();
+
+		#ifndef MODPLUG_NO_FILESAVE
+			// Test file saving
+			SaveXM(sndFileContainer, filenameBase + MPT_PATHSTRING("saved.xm"));
+		#endif
+
+		TestSIMDMixer(GetrSoundFile(sndFileContainer));
+		TestVoiceCulling(GetrSoundFile(sndFileContainer));
+		TestRenderStats(GetrSoundFile(sndFileContainer));
+
+		DestroySoundFileContainer(sndFileContainer);
+	}
+
+	// Reload the saved file and test if everything is still working correctly.
+	#ifndef MODPLUG_NO_FILESAVE
+	{
+		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBase + MPT_PATHSTRING("saved.xm"));
+
+		TestLoadXMFile(GetrSoundFile(sndFileContainer));
+
+		DestroySoundFileContainer(sndFileContainer);
+
+		RemoveFile(filenameBase + MPT_PATHSTRING("saved.xm"));
+	}
+	#endif
+
+	TestSharedSampleData(filenameBaseSrc + MPT_PATHSTRING("xm"));
+
+	TestPackedFile(filenameBaseSrc + MPT_PATHSTRING("xm"));
+
+	#ifdef LIBOPENMPT_BUILD
+		TestOfflineRender(filenameBaseSrc + MPT_PATHSTRING("xm"));
+		TestArchive(filenameBaseSrc);
+		TestProbe(filenameBaseSrc + MPT_PATHSTRING("mptm"));
+		TestProbe(filenameBaseSrc + MPT_PATHSTRING("xm"));
+		TestProbe(filenameBaseSrc + MPT_PATHSTRING("s3m"));
+	#endif
+
+	// Loading from a memory-mapped file must give the same result as loading from a stream.
+	#if defined(MPT_FILEREADER_MMAP)
+	{
+		MPT_SHARED_PTR<IFileDataContainer> mapping(new FileDataContainerMMap((filenameBaseSrc + MPT_PATHSTRING("xm")).AsNative().c_str()));
+		VERIFY_EQUAL_NONCONT(mapping->IsValid(), true);
+		VERIFY_EQUAL_NONCONT(mapping->GetRawData() != nullptr, true);
+		FileReader file(mapping);
+		MPT_SHARED_PTR<CSoundFile> pSndFile = mpt::make_shared<CSoundFile>();
+		VERIFY_EQUAL_NONCONT(pSndFile->Create(file, CSoundFile::loadCompleteModule), true);
+		TestLoadXMFile(*pSndFile);
+		pSndFile->Destroy();
+	}
+	#endif
+
+	// Test S3M file loading
+	{
+		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBaseSrc + MPT_PATHSTRING("s3m"));
+
+		TestLoadS3MFile(GetrSoundFile(sndFileContainer), false);
+		TestSeekIndex(GetrSoundFile(sndFileContainer));
+		TestSongLengthCache(GetrSoundFile(sndFileContainer));
+
+		#ifndef MODPLUG_NO_FILESAVE
+			// Test file saving
+			SaveS3M(sndFileContainer, filenameBase + MPT_PATHSTRING("saved.s3m"));
+		#endif
+
+		TestSIMDMixer(GetrSoundFile(sndFileContainer));
+
+		DestroySoundFileContainer(sndFileContainer);
+	}
+
+	// Reload the saved file and test if everything is still working correctly.
+	#ifndef MODPLUG_NO_FILESAVE
+	{
+		TSoundFileContainer sndFileContainer = CreateSoundFileContainer(filenameBase + MPT_PATHSTRING("saved.s3m"));
+
+		TestLoadS3MFile(GetrSoundFile(sndFileContainer), true);
+
+		DestroySoundFileContainer(sndFileContainer);
+
+		RemoveFile(filenameBase + MPT_PATHSTRING("saved.s3m"));
+	}
+	#endif
+
+	// General file I/O tests
+	{
+		std::ostringstream f;
+		size_t bytesWritten;
+		mpt::IO::WriteVarInt(f, uint16(0), &bytesWritten);		VERIFY_EQUAL_NONCONT(bytesWritten, 1);
+		mpt::IO::WriteVarInt(f, uint16(127), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 1);
+		mpt::IO::WriteVarInt(f, uint16(128), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 2);
+		mpt::IO::WriteVarInt(f, uint16(16383), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 2);
+		mpt::IO::WriteVarInt(f, uint16(16384), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 3);
+		mpt::IO::WriteVarInt(f, uint16(65535), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 3);
+		mpt::IO::WriteVarInt(f, uint64(0xFFFFFFFFFFFFFFFFull), &bytesWritten);	VERIFY_EQUAL_NONCONT(bytesWritten, 10);
+		std::string data = f.str();
+		FileReader file(&data[0], data.size());
+		uint64 v;
+		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 0);
+		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 127);
+		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 128);
+		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 16383);
+		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 16384);
+		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 65535);
+		file.ReadVarInt(v); VERIFY_EQUAL_NONCONT(v, 0xFFFFFFFFFFFFFFFFull);
+	}
+}
+
+
+static void RunITCompressionTest(const std::vector<int8> &sampleData, ChannelFlags smpFormat, bool it215)
+//-------------------------------------------------------------------------------------------------------
+{
+
+	ModSample smp;
+	smp.uFlags = smpFormat;
+	smp.pSample = const_cast<int8 *>(&sampleData[0]);
+	smp.nLength = sampleData.size() / smp.GetBytesPerSample();
+
+	std::string data;
+
+	{
+		std::ostringstream f;
+		ITCompression compression(smp, it215, &f);
+		data = f.str();
+	}
+
+	{
+		FileReader file(&data[0], data.length());
+
+		std::vector<int8> sampleDataNew(sampleData.size(), 0);
+		smp.pSample = &sampleDataNew[0];
+
+		ITDecompression decompression(file, smp, it215);
+		VERIFY_EQUAL_NONCONT(memcmp(&sampleData[0], &sampleDataNew[0], sampleData.size()), 0);
+	}
+
+	// Deferred decoding must yield the same sample data
+	{
+		FileReader file(&data[0], data.length());
+
+		MPT_SHARED_PTR<CSoundFile> sndFile = mpt::make_shared<CSoundFile>();
+		sndFile->m_nSamples = 1;
+		ModSample &lazySmp = sndFile->GetSample(1);
+		lazySmp.nLength = smp.nLength;
+		const SampleIO format(
+			smpFormat & CHN_16BIT ? SampleIO::_16bit : SampleIO::_8bit,
+			smpFormat & CHN_STEREO ? SampleIO::stereoSplit : SampleIO::mono,
+			SampleIO::littleEndian,
+			it215 ? SampleIO::IT215 : SampleIO::IT214);
+
+		VERIFY_EQUAL_NONCONT(sndFile->DeferSampleDecoding(1, format, file), true);
+		VERIFY_EQUAL_NONCONT(file.AreBytesLeft(), false);
+		VERIFY_EQUAL_NONCONT(lazySmp.pSample == nullptr, true);
+		VERIFY_EQUAL_NONCONT(lazySmp.GetBytesPerSample(), smp.GetBytesPerSample());
+		VERIFY_EQUAL_NONCONT(sndFile->DecodeLazySample(1), true);
+		VERIFY_EQUAL_NONCONT(sndFile->IsSampleDecodingDeferred(1), false);
+		VERIFY_EQUAL_NONCONT(memcmp(&sampleData[0], lazySmp.pSample, sampleData.size()), 0);
+		sndFile->Destroy();
+	}
+}
+
+
+static noinline void TestITCompression()
+//--------------------------------------
+{
+	// Test loading / saving of IT-compressed samples
+	const int sampleDataSize = 65536;
+	std::vector<int8> sampleData(sampleDataSize, 0);
+	std::srand(0);
+	for(int i = 0; i < sampleDataSize; i++)
+	{
+		sampleData[i] = (int8)std::rand();
+	}
+
+	// Run each compression test with IT215 compression and without.
+	for(int i = 0; i < 2; i++)
+	{
+		RunITCompressionTest(sampleData, ChannelFlags(0), i == 0);
+		RunITCompressionTest(sampleData, CHN_16BIT, i == 0);
+		RunITCompressionTest(sampleData, CHN_STEREO, i == 0);
+		RunITCompressionTest(sampleData, CHN_16BIT | CHN_STEREO, i == 0);
+	}
+}
+
+
+static double Rand01() {return rand() / double(RAND_MAX);}
+template <class T>
+T Rand(const T min, const T max) {return Util::Round<T>(min + Rand01() * (max - min));}
+
+
+
+// Finds a voice for a new note action by scanning all voices, like GetNNAChannel() used to do.
+static CHANNELINDEX FindNNAVoiceReference(const std::vector<ModChannel> &voices, CHANNELINDEX first)
+//-------------------------------------------------------------------------------------------------
+{
+	for(CHANNELINDEX i = first; i < voices.size(); i++) if(!voices[i].nLength) return i;
+	CHANNELINDEX result = 0;
+	uint32 vol = 64 * 65536;
+	uint32 envpos = 0xFFFFFF;
+	for(CHANNELINDEX j = first; j < voices.size(); j++)
+	{
+		const ModChannel &chn = voices[j];
+		if(!chn.nFadeOutVol) return j;
+		uint32 v = chn.nVolume;
+		if(chn.dwFlags[CHN_NOTEFADE])
+			v = v * chn.nFadeOutVol;
+		else
+			v <<= 16;
+		if(chn.dwFlags[CHN_LOOP]) v >>= 1;
+		if((v < vol) || ((v == vol) && (chn.VolEnv.nEnvPosition > envpos)))
+		{
+			envpos = chn.VolEnv.nEnvPosition;
+			vol = v;
+			result = j;
+		}
+	}
+	return result;
+}
+
+
+static void RandomizeVoice(ModChannel &chn)
+//-----------------------------------------
+{
+	chn.nLength = (Rand01() < 0.1) ? 0 : 1000;
+	chn.nFadeOutVol = (Rand01() < 0.05) ? 0 : Rand<int32>(1, 65536);
+	chn.nVolume = Rand<int32>(0, 256);
+	chn.dwFlags.set(CHN_NOTEFADE, Rand01() < 0.5);
+	chn.dwFlags.set(CHN_LOOP, Rand01() < 0.5);
+	chn.VolEnv.nEnvPosition = Rand<uint32>(0, 3);
+}
+
+
+// Creates an IT module in which every row triggers a note on every channel at speed 1.
+// The previous notes keep playing (NNA continue) until all voices are taken.
+static bool CreateVoiceTestModule(CSoundFile &sndFile, CHANNELINDEX numChannels)
+//------------------------------------------------------------------------------
+{
+	sndFile.Create(FileReader(), CSoundFile::loadCompleteModule);
+	sndFile.ChangeModTypeTo(MOD_TYPE_IT);
+	sndFile.Patterns.DestroyPatterns();
+	sndFile.m_nChannels = numChannels;
+	sndFile.m_nDefaultSpeed = 1;
+
+	sndFile.m_nSamples = 1;
+	ModSample &sample = sndFile.GetSample(1);
+	sample.Initialize(MOD_TYPE_IT);
+	sample.nLength = 4000;
+	if(!sample.AllocateSample())
+	{
+		return false;
+	}
+	uint32 seed = 1;
+	for(SmpLength i = 0; i < sample.GetSampleSizeInBytes(); i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		static_cast<uint8 *>(sample.pSample)[i] = static_cast<uint8>(seed >> 16);
+	}
+	sample.SetLoop(0, sample.nLength, true, false, sndFile);
+
+	ModInstrument *pIns = sndFile.AllocateInstrument(1, 1);
+	if(pIns == nullptr)
+	{
+		return false;
+	}
+	pIns->nNNA = NNA_CONTINUE;
+	pIns->nFadeOut = 0;
+	sndFile.m_nInstruments = 1;
+
+	sndFile.Patterns.Insert(0, 64);
+	for(ROWINDEX row = 0; row < 64; row++)
+	{
+		for(CHANNELINDEX chn = 0; chn < numChannels; chn++)
+		{
+			ModCommand &m = *sndFile.Patterns[0].GetpModCommand(row, chn);
+			m.note = static_cast<ModCommand::NOTE>(NOTE_MIDDLEC + (row + chn) % 12);
+			m.instr = 1;
+			m.volcmd = VOLCMD_VOLUME;
+			m.vol = static_cast<ModCommand::VOL>(16 + (row * 7 + chn * 13) % 48);
+		}
+	}
+	sndFile.Order.resize(256);
+	for(ORDERINDEX ord = 0; ord < 256; ord++)
+	{
+		sndFile.Order[ord] = 0;
+	}
+	return true;
+}
+
+
+// The voice pool must find the same voices as scanning all voices, also after voices have been taken or changed.
+static noinline void TestVoicePool()
+//----------------------------------
+{
+	srand(1);
+	const CHANNELINDEX firstVoice = 4;
+	std::vector<ModChannel> voices(64);
+	for(int pass = 0; pass < 100; pass++)
+	{
+		for(CHANNELINDEX i = 0; i < voices.size(); i++)
+		{
+			RandomizeVoice(voices[i]);
+		}
+		VoicePool pool;
+		pool.Rebuild(&voices[0], firstVoice, static_cast<CHANNELINDEX>(voices.size()));
+		for(int note = 0; note < 20; note++)
+		{
+			const CHANNELINDEX expected = FindNNAVoiceReference(voices, firstVoice);
+			CHANNELINDEX voice = pool.GetFreeVoice(&voices[0]);
+			if(!voice) voice = pool.GetVoiceToSteal(&voices[0]);
+			VERIFY_EQUAL_NONCONT(voice, expected);
+			if(voice != expected)
+			{
+				break;
+			}
+
+			// Start a new note on the found voice and change some other voice
+			if(voice)
+			{
+				RandomizeVoice(voices[voice]);
+				voices[voice].nLength = 1000;
+				pool.Update(&voices[0], voice);
+			}
+			const CHANNELINDEX other = Rand<CHANNELINDEX>(firstVoice, static_cast<CHANNELINDEX>(voices.size() - 1));
+			RandomizeVoice(voices[other]);
+			pool.Update(&voices[0], other);
+		}
+	}
+
+#ifdef MPT_INTMIXER
+	// Voices above a lowered voice limit are faded out instead of being stopped right away.
+	MPT_SHARED_PTR<CSoundFile> pSndFile = mpt::make_shared<CSoundFile>();
+	CSoundFile &sndFile = *pSndFile;
+	if(CreateVoiceTestModule(sndFile, 4))
+	{
+		sndFile.InitPlayer(true);
+		sndFile.SetCurrentOrder(0);
+		MixBufferCollector target;
+		sndFile.Read(44100, target);
+		CHANNELINDEX playing = 0;
+		for(CHANNELINDEX i = 64; i < MAX_CHANNELS; i++)
+		{
+			if(sndFile.m_PlayState.Chn[i].nLength) playing++;
+		}
+		VERIFY_EQUAL_NONCONT(playing > 0, true);
+
+		sndFile.SetMaxVoices(64);
+		CHANNELINDEX fading = 0;
+		for(CHANNELINDEX i = 64; i < MAX_CHANNELS; i++)
+		{
+			const ModChannel &chn = sndFile.m_PlayState.Chn[i];
+			if(chn.nLength && chn.dwFlags[CHN_NOTEFADE] && chn.nFadeOutVol == 0) fading++;
+		}
+		VERIFY_EQUAL_NONCONT(fading, playing);
+
+		sndFile.Read(4096, target);
+		for(CHANNELINDEX i = 64; i < MAX_CHANNELS; i++)
+		{
+			VERIFY_EQUAL_NONCONT(sndFile.m_PlayState.Chn[i].nLength, 0);
+		}
+		sndFile.Destroy();
+	}
+#endif // MPT_INTMIXER
+}
+
+
+// Edits in the middle of a long song must only be simulated until the state converges again, and the visited rows that are
+// rebuilt from the cached entries must be the same as in a complete calculation.
+static noinline void TestSongLengthCacheEdits()
+//---------------------------------------------
+{
+	MPT_SHARED_PTR<CSoundFile> pSndFile = mpt::make_shared<CSoundFile>();
+	CSoundFile &sndFile = *pSndFile;
+	if(!CreateVoiceTestModule(sndFile, 1))
+	{
+		return;
+	}
+	// Pattern 1 is played twice, and the song ends by jumping back to an order that has already been played.
+	sndFile.Patterns.Insert(1, 64);
+	sndFile.Patterns.Insert(2, 64);
+	sndFile.Order[100] = 1;
+	sndFile.Order[120] = 1;
+	sndFile.Order[255] = 2;
+	ModCommand &jump = *sndFile.Patterns[2].GetpModCommand(63, 0);
+	jump.command = CMD_POSITIONJUMP;
+	jump.param = 140;
+	ModCommand &speedUp = *sndFile.Patterns[1].GetpModCommand(0, 0);
+	ModCommand &speedDown = *sndFile.Patterns[1].GetpModCommand(1, 0);
+
+	// Expected lengths of the edited song
+	const GetLengthType reference = sndFile.GetLength(eNoAdjust).back();
+	VERIFY_EQUAL_NONCONT(reference.lastOrder, 140);
+	speedUp.command = CMD_SPEED;
+	speedUp.param = 3;
+	speedDown.command = CMD_SPEED;
+	speedDown.param = 1;
+	const double slower = sndFile.GetLength(eNoAdjust).back().duration;
+	VERIFY_EQUAL_NONCONT(slower > reference.duration, true);
+	sndFile.Order[150] = 1;
+	const double longer = sndFile.GetLength(eNoAdjust).back().duration;
+	VERIFY_EQUAL_NONCONT(longer > slower, true);
+	sndFile.Order[150] = 0;
+	speedUp = ModCommand::Empty();
+	speedDown = ModCommand::Empty();
+
+	sndFile.m_SongLengthCache.SetEnabled(true);
+	VERIFY_EQUAL_NONCONT(sndFile.GetLength(eNoAdjust).back().duration, reference.duration);
+	const size_t fullEntries = sndFile.m_SongLengthCache.GetLastSimulatedEntries();
+	VERIFY_EQUAL_NONCONT(fullEntries >= 256, true);
+
+	speedUp.command = CMD_SPEED;
+	speedUp.param = 3;
+	speedDown.command = CMD_SPEED;
+	speedDown.param = 1;
+	sndFile.m_SongLengthCache.InvalidatePattern(1);
+	VERIFY_EQUAL_NONCONT(std::abs(sndFile.GetLength(eNoAdjust).back().duration - slower) < 1e-9, true);
+	VERIFY_EQUAL_NONCONT(sndFile.m_SongLengthCache.GetLastSimulatedEntries() < fullEntries / 4, true);
+	VERIFY_EQUAL_NONCONT(std::abs(sndFile.GetLength(eNoAdjust).back().duration - slower) < 1e-9, true);
+	VERIFY_EQUAL_NONCONT(sndFile.m_SongLengthCache.GetLastSimulatedEntries(), 0);
+
+	// Resume from an entry that has been taken over from the first calculation
+	sndFile.Order[150] = 1;
+	const GetLengthType edited = sndFile.GetLength(eNoAdjust).back();
+	VERIFY_EQUAL_NONCONT(std::abs(edited.duration - longer) < 1e-9, true);
+	VERIFY_EQUAL_NONCONT(edited.lastOrder, 140);
+	VERIFY_EQUAL_NONCONT(sndFile.m_SongLengthCache.GetLastSimulatedEntries() < fullEntries / 4, true);
+
+	sndFile.m_SongLengthCache.SetEnabled(false);
+	sndFile.Destroy();
+}
+
+
+static void GenerateCommands(CPattern& pat, const double dProbPcs, const double dProbPc)
+//--------------------------------------------------------------------------------------
+{
+	const double dPcxProb = dProbPcs + dProbPc;
+	const CPattern::const_iterator end = pat.End();
+	for(CPattern::iterator i = pat.Begin(); i != end; i++)
+	{
+		const double rand = Rand01();
+		if(rand < dPcxProb)
+		{
+			if(rand < dProbPcs)
+				i->note = NOTE_PCS;
+			else
+				i->note = NOTE_PC;
+
+			i->instr = Rand<ModCommand::INSTR>(0, MAX_MIXPLUGINS);
+			i->SetValueVolCol(Rand<uint16>(0, ModCommand::maxColumnValue));
+			i->SetValueEffectCol(Rand<uint16>(0, ModCommand::maxColumnValue));
+		}
+		else
+			i->Clear();
+	}
+}
+
+
+// Test PC note serialization
 static noinline void TestPCnoteSerialization()
 //--------------------------------------------
 {
@@ -2456,11 +3882,607 @@ static noinline void TestSampleConversion()
 		VERIFY_EQUAL_NONCONT(signed8[3], 0);
 	}
 
+#if defined(ENABLE_SSE4)
+	// The bulk decoders used by SampleIO::ReadSample must give the same results as decoding one sample at a time
+	{
+		const uint32 oldProcSupport = ProcSupport;
+		const SmpLength length = 1001;
+		std::vector<uint8> data(length * 2 * 4);
+		uint32 seed = 1;
+		for(size_t i = 0; i < data.size(); i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			data[i] = static_cast<uint8>(seed >> 16);
+		}
+		// Random bytes are mostly out of range or NaN as floating point values, so add some values in the usual range.
+		for(size_t i = 0; i + 4 <= data.size(); i += 16)
+		{
+			seed = seed * 1103515245 + 12345;
+			const uint32 le = EncodeIEEE754binary32((static_cast<int32>(seed) / 2147483648.0f) * 1.25f);
+			const uint32 be = EncodeIEEE754binary32((static_cast<int32>(seed * 3) / 2147483648.0f) * 0.75f);
+			for(int b = 0; b < 4; b++)
+			{
+				data[i + b] = static_cast<uint8>(le >> (b * 8));
+				if(i + 12 < data.size()) data[i + 8 + b] = static_cast<uint8>(be >> (24 - b * 8));
+			}
+		}
+
+		// Converting NaN to an integer is undefined in the scalar code, so there is no reference result for it.
+		for(size_t i = 0; i + 4 <= data.size(); i += 4)
+		{
+			if((data[i + 3] & 0x7F) == 0x7F && (data[i + 2] & 0x80)) data[i + 3] &= 0xBF;
+			if((data[i] & 0x7F) == 0x7F && (data[i + 1] & 0x80)) data[i] &= 0xBF;
+		}
+
+		const SampleIO::Bitdepth bitDepths[] = { SampleIO::_8bit, SampleIO::_8bit, SampleIO::_8bit, SampleIO::_16bit, SampleIO::_16bit, SampleIO::_16bit, SampleIO::_24bit, SampleIO::_32bit };
+		const SampleIO::Encoding encodings[] = { SampleIO::signedPCM, SampleIO::unsignedPCM, SampleIO::deltaPCM, SampleIO::signedPCM, SampleIO::unsignedPCM, SampleIO::deltaPCM, SampleIO::signedPCM, SampleIO::floatPCM };
+		const SampleIO::Channels channels[] = { SampleIO::mono, SampleIO::stereoInterleaved, SampleIO::stereoSplit };
+		const SampleIO::Endianness endianness[] = { SampleIO::littleEndian, SampleIO::bigEndian };
+		for(size_t f = 0; f < CountOf(bitDepths); f++)
+		{
+			for(size_t c = 0; c < CountOf(channels); c++)
+			{
+				for(size_t e = 0; e < CountOf(endianness); e++)
+				{
+					const SampleIO sampleIO(bitDepths[f], channels[c], endianness[e], encodings[f]);
+					ModSample scalar, vectorized;
+					scalar.Initialize();
+					vectorized.Initialize();
+					scalar.nLength = vectorized.nLength = length;
+
+					ProcSupport = oldProcSupport & ~(PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2);
+					FileReader scalarFile(&data[0], data.size());
+					const size_t scalarRead = sampleIO.ReadSample(scalar, scalarFile);
+
+					ProcSupport = oldProcSupport;
+					FileReader vectorizedFile(&data[0], data.size());
+					const size_t vectorizedRead = sampleIO.ReadSample(vectorized, vectorizedFile);
+
+					VERIFY_EQUAL_NONCONT(vectorizedRead, scalarRead);
+					VERIFY_EQUAL_NONCONT(vectorized.GetSampleSizeInBytes(), scalar.GetSampleSizeInBytes());
+					if(scalar.pSample != nullptr && vectorized.pSample != nullptr && scalar.GetSampleSizeInBytes() == vectorized.GetSampleSizeInBytes())
+					{
+						VERIFY_EQUAL_NONCONT(memcmp(vectorized.pSample, scalar.pSample, scalar.GetSampleSizeInBytes()), 0);
+					}
+					scalar.FreeSample();
+					vectorized.FreeSample();
+				}
+			}
+		}
+		ProcSupport = oldProcSupport;
+	}
+#endif // ENABLE_SSE4
+
+	// The encoded sample size must be what reading the sample consumes
+	{
+		const SmpLength length = 1001;
+		std::vector<uint8> data(length * 4);
+		uint32 seed = 1;
+		for(size_t i = 0; i < data.size(); i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			data[i] = static_cast<uint8>(seed >> 16);
+		}
+		// AMS header: unpacked size, packed size and pack character
+		data[4] = 0x2C; data[5] = 0x01; data[6] = 0; data[7] = 0;
+
+		const SampleIO formats[] =
+		{
+			SampleIO(SampleIO::_16bit, SampleIO::stereoSplit, SampleIO::bigEndian, SampleIO::signedPCM),
+			SampleIO(SampleIO::_8bit, SampleIO::mono, SampleIO::littleEndian, SampleIO::ADPCM),
+			SampleIO(SampleIO::_16bit, SampleIO::mono, SampleIO::littleEndian, SampleIO::PTM8Dto16),
+			SampleIO(SampleIO::_8bit, SampleIO::mono, SampleIO::littleEndian, SampleIO::AMS),
+		};
+		// The sample data may also be truncated
+		const size_t fileSizes[] = { data.size(), 100 };
+		for(size_t f = 0; f < CountOf(formats); f++)
+		{
+			for(size_t size = 0; size < CountOf(fileSizes); size++)
+			{
+				ModSample sample;
+				sample.Initialize();
+				sample.nLength = length;
+				FileReader file(&data[0], fileSizes[size]);
+				const size_t encodedSize = formats[f].CalculateEncodedSize(length, file);
+				VERIFY_EQUAL_NONCONT(encodedSize, formats[f].ReadSample(sample, file));
+				VERIFY_EQUAL_NONCONT(encodedSize > 0, true);
+				sample.FreeSample();
+			}
+		}
+	}
+
+	// The fused output stage must produce the same output as applying gain, dither and conversion in separate passes
+	{
+#if defined(ENABLE_SSE4)
+		const uint32 oldProcSupport = ProcSupport;
+		const uint32 procSupports[] = { oldProcSupport & ~(PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2), oldProcSupport & ~PROCSUPPORT_AVX2, oldProcSupport };
+#else
+		const uint32 procSupports[] = { 0 };
+#endif // ENABLE_SSE4
+		const size_t count = 301;
+		std::vector<int32> source(count * 4);
+		uint32 seed = 1;
+		for(size_t i = 0; i < source.size(); i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			source[i] = static_cast<int32>(seed) >> 3;	// Also exceeds the clipping range
+		}
+		const size_t channelCounts[] = { 1, 2, 4 };
+		const DitherMode ditherModes[] = { DitherNone, DitherModPlug, DitherSimple };
+		const int32 intGains[] = { 1 << 16, 40000, 100000 };
+		const float floatGains[] = { 1.0f, 0.3f };
+
+		for(size_t support = 0; support < CountOf(procSupports); support++)
+		{
+#if defined(ENABLE_SSE4)
+			ProcSupport = procSupports[support];
+#endif // ENABLE_SSE4
+			for(size_t c = 0; c < CountOf(channelCounts); c++)
+			{
+				const size_t channels = channelCounts[c];
+
+				for(size_t d = 0; d < CountOf(ditherModes); d++)
+				{
+					for(size_t g = 0; g < CountOf(intGains); g++)
+					{
+						std::vector<int32> mix(source.begin(), source.begin() + count * channels);
+						for(size_t i = 0; i < mix.size(); i++)
+						{
+							mix[i] = Util::muldiv(mix[i], intGains[g], 1 << 16);
+						}
+						Dither refDither;
+						refDither.SetMode(ditherModes[d]);
+						refDither.Process(&mix[0], count, channels, 16);
+						std::vector<int16> expected(count * channels);
+						ConvertInterleavedFixedPointToInterleaved<MIXING_FRACTIONAL_BITS, false>(&expected[0], &mix[0], channels, count);
+
+						mix.assign(source.begin(), source.begin() + count * channels);
+						Dither dither;
+						dither.SetMode(ditherModes[d]);
+						std::vector<int16> interleaved(count * channels), planarData(count * channels);
+						int16 *planar[4];
+						for(size_t chn = 0; chn < channels; chn++)
+						{
+							planar[chn] = &planarData[chn * count];
+						}
+						ConvertMixBufferToOutput(&interleaved[0], planar, &mix[0], channels, count, dither, intGains[g]);
+
+						bool planarEqual = true;
+						for(size_t i = 0; i < expected.size(); i++)
+						{
+							planarEqual = planarEqual && (planar[i % channels][i / channels] == expected[i]);
+						}
+						VERIFY_EQUAL_NONCONT(interleaved == expected, true);
+						VERIFY_EQUAL_NONCONT(planarEqual, true);
+					}
+				}
+
+				for(int clip = 0; clip < 2; clip++)
+				{
+					for(size_t g = 0; g < CountOf(floatGains); g++)
+					{
+						std::vector<float> expected(count * channels);
+						if(clip)
+						{
+							ConvertInterleavedFixedPointToInterleaved<MIXING_FRACTIONAL_BITS, true>(&expected[0], &source[0], channels, count);
+						} else
+						{
+							ConvertInterleavedFixedPointToInterleaved<MIXING_FRACTIONAL_BITS, false>(&expected[0], &source[0], channels, count);
+						}
+						for(size_t i = 0; i < expected.size(); i++)
+						{
+							expected[i] *= floatGains[g];
+						}
+
+						std::vector<float> interleaved(count * channels), planarData(count * channels);
+						float *planar[4];
+						for(size_t chn = 0; chn < channels; chn++)
+						{
+							planar[chn] = &planarData[chn * count];
+						}
+						ConvertMixBufferToOutput(&interleaved[0], planar, &source[0], channels, count, clip != 0, floatGains[g]);
+
+						bool planarEqual = true;
+						for(size_t i = 0; i < expected.size(); i++)
+						{
+							planarEqual = planarEqual && (planar[i % channels][i / channels] == expected[i]);
+						}
+						VERIFY_EQUAL_NONCONT(interleaved == expected, true);
+						VERIFY_EQUAL_NONCONT(planarEqual, true);
+					}
+				}
+			}
+		}
+#if defined(ENABLE_SSE4)
+		ProcSupport = oldProcSupport;
+#endif // ENABLE_SSE4
+	}
+
 	delete[] sourceBuf;
 	delete[] static_cast<uint8*>(targetBuf);
 }
 
 
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmarks
+// They are not part of the test suite. Run "make bench" or "libopenmpt_test --benchmark" to print the results.
+// The numbers are wall clock times, so run them on an otherwise idle machine.
+
+
+// Repeats an operation for a minimum amount of time and reports its average duration.
+class BenchmarkTimer
+{
+protected:
+	uint64 start, elapsed, minDuration;
+	uint64 iterations;
+
+public:
+	BenchmarkTimer(uint64 minDurationMs = 200) : start(Util::GetTimestampNanoseconds()), elapsed(0), minDuration(minDurationMs * 1000000), iterations(0) { }
+
+	// Call after each repetition. Returns true as long as the operation should be repeated.
+	bool Repeat()
+	{
+		iterations++;
+		elapsed = Util::GetTimestampNanoseconds() - start;
+		return elapsed < minDuration;
+	}
+
+	double GetMicroseconds() const { return iterations ? static_cast<double>(elapsed) / 1000.0 / static_cast<double>(iterations) : 0.0; }
+};
+
+
+// Loader messages would only distort the timings.
+class NullLog : public ILog
+{
+public:
+	virtual void AddToLog(LogLevel, const mpt::ustring &) const { }
+};
+
+
+static std::vector<char> ReadTestFile(const mpt::PathString &filename)
+//--------------------------------------------------------------------
+{
+	mpt::ifstream stream(filename, std::ios::binary);
+	FileReader file(&stream);
+	std::vector<char> data(file.GetLength());
+	if(!data.empty())
+	{
+		file.ReadRaw(&data[0], data.size());
+	}
+	return data;
+}
+
+
+// Cost of finding the right loader for the files of the test corpus: Signature matching alone, Create() with header verification only, and a complete load.
+// test.flac is not a module, so its header check goes through all loaders.
+static noinline void BenchmarkFormatProbing()
+//-------------------------------------------
+{
+	static const char * const extensions[] = { "mptm", "xm", "s3m", "flac" };
+
+	std::cout << "Format probing (microseconds per file)" << std::endl;
+	std::cout << "file        format  signatures  header check   full load" << std::endl;
+	NullLog log;
+	MPT_SHARED_PTR<CSoundFile> sndFile = mpt::make_shared<CSoundFile>();
+	sndFile->SetCustomLog(&log);
+	for(std::size_t i = 0; i < CountOf(extensions); i++)
+	{
+		const std::vector<char> data = ReadTestFile(GetTestFilenameBase() + mpt::PathString::FromUTF8(extensions[i]));
+		if(data.empty())
+		{
+			continue;
+		}
+		FileReader file(&data[0], data.size());
+
+		std::vector<const char *> formats;
+		BenchmarkTimer signatureTimer;
+		do
+		{
+			formats = CSoundFile::ProbeFormatSignatures(file);
+		} while(signatureTimer.Repeat());
+
+		BenchmarkTimer headerTimer;
+		do
+		{
+			sndFile->Create(file, CSoundFile::onlyVerifyHeader);
+			sndFile->Destroy();
+		} while(headerTimer.Repeat());
+
+		BenchmarkTimer loadTimer;
+		do
+		{
+			sndFile->Create(file, CSoundFile::loadCompleteModule);
+			sndFile->Destroy();
+		} while(loadTimer.Repeat());
+
+		std::cout << std::left << std::setw(12) << (std::string("test.") + extensions[i]) << std::setw(8) << (formats.empty() ? "-" : formats[0]) << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << signatureTimer.GetMicroseconds()
+			<< std::setw(14) << headerTimer.GetMicroseconds()
+			<< std::setw(12) << loadTimer.GetMicroseconds() << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+
+// Throughput of SampleIO::ReadSample for the formats that have bulk decoders, with the per-sample functors ("scalar") and with the SSE4.1 bulk decoders.
+// The throughput is given in bytes of encoded sample data per second and includes allocating the sample.
+static noinline void BenchmarkSampleDecoding()
+//--------------------------------------------
+{
+	const SmpLength length = 1024 * 1024;
+	std::vector<uint8> data(length * 2 * 4);
+	uint32 seed = 1;
+	for(size_t i = 0; i < data.size(); i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		data[i] = static_cast<uint8>(seed >> 16);
+	}
+	// Floating point data in the usual range
+	std::vector<uint8> floatData(data.size());
+	for(size_t i = 0; i + 4 <= floatData.size(); i += 4)
+	{
+		seed = seed * 1103515245 + 12345;
+		const uint32 value = EncodeIEEE754binary32(static_cast<int32>(seed) / 2147483648.0f);
+		for(int b = 0; b < 4; b++)
+		{
+			floatData[i + b] = static_cast<uint8>(value >> (b * 8));
+		}
+	}
+
+	static const char * const encodingNames[] = { "signed", "unsigned", "delta", "float" };
+	static const char * const channelNames[] = { "mono", "interleaved", "split" };
+	const SampleIO::Bitdepth bitDepths[] = { SampleIO::_8bit, SampleIO::_8bit, SampleIO::_8bit, SampleIO::_16bit, SampleIO::_16bit, SampleIO::_16bit, SampleIO::_24bit, SampleIO::_32bit };
+	const SampleIO::Encoding encodings[] = { SampleIO::signedPCM, SampleIO::unsignedPCM, SampleIO::deltaPCM, SampleIO::signedPCM, SampleIO::unsignedPCM, SampleIO::deltaPCM, SampleIO::signedPCM, SampleIO::floatPCM };
+	const SampleIO::Channels channels[] = { SampleIO::mono, SampleIO::stereoInterleaved, SampleIO::stereoSplit };
+	const SampleIO::Endianness endianness[] = { SampleIO::littleEndian, SampleIO::bigEndian };
+
+#if defined(ENABLE_SSE4)
+	const uint32 oldProcSupport = ProcSupport;
+#endif // ENABLE_SSE4
+	std::cout << "Sample decoding (GB/s of encoded data, " << length << " sampling points)" << std::endl;
+	std::cout << "format                          scalar   SSE4.1" << std::endl;
+	for(size_t f = 0; f < CountOf(bitDepths); f++)
+	{
+		const std::vector<uint8> &input = (encodings[f] == SampleIO::floatPCM) ? floatData : data;
+		for(size_t c = 0; c < CountOf(channels); c++)
+		{
+			for(size_t e = 0; e < CountOf(endianness); e++)
+			{
+				const SampleIO sampleIO(bitDepths[f], channels[c], endianness[e], encodings[f]);
+				double throughput[2];
+				size_t bytesRead = 0;
+				for(int vectorized = 0; vectorized < 2; vectorized++)
+				{
+#if defined(ENABLE_SSE4)
+					ProcSupport = vectorized ? oldProcSupport : (oldProcSupport & ~(PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2));
+#else
+					if(vectorized)
+					{
+						throughput[vectorized] = 0.0;
+						continue;
+					}
+#endif // ENABLE_SSE4
+					BenchmarkTimer timer(100);
+					do
+					{
+						ModSample sample;
+						sample.Initialize();
+						sample.nLength = length;
+						FileReader file(&input[0], input.size());
+						bytesRead = sampleIO.ReadSample(sample, file);
+						sample.FreeSample();
+					} while(timer.Repeat());
+					throughput[vectorized] = bytesRead / timer.GetMicroseconds() / 1000.0;
+				}
+				if(bytesRead == 0)
+				{
+					// Format is not supported by SampleIO
+					continue;
+				}
+#if defined(ENABLE_SSE4)
+				if(!(oldProcSupport & PROCSUPPORT_SSE4_1))
+				{
+					throughput[1] = 0.0;
+				}
+#endif // ENABLE_SSE4
+
+				std::ostringstream name;
+				name << bitDepths[f] << "-bit " << encodingNames[encodings[f]] << " " << channelNames[channels[c]] << (endianness[e] == SampleIO::bigEndian ? " BE" : " LE");
+				std::cout << std::left << std::setw(30) << name.str() << std::right << std::fixed << std::setprecision(2)
+					<< std::setw(8) << throughput[0]
+					<< std::setw(9) << throughput[1] << std::endl;
+			}
+		}
+	}
+#if defined(ENABLE_SSE4)
+	ProcSupport = oldProcSupport;
+#endif // ENABLE_SSE4
+	std::cout << std::endl;
+}
+
+
+// Processing cost of the reverb per second of 44.1kHz stereo audio, with the portable code and with the SSE2 kernels.
+// The reverb is fed with noise all the time, so it never shuts itself down. Filling the send and output buffers is included in the timings.
+static noinline void BenchmarkReverb()
+//------------------------------------
+{
+#ifndef NO_REVERB
+	const uint32 frames = 44100, chunkSize = 512;
+	std::vector<int> noise(chunkSize * 2);
+	uint32 seed = 1;
+	for(size_t i = 0; i < noise.size(); i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		noise[i] = static_cast<int>((seed >> 8) % (1 << 25)) - (1 << 24);
+	}
+	std::vector<int> output(chunkSize * 2);
+	const int reverbTypes[] = { 1, 5, 12, 28 };
+
+#if defined(MPT_INTRINSICS_X86)
+	const uint32 oldProcSupport = ProcSupport;
+#endif // MPT_INTRINSICS_X86
+	std::cout << "Reverb (milliseconds per second of audio)" << std::endl;
+	std::cout << "preset                portable     SSE2" << std::endl;
+	for(size_t t = 0; t < CountOf(reverbTypes); t++)
+	{
+		double cost[2];
+		for(int vectorized = 0; vectorized < 2; vectorized++)
+		{
+#if defined(MPT_INTRINSICS_X86)
+			if(vectorized && !(oldProcSupport & PROCSUPPORT_SSE2))
+			{
+				cost[vectorized] = 0.0;
+				continue;
+			}
+			ProcSupport = vectorized ? oldProcSupport : (oldProcSupport & ~(PROCSUPPORT_SSE2 | PROCSUPPORT_SSE4_1 | PROCSUPPORT_AVX2));
+#else
+			if(vectorized)
+			{
+				cost[vectorized] = 0.0;
+				continue;
+			}
+#endif // MPT_INTRINSICS_X86
+			MPT_SHARED_PTR<CReverb> reverb = mpt::make_shared<CReverb>();
+			reverb->m_Settings.m_nReverbType = reverbTypes[t];
+			reverb->Initialize(true, 44100);
+			BenchmarkTimer timer;
+			do
+			{
+				for(uint32 pos = 0; pos < frames; pos += chunkSize)
+				{
+					const uint32 count = std::min(chunkSize, frames - pos);
+					int *send = reverb->GetReverbSendBuffer(count);
+					for(uint32 i = 0; i < count * 2; i++)
+					{
+						send[i] += noise[i];
+					}
+					std::fill(output.begin(), output.end(), 0);
+					reverb->Process(&output[0], count);
+				}
+			} while(timer.Repeat());
+			cost[vectorized] = timer.GetMicroseconds() / 1000.0;
+		}
+		std::cout << std::left << std::setw(20) << GetReverbPresetName(reverbTypes[t]) << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << cost[0]
+			<< std::setw(9) << cost[1] << std::endl;
+	}
+#if defined(MPT_INTRINSICS_X86)
+	ProcSupport = oldProcSupport;
+#endif // MPT_INTRINSICS_X86
+	std::cout << std::endl;
+#endif // NO_REVERB
+}
+
+
+// Cost of GetLength() on a long MPTM sequence (400 orders of 1024-row patterns): a seek to a row of the first order, which is dominated by setting up
+// the visited rows, and the complete song length. Followed by openmpt::module::set_position_seconds to the middle of the modules of the test corpus.
+static noinline void BenchmarkSeeking()
+//-------------------------------------
+{
+	std::cout << "Seeking (microseconds per seek)" << std::endl;
+	{
+		MPT_SHARED_PTR<CSoundFile> pSndFile = mpt::make_shared<CSoundFile>();
+		CSoundFile &sndFile = *pSndFile;
+		sndFile.Create(FileReader(), CSoundFile::loadCompleteModule);
+		sndFile.ChangeModTypeTo(MOD_TYPE_MPT);
+		sndFile.Patterns.DestroyPatterns();
+		sndFile.m_nChannels = 4;
+		sndFile.Patterns.Insert(0, 1024);
+		sndFile.Order.resize(400);
+		for(ORDERINDEX ord = 0; ord < 400; ord++)
+		{
+			sndFile.Order[ord] = 0;
+		}
+
+		BenchmarkTimer shortTimer;
+		do
+		{
+			sndFile.GetLength(eNoAdjust, GetLengthTarget(0, 16));
+		} while(shortTimer.Repeat());
+
+		BenchmarkTimer fullTimer;
+		do
+		{
+			sndFile.GetLength(eNoAdjust);
+		} while(fullTimer.Repeat());
+
+		std::cout << std::left << std::setw(24) << "400x1024 rows, row 16" << std::right << std::fixed << std::setprecision(2) << std::setw(12) << shortTimer.GetMicroseconds() << std::endl;
+		std::cout << std::left << std::setw(24) << "400x1024 rows, length" << std::right << std::fixed << std::setprecision(2) << std::setw(12) << fullTimer.GetMicroseconds() << std::endl;
+		sndFile.Destroy();
+	}
+
+#ifdef LIBOPENMPT_BUILD
+	static const char * const extensions[] = { "mptm", "xm", "s3m" };
+	for(std::size_t i = 0; i < CountOf(extensions); i++)
+	{
+		const std::vector<char> data = ReadTestFile(GetTestFilenameBase() + mpt::PathString::FromUTF8(extensions[i]));
+		if(data.empty())
+		{
+			continue;
+		}
+		std::ostringstream log;
+		openmpt::module mod(data, log);
+		const double target = mod.get_duration_seconds() / 2.0;
+		BenchmarkTimer timer;
+		do
+		{
+			mod.set_position_seconds(target);
+		} while(timer.Repeat());
+		std::cout << std::left << std::setw(24) << (std::string("test.") + extensions[i] + ", middle") << std::right << std::fixed << std::setprecision(2) << std::setw(12) << timer.GetMicroseconds() << std::endl;
+	}
+#endif // LIBOPENMPT_BUILD
+	std::cout << std::endl;
+}
+
+
+// Measures the cost of ReadNote() per tick depending on the number of playing voices.
+static noinline void BenchmarkVoices()
+//------------------------------------
+{
+	std::cout << "Voice allocation (microseconds per tick)" << std::endl;
+	static const CHANNELINDEX channels[] = { 4, 16, 64 };
+	static const CHANNELINDEX limits[] = { 64, 128, 256 };
+	for(std::size_t c = 0; c < CountOf(channels); c++)
+	{
+		MPT_SHARED_PTR<CSoundFile> pSndFile = mpt::make_shared<CSoundFile>();
+		CSoundFile &sndFile = *pSndFile;
+		if(!CreateVoiceTestModule(sndFile, channels[c]))
+		{
+			continue;
+		}
+
+		for(std::size_t l = 0; l < CountOf(limits); l++)
+		{
+			sndFile.SetMaxVoices(limits[l]);
+			sndFile.ResetChannels();
+			sndFile.InitPlayer(true);
+			sndFile.SetCurrentOrder(0);
+			// Fill up all voices first
+			for(int i = 0; i < 512; i++)
+			{
+				sndFile.ReadNote();
+			}
+
+			BenchmarkTimer timer;
+			do
+			{
+				if(!sndFile.ReadNote())
+				{
+					sndFile.SetCurrentOrder(0);
+				}
+			} while(timer.Repeat());
+
+			std::ostringstream name;
+			name << channels[c] << " channels, " << sndFile.m_nMixChannels << " voices";
+			std::cout << std::left << std::setw(24) << name.str() << std::right << std::fixed << std::setprecision(2) << std::setw(12) << timer.GetMicroseconds() << std::endl;
+		}
+		sndFile.Destroy();
+	}
+	std::cout << std::endl;
+}
+
+
 } // namespace Test
 
 OPENMPT_NAMESPACE_END
@@ -2477,6 +4499,12 @@ void DoTests()
 	return;
 }
 
+void DoBenchmarks()
+//-----------------
+{
+	return;
+}
+
 } // namespace Test
 
 OPENMPT_NAMESPACE_END
@@ -17,6 +17,9 @@ namespace Test {
 
 void DoTests();
 
+// Not part of the test suite, prints timings to stdout.
+void DoBenchmarks();
+
 } // namespace Test
 
 OPENMPT_NAMESPACE_END